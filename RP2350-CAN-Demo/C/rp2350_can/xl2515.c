@@ -11,6 +11,7 @@
 
 
 bool g_xl2515_recv_flag = false;
+static uint32_t g_xl2515_recv_id = 0;  // Standard ID of the last received frame
 static void xl2515_write_reg(uint8_t reg, uint8_t *data, uint8_t len)
 {
     uint8_t buf[len + 2];
@@ -191,6 +192,9 @@ bool xl2515_recv(uint32_t can_id, uint8_t *data, uint8_t *len)
                 data[i] = xl2515_read_reg_byte(RXB0D0 + i);
                 // printf("rx buf =%d\r\n",CAN_RX_Buf[i]);
             }
+            // Latch the ID before the buffer is released to the next frame
+            g_xl2515_recv_id = ((uint32_t)xl2515_read_reg_byte(RXB0SIDH) << 3) |
+                               (xl2515_read_reg_byte(RXB0SIDL) >> 5);
             break;
         }
     }
@@ -201,3 +205,32 @@ bool xl2515_recv(uint32_t can_id, uint8_t *data, uint8_t *len)
     xl2515_write_reg_byte(RXB0SIDL, 0x60);
     return true;
 }
+
+uint32_t xl2515_recv_can_id(void)
+{
+    return g_xl2515_recv_id;
+}
+
+// Accept only two standard IDs into RXB0 (filters RXF0/RXF1, mask RXM0);
+// filters can only be written in configuration mode
+void xl2515_set_rx_filters(uint32_t id0, uint32_t id1)
+{
+    uint8_t dly = 0;
+
+    xl2515_write_reg_byte(CANCTRL, REQOP_CONFIG | CLKOUT_ENABLED);
+    while (((xl2515_read_reg_byte(CANSTAT) & 0xe0) != OPMODE_CONFIG) && (dly < 50))
+    {
+        sleep_ms(1);
+        dly++;
+    }
+
+    xl2515_write_reg_byte(RXM0SIDH, 0xFF);
+    xl2515_write_reg_byte(RXM0SIDL, 0xE0);
+    xl2515_write_reg_byte(RXF0SIDH, (id0 >> 3) & 0XFF);
+    xl2515_write_reg_byte(RXF0SIDL, (id0 & 0x07) << 5);
+    xl2515_write_reg_byte(RXF1SIDH, (id1 >> 3) & 0XFF);
+    xl2515_write_reg_byte(RXF1SIDL, (id1 & 0x07) << 5);
+    xl2515_write_reg_byte(RXB0CTRL, 0x00);  // Filters on, no rollover
+
+    xl2515_write_reg_byte(CANCTRL, REQOP_NORMAL | CLKOUT_ENABLED);
+}
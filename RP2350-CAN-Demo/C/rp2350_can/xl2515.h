@@ -412,6 +412,8 @@ void xl2515_reset(void);
 void xl2515_init(xl2515_rate_kbps_t rate_kbps);
 void xl2515_send(uint32_t can_id, uint8_t *data, uint8_t len);
 bool xl2515_recv(uint32_t can_id, uint8_t *data, uint8_t *len);
+uint32_t xl2515_recv_can_id(void);
+void xl2515_set_rx_filters(uint32_t id0, uint32_t id1);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,14 @@
+#ifndef __PICO_HOST_HARDWARE_FLASH_H__
+#define __PICO_HOST_HARDWARE_FLASH_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define FLASH_PAGE_SIZE         256u
+#define FLASH_SECTOR_SIZE       4096u
+
+// NOR semantics on the host image: erase sets bytes to 0xFF, program can only clear bits
+void flash_range_erase(uint32_t flash_offs, size_t count);
+void flash_range_program(uint32_t flash_offs, const uint8_t *data, size_t count);
+
+#endif // __PICO_HOST_HARDWARE_FLASH_H__
@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "obd2_vehicle.h"
+#include "obd2_vehicle_batch.h"
+#include "obd2_fault.h"
+
+// Host check: the batched model against obd2_vehicle_step()
+//
+//   obd2_batch_check [vehicles] [seconds]
+//
+// Steps the same fleet through both models and reports every field, and
+// every fault rule signal captured from it, that differs after any tick;
+// exits non-zero on the first tick with a mismatch.
+// The MIL is on for odd vehicles so distance with MIL is exercised too.
+
+#define CHECK_DEFAULT_VEHICLES      500
+#define CHECK_DEFAULT_SECONDS       1800
+
+#define CHECK_FIELD(field) \
+    if (batched.field != model->field) { \
+        printf("tick %lu vehicle %lu: " #field " %g, model %g\r\n", (unsigned long)tick, \
+               (unsigned long)i, (double)batched.field, (double)model->field); \
+        mismatches++; \
+    }
+
+static uint32_t compare_vehicles(const obd2_vehicle_batch_t *batch, const obd2_vehicle_t *models,
+                                 uint32_t count, uint32_t tick)
+{
+    uint32_t mismatches = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+        const obd2_vehicle_t *model = &models[i];
+        obd2_vehicle_t batched;
+
+        obd2_vehicle_batch_load(batch, i, &batched);
+        CHECK_FIELD(engine_runtime);
+        CHECK_FIELD(base_rpm);
+        CHECK_FIELD(throttle_position);
+        CHECK_FIELD(vehicle_speed);
+        CHECK_FIELD(engine_load);
+        CHECK_FIELD(coolant_temp);
+        CHECK_FIELD(intake_temp);
+        CHECK_FIELD(fuel_level);
+        CHECK_FIELD(engine_running);
+        CHECK_FIELD(maf_flow_rate);
+        CHECK_FIELD(fuel_pressure);
+        CHECK_FIELD(manifold_pressure);
+        CHECK_FIELD(o2_sensor_b1s1);
+        CHECK_FIELD(o2_sensor_b1s2);
+        CHECK_FIELD(short_fuel_trim_b1);
+        CHECK_FIELD(long_fuel_trim_b1);
+        CHECK_FIELD(timing_advance);
+        CHECK_FIELD(simulation_cycle);
+        CHECK_FIELD(fuel_trim_integrator);
+        CHECK_FIELD(odometer_m);
+        CHECK_FIELD(distance_since_clear_m);
+        CHECK_FIELD(distance_with_mil_m);
+        CHECK_FIELD(warmups_since_clear);
+        CHECK_FIELD(distance_mm);
+        CHECK_FIELD(start_coolant_temp);
+        CHECK_FIELD(warmup_counted);
+
+        int32_t signals[OBD2_SIGNAL_COUNT];
+        int32_t model_signals[OBD2_SIGNAL_COUNT];
+        obd2_vehicle_batch_capture_signals(batch, i, signals);
+        obd2_fault_capture_signals(model, model_signals);
+        for (uint8_t s = 0; s < OBD2_SIGNAL_COUNT; s++) {
+            if (signals[s] != model_signals[s]) {
+                printf("tick %lu vehicle %lu: signal %u %ld, model %ld\r\n", (unsigned long)tick,
+                       (unsigned long)i, s, (long)signals[s], (long)model_signals[s]);
+                mismatches++;
+            }
+        }
+    }
+    return mismatches;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t count = (argc > 1) ? strtoul(argv[1], NULL, 10) : CHECK_DEFAULT_VEHICLES;
+    uint32_t seconds = (argc > 2) ? strtoul(argv[2], NULL, 10) : CHECK_DEFAULT_SECONDS;
+    uint32_t ticks = seconds * (1000 / OBD2_VEHICLE_TICK_MS);
+    obd2_vehicle_t *models = calloc(count ? count : 1, sizeof(obd2_vehicle_t));
+    uint8_t *mil_on = calloc(count ? count : 1, 1);
+    obd2_vehicle_batch_t batch;
+
+    if (models == NULL || mil_on == NULL || !obd2_vehicle_batch_init(&batch, count)) {
+        printf("Cannot allocate %lu vehicles\r\n", (unsigned long)count);
+        return 1;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        obd2_vehicle_init(&models[i], i + 1);
+        obd2_vehicle_batch_store(&batch, i, &models[i]);
+        mil_on[i] = i & 1;
+    }
+
+    for (uint32_t tick = 1; tick <= ticks; tick++) {
+        for (uint32_t i = 0; i < count; i++) {
+            obd2_vehicle_step(&models[i], mil_on[i]);
+        }
+        obd2_vehicle_batch_step(&batch, 0, count, mil_on);
+
+        uint32_t mismatches = compare_vehicles(&batch, models, count, tick);
+        if (mismatches != 0) {
+            printf("FAIL: %lu mismatches at tick %lu\r\n", (unsigned long)mismatches, (unsigned long)tick);
+            return 1;
+        }
+    }
+
+    printf("OK: %lu vehicles, %lu ticks, batch matches the model\r\n",
+           (unsigned long)count, (unsigned long)ticks);
+    obd2_vehicle_batch_free(&batch);
+    free(mil_on);
+    free(models);
+    return 0;
+}
@@ -0,0 +1,650 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include "obd2_fleet.h"
+#include "obd2_vehicle.h"
+#include "obd2_vehicle_batch.h"
+#include "obd2_protocol.h"
+#include "obd2_dtc.h"
+#include "obd2_fault.h"
+#include "obd2_memo.h"
+
+#define FLEET_LINE_MAX          128     // One stream line: time, vehicle, response bytes
+#define FLEET_STREAM_RESPONSE   32      // Longest streamed response (VIN is 20)
+#define FLEET_CACHE_LINE        64
+
+// DTCs of one vehicle (its model lives in the fleet's batch). The firmware's
+// DTC manager is a single static instance of about 7 KB (hash index, status
+// bitsets, cached payloads) tied to the flash log and freeze frames, so it
+// is not instantiated per vehicle. A fleet vehicle keeps at most
+// OBD2_FLEET_MAX_DTCS entries instead and runs them through the manager's
+// own lifecycle (obd2_dtc_entry_*); it has no flash log or freeze frames.
+typedef struct {
+    dtc_entry_t dtcs[OBD2_FLEET_MAX_DTCS];
+    uint8_t dtc_count;
+    uint8_t tested;                     // Bit per entry: result reported this driving cycle
+    bool warmup_counted;                // The model's flag as of the last tick
+} fleet_vehicle_t;
+
+_Static_assert(OBD2_FLEET_MAX_DTCS <= 8, "tested has a bit per DTC entry");
+
+// Aggregate of one chunk, summed in chunk order after the tick
+typedef struct {
+    uint32_t running;
+    uint32_t mil_on;
+    uint32_t dtcs;
+    uint64_t rpm_sum;
+    uint64_t speed_sum;
+    int64_t coolant_sum;
+} fleet_telemetry_t;
+
+// Worker share of the chunks; next is claimed by the owner and by thieves
+typedef struct {
+    _Alignas(FLEET_CACHE_LINE) atomic_uint next;
+    uint32_t end;
+    uint64_t steals;
+    pthread_t thread;
+    struct obd2_fleet *fleet;
+    uint8_t index;
+} fleet_worker_t;
+
+struct obd2_fleet {
+    obd2_fleet_config_t config;
+    obd2_vehicle_batch_t models;        // Vehicle models, stepped a chunk per call
+    fleet_vehicle_t *vehicles;
+    uint8_t *mil_on;                    // Per vehicle, kept in step with the DTC sets
+    uint32_t chunk_count;
+
+    // The firmware's fault rules, compiled once and evaluated per vehicle
+    obd2_fault_table_t faults;
+    obd2_fault_state_t *fault_states;
+    int32_t *fault_debounce;            // faults.count per vehicle
+    uint32_t *fault_passed;             // OBD2_FAULT_PASSED_WORDS(faults.count) per vehicle
+
+    // Per-chunk output, joined in order so the stream is deterministic
+    char *stream_buffers;               // chunk_count * stream_chunk_size
+    uint32_t *stream_lengths;
+    size_t stream_chunk_size;
+    fleet_telemetry_t *telemetry;
+
+    fleet_worker_t workers[OBD2_FLEET_MAX_THREADS];
+    pthread_barrier_t tick_start;
+    pthread_barrier_t tick_done;
+    bool stopping;
+
+    uint32_t tick;
+    bool output_due;
+    uint64_t vehicle_ticks;
+
+    // Service 01 data answered through obd2_fleet_respond() in this tick
+    obd2_memo_t memo;
+};
+
+// DTC set
+
+static int find_dtc(const fleet_vehicle_t *vehicle, uint16_t code, uint8_t type)
+{
+    for (uint8_t i = 0; i < vehicle->dtc_count; i++) {
+        if (vehicle->dtcs[i].code == code && vehicle->dtcs[i].type == type) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void remove_dtc(fleet_vehicle_t *vehicle, uint8_t index)
+{
+    uint8_t last = --vehicle->dtc_count;
+
+    vehicle->dtcs[index] = vehicle->dtcs[last];
+    vehicle->tested = (vehicle->tested & ~(1u << index)) | (((vehicle->tested >> last) & 1u) << index);
+    vehicle->tested &= ~(1u << last);
+}
+
+static uint8_t count_dtcs(const fleet_vehicle_t *vehicle, uint8_t status_mask)
+{
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < vehicle->dtc_count; i++) {
+        if (vehicle->dtcs[i].status & status_mask) {
+            count++;
+        }
+    }
+    return count;
+}
+
+static void update_mil(obd2_fleet_t *fleet, uint32_t index)
+{
+    fleet->mil_on[index] = count_dtcs(&fleet->vehicles[index], DTC_STATUS_WARNING_INDICATOR_REQUESTED) > 0;
+}
+
+// Lifecycle events, as obd2_dtc_report_result(), obd2_dtc_end_driving_cycle()
+// and obd2_dtc_warmup_cycle() do for the firmware's vehicle; removal swaps
+// the last entry in, so the sweeps run backwards
+
+static void report_result(obd2_fleet_t *fleet, uint32_t index, uint16_t code, uint8_t type,
+                          bool failed, bool mil)
+{
+    fleet_vehicle_t *vehicle = &fleet->vehicles[index];
+    int i = find_dtc(vehicle, code, type);
+
+    if (i < 0) {
+        // A passing test has nothing to update; a full set drops new codes
+        if (!failed || vehicle->dtc_count >= OBD2_FLEET_MAX_DTCS) {
+            return;
+        }
+        i = vehicle->dtc_count++;
+        memset(&vehicle->dtcs[i], 0, sizeof(dtc_entry_t));
+        vehicle->dtcs[i].code = code;
+        vehicle->dtcs[i].type = type;
+        vehicle->dtcs[i].active = true;
+        vehicle->dtcs[i].timestamp = fleet->tick * OBD2_VEHICLE_TICK_MS;
+    }
+
+    obd2_dtc_entry_result(&vehicle->dtcs[i], failed, mil);
+    vehicle->tested |= 1u << i;
+    update_mil(fleet, index);
+}
+
+static void end_driving_cycle(obd2_fleet_t *fleet, uint32_t index)
+{
+    fleet_vehicle_t *vehicle = &fleet->vehicles[index];
+
+    for (int i = vehicle->dtc_count - 1; i >= 0; i--) {
+        if ((vehicle->tested & (1u << i)) && !obd2_dtc_entry_end_cycle(&vehicle->dtcs[i])) {
+            remove_dtc(vehicle, i);
+        }
+    }
+    vehicle->tested = 0;
+    update_mil(fleet, index);
+}
+
+static void warmup_cycle(obd2_fleet_t *fleet, uint32_t index)
+{
+    fleet_vehicle_t *vehicle = &fleet->vehicles[index];
+
+    for (int i = vehicle->dtc_count - 1; i >= 0; i--) {
+        if (!obd2_dtc_entry_warmup(&vehicle->dtcs[i])) {
+            remove_dtc(vehicle, i);
+        }
+    }
+}
+
+// Service 04: permanent entries stay with their status reset
+static void clear_diagnostic_info(obd2_fleet_t *fleet, uint32_t index)
+{
+    fleet_vehicle_t *vehicle = &fleet->vehicles[index];
+
+    for (int i = vehicle->dtc_count - 1; i >= 0; i--) {
+        if (!obd2_dtc_entry_clear(&vehicle->dtcs[i])) {
+            remove_dtc(vehicle, i);
+        }
+    }
+    vehicle->tested = 0;
+    update_mil(fleet, index);
+}
+
+// Drives: every OBD2_FLEET_DRIVE_TICKS (staggered by index) the engine stops
+// for one tick, which ends the driving cycle, and then starts again
+static void update_drive(obd2_fleet_t *fleet, uint32_t index)
+{
+    fleet_vehicle_t *vehicle = &fleet->vehicles[index];
+    bool running = fleet->models.engine_running[index] != 0;
+
+    if (!running || (fleet->tick + index) % OBD2_FLEET_DRIVE_TICKS == 0) {
+        obd2_vehicle_t model;
+        obd2_vehicle_batch_load(&fleet->models, index, &model);
+        obd2_vehicle_set_engine_state(&model, !running);
+        obd2_vehicle_batch_store(&fleet->models, index, &model);
+        if (running) {
+            end_driving_cycle(fleet, index);
+        }
+    }
+
+    // A completed warm-up ages the DTCs that no longer request the MIL
+    bool warmup_counted = fleet->models.warmup_counted[index] != 0;
+    if (warmup_counted && !vehicle->warmup_counted) {
+        warmup_cycle(fleet, index);
+    }
+    vehicle->warmup_counted = warmup_counted;
+}
+
+// Fault rules
+
+typedef struct {
+    obd2_fleet_t *fleet;
+    uint32_t index;
+} fleet_fault_context_t;
+
+static void report_fault(void *context, const obd2_fault_rule_t *rule, bool failed)
+{
+    fleet_fault_context_t *fault = context;
+
+    report_result(fault->fleet, fault->index, rule->code, rule->type, failed, rule->mil);
+}
+
+// Every tick, like the firmware's obd2_fault_tick(), on the batch's signals
+static void evaluate_faults(obd2_fleet_t *fleet, uint32_t index)
+{
+    fleet_fault_context_t context = { fleet, index };
+    int32_t signals[OBD2_SIGNAL_COUNT];
+    bool running = fleet->models.engine_running[index] != 0;
+
+    if (running) {
+        obd2_vehicle_batch_capture_signals(&fleet->models, index, signals);
+    }
+    obd2_fault_evaluate(&fleet->faults, &fleet->fault_states[index], running, signals,
+                        report_fault, &context);
+}
+
+// Responder
+
+static uint16_t negative_response(uint8_t service, uint8_t nrc, uint8_t *response)
+{
+    response[0] = 0x7F;
+    response[1] = service;
+    response[2] = nrc;
+    return 3;
+}
+
+// Service 03 lists confirmed DTCs, 07 pending and 0A permanent ones
+static bool dtc_listed(const dtc_entry_t *entry, uint8_t service)
+{
+    switch (service) {
+        case OBD2_SERVICE_03: return (entry->status & DTC_STATUS_CONFIRMED) != 0;
+        case OBD2_SERVICE_07: return (entry->status & DTC_STATUS_PENDING) != 0;
+        default:              return entry->permanent;
+    }
+}
+
+static uint16_t dtc_list_response(const fleet_vehicle_t *vehicle, uint8_t service,
+                                  uint8_t *response, uint16_t max_length)
+{
+    // [service + 0x40][count][DTC1 hi][DTC1 lo]... as the firmware sends it
+    uint16_t length = 2;
+    uint8_t count = 0;
+
+    for (uint8_t i = 0; i < vehicle->dtc_count && length + 2 <= max_length; i++) {
+        const dtc_entry_t *entry = &vehicle->dtcs[i];
+        if (dtc_listed(entry, service)) {
+            uint16_t code = obd2_dtc_format_for_transmission(entry->code, entry->type);
+            response[length++] = (code >> 8) & 0xFF;
+            response[length++] = code & 0xFF;
+            count++;
+        }
+    }
+    response[0] = service + OBD2_POSITIVE_RESPONSE_OFFSET;
+    response[1] = count;
+    return length;
+}
+
+// memo (NULL from the workers) coalesces identical Service 01 requests to a
+// vehicle within one tick
+static uint16_t vehicle_respond(obd2_fleet_t *fleet, uint32_t index, const uint8_t *request,
+                                uint8_t length, uint8_t *response, uint16_t max_length,
+                                obd2_memo_t *memo)
+{
+    fleet_vehicle_t *vehicle = &fleet->vehicles[index];
+    obd2_vehicle_t model;
+    uint8_t service = request[0];
+    uint8_t pid = (length >= 2) ? request[1] : 0;
+    uint8_t data_length;
+
+    switch (service) {
+        case OBD2_SERVICE_01:
+            if (length < 2 || max_length < 6) {
+                return negative_response(service, OBD2_ERROR_INVALID_FORMAT, response);
+            }
+            response[0] = OBD2_SERVICE_01 + OBD2_POSITIVE_RESPONSE_OFFSET;
+            response[1] = pid;
+            if (pid == OBD2_PID_MONITOR_STATUS) {
+                // MIL and stored DTC count from this vehicle's set; no
+                // Service 06 monitors run in the fleet, so only the
+                // continuous ones are reported
+                return 2 + obd2_encode_monitor_status(fleet->mil_on[index], count_dtcs(vehicle, DTC_STATUS_CONFIRMED),
+                                                      0x00, 0x00, &response[2]);
+            }
+            data_length = obd2_encode_supported_pids(pid, &response[2]);
+            if (data_length == 0 && memo != NULL) {
+                data_length = obd2_memo_lookup(memo, index, service, pid, fleet->tick, &response[2]);
+            }
+            if (data_length == 0) {
+                obd2_vehicle_snapshot_t snapshot;
+                obd2_vehicle_batch_load(&fleet->models, index, &model);
+                obd2_vehicle_capture_snapshot(&model, &snapshot);
+                data_length = obd2_encode_pid(pid, &snapshot, &response[2]);
+                if (memo != NULL) {
+                    obd2_memo_store(memo, index, service, pid, fleet->tick, &response[2], data_length);
+                }
+            }
+            if (data_length == 0) {
+                return negative_response(service, OBD2_ERROR_SUBFUNCTION_NOT_SUPPORTED, response);
+            }
+            return 2 + data_length;
+
+        case OBD2_SERVICE_03:
+        case OBD2_SERVICE_07:
+        case OBD2_SERVICE_0A:
+            return dtc_list_response(vehicle, service, response, max_length);
+
+        case OBD2_SERVICE_04:
+            clear_diagnostic_info(fleet, index);
+            obd2_vehicle_batch_load(&fleet->models, index, &model);
+            obd2_vehicle_clear_counters(&model);
+            obd2_vehicle_batch_store(&fleet->models, index, &model);
+            if (memo != NULL) {
+                obd2_memo_clear(memo);
+            }
+            response[0] = OBD2_SERVICE_04 + OBD2_POSITIVE_RESPONSE_OFFSET;
+            return 1;
+
+        case OBD2_SERVICE_09:
+            if (pid != OBD2_PID_VIN || max_length < 20) {
+                return negative_response(service, OBD2_ERROR_SUBFUNCTION_NOT_SUPPORTED, response);
+            }
+            // [49][02][01][VIN]; the VIN serial is the vehicle index, which
+            // wraps past the eight digits the VIN has room for
+            response[0] = OBD2_SERVICE_09 + OBD2_POSITIVE_RESPONSE_OFFSET;
+            response[1] = pid;
+            response[2] = 0x01;
+            {
+                char vin[18];
+                snprintf(vin, sizeof(vin), "1OBDFLEET%08lu", (unsigned long)(index % 100000000u));
+                memcpy(&response[3], vin, 17);
+            }
+            return 20;
+
+        default:
+            return negative_response(service, OBD2_ERROR_SERVICE_NOT_SUPPORTED, response);
+    }
+}
+
+// Tick
+
+static void output_vehicle(obd2_fleet_t *fleet, uint32_t chunk, uint32_t index)
+{
+    const obd2_vehicle_batch_t *models = &fleet->models;
+
+    if (fleet->config.output == OBD2_FLEET_OUTPUT_TELEMETRY) {
+        fleet_telemetry_t *telemetry = &fleet->telemetry[chunk];
+        if (models->engine_running[index]) {
+            telemetry->running++;
+        }
+        if (fleet->mil_on[index]) {
+            telemetry->mil_on++;
+        }
+        telemetry->dtcs += fleet->vehicles[index].dtc_count;
+        telemetry->rpm_sum += (uint32_t)models->base_rpm[index];
+        telemetry->speed_sum += models->vehicle_speed[index];
+        telemetry->coolant_sum += (int32_t)models->coolant_temp[index];
+        return;
+    }
+
+    // Stream: "<time ms> <vehicle> <response bytes>" per query
+    char *line = fleet->stream_buffers + chunk * fleet->stream_chunk_size + fleet->stream_lengths[chunk];
+    uint32_t time_ms = fleet->tick * OBD2_VEHICLE_TICK_MS;
+
+    for (uint8_t q = 0; q < fleet->config.query_count; q++) {
+        uint8_t response[FLEET_STREAM_RESPONSE];
+        uint16_t length = vehicle_respond(fleet, index, fleet->config.queries[q], 2,
+                                          response, sizeof(response), NULL);
+        int written = sprintf(line, "%lu %lu", (unsigned long)time_ms, (unsigned long)index);
+        for (uint16_t i = 0; i < length; i++) {
+            written += sprintf(line + written, " %02X", response[i]);
+        }
+        line[written++] = '\n';
+        line += written;
+        fleet->stream_lengths[chunk] += written;
+    }
+}
+
+static void process_chunk(obd2_fleet_t *fleet, uint32_t chunk)
+{
+    uint32_t first = chunk * OBD2_FLEET_CHUNK;
+    uint32_t last = first + OBD2_FLEET_CHUNK;
+
+    if (last > fleet->config.vehicles) {
+        last = fleet->config.vehicles;
+    }
+
+    obd2_vehicle_batch_step(&fleet->models, first, last - first, fleet->mil_on);
+
+    for (uint32_t i = first; i < last; i++) {
+        update_drive(fleet, i);
+        evaluate_faults(fleet, i);
+
+        if (fleet->output_due) {
+            output_vehicle(fleet, chunk, i);
+        }
+    }
+}
+
+static void run_worker(obd2_fleet_t *fleet, fleet_worker_t *worker)
+{
+    uint8_t threads = fleet->config.threads;
+    uint32_t chunk;
+
+    // Own share first, then take chunks from the others until none are left
+    while ((chunk = atomic_fetch_add_explicit(&worker->next, 1, memory_order_relaxed)) < worker->end) {
+        process_chunk(fleet, chunk);
+    }
+    for (uint8_t k = 1; k < threads; k++) {
+        fleet_worker_t *victim = &fleet->workers[(worker->index + k) % threads];
+        while ((chunk = atomic_fetch_add_explicit(&victim->next, 1, memory_order_relaxed)) < victim->end) {
+            process_chunk(fleet, chunk);
+            worker->steals++;
+        }
+    }
+}
+
+static void* worker_main(void *arg)
+{
+    fleet_worker_t *worker = arg;
+    obd2_fleet_t *fleet = worker->fleet;
+
+    while (true) {
+        pthread_barrier_wait(&fleet->tick_start);
+        if (fleet->stopping) {
+            break;
+        }
+        run_worker(fleet, worker);
+        pthread_barrier_wait(&fleet->tick_done);
+    }
+    return NULL;
+}
+
+static void write_output(obd2_fleet_t *fleet)
+{
+    FILE *out = fleet->config.out;
+
+    if (fleet->config.output == OBD2_FLEET_OUTPUT_STREAM) {
+        for (uint32_t c = 0; c < fleet->chunk_count; c++) {
+            fwrite(fleet->stream_buffers + c * fleet->stream_chunk_size, 1, fleet->stream_lengths[c], out);
+        }
+        return;
+    }
+
+    fleet_telemetry_t total = {0};
+    for (uint32_t c = 0; c < fleet->chunk_count; c++) {
+        const fleet_telemetry_t *part = &fleet->telemetry[c];
+        total.running += part->running;
+        total.mil_on += part->mil_on;
+        total.dtcs += part->dtcs;
+        total.rpm_sum += part->rpm_sum;
+        total.speed_sum += part->speed_sum;
+        total.coolant_sum += part->coolant_sum;
+    }
+
+    uint32_t vehicles = fleet->config.vehicles;
+    fprintf(out, "t=%lu vehicles=%lu running=%lu mil=%lu dtcs=%lu avg_rpm=%lu avg_speed=%lu avg_coolant=%ld\n",
+            (unsigned long)(fleet->tick * OBD2_VEHICLE_TICK_MS), (unsigned long)vehicles,
+            (unsigned long)total.running, (unsigned long)total.mil_on, (unsigned long)total.dtcs,
+            (unsigned long)(total.rpm_sum / vehicles), (unsigned long)(total.speed_sum / vehicles),
+            (long)(total.coolant_sum / vehicles));
+}
+
+void obd2_fleet_tick(obd2_fleet_t *fleet)
+{
+    uint8_t threads = fleet->config.threads;
+
+    fleet->tick++;
+    fleet->output_due = fleet->config.output_ticks != 0 && fleet->tick % fleet->config.output_ticks == 0;
+    if (fleet->output_due) {
+        memset(fleet->stream_lengths, 0, fleet->chunk_count * sizeof(uint32_t));
+        memset(fleet->telemetry, 0, fleet->chunk_count * sizeof(fleet_telemetry_t));
+    }
+
+    // Equal contiguous shares; a worker that finishes early steals the rest
+    for (uint8_t w = 0; w < threads; w++) {
+        atomic_store_explicit(&fleet->workers[w].next,
+                              (uint32_t)((uint64_t)fleet->chunk_count * w / threads), memory_order_relaxed);
+        fleet->workers[w].end = (uint32_t)((uint64_t)fleet->chunk_count * (w + 1) / threads);
+    }
+
+    // The calling thread is worker 0
+    if (threads > 1) {
+        pthread_barrier_wait(&fleet->tick_start);
+    }
+    run_worker(fleet, &fleet->workers[0]);
+    if (threads > 1) {
+        pthread_barrier_wait(&fleet->tick_done);
+    }
+
+    fleet->vehicle_ticks += fleet->config.vehicles;
+    if (fleet->output_due) {
+        write_output(fleet);
+    }
+}
+
+// Lifecycle
+
+obd2_fleet_t* obd2_fleet_create(const obd2_fleet_config_t *config)
+{
+    if (config->vehicles == 0 || config->threads == 0 || config->threads > OBD2_FLEET_MAX_THREADS ||
+        config->query_count > OBD2_FLEET_MAX_QUERIES || config->out == NULL) {
+        return NULL;
+    }
+
+    obd2_fleet_t *fleet = calloc(1, sizeof(obd2_fleet_t));
+    const obd2_fault_rule_t *rules;
+    uint16_t rule_count;
+
+    if (fleet == NULL) {
+        return NULL;
+    }
+    fleet->config = *config;
+    rules = obd2_fault_get_default_rules(&rule_count);
+    obd2_fault_compile(&fleet->faults, rules, rule_count);
+    fleet->chunk_count = (config->vehicles + OBD2_FLEET_CHUNK - 1) / OBD2_FLEET_CHUNK;
+    fleet->stream_chunk_size = (size_t)OBD2_FLEET_CHUNK * config->query_count * FLEET_LINE_MAX;
+
+    fleet->vehicles = calloc(config->vehicles, sizeof(fleet_vehicle_t));
+    fleet->mil_on = calloc(config->vehicles, sizeof(uint8_t));
+    fleet->fault_states = calloc(config->vehicles, sizeof(obd2_fault_state_t));
+    fleet->fault_debounce = calloc((size_t)config->vehicles * fleet->faults.count, sizeof(int32_t));
+    fleet->fault_passed = calloc((size_t)config->vehicles * OBD2_FAULT_PASSED_WORDS(fleet->faults.count),
+                                 sizeof(uint32_t));
+    fleet->stream_lengths = calloc(fleet->chunk_count, sizeof(uint32_t));
+    fleet->telemetry = calloc(fleet->chunk_count, sizeof(fleet_telemetry_t));
+    if (config->output == OBD2_FLEET_OUTPUT_STREAM && config->query_count > 0) {
+        fleet->stream_buffers = malloc(fleet->chunk_count * fleet->stream_chunk_size);
+    }
+    if (!obd2_vehicle_batch_init(&fleet->models, config->vehicles) ||
+        fleet->vehicles == NULL || fleet->mil_on == NULL || fleet->stream_lengths == NULL || fleet->telemetry == NULL ||
+        fleet->fault_states == NULL || fleet->fault_debounce == NULL || fleet->fault_passed == NULL ||
+        (config->output == OBD2_FLEET_OUTPUT_STREAM && fleet->stream_buffers == NULL)) {
+        fleet->config.threads = 1;      // No workers started yet
+        obd2_fleet_destroy(fleet);
+        return NULL;
+    }
+    if (config->output == OBD2_FLEET_OUTPUT_STREAM && config->query_count == 0) {
+        fleet->config.output_ticks = 0;
+    }
+
+    for (uint32_t i = 0; i < config->vehicles; i++) {
+        obd2_vehicle_t model;
+        obd2_vehicle_init(&model, i + 1);
+        obd2_vehicle_batch_store(&fleet->models, i, &model);
+
+        // Own chance rolls per vehicle (never 0, as xorshift needs)
+        fleet->fault_states[i].debounce = &fleet->fault_debounce[(size_t)i * fleet->faults.count];
+        fleet->fault_states[i].passed = &fleet->fault_passed[(size_t)i * OBD2_FAULT_PASSED_WORDS(fleet->faults.count)];
+        fleet->fault_states[i].rng_state = (i + 1) * 0x9E3779B9u;
+    }
+
+    for (uint8_t w = 0; w < config->threads; w++) {
+        fleet->workers[w].fleet = fleet;
+        fleet->workers[w].index = w;
+    }
+    if (config->threads > 1) {
+        pthread_barrier_init(&fleet->tick_start, NULL, config->threads);
+        pthread_barrier_init(&fleet->tick_done, NULL, config->threads);
+        for (uint8_t w = 1; w < config->threads; w++) {
+            pthread_create(&fleet->workers[w].thread, NULL, worker_main, &fleet->workers[w]);
+        }
+    }
+
+    return fleet;
+}
+
+void obd2_fleet_destroy(obd2_fleet_t *fleet)
+{
+    if (fleet == NULL) {
+        return;
+    }
+
+    if (fleet->config.threads > 1) {
+        fleet->stopping = true;
+        pthread_barrier_wait(&fleet->tick_start);
+        for (uint8_t w = 1; w < fleet->config.threads; w++) {
+            pthread_join(fleet->workers[w].thread, NULL);
+        }
+        pthread_barrier_destroy(&fleet->tick_start);
+        pthread_barrier_destroy(&fleet->tick_done);
+    }
+
+    free(fleet->stream_buffers);
+    free(fleet->stream_lengths);
+    free(fleet->telemetry);
+    free(fleet->mil_on);
+    free(fleet->fault_states);
+    free(fleet->fault_debounce);
+    free(fleet->fault_passed);
+    free(fleet->vehicles);
+    obd2_vehicle_batch_free(&fleet->models);
+    free(fleet);
+}
+
+uint16_t obd2_fleet_respond(obd2_fleet_t *fleet, uint32_t vehicle, const uint8_t *request,
+                            uint8_t length, uint8_t *response, uint16_t max_length)
+{
+    if (vehicle >= fleet->config.vehicles || length < 1 || max_length < 3) {
+        return 0;
+    }
+    return vehicle_respond(fleet, vehicle, request, length, response, max_length, &fleet->memo);
+}
+
+uint64_t obd2_fleet_get_vehicle_ticks(const obd2_fleet_t *fleet)
+{
+    return fleet->vehicle_ticks;
+}
+
+uint32_t obd2_fleet_get_memo_hits(const obd2_fleet_t *fleet)
+{
+    return fleet->memo.hits;
+}
+
+uint32_t obd2_fleet_get_memo_misses(const obd2_fleet_t *fleet)
+{
+    return fleet->memo.misses;
+}
+
+uint64_t obd2_fleet_get_steals(const obd2_fleet_t *fleet)
+{
+    uint64_t steals = 0;
+    for (uint8_t w = 0; w < fleet->config.threads; w++) {
+        steals += fleet->workers[w].steals;
+    }
+    return steals;
+}
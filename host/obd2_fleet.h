@@ -0,0 +1,67 @@
+#ifndef __OBD2_FLEET_H__
+#define __OBD2_FLEET_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+// Fleet simulator (host build)
+//
+// Every vehicle is its own obd2_vehicle_t model with a compact DTC set and
+// a VIN derived from its index, stepped in 50 ms ticks by a pool of worker
+// threads. The firmware's fault rule table (obd2_fault.h) is evaluated for
+// every vehicle each tick, with its own debounce counters and chance rolls,
+// and its results drive the DTC lifecycle of obd2_dtc.h over the vehicle's
+// set. Drives end every OBD2_FLEET_DRIVE_TICKS with the engine stopped for
+// one tick, which ends the driving cycle. Vehicles are handed out in chunks: each worker starts on its own
+// share of the chunks and steals from the other shares once it runs out,
+// so chunks that cost more (faults, output) never leave a core idle.
+// Output is written per chunk and joined in vehicle order after each tick,
+// either as per-vehicle OBD response streams or as fleet-wide telemetry.
+
+#define OBD2_FLEET_CHUNK            256     // Vehicles per work item
+#define OBD2_FLEET_MAX_THREADS      64
+#define OBD2_FLEET_MAX_DTCS         8       // DTC set per vehicle
+#define OBD2_FLEET_MAX_QUERIES      16      // Streamed requests per vehicle
+#define OBD2_FLEET_DRIVE_TICKS      36000   // 30 min drives
+
+typedef enum {
+    OBD2_FLEET_OUTPUT_TELEMETRY = 0,    // One aggregate line per output period
+    OBD2_FLEET_OUTPUT_STREAM            // One response line per vehicle and query
+} obd2_fleet_output_t;
+
+typedef struct {
+    uint32_t vehicles;
+    uint8_t threads;                    // Including the calling thread
+    obd2_fleet_output_t output;
+    uint32_t output_ticks;              // Ticks between outputs (0 = no output)
+    uint8_t queries[OBD2_FLEET_MAX_QUERIES][2];     // [service][pid] per streamed request
+    uint8_t query_count;
+    FILE *out;
+} obd2_fleet_config_t;
+
+typedef struct obd2_fleet obd2_fleet_t;
+
+// Create the vehicles and start the workers; NULL on allocation failure
+obd2_fleet_t* obd2_fleet_create(const obd2_fleet_config_t *config);
+void obd2_fleet_destroy(obd2_fleet_t *fleet);
+
+// Advance every vehicle by one tick and write the output when it is due
+void obd2_fleet_tick(obd2_fleet_t *fleet);
+
+// Answer one request ([SID][PID...]) as the given vehicle's ECU; returns the
+// response length ([SID+40]... or [7F][SID][NRC]), 0 for a bad vehicle index.
+// Fleet vehicles answer Services 01, 03, 04, 07, 09 (VIN only) and 0A;
+// there are no freeze frames, Service 06 monitors or UDS.
+// Safe to call between ticks. A Service 01 PID asked of the same vehicle
+// again before the next tick reuses the data encoded for the first request.
+uint16_t obd2_fleet_respond(obd2_fleet_t *fleet, uint32_t vehicle, const uint8_t *request,
+                            uint8_t length, uint8_t *response, uint16_t max_length);
+
+// Statistics
+uint64_t obd2_fleet_get_vehicle_ticks(const obd2_fleet_t *fleet);
+uint64_t obd2_fleet_get_steals(const obd2_fleet_t *fleet);
+uint32_t obd2_fleet_get_memo_hits(const obd2_fleet_t *fleet);
+uint32_t obd2_fleet_get_memo_misses(const obd2_fleet_t *fleet);
+
+#endif // __OBD2_FLEET_H__
@@ -0,0 +1,195 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "obd2_fleet.h"
+#include "obd2_vehicle.h"
+
+// Host (Linux) fleet simulator: many vehicles, no CAN bus
+//
+//   obd2_fleet_host [-n vehicles] [-j threads] [-s seconds] [-x speed]
+//                   [-m telemetry|stream] [-r output_ms] [-q 010C,010D,03] [-o file]
+//
+// Vehicles advance in 50 ms ticks paced to the wall clock times the speed
+// factor (-x 0 runs unpaced, as fast as the cores allow).
+
+#define FLEET_DEFAULT_VEHICLES      10000
+#define FLEET_DEFAULT_OUTPUT_MS     1000
+
+static volatile sig_atomic_t running = 1;
+
+static void handle_signal(int sig)
+{
+    running = 0;
+}
+
+static void usage(const char *program)
+{
+    printf("Usage: %s [-n vehicles] [-j threads] [-s seconds] [-x speed]\r\n", program);
+    printf("          [-m telemetry|stream] [-r output_ms] [-q requests] [-o file]\r\n");
+    printf("  -n  number of vehicles (default %d)\r\n", FLEET_DEFAULT_VEHICLES);
+    printf("  -j  worker threads including the main thread (default: all cores)\r\n");
+    printf("  -s  simulated seconds to run (default: until interrupted)\r\n");
+    printf("  -x  speed factor against the wall clock, 0 = unpaced (default 1)\r\n");
+    printf("  -m  telemetry = fleet aggregates, stream = per-vehicle responses\r\n");
+    printf("  -r  output period in ms (default %d, 0 = no output)\r\n", FLEET_DEFAULT_OUTPUT_MS);
+    printf("  -q  streamed requests as hex SID[PID], comma separated (default 010C,010D)\r\n");
+    printf("  -o  output file (default: standard output)\r\n");
+}
+
+// "010C,010D,03" -> {01,0C}, {01,0D}, {03,00}
+static bool parse_queries(const char *text, obd2_fleet_config_t *config)
+{
+    config->query_count = 0;
+    while (*text != '\0') {
+        char *end;
+        unsigned long value = strtoul(text, &end, 16);
+        size_t digits = end - text;
+
+        if ((digits != 2 && digits != 4) || config->query_count >= OBD2_FLEET_MAX_QUERIES) {
+            return false;
+        }
+        config->queries[config->query_count][0] = (digits == 4) ? (value >> 8) & 0xFF : value & 0xFF;
+        config->queries[config->query_count][1] = (digits == 4) ? value & 0xFF : 0;
+        config->query_count++;
+
+        text = end;
+        if (*text == ',') {
+            text++;
+        } else if (*text != '\0') {
+            return false;
+        }
+    }
+    return config->query_count > 0;
+}
+
+static uint64_t monotonic_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+int main(int argc, char **argv)
+{
+    obd2_fleet_config_t config = {
+        .vehicles = FLEET_DEFAULT_VEHICLES,
+        .output = OBD2_FLEET_OUTPUT_TELEMETRY,
+        .out = stdout,
+    };
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    uint32_t output_ms = FLEET_DEFAULT_OUTPUT_MS;
+    uint32_t seconds = 0;
+    double speed = 1.0;
+    const char *out_path = NULL;
+    int opt;
+
+    parse_queries("010C,010D", &config);
+
+    while ((opt = getopt(argc, argv, "n:j:s:x:m:r:q:o:h")) != -1) {
+        switch (opt) {
+            case 'n':
+                config.vehicles = strtoul(optarg, NULL, 10);
+                break;
+            case 'j':
+                threads = strtol(optarg, NULL, 10);
+                break;
+            case 's':
+                seconds = strtoul(optarg, NULL, 10);
+                break;
+            case 'x':
+                speed = strtod(optarg, NULL);
+                break;
+            case 'm':
+                if (strcmp(optarg, "stream") == 0) {
+                    config.output = OBD2_FLEET_OUTPUT_STREAM;
+                } else if (strcmp(optarg, "telemetry") == 0) {
+                    config.output = OBD2_FLEET_OUTPUT_TELEMETRY;
+                } else {
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'r':
+                output_ms = strtoul(optarg, NULL, 10);
+                break;
+            case 'q':
+                if (!parse_queries(optarg, &config)) {
+                    printf("Invalid request list: %s\r\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'o':
+                out_path = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    if (threads < 1) {
+        threads = 1;
+    } else if (threads > OBD2_FLEET_MAX_THREADS) {
+        threads = OBD2_FLEET_MAX_THREADS;
+    }
+    config.threads = (uint8_t)threads;
+    config.output_ticks = (output_ms + OBD2_VEHICLE_TICK_MS - 1) / OBD2_VEHICLE_TICK_MS;
+
+    if (out_path != NULL) {
+        config.out = fopen(out_path, "w");
+        if (config.out == NULL) {
+            printf("Cannot open %s: %s\r\n", out_path, strerror(errno));
+            return 1;
+        }
+    }
+
+    obd2_fleet_t *fleet = obd2_fleet_create(&config);
+    if (fleet == NULL) {
+        printf("ERROR: Failed to create a fleet of %lu vehicles\r\n", (unsigned long)config.vehicles);
+        return 1;
+    }
+
+    signal(SIGINT, handle_signal);
+    signal(SIGTERM, handle_signal);
+
+    fprintf(stderr, "Fleet: %lu vehicles, %d threads, speed %.1fx\r\n",
+            (unsigned long)config.vehicles, config.threads, speed);
+
+    // Absolute deadlines so pacing does not drift with the tick cost
+    uint64_t tick_ns = (speed > 0) ? (uint64_t)(OBD2_VEHICLE_TICK_MS * 1000000.0 / speed) : 0;
+    uint64_t start_ns = monotonic_ns();
+    uint64_t ticks = 0;
+    uint64_t tick_limit = (uint64_t)seconds * 1000 / OBD2_VEHICLE_TICK_MS;
+
+    while (running && (tick_limit == 0 || ticks < tick_limit)) {
+        obd2_fleet_tick(fleet);
+        ticks++;
+
+        if (tick_ns != 0) {
+            uint64_t deadline = start_ns + ticks * tick_ns;
+            struct timespec wake = {
+                .tv_sec = deadline / 1000000000ull,
+                .tv_nsec = deadline % 1000000000ull,
+            };
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, NULL) == EINTR && running) {
+            }
+        }
+    }
+
+    double elapsed = (monotonic_ns() - start_ns) / 1e9;
+    uint64_t vehicle_ticks = obd2_fleet_get_vehicle_ticks(fleet);
+    fprintf(stderr, "Fleet: %llu ticks (%.1f s simulated) in %.2f s, %.0f vehicle-ticks/s, %llu chunks stolen\r\n",
+            (unsigned long long)ticks, ticks * OBD2_VEHICLE_TICK_MS / 1000.0, elapsed,
+            elapsed > 0 ? vehicle_ticks / elapsed : 0.0, (unsigned long long)obd2_fleet_get_steals(fleet));
+
+    obd2_fleet_destroy(fleet);
+    if (config.out != stdout) {
+        fclose(config.out);
+    }
+    return 0;
+}
@@ -0,0 +1,219 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+#include "pico/stdlib.h"
+#include "pico_host.h"
+#include "obd2_handler.h"
+#include "obd2_timer.h"
+#include "obd2_dtc.h"
+#include "obd2_console.h"
+#include "obd2_storage.h"
+#include "obd2_uds.h"
+#include "obd2_periodic.h"
+#include "obd2_socketcan.h"
+#include "obd2_vehicle.h"
+#include "obd2_fleet.h"
+
+// Host (Linux) entry point: the emulator on SocketCAN interfaces
+//
+//   obd2_emulator_host [-c] [-f flash.img] <ifname>...
+//
+// All interfaces share one epoll loop. The first interface is the firmware's
+// ECU, with its vehicle, DTCs in flash, console and UDS. Every further
+// interface is a vehicle of its own from the fleet simulator (obd2_fleet.h),
+// stepped on a 50 ms timer: it has its own model, fault rules, DTC set and
+// VIN, and answers Services 01, 03, 04, 07, 09 (VIN) and 0A only.
+
+#define HOST_MAX_EVENTS         16
+#define HOST_LOOP_MS            10      // Same pacing as the firmware main loop
+
+static volatile sig_atomic_t running = 1;
+static int stdin_marker;    // epoll data.ptr for standard input
+static obd2_fleet_t *fleet; // Vehicles on interfaces after the first, NULL for one interface
+static obd2_timer_t fleet_timer;
+
+static void tick_fleet(void *context)
+{
+    obd2_fleet_tick(fleet);
+}
+
+// Channel 0 is the firmware's ECU; channel n is fleet vehicle n - 1
+static uint16_t respond_channel(uint8_t channel, const uint8_t *request, uint8_t length,
+                                uint8_t *response, uint16_t max_length)
+{
+    if (channel == 0) {
+        return 0;
+    }
+    return obd2_fleet_respond(fleet, channel - 1, request, length, response, max_length);
+}
+
+static void handle_signal(int sig)
+{
+    running = 0;
+}
+
+static void handle_host_command(char cmd)
+{
+    switch (cmd) {
+        case 's':
+        case 'S':
+            obd2_handler_stats();
+            obd2_uds_print_status();
+            obd2_periodic_print_status();
+            obd2_socketcan_print_status();
+            break;
+        case 'q':
+        case 'Q':
+            running = 0;
+            break;
+        case 'h':
+        case 'H':
+            printf("Commands: s = statistics, q = quit, $<seq> <command> = console frame\r\n");
+            obd2_console_print_help();
+            break;
+        default:
+            break;
+    }
+}
+
+static void usage(const char *program)
+{
+    printf("Usage: %s [-c] [-f flash.img] <ifname>...\r\n", program);
+    printf("  -c  classic CAN framing even on CAN FD interfaces\r\n");
+    printf("  -f  flash image file for persistent DTCs, counters and VIN\r\n");
+}
+
+int main(int argc, char **argv)
+{
+    const char *flash_path = NULL;
+    bool allow_fd = true;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "cf:h")) != -1) {
+        switch (opt) {
+            case 'c':
+                allow_fd = false;
+                break;
+            case 'f':
+                flash_path = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (optind >= argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (!pico_host_flash_open(flash_path)) {
+        printf("Cannot open flash image %s: %s\r\n", flash_path, strerror(errno));
+        return 1;
+    }
+
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0) {
+        perror("epoll_create1");
+        return 1;
+    }
+
+    for (int i = optind; i < argc; i++) {
+        if (obd2_socketcan_open(argv[i], epoll_fd, allow_fd) == NULL) {
+            return 1;
+        }
+    }
+
+    if (argc - optind > 1) {
+        obd2_fleet_config_t config = {
+            .vehicles = (uint32_t)(argc - optind - 1),
+            .threads = 1,
+            .output_ticks = 0,
+            .out = stdout
+        };
+        fleet = obd2_fleet_create(&config);
+        if (fleet == NULL) {
+            printf("Cannot create the vehicles for %d interfaces\r\n", argc - optind - 1);
+            return 1;
+        }
+    }
+
+    // Console frames and single-character commands on standard input (a
+    // terminal or pipe; epoll refuses regular files, which are then ignored)
+    struct epoll_event event = { .events = EPOLLIN, .data.ptr = &stdin_marker };
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, STDIN_FILENO, &event) == 0) {
+        fcntl(STDIN_FILENO, F_SETFL, fcntl(STDIN_FILENO, F_GETFL) | O_NONBLOCK);
+    }
+
+    signal(SIGINT, handle_signal);
+    signal(SIGTERM, handle_signal);
+
+    // Same start-up order as the firmware
+    obd2_dtc_init();
+    obd2_console_init(handle_host_command);
+    if (!obd2_handler_init(&obd2_socketcan_transport)) {
+        printf("ERROR: Failed to initialize OBD2 handler\r\n");
+        return 1;
+    }
+    if (!obd2_storage_init()) {
+        obd2_dtc_simulate_fault(0x0171, DTC_TYPE_POWERTRAIN);  // System Too Lean
+    }
+    if (fleet != NULL) {
+        obd2_handler_set_channel_responder(respond_channel);
+        obd2_timer_start_periodic(&fleet_timer, OBD2_VEHICLE_TICK_MS * 1000, tick_fleet, NULL);
+    }
+    printf("OBD2 Emulator (host) started - 'h' for help\r\n");
+
+    struct epoll_event events[HOST_MAX_EVENTS];
+    while (running) {
+        // Sleep until a frame, console input or the next timer is due
+        uint32_t timer_us = obd2_timer_next_due_us(HOST_LOOP_MS * 1000);
+        int timeout_ms = (int)((timer_us + 999) / 1000);
+
+        int count = epoll_wait(epoll_fd, events, HOST_MAX_EVENTS, timeout_ms);
+        if (count < 0 && errno != EINTR) {
+            perror("epoll_wait");
+            break;
+        }
+
+        for (int i = 0; i < count; i++) {
+            if (events[i].data.ptr == &stdin_marker) {
+                char input[256];
+                ssize_t length = read(STDIN_FILENO, input, sizeof(input));
+                if (length == 0) {
+                    // End of input: keep serving the bus without a console
+                    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, STDIN_FILENO, NULL);
+                }
+                for (ssize_t j = 0; j < length; j++) {
+                    obd2_console_feed(input[j]);
+                }
+            } else {
+                obd2_socketcan_receive(events[i].data.ptr);
+            }
+        }
+
+        // Due timers, then every received and queued request; responses
+        // from the whole pass leave in one sendmmsg() per interface
+        do {
+            obd2_handler_process();
+        } while (obd2_socketcan_rx_pending() || obd2_handler_get_queue_depth() > 0);
+        obd2_socketcan_flush();
+
+        // Move queued DTC/counter records to flash while the bus is quiet
+        obd2_storage_service(obd2_handler_get_idle_ms());
+    }
+
+    printf("Shutting down\r\n");
+    obd2_socketcan_close_all();
+    close(epoll_fd);
+    if (fleet != NULL) {
+        obd2_fleet_destroy(fleet);
+    }
+    return 0;
+}
@@ -0,0 +1,468 @@
+#define _GNU_SOURCE
+#include "obd2_socketcan.h"
+#include "obd2_protocol.h"
+#include "pico/stdlib.h"
+#include <errno.h>
+#include <net/if.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+
+// Hardware timestamps further than this from the system clock are in the
+// controller's own timebase and cannot be compared with time_us_64()
+#define HW_STAMP_MAX_SKEW_US    1000000
+
+#define CONTROL_SIZE            (CMSG_SPACE(sizeof(struct scm_timestamping)) + CMSG_SPACE(sizeof(uint32_t)))
+
+typedef struct {
+    struct canfd_frame frame;
+    uint64_t time_us;           // Arrival time, time_us_64() timebase
+} rx_entry_t;
+
+struct obd2_socketcan_bus {
+    char name[IFNAMSIZ];
+    int fd;
+    bool fd_capable;            // Interface MTU is CANFD_MTU and FD frames are enabled
+
+    rx_entry_t rx[OBD2_SOCKETCAN_RX_QUEUE];
+    uint16_t rx_head;
+    uint16_t rx_count;
+
+    struct canfd_frame tx[OBD2_SOCKETCAN_TX_QUEUE];
+    uint16_t tx_count;
+
+    uint32_t rx_frames;
+    uint32_t rx_batches;        // recvmmsg() calls that returned frames
+    uint32_t kernel_drops;      // Socket receive queue overflows (SO_RXQ_OVFL)
+    uint32_t hw_stamps;         // Frames timed by the controller
+    uint32_t tx_frames;
+    uint32_t tx_batches;        // sendmmsg() calls that sent frames
+    uint32_t tx_dropped;        // Queue full or send error
+};
+
+static struct {
+    obd2_socketcan_bus_t buses[OBD2_SOCKETCAN_MAX_BUSES];
+    uint8_t count;
+    uint8_t next_rx;            // Round-robin start for the next receive
+    obd2_socketcan_bus_t *reply_bus;    // Bus responses go to: the last request's unless selected
+    uint8_t last_rx_channel;
+    uint64_t last_rx_time;
+    uint32_t last_rx_id;
+
+    // Scatter/gather state shared by all batched calls (single-threaded)
+    struct mmsghdr msgs[OBD2_SOCKETCAN_BATCH];
+    struct iovec iovs[OBD2_SOCKETCAN_BATCH];
+    struct canfd_frame frames[OBD2_SOCKETCAN_BATCH];
+    uint8_t control[OBD2_SOCKETCAN_BATCH][CONTROL_SIZE];
+} socketcan_state;
+
+static bool socketcan_init(void);
+static bool socketcan_send(uint32_t can_id, const uint8_t *can_data, uint8_t can_length);
+static uint8_t* socketcan_tx_claim(void);
+static bool socketcan_tx_commit(uint32_t can_id, uint8_t can_length);
+static bool socketcan_recv(uint32_t can_id, uint8_t *can_data, uint8_t *can_length);
+static uint64_t socketcan_rx_time(void);
+static uint32_t socketcan_rx_can_id(void);
+static uint8_t socketcan_rx_channel(void);
+static void socketcan_tx_channel(uint8_t channel);
+
+obd2_can_transport_t obd2_socketcan_transport = {
+    .name = "SocketCAN",
+    .frame_size = OBD2_CAN_CLASSIC_FRAME_SIZE,
+    .init = socketcan_init,
+    .send = socketcan_send,
+    .recv = socketcan_recv,
+    .rx_time_us = socketcan_rx_time,
+    .rx_can_id = socketcan_rx_can_id,
+    .rx_channel = socketcan_rx_channel,
+    .tx_channel = socketcan_tx_channel,
+    .tx_claim = socketcan_tx_claim,
+    .tx_commit = socketcan_tx_commit,
+};
+
+static uint64_t timespec_us(const struct timespec *ts)
+{
+    return (uint64_t)ts->tv_sec * 1000000u + (uint64_t)ts->tv_nsec / 1000u;
+}
+
+static uint64_t realtime_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return timespec_us(&ts);
+}
+
+obd2_socketcan_bus_t* obd2_socketcan_open(const char *ifname, int epoll_fd, bool allow_fd)
+{
+    if (socketcan_state.count >= OBD2_SOCKETCAN_MAX_BUSES || strlen(ifname) >= IFNAMSIZ) {
+        return NULL;
+    }
+
+    obd2_socketcan_bus_t *bus = &socketcan_state.buses[socketcan_state.count];
+    memset(bus, 0, sizeof(*bus));
+    strcpy(bus->name, ifname);
+
+    bus->fd = socket(PF_CAN, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, CAN_RAW);
+    if (bus->fd < 0) {
+        printf("%s: socket failed: %s\r\n", ifname, strerror(errno));
+        return NULL;
+    }
+
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    strcpy(ifr.ifr_name, ifname);
+    if (ioctl(bus->fd, SIOCGIFINDEX, &ifr) < 0) {
+        printf("%s: no such interface\r\n", ifname);
+        close(bus->fd);
+        return NULL;
+    }
+    int ifindex = ifr.ifr_ifindex;
+
+    // FD frames only where the interface MTU allows them
+    int enable = 1;
+    if (allow_fd && ioctl(bus->fd, SIOCGIFMTU, &ifr) == 0 && ifr.ifr_mtu == CANFD_MTU) {
+        bus->fd_capable = setsockopt(bus->fd, SOL_CAN_RAW, CAN_RAW_FD_FRAMES,
+                                     &enable, sizeof(enable)) == 0;
+    }
+
+    // Only standard-ID data frames addressed to us reach user space
+    struct can_filter filters[] = {
+        { OBD2_REQUEST_ID, CAN_SFF_MASK | CAN_EFF_FLAG | CAN_RTR_FLAG },
+        { OBD2_PHYSICAL_REQUEST_ID, CAN_SFF_MASK | CAN_EFF_FLAG | CAN_RTR_FLAG },
+    };
+    setsockopt(bus->fd, SOL_CAN_RAW, CAN_RAW_FILTER, filters, sizeof(filters));
+
+    // Arrival timestamps (hardware where the driver has them) and drop counts
+    int stamping = SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE |
+                   SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+    setsockopt(bus->fd, SOL_SOCKET, SO_TIMESTAMPING, &stamping, sizeof(stamping));
+    setsockopt(bus->fd, SOL_SOCKET, SO_RXQ_OVFL, &enable, sizeof(enable));
+
+    struct sockaddr_can addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.can_family = AF_CAN;
+    addr.can_ifindex = ifindex;
+    if (bind(bus->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        printf("%s: bind failed: %s\r\n", ifname, strerror(errno));
+        close(bus->fd);
+        return NULL;
+    }
+
+    struct epoll_event event = { .events = EPOLLIN, .data.ptr = bus };
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, bus->fd, &event) < 0) {
+        close(bus->fd);
+        return NULL;
+    }
+
+    socketcan_state.count++;
+
+    // One classic interface keeps the whole transport classic
+    bool all_fd = true;
+    for (uint8_t i = 0; i < socketcan_state.count; i++) {
+        all_fd = all_fd && socketcan_state.buses[i].fd_capable;
+    }
+    obd2_socketcan_transport.frame_size = all_fd ? OBD2_CAN_FD_FRAME_SIZE : OBD2_CAN_CLASSIC_FRAME_SIZE;
+
+    printf("%s: opened (%s)\r\n", ifname, bus->fd_capable ? "CAN FD" : "classic CAN");
+    return bus;
+}
+
+void obd2_socketcan_close_all(void)
+{
+    obd2_socketcan_flush();
+    for (uint8_t i = 0; i < socketcan_state.count; i++) {
+        close(socketcan_state.buses[i].fd);
+    }
+    socketcan_state.count = 0;
+    socketcan_state.reply_bus = NULL;
+}
+
+static bool socketcan_init(void)
+{
+    return socketcan_state.count > 0;
+}
+
+// Arrival time of one received message in the time_us_64() timebase
+static uint64_t message_time(struct msghdr *msg, obd2_socketcan_bus_t *bus, uint64_t now_real,
+                             uint64_t now_mono)
+{
+    uint64_t stamp = 0;
+
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET) {
+            continue;
+        }
+        if (cmsg->cmsg_type == SCM_TIMESTAMPING) {
+            struct scm_timestamping stamps;
+            memcpy(&stamps, CMSG_DATA(cmsg), sizeof(stamps));
+
+            // ts[2] is the controller's stamp, ts[0] the kernel's
+            uint64_t hw = timespec_us(&stamps.ts[2]);
+            if (hw != 0 && hw <= now_real && now_real - hw < HW_STAMP_MAX_SKEW_US) {
+                stamp = hw;
+                bus->hw_stamps++;
+            } else {
+                stamp = timespec_us(&stamps.ts[0]);
+            }
+        } else if (cmsg->cmsg_type == SO_RXQ_OVFL) {
+            memcpy(&bus->kernel_drops, CMSG_DATA(cmsg), sizeof(uint32_t));
+        }
+    }
+
+    if (stamp == 0 || stamp > now_real) {
+        return now_mono;
+    }
+    return (now_real - stamp < now_mono) ? now_mono - (now_real - stamp) : 0;
+}
+
+void obd2_socketcan_receive(obd2_socketcan_bus_t *bus)
+{
+    uint16_t space = OBD2_SOCKETCAN_RX_QUEUE - bus->rx_count;
+    int batch = (space < OBD2_SOCKETCAN_BATCH) ? space : OBD2_SOCKETCAN_BATCH;
+
+    // Queue full: the handler drains it before the next epoll wait
+    if (batch == 0) {
+        return;
+    }
+
+    for (int i = 0; i < batch; i++) {
+        socketcan_state.iovs[i].iov_base = &socketcan_state.frames[i];
+        socketcan_state.iovs[i].iov_len = sizeof(struct canfd_frame);
+        memset(&socketcan_state.msgs[i], 0, sizeof(struct mmsghdr));
+        socketcan_state.msgs[i].msg_hdr.msg_iov = &socketcan_state.iovs[i];
+        socketcan_state.msgs[i].msg_hdr.msg_iovlen = 1;
+        socketcan_state.msgs[i].msg_hdr.msg_control = socketcan_state.control[i];
+        socketcan_state.msgs[i].msg_hdr.msg_controllen = CONTROL_SIZE;
+    }
+
+    int received = recvmmsg(bus->fd, socketcan_state.msgs, batch, MSG_DONTWAIT, NULL);
+    if (received <= 0) {
+        return;
+    }
+    bus->rx_batches++;
+
+    uint64_t now_real = realtime_us();
+    uint64_t now_mono = time_us_64();
+    for (int i = 0; i < received; i++) {
+        unsigned int size = socketcan_state.msgs[i].msg_len;
+        struct canfd_frame *frame = &socketcan_state.frames[i];
+
+        if ((size != CAN_MTU && size != CANFD_MTU) || frame->len > CANFD_MAX_DLEN) {
+            continue;
+        }
+
+        rx_entry_t *entry = &bus->rx[(bus->rx_head + bus->rx_count) % OBD2_SOCKETCAN_RX_QUEUE];
+        entry->frame = *frame;
+        entry->time_us = message_time(&socketcan_state.msgs[i].msg_hdr, bus, now_real, now_mono);
+        bus->rx_count++;
+        bus->rx_frames++;
+    }
+}
+
+bool obd2_socketcan_rx_pending(void)
+{
+    for (uint8_t i = 0; i < socketcan_state.count; i++) {
+        if (socketcan_state.buses[i].rx_count > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool socketcan_recv(uint32_t can_id, uint8_t *can_data, uint8_t *can_length)
+{
+    // The kernel filters already matched the request IDs; take buses in turn
+    for (uint8_t n = 0; n < socketcan_state.count; n++) {
+        uint8_t index = (socketcan_state.next_rx + n) % socketcan_state.count;
+        obd2_socketcan_bus_t *bus = &socketcan_state.buses[index];
+
+        if (bus->rx_count == 0) {
+            continue;
+        }
+
+        rx_entry_t *entry = &bus->rx[bus->rx_head];
+        memcpy(can_data, entry->frame.data, entry->frame.len);
+        *can_length = entry->frame.len;
+        socketcan_state.last_rx_time = entry->time_us;
+        socketcan_state.last_rx_id = entry->frame.can_id & CAN_SFF_MASK;
+        socketcan_state.reply_bus = bus;
+        socketcan_state.last_rx_channel = index;
+        socketcan_state.next_rx = (index + 1) % socketcan_state.count;
+
+        bus->rx_head = (bus->rx_head + 1) % OBD2_SOCKETCAN_RX_QUEUE;
+        bus->rx_count--;
+        return true;
+    }
+    return false;
+}
+
+static uint64_t socketcan_rx_time(void)
+{
+    return socketcan_state.last_rx_time;
+}
+
+static uint32_t socketcan_rx_can_id(void)
+{
+    return socketcan_state.last_rx_id;
+}
+
+// Channels are bus indexes in the order the interfaces were opened
+static uint8_t socketcan_rx_channel(void)
+{
+    return socketcan_state.last_rx_channel;
+}
+
+static void socketcan_tx_channel(uint8_t channel)
+{
+    if (channel < socketcan_state.count) {
+        socketcan_state.reply_bus = &socketcan_state.buses[channel];
+    }
+}
+
+static void flush_bus(obd2_socketcan_bus_t *bus)
+{
+    uint16_t done = 0;
+
+    while (done < bus->tx_count) {
+        int batch = bus->tx_count - done;
+        if (batch > OBD2_SOCKETCAN_BATCH) {
+            batch = OBD2_SOCKETCAN_BATCH;
+        }
+
+        for (int i = 0; i < batch; i++) {
+            struct canfd_frame *frame = &bus->tx[done + i];
+            socketcan_state.iovs[i].iov_base = frame;
+            socketcan_state.iovs[i].iov_len = (frame->flags & CANFD_FDF) ? CANFD_MTU : CAN_MTU;
+            memset(&socketcan_state.msgs[i], 0, sizeof(struct mmsghdr));
+            socketcan_state.msgs[i].msg_hdr.msg_iov = &socketcan_state.iovs[i];
+            socketcan_state.msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        int sent = sendmmsg(bus->fd, socketcan_state.msgs, batch, MSG_DONTWAIT);
+        if (sent <= 0) {
+            // Device queue full: keep the rest for the next flush
+            if (sent < 0 && (errno == EAGAIN || errno == ENOBUFS)) {
+                break;
+            }
+            bus->tx_dropped += bus->tx_count - done;
+            done = bus->tx_count;
+            break;
+        }
+        bus->tx_batches++;
+        bus->tx_frames += sent;
+        done += sent;
+    }
+
+    if (done > 0) {
+        memmove(bus->tx, &bus->tx[done], (bus->tx_count - done) * sizeof(struct canfd_frame));
+        bus->tx_count -= done;
+    }
+}
+
+void obd2_socketcan_flush(void)
+{
+    for (uint8_t i = 0; i < socketcan_state.count; i++) {
+        if (socketcan_state.buses[i].tx_count > 0) {
+            flush_bus(&socketcan_state.buses[i]);
+        }
+    }
+}
+
+static obd2_socketcan_bus_t* reply_bus(void)
+{
+    return (socketcan_state.reply_bus != NULL) ? socketcan_state.reply_bus : &socketcan_state.buses[0];
+}
+
+// Next free queue entry of the bus, flushing once if the queue is full
+static struct canfd_frame* tx_slot(obd2_socketcan_bus_t *bus)
+{
+    if (bus->tx_count == OBD2_SOCKETCAN_TX_QUEUE) {
+        flush_bus(bus);
+        if (bus->tx_count == OBD2_SOCKETCAN_TX_QUEUE) {
+            return NULL;
+        }
+    }
+    return &bus->tx[bus->tx_count];
+}
+
+static bool length_fits(const obd2_socketcan_bus_t *bus, uint8_t can_length)
+{
+    return can_length <= CANFD_MAX_DLEN && (can_length <= CAN_MAX_DLEN || bus->fd_capable);
+}
+
+// Fill in the header of the queue entry at tx_count and queue it; the data
+// is already in place. With FD framing selected every frame goes out as
+// CAN FD with bit rate switch.
+static void queue_frame(obd2_socketcan_bus_t *bus, uint32_t can_id, uint8_t can_length)
+{
+    struct canfd_frame *frame = &bus->tx[bus->tx_count++];
+    frame->can_id = can_id;
+    frame->len = can_length;
+    frame->flags = 0;
+    frame->__res0 = 0;
+    frame->__res1 = 0;
+    if (bus->fd_capable && obd2_socketcan_transport.frame_size > OBD2_CAN_CLASSIC_FRAME_SIZE) {
+        frame->flags = CANFD_BRS | CANFD_FDF;
+    }
+}
+
+static bool socketcan_send(uint32_t can_id, const uint8_t *can_data, uint8_t can_length)
+{
+    obd2_socketcan_bus_t *bus = reply_bus();
+
+    if (!length_fits(bus, can_length)) {
+        return false;
+    }
+
+    struct canfd_frame *frame = tx_slot(bus);
+    if (frame == NULL) {
+        bus->tx_dropped++;
+        return false;
+    }
+    memcpy(frame->data, can_data, can_length);
+    queue_frame(bus, can_id, can_length);
+    return true;
+}
+
+// Zero-copy transmit: responses are encoded straight into the queue entry
+static uint8_t* socketcan_tx_claim(void)
+{
+    struct canfd_frame *frame = tx_slot(reply_bus());
+    return (frame != NULL) ? frame->data : NULL;
+}
+
+static bool socketcan_tx_commit(uint32_t can_id, uint8_t can_length)
+{
+    obd2_socketcan_bus_t *bus = reply_bus();
+
+    if (!length_fits(bus, can_length)) {
+        return false;
+    }
+    if (bus->tx_count == OBD2_SOCKETCAN_TX_QUEUE) {
+        bus->tx_dropped++;
+        return false;
+    }
+    queue_frame(bus, can_id, can_length);
+    return true;
+}
+
+void obd2_socketcan_print_status(void)
+{
+    printf("SocketCAN: %u interfaces, %u-byte frames\r\n", socketcan_state.count,
+           obd2_socketcan_transport.frame_size);
+    for (uint8_t i = 0; i < socketcan_state.count; i++) {
+        const obd2_socketcan_bus_t *bus = &socketcan_state.buses[i];
+        printf("  %s: rx %u frames in %u batches (%u hw-stamped, %u kernel drops), "
+               "tx %u frames in %u batches (%u dropped)\r\n",
+               bus->name, bus->rx_frames, bus->rx_batches, bus->hw_stamps, bus->kernel_drops,
+               bus->tx_frames, bus->tx_batches, bus->tx_dropped);
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef __OBD2_SOCKETCAN_H__
+#define __OBD2_SOCKETCAN_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "obd2_can.h"
+
+// SocketCAN transport for the host build (real interfaces or vcan)
+//
+// Every interface gets a non-blocking CAN_RAW socket with kernel receive
+// filters for the OBD2 request IDs, registered in the caller's epoll set.
+// A readable socket is drained with one recvmmsg() call into the bus's
+// receive queue, with each frame's kernel (or hardware) timestamp kept for
+// the handler's latency statistics. Responses go back out on the bus the
+// request came from and are queued until obd2_socketcan_flush() sends each
+// bus's queue with one sendmmsg() call.
+//
+// The transport frame size is 64 (CAN FD) when every opened interface has
+// the CAN FD MTU, and 8 otherwise.
+
+#define OBD2_SOCKETCAN_MAX_BUSES    8
+#define OBD2_SOCKETCAN_BATCH        32      // Frames per recvmmsg()/sendmmsg() call
+#define OBD2_SOCKETCAN_RX_QUEUE     64      // Received frames waiting for the handler
+#define OBD2_SOCKETCAN_TX_QUEUE     64      // Frames waiting for the next flush
+
+typedef struct obd2_socketcan_bus obd2_socketcan_bus_t;
+
+// Transport for obd2_handler_init(); open the interfaces first
+extern obd2_can_transport_t obd2_socketcan_transport;
+
+// Open an interface and add it to the epoll set (event data.ptr is the bus).
+// allow_fd = false keeps classic framing on FD-capable interfaces.
+obd2_socketcan_bus_t* obd2_socketcan_open(const char *ifname, int epoll_fd, bool allow_fd);
+void obd2_socketcan_close_all(void);
+
+// Event loop hooks: drain a readable socket, check for frames the handler
+// has not consumed yet, and send everything queued for transmission
+void obd2_socketcan_receive(obd2_socketcan_bus_t *bus);
+bool obd2_socketcan_rx_pending(void);
+void obd2_socketcan_flush(void);
+
+// Status and statistics
+void obd2_socketcan_print_status(void);
+
+#endif // __OBD2_SOCKETCAN_H__
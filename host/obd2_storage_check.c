@@ -0,0 +1,113 @@
+#include <stdio.h>
+#include <string.h>
+#include "obd2_storage.h"
+#include "pico_host.h"
+#include "pico/stdlib.h"
+
+// Host check: storage survives a snapshot that does not fit the queue
+//
+//   obd2_storage_check
+//
+// A client whose snapshot outgrows the queue makes compaction fail. Retrying
+// must neither write into sectors boot ignores nor erase its way round to the
+// last committed sector: after a reset the state saved before the failure is
+// still there. Once the state has shrunk the retried compaction commits it.
+// Built with a short OBD2_STORAGE_RETRY_MS (host/CMakeLists.txt).
+
+#define CHECK_RECORD_FILLER     0x40
+#define CHECK_RECORD_VALUE      0x41
+#define CHECK_FILLER_LENGTH     60
+#define CHECK_LARGE_FILLERS     80      // 80 * 63 bytes > OBD2_STORAGE_QUEUE_SIZE
+#define CHECK_SMALL_FILLERS     4
+
+static struct {
+    uint8_t fillers;
+    uint32_t value;
+    uint32_t restored_value;
+} client;
+
+static void check_restore(uint8_t type, const uint8_t *data, uint8_t length)
+{
+    if (type == CHECK_RECORD_VALUE && length == sizeof(uint32_t)) {
+        memcpy(&client.restored_value, data, sizeof(uint32_t));
+    }
+}
+
+static void check_snapshot(void)
+{
+    uint8_t filler[CHECK_FILLER_LENGTH];
+
+    memset(filler, 0xA5, sizeof(filler));
+    for (uint8_t i = 0; i < client.fillers; i++) {
+        obd2_storage_append(CHECK_RECORD_FILLER, filler, sizeof(filler));
+    }
+    obd2_storage_append(CHECK_RECORD_VALUE, &client.value, sizeof(client.value));
+}
+
+static void set_value(uint32_t value)
+{
+    client.value = value;
+    obd2_storage_append(CHECK_RECORD_VALUE, &value, sizeof(value));
+}
+
+// Service with an idle bus until storage settles or the time runs out
+static void run_storage(uint32_t ms)
+{
+    absolute_time_t end = make_timeout_time_ms(ms);
+
+    while (get_absolute_time() < end) {
+        obd2_storage_service(OBD2_STORAGE_ERASE_IDLE_MS);
+        if (!obd2_storage_is_pending()) {
+            return;
+        }
+        sleep_ms(1);
+    }
+}
+
+static bool expect(bool condition, const char *what)
+{
+    printf("%s: %s\r\n", condition ? "ok" : "FAIL", what);
+    return condition;
+}
+
+int main(void)
+{
+    bool passed = true;
+
+    pico_host_flash_open(NULL);
+    obd2_storage_register(CHECK_RECORD_FILLER, CHECK_RECORD_VALUE, check_restore, check_snapshot);
+
+    // First boot: the small state is committed
+    client.fillers = CHECK_SMALL_FILLERS;
+    passed &= expect(!obd2_storage_init(), "empty flash has no log");
+    set_value(1);
+    run_storage(OBD2_STORAGE_RETRY_MS);
+    passed &= expect(!obd2_storage_is_pending(), "first snapshot committed");
+
+    // The state outgrows the queue; filling the sector forces compactions
+    client.fillers = CHECK_LARGE_FILLERS;
+    for (uint32_t i = 0; i < 1000; i++) {
+        set_value(100 + i);
+        obd2_storage_service(OBD2_STORAGE_ERASE_IDLE_MS);
+    }
+    run_storage(OBD2_STORAGE_RETRY_MS * OBD2_STORAGE_SECTOR_COUNT * 4);
+    passed &= expect(obd2_storage_is_pending(), "oversized snapshot keeps compaction requested");
+
+    // Simulated reset while compaction is failing: the committed log survives
+    client.restored_value = 0;
+    passed &= expect(obd2_storage_init(), "log found after failed compactions");
+    passed &= expect(client.restored_value >= 1 && client.restored_value < 100 + 1000,
+                     "value from the last committed sector restored");
+
+    // The state shrinks: the retried compaction commits the current value
+    client.fillers = CHECK_SMALL_FILLERS;
+    set_value(7);
+    run_storage(OBD2_STORAGE_RETRY_MS * 4);
+    passed &= expect(!obd2_storage_is_pending(), "retried compaction completes");
+
+    client.restored_value = 0;
+    passed &= expect(obd2_storage_init(), "log found after reset");
+    passed &= expect(client.restored_value == 7, "last value restored");
+
+    return passed ? 0 : 1;
+}
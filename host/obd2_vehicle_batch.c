@@ -0,0 +1,340 @@
+#include "obd2_vehicle_batch.h"
+#include "obd2_fault.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define BATCH_ALIGN         64      // Cache line, and wide enough for any SIMD register
+#define BATCH_ARRAYS        26      // Arrays in obd2_vehicle_batch_t
+
+// sin() for the pattern generators as a polynomial so the step loop has
+// no calls. It is evaluated in double like the model's libm sin(), whose
+// result each pattern scales in double before rounding to float: reduce by
+// pi (three-part Cody-Waite constant, exact for x / pi < 2^20), then Taylor
+// to r^23 on [-pi/2, pi/2], within a few ulp of libm. A float polynomial
+// here lands a count off at the model's truncations. Only for x >= 0, which
+// every pattern argument is; no selects, so the loop if-converts on any
+// vector width.
+static inline double batch_sin(float x)
+{
+    int32_t k = (int32_t)(x * 0.31830988618379067 + 0.5);
+    double kf = (double)k;
+    double r = (double)x - kf * 3.1415926534682512;
+    r = r - kf * 1.2154201012607932e-10;
+    r = r - kf * 4.044532497422333e-21;
+
+    double r2 = r * r;
+    double p = r + r * r2 * (-1.6666666666666666e-1 + r2 * (8.3333333333333333e-3 +
+               r2 * (-1.9841269841269841e-4 + r2 * (2.7557319223985893e-6 +
+               r2 * (-2.5052108385441720e-8 + r2 * (1.6059043836821613e-10 +
+               r2 * (-7.6471637318198164e-13 + r2 * (2.8114572543455206e-15 +
+               r2 * (-8.2206352466243297e-18 + r2 * (1.9572941063391263e-20 +
+               r2 * -3.8681701706306840e-23))))))))));
+    return p * (double)(1 - 2 * (k & 1));
+}
+
+static inline float batch_trunc(float x)
+{
+    return (float)(int32_t)x;
+}
+
+static inline float batch_clamp(float x, float low, float high)
+{
+    x = x < low ? low : x;
+    return x > high ? high : x;
+}
+
+bool obd2_vehicle_batch_init(obd2_vehicle_batch_t *batch, uint32_t count)
+{
+    // One block, every array starting on its own cache line
+    size_t stride = ((size_t)count * 4 + BATCH_ALIGN - 1) & ~(size_t)(BATCH_ALIGN - 1);
+    uint8_t *memory;
+
+    memset(batch, 0, sizeof(*batch));
+    if (count == 0 || (memory = aligned_alloc(BATCH_ALIGN, stride * BATCH_ARRAYS)) == NULL) {
+        return false;
+    }
+    memset(memory, 0, stride * BATCH_ARRAYS);
+    batch->count = count;
+    batch->memory = memory;
+
+    void **arrays[BATCH_ARRAYS] = {
+        (void **)&batch->throttle_position, (void **)&batch->engine_load, (void **)&batch->base_rpm,
+        (void **)&batch->coolant_temp, (void **)&batch->intake_temp, (void **)&batch->maf_flow_rate,
+        (void **)&batch->fuel_pressure, (void **)&batch->manifold_pressure,
+        (void **)&batch->o2_sensor_b1s1, (void **)&batch->o2_sensor_b1s2,
+        (void **)&batch->short_fuel_trim_b1, (void **)&batch->long_fuel_trim_b1,
+        (void **)&batch->timing_advance, (void **)&batch->fuel_trim_integrator,
+        (void **)&batch->vehicle_speed, (void **)&batch->simulation_cycle,
+        (void **)&batch->engine_running, (void **)&batch->engine_runtime, (void **)&batch->fuel_level,
+        (void **)&batch->odometer_m, (void **)&batch->distance_since_clear_m,
+        (void **)&batch->distance_with_mil_m, (void **)&batch->distance_mm,
+        (void **)&batch->warmups_since_clear, (void **)&batch->start_coolant_temp,
+        (void **)&batch->warmup_counted,
+    };
+    for (int a = 0; a < BATCH_ARRAYS; a++) {
+        *arrays[a] = memory + a * stride;
+    }
+    return true;
+}
+
+void obd2_vehicle_batch_free(obd2_vehicle_batch_t *batch)
+{
+    free(batch->memory);
+    memset(batch, 0, sizeof(*batch));
+}
+
+void obd2_vehicle_batch_store(obd2_vehicle_batch_t *batch, uint32_t index, const obd2_vehicle_t *vehicle)
+{
+    batch->throttle_position[index] = vehicle->throttle_position;
+    batch->engine_load[index] = vehicle->engine_load;
+    batch->base_rpm[index] = vehicle->base_rpm;
+    batch->coolant_temp[index] = vehicle->coolant_temp;
+    batch->intake_temp[index] = vehicle->intake_temp;
+    batch->maf_flow_rate[index] = vehicle->maf_flow_rate;
+    batch->fuel_pressure[index] = vehicle->fuel_pressure;
+    batch->manifold_pressure[index] = vehicle->manifold_pressure;
+    batch->o2_sensor_b1s1[index] = vehicle->o2_sensor_b1s1;
+    batch->o2_sensor_b1s2[index] = vehicle->o2_sensor_b1s2;
+    batch->short_fuel_trim_b1[index] = vehicle->short_fuel_trim_b1;
+    batch->long_fuel_trim_b1[index] = vehicle->long_fuel_trim_b1;
+    batch->timing_advance[index] = vehicle->timing_advance;
+    batch->fuel_trim_integrator[index] = vehicle->fuel_trim_integrator;
+    batch->vehicle_speed[index] = vehicle->vehicle_speed;
+    batch->simulation_cycle[index] = (int32_t)vehicle->simulation_cycle;
+    batch->engine_running[index] = vehicle->engine_running;
+    batch->engine_runtime[index] = vehicle->engine_runtime;
+    batch->fuel_level[index] = vehicle->fuel_level;
+    batch->odometer_m[index] = vehicle->odometer_m;
+    batch->distance_since_clear_m[index] = vehicle->distance_since_clear_m;
+    batch->distance_with_mil_m[index] = vehicle->distance_with_mil_m;
+    batch->distance_mm[index] = vehicle->distance_mm;
+    batch->warmups_since_clear[index] = vehicle->warmups_since_clear;
+    batch->start_coolant_temp[index] = vehicle->start_coolant_temp;
+    batch->warmup_counted[index] = vehicle->warmup_counted;
+}
+
+void obd2_vehicle_batch_load(const obd2_vehicle_batch_t *batch, uint32_t index, obd2_vehicle_t *vehicle)
+{
+    vehicle->throttle_position = (uint8_t)batch->throttle_position[index];
+    vehicle->engine_load = (uint8_t)batch->engine_load[index];
+    vehicle->base_rpm = (uint16_t)batch->base_rpm[index];
+    vehicle->coolant_temp = (uint8_t)batch->coolant_temp[index];
+    vehicle->intake_temp = (uint8_t)batch->intake_temp[index];
+    vehicle->maf_flow_rate = (uint16_t)batch->maf_flow_rate[index];
+    vehicle->fuel_pressure = (uint16_t)batch->fuel_pressure[index];
+    vehicle->manifold_pressure = (uint16_t)batch->manifold_pressure[index];
+    vehicle->o2_sensor_b1s1 = (uint16_t)batch->o2_sensor_b1s1[index];
+    vehicle->o2_sensor_b1s2 = (uint16_t)batch->o2_sensor_b1s2[index];
+    vehicle->short_fuel_trim_b1 = (uint8_t)batch->short_fuel_trim_b1[index];
+    vehicle->long_fuel_trim_b1 = (uint8_t)batch->long_fuel_trim_b1[index];
+    vehicle->timing_advance = (uint8_t)batch->timing_advance[index];
+    vehicle->fuel_trim_integrator = batch->fuel_trim_integrator[index];
+    vehicle->vehicle_speed = (uint8_t)batch->vehicle_speed[index];
+    vehicle->simulation_cycle = (uint32_t)batch->simulation_cycle[index];
+    vehicle->engine_running = batch->engine_running[index] != 0;
+    vehicle->engine_runtime = batch->engine_runtime[index];
+    vehicle->fuel_level = (uint8_t)batch->fuel_level[index];
+    vehicle->odometer_m = batch->odometer_m[index];
+    vehicle->distance_since_clear_m = batch->distance_since_clear_m[index];
+    vehicle->distance_with_mil_m = batch->distance_with_mil_m[index];
+    vehicle->distance_mm = (uint16_t)batch->distance_mm[index];
+    vehicle->warmups_since_clear = (uint8_t)batch->warmups_since_clear[index];
+    vehicle->start_coolant_temp = (uint8_t)batch->start_coolant_temp[index];
+    vehicle->warmup_counted = batch->warmup_counted[index] != 0;
+}
+
+void obd2_vehicle_batch_capture_signals(const obd2_vehicle_batch_t *batch, uint32_t index, int32_t *signals)
+{
+    // Integral floats convert exactly, so these match obd2_fault_capture_signals()
+    signals[OBD2_SIGNAL_NONE] = 0;
+    signals[OBD2_SIGNAL_RPM] = (int32_t)batch->base_rpm[index];
+    signals[OBD2_SIGNAL_SPEED] = batch->vehicle_speed[index];
+    signals[OBD2_SIGNAL_LOAD] = (int32_t)batch->engine_load[index];
+    signals[OBD2_SIGNAL_COOLANT] = (int32_t)batch->coolant_temp[index];
+    signals[OBD2_SIGNAL_INTAKE_TEMP] = (int32_t)batch->intake_temp[index];
+    signals[OBD2_SIGNAL_THROTTLE] = (int32_t)batch->throttle_position[index];
+    signals[OBD2_SIGNAL_MAF] = (int32_t)batch->maf_flow_rate[index];
+    signals[OBD2_SIGNAL_MAP] = (int32_t)batch->manifold_pressure[index];
+    signals[OBD2_SIGNAL_FUEL_PRESSURE] = (int32_t)batch->fuel_pressure[index];
+    signals[OBD2_SIGNAL_O2_B1S1] = (int32_t)batch->o2_sensor_b1s1[index];
+    signals[OBD2_SIGNAL_O2_B1S2] = (int32_t)batch->o2_sensor_b1s2[index];
+    signals[OBD2_SIGNAL_SHORT_TRIM] = ((int32_t)batch->short_fuel_trim_b1[index] - 128) * 100 / 128;
+    signals[OBD2_SIGNAL_LONG_TRIM] = ((int32_t)batch->long_fuel_trim_b1[index] - 128) * 100 / 128;
+    signals[OBD2_SIGNAL_FUEL_LEVEL] = batch->fuel_level[index];
+    signals[OBD2_SIGNAL_RUNTIME] = batch->engine_runtime[index] / (1000 / OBD2_VEHICLE_TICK_MS);
+}
+
+// Signals: obd2_vehicle_step()'s engine dynamics, advanced parameters,
+// movement and temperatures for a run of vehicles whose engines all run.
+// The body is straight-line code apart from selects, so the loop vectorises
+// (with -O3 -fno-trapping-math, see host/CMakeLists.txt).
+static void step_signals(obd2_vehicle_batch_t *batch, uint32_t first, uint32_t end)
+{
+    float *restrict throttle_position = batch->throttle_position;
+    float *restrict engine_load = batch->engine_load;
+    float *restrict base_rpm = batch->base_rpm;
+    float *restrict coolant_temp = batch->coolant_temp;
+    float *restrict intake_temp = batch->intake_temp;
+    float *restrict maf_flow_rate = batch->maf_flow_rate;
+    float *restrict fuel_pressure = batch->fuel_pressure;
+    float *restrict manifold_pressure = batch->manifold_pressure;
+    float *restrict o2_sensor_b1s1 = batch->o2_sensor_b1s1;
+    float *restrict o2_sensor_b1s2 = batch->o2_sensor_b1s2;
+    float *restrict short_fuel_trim_b1 = batch->short_fuel_trim_b1;
+    float *restrict long_fuel_trim_b1 = batch->long_fuel_trim_b1;
+    float *restrict timing_advance = batch->timing_advance;
+    float *restrict fuel_trim_integrator = batch->fuel_trim_integrator;
+    int32_t *restrict vehicle_speed = batch->vehicle_speed;
+    int32_t *restrict simulation_cycle = batch->simulation_cycle;
+
+    // Lanes are independent; GCC does not apply restrict to these locals
+    // and would otherwise give up on the run-time alias checks
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC ivdep
+#endif
+    for (uint32_t i = first; i < end; i++) {
+        int32_t cycle = simulation_cycle[i] + 1;
+        simulation_cycle[i] = cycle;
+
+        // Driving pattern; each sine term is scaled in double and rounded to
+        // float as in the model (float constants widened, not retyped)
+        float time_factor = (float)cycle * 0.005f;
+        double sin_2t = batch_sin(time_factor * 2.0f);
+        float city_driving = (float)(batch_sin(time_factor) * 25.0 + 35.0);
+        float highway_driving = (float)(batch_sin(time_factor * 0.3f) * 15.0 + 65.0);
+        float idle_pattern = (float)(sin_2t * 5.0 + 10.0);
+        float pattern_selector = (float)batch_sin(time_factor * 0.1f);
+        float throttle_base = pattern_selector > -0.3f ? city_driving : idle_pattern;
+        throttle_base = pattern_selector > 0.3f ? highway_driving : throttle_base;
+        float micro_variation = (float)(batch_sin(time_factor * 5.0f) * 3.0);
+        int32_t throttle_percent = (int32_t)(throttle_base + micro_variation);
+        float throttle = (float)(throttle_percent > 100 ? 100 : throttle_percent);
+
+        // Load follows the throttle with lag
+        float load = engine_load[i];
+        float target_load = 15.0f + batch_trunc((throttle * 85.0f) / 100.0f);
+        load += (float)(load < target_load) * 2.0f - (float)(load > target_load);
+
+        float rpm_vibration = (float)(batch_sin(time_factor * 20.0f) * 50.0);
+        float rpm_variation = (float)(batch_sin(time_factor * 1.5f) * 200.0);
+        int32_t engine_rpm = (int32_t)(800.0f + (throttle / 100.0f) * 4500.0f +
+                                       rpm_vibration + rpm_variation);
+        engine_rpm = engine_rpm > 6500 ? 6500 : engine_rpm;
+        float rpm = (float)(engine_rpm < 650 ? 650 : engine_rpm);
+
+        // Advanced parameters
+        float maf_variation = (float)(batch_sin(time_factor * 3.0f) * 2.0);
+        float maf = 2.0f + (rpm - 650.0f) / 6000.0f * 25.0f + (throttle / 100.0f) * 15.0f +
+                    maf_variation;
+        maf = batch_clamp(maf, 0.5f, 50.0f);
+
+        float pressure = 300.0f + (load / 100.0f) * 50.0f + (float)(sin_2t * 10.0);
+        pressure = batch_clamp(pressure, 250.0f, 400.0f);
+
+        float manifold = 101.3f - (100.0f - throttle) / 100.0f * 70.0f +
+                         (float)(batch_sin(time_factor * 4.0f) * 3.0);
+        manifold = batch_clamp(manifold, 20.0f, 105.0f);
+
+        float fuel_trim_effect = (short_fuel_trim_b1[i] - 128.0f) / 128.0f * 0.1f;
+        float o2_b1s1 = 0.45f + fuel_trim_effect + (float)(batch_sin(time_factor * 8.0f) * (double)0.15f);
+        o2_b1s1 = batch_clamp(o2_b1s1, 0.1f, 0.9f);
+        float o2_b1s2 = (float)((double)(0.42f + fuel_trim_effect * 0.5f) + sin_2t * (double)0.05f);
+        o2_b1s2 = batch_clamp(o2_b1s2, 0.2f, 0.7f);
+
+        float integrator = fuel_trim_integrator[i] + (o2_b1s1 - 0.45f) * 0.1f;
+        integrator = batch_clamp(integrator, -25.0f, 25.0f);
+
+        float timing = 10.0f + (rpm - 650.0f) / 6000.0f * 25.0f - (load / 100.0f) * 8.0f;
+        timing = batch_clamp(timing, -5.0f, 35.0f);
+
+        // Movement (the speed wraps like the model's uint8_t before its limit)
+        int32_t speed = vehicle_speed[i];
+        float speed_variation = (float)(batch_sin((float)cycle * 0.015f) * 10.0);
+        int32_t driving_speed = ((int32_t)((rpm - 800.0f) / 5200.0f * 120.0f) +
+                                 (int32_t)speed_variation) & 0xFF;
+        int32_t coasting_speed = speed > 0 ? speed - 1 : speed;
+        speed = throttle > 10.0f ? driving_speed : coasting_speed;
+        speed = speed > 200 ? 200 : speed;
+
+        // Temperatures
+        float coolant = coolant_temp[i];
+        coolant += (float)(load > 50.0f && coolant < 95.0f) - (float)(load < 30.0f && coolant > 85.0f);
+
+        throttle_position[i] = throttle;
+        engine_load[i] = load;
+        base_rpm[i] = rpm;
+        maf_flow_rate[i] = batch_trunc(maf * 100.0f);
+        fuel_pressure[i] = batch_trunc(pressure * 100.0f);
+        manifold_pressure[i] = batch_trunc(manifold * 100.0f);
+        o2_sensor_b1s1[i] = batch_trunc(o2_b1s1 * 1000.0f);
+        o2_sensor_b1s2[i] = batch_trunc(o2_b1s2 * 1000.0f);
+        fuel_trim_integrator[i] = integrator;
+        short_fuel_trim_b1[i] = batch_trunc(128.0f + integrator);
+        long_fuel_trim_b1[i] = batch_trunc(128.0f + integrator * 0.3f);
+        timing_advance[i] = batch_trunc(timing + 64.0f);
+        vehicle_speed[i] = speed;
+        coolant_temp[i] = coolant;
+        intake_temp[i] = 25.0f + batch_trunc((load * 20.0f) / 100.0f);
+    }
+}
+
+// Counters: fuel use, distance and warm-ups, as update_persistent_counters()
+static void step_counters(obd2_vehicle_batch_t *batch, uint32_t first, uint32_t end, const uint8_t *mil_on)
+{
+    for (uint32_t i = first; i < end; i++) {
+        if (!batch->engine_running[i]) {
+            continue;
+        }
+        batch->engine_runtime[i]++;
+
+        if (batch->simulation_cycle[i] % 1000 == 0 && batch->fuel_level[i] > 0) {
+            batch->fuel_level[i]--;
+        }
+
+        batch->distance_mm[i] += (batch->vehicle_speed[i] * 125) / 9;
+        if (batch->distance_mm[i] >= 1000) {
+            uint32_t meters = batch->distance_mm[i] / 1000;
+            batch->distance_mm[i] %= 1000;
+            batch->odometer_m[i] += meters;
+            batch->distance_since_clear_m[i] += meters;
+            if (mil_on != NULL && mil_on[i]) {
+                batch->distance_with_mil_m[i] += meters;
+            }
+        }
+
+        int32_t coolant = (int32_t)batch->coolant_temp[i];
+        if (!batch->warmup_counted[i] && coolant >= 70 && coolant >= batch->start_coolant_temp[i] + 22) {
+            batch->warmup_counted[i] = 1;
+            if (batch->warmups_since_clear[i] < 0xFF) {
+                batch->warmups_since_clear[i]++;
+            }
+        }
+    }
+}
+
+void obd2_vehicle_batch_step(obd2_vehicle_batch_t *batch, uint32_t first, uint32_t count,
+                             const uint8_t *mil_on)
+{
+    uint32_t end = first + count;
+
+    if (end > batch->count) {
+        end = batch->count;
+    }
+
+    // Vectorised over each run of running engines; stopped engines only
+    // count the simulation cycle, as in obd2_vehicle_step()
+    for (uint32_t i = first; i < end; ) {
+        if (!batch->engine_running[i]) {
+            batch->simulation_cycle[i]++;
+            i++;
+            continue;
+        }
+        uint32_t run_end = i + 1;
+        while (run_end < end && batch->engine_running[run_end]) {
+            run_end++;
+        }
+        step_signals(batch, i, run_end);
+        i = run_end;
+    }
+    step_counters(batch, first, end, mil_on);
+}
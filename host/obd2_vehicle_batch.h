@@ -0,0 +1,75 @@
+#ifndef __OBD2_VEHICLE_BATCH_H__
+#define __OBD2_VEHICLE_BATCH_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "obd2_vehicle.h"
+
+// Batched vehicle model (host build)
+//
+// The obd2_vehicle_t model laid out as structure-of-arrays: every signal of
+// every vehicle in one contiguous, 64-byte aligned array. A batch step runs
+// the same equations as obd2_vehicle_step() over a range of vehicles in one
+// branch-free loop that the compiler vectorises at the target's baseline
+// vector ISA (SSE2 on x86-64, NEON on aarch64); built without vectorisation
+// it is the plain scalar loop. Sines come from a double polynomial within
+// an ulp of libm's, and every expression rounds to float where the model's
+// does, so results match the single-vehicle model; obd2_batch_check
+// compares the two.
+//
+// Signals are held as float (integral values where the model stores
+// integers) and flags/counters as 32-bit integers, so each loop works on
+// lanes of one width.
+
+typedef struct {
+    uint32_t count;
+    void *memory;
+
+    // Simulated signals (units as in obd2_vehicle_t)
+    float *throttle_position;
+    float *engine_load;
+    float *base_rpm;
+    float *coolant_temp;
+    float *intake_temp;
+    float *maf_flow_rate;
+    float *fuel_pressure;
+    float *manifold_pressure;
+    float *o2_sensor_b1s1;
+    float *o2_sensor_b1s2;
+    float *short_fuel_trim_b1;
+    float *long_fuel_trim_b1;
+    float *timing_advance;
+    float *fuel_trim_integrator;
+    int32_t *vehicle_speed;
+
+    // Model state, flags and counters
+    int32_t *simulation_cycle;
+    int32_t *engine_running;
+    uint32_t *engine_runtime;
+    int32_t *fuel_level;
+    uint32_t *odometer_m;
+    uint32_t *distance_since_clear_m;
+    uint32_t *distance_with_mil_m;
+    int32_t *distance_mm;
+    int32_t *warmups_since_clear;
+    int32_t *start_coolant_temp;
+    int32_t *warmup_counted;
+} obd2_vehicle_batch_t;
+
+// Allocate count vehicles (contents undefined until stored); false on failure
+bool obd2_vehicle_batch_init(obd2_vehicle_batch_t *batch, uint32_t count);
+void obd2_vehicle_batch_free(obd2_vehicle_batch_t *batch);
+
+// Copy one vehicle into or out of the batch
+void obd2_vehicle_batch_store(obd2_vehicle_batch_t *batch, uint32_t index, const obd2_vehicle_t *vehicle);
+void obd2_vehicle_batch_load(const obd2_vehicle_batch_t *batch, uint32_t index, obd2_vehicle_t *vehicle);
+
+// One vehicle's fault rule signals (obd2_fault.h) read from the arrays
+void obd2_vehicle_batch_capture_signals(const obd2_vehicle_batch_t *batch, uint32_t index, int32_t *signals);
+
+// Advance vehicles [first, first + count) by one tick; mil_on[i] (indexed
+// like the batch, NULL = all off) accrues distance with MIL
+void obd2_vehicle_batch_step(obd2_vehicle_batch_t *batch, uint32_t first, uint32_t count,
+                             const uint8_t *mil_on);
+
+#endif // __OBD2_VEHICLE_BATCH_H__
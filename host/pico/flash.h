@@ -0,0 +1,9 @@
+#ifndef __PICO_HOST_FLASH_H__
+#define __PICO_HOST_FLASH_H__
+
+#include <stdint.h>
+
+// No second core or XIP cache on the host: the operation simply runs
+int flash_safe_execute(void (*func)(void *), void *param, uint32_t enter_exit_timeout_ms);
+
+#endif // __PICO_HOST_FLASH_H__
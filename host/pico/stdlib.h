@@ -0,0 +1,34 @@
+#ifndef __PICO_HOST_STDLIB_H__
+#define __PICO_HOST_STDLIB_H__
+
+// Host (Linux) stand-in for the subset of the Pico SDK the emulator uses.
+// Time is CLOCK_MONOTONIC since process start; there are no hardware
+// timers, the host main loop runs obd2_timer's wheel when it falls due.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef unsigned int uint;
+typedef uint64_t absolute_time_t;
+
+#define PICO_OK                 0
+#define PICO_ERROR_TIMEOUT      (-1)
+
+// Flash image (see hardware/flash.h); XIP reads go straight to host memory
+#define PICO_FLASH_SIZE_BYTES   (4u * 1024u * 1024u)
+extern uint8_t *pico_host_flash;
+#define XIP_BASE                ((uintptr_t)pico_host_flash)
+
+// Time
+uint64_t time_us_64(void);
+absolute_time_t get_absolute_time(void);
+uint32_t to_ms_since_boot(absolute_time_t t);
+absolute_time_t make_timeout_time_ms(uint32_t ms);
+void sleep_ms(uint32_t ms);
+
+// Events and stdio (the host loop waits in epoll instead)
+bool best_effort_wfe_or_timeout(absolute_time_t timeout_timestamp);
+int getchar_timeout_us(uint32_t timeout_us);
+
+#endif // __PICO_HOST_STDLIB_H__
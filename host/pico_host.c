@@ -0,0 +1,124 @@
+#define _GNU_SOURCE
+#include "pico_host.h"
+#include "pico/stdlib.h"
+#include "pico/flash.h"
+#include "hardware/flash.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+static uint8_t flash_memory[PICO_FLASH_SIZE_BYTES];
+uint8_t *pico_host_flash;
+
+static struct {
+    bool started;
+    uint64_t start_us;
+} host_state;
+
+static uint64_t monotonic_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+uint64_t time_us_64(void)
+{
+    // Boot time is the first clock read, like the RP2350 timer starting at reset
+    if (!host_state.started) {
+        host_state.start_us = monotonic_us();
+        host_state.started = true;
+    }
+    return monotonic_us() - host_state.start_us;
+}
+
+absolute_time_t get_absolute_time(void)
+{
+    return time_us_64();
+}
+
+uint32_t to_ms_since_boot(absolute_time_t t)
+{
+    return (uint32_t)(t / 1000u);
+}
+
+absolute_time_t make_timeout_time_ms(uint32_t ms)
+{
+    return time_us_64() + (uint64_t)ms * 1000u;
+}
+
+void sleep_ms(uint32_t ms)
+{
+    usleep(ms * 1000u);
+}
+
+bool best_effort_wfe_or_timeout(absolute_time_t timeout_timestamp)
+{
+    uint64_t now = time_us_64();
+
+    if (now < timeout_timestamp) {
+        usleep((useconds_t)(timeout_timestamp - now));
+    }
+    return true;
+}
+
+int getchar_timeout_us(uint32_t timeout_us)
+{
+    // Console input is fed by the host main loop
+    return PICO_ERROR_TIMEOUT;
+}
+
+bool pico_host_flash_open(const char *path)
+{
+    if (path == NULL) {
+        memset(flash_memory, 0xFF, sizeof(flash_memory));
+        pico_host_flash = flash_memory;
+        return true;
+    }
+
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        return false;
+    }
+
+    // A new image file starts erased
+    off_t size = lseek(fd, 0, SEEK_END);
+    if (size < (off_t)PICO_FLASH_SIZE_BYTES) {
+        if (ftruncate(fd, PICO_FLASH_SIZE_BYTES) != 0) {
+            close(fd);
+            return false;
+        }
+    }
+
+    void *image = mmap(NULL, PICO_FLASH_SIZE_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (image == MAP_FAILED) {
+        return false;
+    }
+    if (size == 0) {
+        memset(image, 0xFF, PICO_FLASH_SIZE_BYTES);
+    }
+    pico_host_flash = image;
+    return true;
+}
+
+void flash_range_erase(uint32_t flash_offs, size_t count)
+{
+    memset(pico_host_flash + flash_offs, 0xFF, count);
+}
+
+void flash_range_program(uint32_t flash_offs, const uint8_t *data, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        pico_host_flash[flash_offs + i] &= data[i];
+    }
+}
+
+int flash_safe_execute(void (*func)(void *), void *param, uint32_t enter_exit_timeout_ms)
+{
+    func(param);
+    return PICO_OK;
+}
@@ -0,0 +1,13 @@
+#ifndef __PICO_HOST_H__
+#define __PICO_HOST_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Host-only controls for the Pico SDK shim (pico/stdlib.h)
+
+// Set up the flash image before storage is initialised: a file keeps stored
+// DTCs and counters across restarts, NULL gives an erased in-memory image
+bool pico_host_flash_open(const char *path);
+
+#endif // __PICO_HOST_H__
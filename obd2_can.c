@@ -0,0 +1,36 @@
+#include "obd2_can.h"
+
+// Data length for each DLC code
+static const uint8_t dlc_lengths[16] = {
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64
+};
+
+uint8_t obd2_can_dlc_to_length(uint8_t dlc)
+{
+    return dlc_lengths[dlc & 0x0F];
+}
+
+uint8_t obd2_can_length_to_dlc(uint8_t length)
+{
+    if (length <= 8) {
+        return length;
+    }
+    for (uint8_t dlc = 9; dlc < 15; dlc++) {
+        if (length <= dlc_lengths[dlc]) {
+            return dlc;
+        }
+    }
+    return 15;
+}
+
+uint8_t obd2_can_frame_length(uint8_t length)
+{
+    return dlc_lengths[obd2_can_length_to_dlc(length)];
+}
+
+bool obd2_can_is_valid_frame_size(uint8_t frame_size)
+{
+    // ISO-TP needs at least a classic frame and an encodable length
+    return frame_size >= OBD2_CAN_CLASSIC_FRAME_SIZE && frame_size <= OBD2_CAN_FD_FRAME_SIZE &&
+           obd2_can_frame_length(frame_size) == frame_size;
+}
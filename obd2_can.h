@@ -0,0 +1,53 @@
+#ifndef __OBD2_CAN_H__
+#define __OBD2_CAN_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// CAN frame sizes and transport selection
+//
+// Classic CAN carries up to 8 data bytes per frame; CAN FD carries up to 64,
+// but above 8 only the lengths 12, 16, 20, 24, 32, 48 and 64 can be encoded
+// in the 4-bit DLC. Each transport declares the frame size it transmits with
+// (ISO 15765-2 TX_DL) and ISO-TP segments responses to fit, so an FD bus
+// carries most multi-frame responses in a single frame.
+
+#define OBD2_CAN_CLASSIC_FRAME_SIZE     8
+#define OBD2_CAN_FD_FRAME_SIZE          64
+#define OBD2_CAN_MAX_FRAME_SIZE         OBD2_CAN_FD_FRAME_SIZE  // Receive/transmit buffers
+
+// Frame transport (CAN controller or virtual bus)
+typedef struct {
+    const char *name;
+    uint8_t frame_size;         // Transmit data length: 8 = classic, 12..64 = FD
+    bool (*init)(void);
+    bool (*send)(uint32_t can_id, const uint8_t *can_data, uint8_t can_length);
+    bool (*recv)(uint32_t can_id, uint8_t *can_data, uint8_t *can_length);
+    uint64_t (*rx_time_us)(void);   // Optional: arrival time of the last received frame
+                                    // (time_us_64() timebase), e.g. a kernel timestamp
+    uint32_t (*rx_can_id)(void);    // Optional: CAN ID of the last received frame; without
+                                    // it frames are taken to carry the ID passed to recv()
+
+    // Optional, for transports serving several interfaces: the interface the
+    // last frame arrived on, and the one the following frames are sent on
+    uint8_t (*rx_channel)(void);
+    void (*tx_channel)(uint8_t channel);
+
+    // Optional zero-copy transmit: tx_claim returns the data area of the next
+    // transmit slot (NULL if none is free; claiming again returns the same
+    // slot) and tx_commit queues it. A claimed slot is valid until the next
+    // send or commit. Without them frames are built in a buffer for send().
+    uint8_t *(*tx_claim)(void);
+    bool (*tx_commit)(uint32_t can_id, uint8_t can_length);
+} obd2_can_transport_t;
+
+// Classic CAN through the XL2515 (MCP2515) controller at 500 kbps
+extern const obd2_can_transport_t obd2_can_xl2515_transport;
+
+// DLC mapping
+uint8_t obd2_can_dlc_to_length(uint8_t dlc);
+uint8_t obd2_can_length_to_dlc(uint8_t length);     // Rounds up to the next encodable length
+uint8_t obd2_can_frame_length(uint8_t length);      // Smallest encodable length >= length
+bool obd2_can_is_valid_frame_size(uint8_t frame_size);
+
+#endif // __OBD2_CAN_H__
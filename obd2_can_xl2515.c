@@ -0,0 +1,38 @@
+#include "obd2_can.h"
+#include "obd2_protocol.h"
+#include "xl2515.h"
+
+// The MCP2515 is a classic CAN controller: frames never exceed 8 data bytes.
+// Its filters pass only the functional and physical request IDs, and the
+// received ID is reported so physical requests are told apart.
+
+static bool xl2515_transport_init(void)
+{
+    // Standard OBD2 bit rate
+    xl2515_init(KBPS500);
+    xl2515_set_rx_filters(OBD2_REQUEST_ID, OBD2_PHYSICAL_REQUEST_ID);
+    return true;
+}
+
+static bool xl2515_transport_send(uint32_t can_id, const uint8_t *can_data, uint8_t can_length)
+{
+    if (can_length > OBD2_CAN_CLASSIC_FRAME_SIZE) {
+        return false;
+    }
+    xl2515_send(can_id, (uint8_t *)can_data, can_length);
+    return true;
+}
+
+static bool xl2515_transport_recv(uint32_t can_id, uint8_t *can_data, uint8_t *can_length)
+{
+    return xl2515_recv(can_id, can_data, can_length);
+}
+
+const obd2_can_transport_t obd2_can_xl2515_transport = {
+    .name = "XL2515 classic CAN",
+    .frame_size = OBD2_CAN_CLASSIC_FRAME_SIZE,
+    .init = xl2515_transport_init,
+    .send = xl2515_transport_send,
+    .recv = xl2515_transport_recv,
+    .rx_can_id = xl2515_recv_can_id,
+};
@@ -0,0 +1,682 @@
+#include "obd2_console.h"
+#include "obd2_handler.h"
+#include "obd2_protocol.h"
+#include "obd2_dtc.h"
+#include "obd2_override.h"
+#include "obd2_timing.h"
+#include "obd2_sensor.h"
+#include "pico/stdlib.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+// Console state
+static struct {
+    char line[OBD2_CONSOLE_LINE_MAX];
+    uint16_t line_length;
+    bool in_frame;
+    bool overflow;
+    obd2_console_legacy_fn legacy_handler;
+    uint32_t frames;
+    uint32_t commands;
+    uint32_t errors;
+} console_state;
+
+// Command handlers
+static bool cmd_help(int argc, char **argv, char *reply, size_t reply_size);
+static bool cmd_pid(int argc, char **argv, char *reply, size_t reply_size);
+static bool cmd_dtc(int argc, char **argv, char *reply, size_t reply_size);
+static bool cmd_vin(int argc, char **argv, char *reply, size_t reply_size);
+static bool cmd_scenario(int argc, char **argv, char *reply, size_t reply_size);
+static bool cmd_stats(int argc, char **argv, char *reply, size_t reply_size);
+static bool cmd_queue(int argc, char **argv, char *reply, size_t reply_size);
+static bool cmd_engine(int argc, char **argv, char *reply, size_t reply_size);
+static bool cmd_override(int argc, char **argv, char *reply, size_t reply_size);
+static bool cmd_timing(int argc, char **argv, char *reply, size_t reply_size);
+static bool cmd_sensor(int argc, char **argv, char *reply, size_t reply_size);
+
+static const obd2_console_cmd_t console_commands[] = {
+    { "HELP",     cmd_help,     "HELP" },
+    { "PID",      cmd_pid,      "PID <pid-hex>" },
+    { "DTC",      cmd_dtc,      "DTC ADD <code> [status-hex] | DEL <code> | CLEAR | LIST | COUNT" },
+    { "VIN",      cmd_vin,      "VIN [17-char VIN]" },
+    { "SCENARIO", cmd_scenario, "SCENARIO COLD|EMISSIONS|FUEL|MISFIRE|RANDOM|TEST" },
+    { "STATS",    cmd_stats,    "STATS [RESET]" },
+    { "QUEUE",    cmd_queue,    "QUEUE [BUDGET <ms>]" },
+    { "ENGINE",   cmd_engine,   "ENGINE [ON|OFF]" },
+    { "OVR",      cmd_override, "OVR SET|RAMP|NOISE|STEP <pid-hex> <values...> | CLEAR [pid-hex] | LIST" },
+    { "TIMING",   cmd_timing,   "TIMING [OFF | FIXED <ms> | UNIFORM <min> <max> | NORMAL <mean> <sd>] [PENDING <%> [ms]]" },
+    { "SENSOR",   cmd_sensor,   "SENSOR <signal> STUCK <v> | DRIFT <v/s> | NOISE <amp> [ms] | OPEN | SHORT | DROPOUT <%> | CLEAR [signal] | LIST" },
+};
+
+#define CONSOLE_COMMAND_COUNT (sizeof(console_commands) / sizeof(console_commands[0]))
+
+void obd2_console_init(obd2_console_legacy_fn legacy_handler)
+{
+    memset(&console_state, 0, sizeof(console_state));
+    console_state.legacy_handler = legacy_handler;
+}
+
+void obd2_console_poll(void)
+{
+    // Drain everything the USB stack has buffered instead of one byte per loop
+    for (int i = 0; i < OBD2_CONSOLE_RX_BUDGET; i++) {
+        int ch = getchar_timeout_us(0);  // Non-blocking read
+        if (ch == PICO_ERROR_TIMEOUT) {
+            break;
+        }
+        obd2_console_feed((char)ch);
+    }
+}
+
+// Optional leading sequence number used to match acknowledgements (0 if absent)
+static unsigned long parse_sequence(char **cursor)
+{
+    while (**cursor == ' ') {
+        (*cursor)++;
+    }
+    if (**cursor >= '0' && **cursor <= '9') {
+        return strtoul(*cursor, cursor, 10);
+    }
+    return 0;
+}
+
+void obd2_console_feed(char ch)
+{
+    if (!console_state.in_frame) {
+        if (ch == OBD2_CONSOLE_FRAME_START) {
+            console_state.in_frame = true;
+            console_state.overflow = false;
+            console_state.line_length = 0;
+        } else if (ch != '\r' && ch != '\n' && console_state.legacy_handler != NULL) {
+            console_state.legacy_handler(ch);
+        }
+        return;
+    }
+
+    if (ch == '\r' || ch == '\n') {
+        console_state.in_frame = false;
+        console_state.line[console_state.line_length] = '\0';
+
+        if (console_state.overflow) {
+            // The leading sequence number was kept, so the frame is still acknowledged
+            char *cursor = console_state.line;
+            unsigned long seq = parse_sequence(&cursor);
+
+            console_state.frames++;
+            console_state.commands++;
+            console_state.errors++;
+            printf("%c%lu.0 ERR frame too long\r\n", OBD2_CONSOLE_REPLY_START, seq);
+            printf("%c%lu ACK 0/1\r\n", OBD2_CONSOLE_REPLY_START, seq);
+            return;
+        }
+
+        obd2_console_execute_line(console_state.line);
+        return;
+    }
+
+    if (console_state.line_length < OBD2_CONSOLE_LINE_MAX - 1) {
+        console_state.line[console_state.line_length++] = ch;
+    } else {
+        console_state.overflow = true;
+    }
+}
+
+// Split a command into whitespace separated tokens (in place)
+static int tokenize(char *str, char **argv, int max_args)
+{
+    int argc = 0;
+    char *p = str;
+
+    while (*p != '\0' && argc < max_args) {
+        while (*p == ' ' || *p == '\t') {
+            p++;
+        }
+        if (*p == '\0') {
+            break;
+        }
+        argv[argc++] = p;
+        while (*p != '\0' && *p != ' ' && *p != '\t') {
+            p++;
+        }
+        if (*p != '\0') {
+            *p++ = '\0';
+        }
+    }
+
+    return argc;
+}
+
+static const obd2_console_cmd_t *find_command(const char *name)
+{
+    for (size_t i = 0; i < CONSOLE_COMMAND_COUNT; i++) {
+        if (strcasecmp(console_commands[i].name, name) == 0) {
+            return &console_commands[i];
+        }
+    }
+    return NULL;
+}
+
+void obd2_console_execute_line(char *line)
+{
+    char *argv[OBD2_CONSOLE_MAX_ARGS];
+    char reply[OBD2_CONSOLE_REPLY_MAX];
+    uint16_t total = 0;
+    uint16_t ok = 0;
+    char *cursor = line;
+    unsigned long seq = parse_sequence(&cursor);
+
+    console_state.frames++;
+
+    // Execute each ';' separated command of the batch in order
+    char *command = cursor;
+    while (command != NULL) {
+        char *next = strchr(command, OBD2_CONSOLE_SEPARATOR);
+        if (next != NULL) {
+            *next++ = '\0';
+        }
+
+        int argc = tokenize(command, argv, OBD2_CONSOLE_MAX_ARGS);
+        if (argc > 0) {
+            const obd2_console_cmd_t *cmd = find_command(argv[0]);
+            bool success = false;
+
+            total++;
+            console_state.commands++;
+            reply[0] = '\0';
+
+            if (cmd == NULL) {
+                snprintf(reply, sizeof(reply), "unknown command %s", argv[0]);
+            } else {
+                success = cmd->handler(argc, argv, reply, sizeof(reply));
+            }
+
+            if (success) {
+                ok++;
+                if (reply[0] != '\0') {
+                    printf("%c%lu.%u %s\r\n", OBD2_CONSOLE_REPLY_START, seq, total - 1, reply);
+                }
+            } else {
+                console_state.errors++;
+                printf("%c%lu.%u ERR %s\r\n", OBD2_CONSOLE_REPLY_START, seq, total - 1,
+                       reply[0] != '\0' ? reply : "failed");
+            }
+        }
+
+        command = next;
+    }
+
+    printf("%c%lu ACK %u/%u\r\n", OBD2_CONSOLE_REPLY_START, seq, ok, total);
+}
+
+void obd2_console_print_help(void)
+{
+    printf("Structured commands: $<seq> <cmd> [args][;<cmd> [args]]...\r\n");
+    for (size_t i = 0; i < CONSOLE_COMMAND_COUNT; i++) {
+        printf("  %s\r\n", console_commands[i].usage);
+    }
+}
+
+uint32_t obd2_console_get_frame_count(void)
+{
+    return console_state.frames;
+}
+
+uint32_t obd2_console_get_command_count(void)
+{
+    return console_state.commands;
+}
+
+uint32_t obd2_console_get_error_count(void)
+{
+    return console_state.errors;
+}
+
+// Argument helpers
+
+static bool parse_hex(const char *str, uint32_t max_value, uint32_t *value)
+{
+    char *end;
+    unsigned long parsed = strtoul(str, &end, 16);
+
+    if (end == str || *end != '\0' || parsed > max_value) {
+        return false;
+    }
+    *value = (uint32_t)parsed;
+    return true;
+}
+
+static bool parse_value(const char *str, uint16_t *value)
+{
+    char *end;
+    unsigned long parsed = strtoul(str, &end, 10);
+
+    if (end == str || *end != '\0' || parsed > 0xFFFF) {
+        return false;
+    }
+    *value = (uint16_t)parsed;
+    return true;
+}
+
+static bool parse_dtc(const char *str, uint16_t *code, uint8_t *type)
+{
+    if (strlen(str) != 5) {
+        return false;
+    }
+    *code = obd2_dtc_parse_code_string(str, type);
+    return *type != 0;
+}
+
+// Command implementations
+
+static bool cmd_help(int argc, char **argv, char *reply, size_t reply_size)
+{
+    size_t pos = 0;
+    for (size_t i = 0; i < CONSOLE_COMMAND_COUNT && pos < reply_size; i++) {
+        pos += snprintf(reply + pos, reply_size - pos, "%s%s", i ? " " : "", console_commands[i].name);
+    }
+    return true;
+}
+
+static bool cmd_pid(int argc, char **argv, char *reply, size_t reply_size)
+{
+    uint32_t pid;
+
+    if (argc != 2 || !parse_hex(argv[1], 0xFF, &pid)) {
+        snprintf(reply, reply_size, "usage: PID <pid-hex>");
+        return false;
+    }
+
+    obd2_message_t request = {
+        .service = OBD2_SERVICE_01,
+        .pid = (uint8_t)pid,
+        .length = 2
+    };
+    obd2_response_t response;
+    uint8_t frame[OBD2_CAN_CLASSIC_FRAME_SIZE];
+
+    obd2_response_init(&response, frame);
+    if (!obd2_create_response(&request, &response) || frame[OBD2_FRAME_SERVICE] == 0x7F) {
+        snprintf(reply, reply_size, "PID %02lX not supported", (unsigned long)pid);
+        return false;
+    }
+
+    size_t pos = snprintf(reply, reply_size, "%02X", frame[OBD2_FRAME_PID]);
+    for (int i = 0; i < response.length - 2 && pos < reply_size; i++) {
+        pos += snprintf(reply + pos, reply_size - pos, " %02X", response.data[i]);
+    }
+    return true;
+}
+
+static bool cmd_dtc(int argc, char **argv, char *reply, size_t reply_size)
+{
+    uint16_t code;
+    uint8_t type;
+
+    if (argc >= 2 && strcasecmp(argv[1], "ADD") == 0) {
+        uint32_t status = DTC_STATUS_TEST_FAILED | DTC_STATUS_CONFIRMED | DTC_STATUS_WARNING_INDICATOR_REQUESTED;
+
+        if (argc < 3 || !parse_dtc(argv[2], &code, &type) ||
+            (argc >= 4 && !parse_hex(argv[3], 0xFF, &status))) {
+            snprintf(reply, reply_size, "usage: DTC ADD <code> [status-hex]");
+            return false;
+        }
+        if (!obd2_dtc_add(code, type, (uint8_t)status)) {
+            snprintf(reply, reply_size, "DTC storage full");
+            return false;
+        }
+        return true;
+    }
+
+    if (argc >= 2 && strcasecmp(argv[1], "DEL") == 0) {
+        if (argc < 3 || !parse_dtc(argv[2], &code, &type)) {
+            snprintf(reply, reply_size, "usage: DTC DEL <code>");
+            return false;
+        }
+        if (!obd2_dtc_remove(code, type)) {
+            snprintf(reply, reply_size, "%s not stored", argv[2]);
+            return false;
+        }
+        return true;
+    }
+
+    if (argc >= 2 && strcasecmp(argv[1], "CLEAR") == 0) {
+        obd2_dtc_clear_all();
+        return true;
+    }
+
+    if (argc >= 2 && strcasecmp(argv[1], "COUNT") == 0) {
+        snprintf(reply, reply_size, "%u MIL=%s", obd2_dtc_get_count(),
+                 obd2_dtc_get_mil_status() ? "ON" : "OFF");
+        return true;
+    }
+
+    if (argc >= 2 && strcasecmp(argv[1], "LIST") == 0) {
+        // Only as many entries as fit in one reply line, total count first
+        dtc_entry_t entries[12];
+        uint16_t count = obd2_dtc_list(entries, sizeof(entries) / sizeof(entries[0]));
+        size_t pos = snprintf(reply, reply_size, "%u", obd2_dtc_get_count());
+
+        for (uint16_t i = 0; i < count && pos + 9 < reply_size; i++) {
+            pos += snprintf(reply + pos, reply_size - pos, " %c%04X:%02X",
+                            entries[i].type, entries[i].code, entries[i].status);
+        }
+        return true;
+    }
+
+    snprintf(reply, reply_size, "usage: DTC ADD|DEL|CLEAR|LIST|COUNT");
+    return false;
+}
+
+static bool cmd_vin(int argc, char **argv, char *reply, size_t reply_size)
+{
+    if (argc == 1) {
+        snprintf(reply, reply_size, "%s", obd2_get_vin());
+        return true;
+    }
+
+    if (argc != 2 || strlen(argv[1]) != 17) {
+        snprintf(reply, reply_size, "VIN must be 17 characters");
+        return false;
+    }
+
+    obd2_set_vin(argv[1]);
+    return true;
+}
+
+static bool cmd_scenario(int argc, char **argv, char *reply, size_t reply_size)
+{
+    if (argc != 2) {
+        snprintf(reply, reply_size, "usage: SCENARIO COLD|EMISSIONS|FUEL|MISFIRE|RANDOM|TEST");
+        return false;
+    }
+
+    if (strcasecmp(argv[1], "COLD") == 0) {
+        obd2_dtc_simulate_cold_start_issues();
+    } else if (strcasecmp(argv[1], "EMISSIONS") == 0) {
+        obd2_dtc_simulate_emissions_failure();
+    } else if (strcasecmp(argv[1], "FUEL") == 0) {
+        obd2_dtc_simulate_fuel_system_issues();
+    } else if (strcasecmp(argv[1], "MISFIRE") == 0) {
+        obd2_dtc_simulate_ignition_misfires();
+    } else if (strcasecmp(argv[1], "RANDOM") == 0) {
+        obd2_dtc_simulate_random_faults();
+    } else if (strcasecmp(argv[1], "TEST") == 0) {
+        obd2_dtc_test_scenario();
+    } else {
+        snprintf(reply, reply_size, "unknown scenario %s", argv[1]);
+        return false;
+    }
+
+    return true;
+}
+
+static bool cmd_stats(int argc, char **argv, char *reply, size_t reply_size)
+{
+    if (argc == 2 && strcasecmp(argv[1], "RESET") == 0) {
+        obd2_handler_reset_stats();
+        return true;
+    }
+
+    snprintf(reply, reply_size, "rx=%lu tx=%lu err=%lu nrc_suppressed=%lu dtc=%u mil=%u runtime=%lu",
+             (unsigned long)obd2_handler_get_message_count(),
+             (unsigned long)obd2_handler_get_sent_count(),
+             (unsigned long)obd2_handler_get_error_count(),
+             (unsigned long)obd2_handler_get_suppressed_count(),
+             obd2_dtc_get_count(),
+             obd2_dtc_get_mil_status() ? 1 : 0,
+             (unsigned long)obd2_get_engine_runtime());
+    return true;
+}
+
+static bool cmd_queue(int argc, char **argv, char *reply, size_t reply_size)
+{
+    uint16_t budget_ms = 0;
+
+    if (argc == 3 && strcasecmp(argv[1], "BUDGET") == 0) {
+        if (!parse_value(argv[2], &budget_ms) || budget_ms == 0) {
+            snprintf(reply, reply_size, "bad budget %s", argv[2]);
+            return false;
+        }
+        obd2_handler_set_latency_budget(budget_ms);
+        return true;
+    }
+
+    if (argc != 1) {
+        snprintf(reply, reply_size, "usage: QUEUE [BUDGET <ms>]");
+        return false;
+    }
+
+    snprintf(reply, reply_size, "depth=%u budget=%lu shed=%lu",
+             obd2_handler_get_queue_depth(),
+             (unsigned long)obd2_handler_get_latency_budget(),
+             (unsigned long)obd2_handler_get_shed_count());
+    return true;
+}
+
+static bool cmd_engine(int argc, char **argv, char *reply, size_t reply_size)
+{
+    if (argc == 1) {
+        snprintf(reply, reply_size, "%s", obd2_get_engine_state() ? "ON" : "OFF");
+        return true;
+    }
+
+    if (strcasecmp(argv[1], "ON") == 0) {
+        obd2_set_engine_state(true);
+    } else if (strcasecmp(argv[1], "OFF") == 0) {
+        obd2_set_engine_state(false);
+    } else {
+        snprintf(reply, reply_size, "usage: ENGINE [ON|OFF]");
+        return false;
+    }
+
+    return true;
+}
+
+static bool cmd_override(int argc, char **argv, char *reply, size_t reply_size)
+{
+    uint32_t pid = 0;
+    uint16_t values[OBD2_OVERRIDE_MAX_STEPS];
+
+    if (argc >= 2 && strcasecmp(argv[1], "LIST") == 0) {
+        uint8_t count = obd2_override_get_active_count();
+        size_t pos = snprintf(reply, reply_size, "%u", count);
+
+        for (uint8_t i = 0; i < count && pos < reply_size; i++) {
+            const obd2_override_t *slot = obd2_override_get_slot(i);
+            pos += snprintf(reply + pos, reply_size - pos, " %02X:%s=%u",
+                            slot->pid, obd2_override_mode_name(slot->mode), slot->value);
+        }
+        return true;
+    }
+
+    if (argc >= 2 && strcasecmp(argv[1], "CLEAR") == 0) {
+        if (argc == 2) {
+            obd2_override_clear_all();
+            return true;
+        }
+        if (!parse_hex(argv[2], 0xFF, &pid) || !obd2_override_clear((uint8_t)pid)) {
+            snprintf(reply, reply_size, "no override for PID %s", argv[2]);
+            return false;
+        }
+        return true;
+    }
+
+    if (argc < 4 || !parse_hex(argv[2], 0xFF, &pid)) {
+        snprintf(reply, reply_size, "usage: OVR SET|RAMP|NOISE|STEP <pid-hex> <values...>");
+        return false;
+    }
+
+    // Remaining arguments are decimal raw values (A or A*256+B)
+    int value_count = argc - 3;
+    if (value_count > OBD2_OVERRIDE_MAX_STEPS + 1) {
+        snprintf(reply, reply_size, "too many values");
+        return false;
+    }
+    uint16_t args[OBD2_OVERRIDE_MAX_STEPS + 1];
+    for (int i = 0; i < value_count; i++) {
+        if (!parse_value(argv[3 + i], &args[i])) {
+            snprintf(reply, reply_size, "invalid value %s", argv[3 + i]);
+            return false;
+        }
+    }
+
+    bool ok = false;
+    if (strcasecmp(argv[1], "SET") == 0 && value_count == 1) {
+        ok = obd2_override_set_fixed((uint8_t)pid, args[0]);
+    } else if (strcasecmp(argv[1], "RAMP") == 0 && value_count == 3) {
+        ok = obd2_override_set_ramp((uint8_t)pid, args[0], args[1], args[2]);
+    } else if (strcasecmp(argv[1], "NOISE") == 0 && value_count == 2) {
+        ok = obd2_override_set_noise((uint8_t)pid, args[0], args[1]);
+    } else if (strcasecmp(argv[1], "STEP") == 0 && value_count >= 2) {
+        // First value is the dwell time in ticks, the rest is the sequence
+        memcpy(values, &args[1], (value_count - 1) * sizeof(uint16_t));
+        ok = obd2_override_set_steps((uint8_t)pid, values, value_count - 1, args[0]);
+    } else {
+        snprintf(reply, reply_size, "usage: OVR SET <pid> <v> | RAMP <pid> <from> <to> <ticks> | "
+                 "NOISE <pid> <center> <amp> | STEP <pid> <dwell> <v1> [v2...]");
+        return false;
+    }
+
+    if (!ok) {
+        snprintf(reply, reply_size, "override table full");
+    }
+    return ok;
+}
+
+static bool cmd_timing(int argc, char **argv, char *reply, size_t reply_size)
+{
+    obd2_timing_profile_t profile = { 0 };
+    uint16_t args[2];
+    int next = 2;
+
+    if (argc == 1) {
+        const obd2_timing_profile_t *current = obd2_timing_get_profile(OBD2_ECU_ID);
+        snprintf(reply, reply_size, "%s delay=%u jitter=%u pending=%u%%/%u waiting=%u",
+                 obd2_timing_mode_name(current->mode), current->delay_ms, current->jitter_ms,
+                 current->pending_percent, current->pending_ms, obd2_handler_get_deferred_count());
+        return true;
+    }
+
+    // Mode and its delays (decimal milliseconds)
+    int value_count = 0;
+    if (strcasecmp(argv[1], "OFF") == 0) {
+        profile.mode = OBD2_TIMING_IMMEDIATE;
+    } else if (strcasecmp(argv[1], "FIXED") == 0) {
+        profile.mode = OBD2_TIMING_FIXED;
+        value_count = 1;
+    } else if (strcasecmp(argv[1], "UNIFORM") == 0) {
+        profile.mode = OBD2_TIMING_UNIFORM;
+        value_count = 2;
+    } else if (strcasecmp(argv[1], "NORMAL") == 0) {
+        profile.mode = OBD2_TIMING_NORMAL;
+        value_count = 2;
+    } else if (strcasecmp(argv[1], "PENDING") == 0) {
+        next = 1;
+    } else {
+        value_count = -1;
+    }
+
+    if (value_count < 0 || argc < next + value_count) {
+        snprintf(reply, reply_size, "usage: TIMING [OFF | FIXED <ms> | UNIFORM <min> <max> | "
+                 "NORMAL <mean> <sd>] [PENDING <%%> [ms]]");
+        return false;
+    }
+    for (int i = 0; i < value_count; i++) {
+        if (!parse_value(argv[next + i], &args[i])) {
+            snprintf(reply, reply_size, "invalid delay %s", argv[next + i]);
+            return false;
+        }
+    }
+    next += value_count;
+    if (value_count >= 1) {
+        profile.delay_ms = args[0];
+    }
+    if (value_count == 2) {
+        if (profile.mode == OBD2_TIMING_UNIFORM && args[1] < args[0]) {
+            snprintf(reply, reply_size, "maximum below minimum");
+            return false;
+        }
+        profile.jitter_ms = (profile.mode == OBD2_TIMING_UNIFORM) ? args[1] - args[0] : args[1];
+    }
+
+    // Optional share answered with NRC 0x78 first
+    if (argc > next) {
+        uint16_t percent = 0;
+        if (strcasecmp(argv[next], "PENDING") != 0 || argc < next + 2 || argc > next + 3 ||
+            !parse_value(argv[next + 1], &percent) || percent > 100 ||
+            (argc == next + 3 && !parse_value(argv[next + 2], &profile.pending_ms))) {
+            snprintf(reply, reply_size, "usage: ... PENDING <percent 0-100> [ms]");
+            return false;
+        }
+        profile.pending_percent = (uint8_t)percent;
+    }
+
+    return obd2_timing_set_profile(OBD2_ECU_ID, &profile);
+}
+
+static bool cmd_sensor(int argc, char **argv, char *reply, size_t reply_size)
+{
+    uint8_t signal = 0;
+    uint8_t mode = 0;
+    long value = 0;
+    uint16_t duration_ms = 0;
+
+    if (argc >= 2 && strcasecmp(argv[1], "LIST") == 0) {
+        uint8_t count = obd2_sensor_get_active_count();
+        size_t pos = snprintf(reply, reply_size, "%u", count);
+
+        for (uint8_t i = 0; i < count && pos < reply_size; i++) {
+            const obd2_sensor_fault_t *fault = obd2_sensor_get_fault(i);
+            pos += snprintf(reply + pos, reply_size - pos, " %s:%s=%ld",
+                            obd2_sensor_signal_name(fault->signal), obd2_sensor_mode_name(fault->mode),
+                            (long)fault->value);
+        }
+        return true;
+    }
+
+    if (argc >= 2 && strcasecmp(argv[1], "CLEAR") == 0) {
+        if (argc == 2) {
+            obd2_sensor_clear_all();
+            return true;
+        }
+        if (!obd2_sensor_parse_signal(argv[2], &signal) || !obd2_sensor_clear(signal)) {
+            snprintf(reply, reply_size, "no fault on %s", argv[2]);
+            return false;
+        }
+        return true;
+    }
+
+    if (argc < 3 || !obd2_sensor_parse_signal(argv[1], &signal) || !obd2_sensor_parse_mode(argv[2], &mode)) {
+        snprintf(reply, reply_size, "usage: SENSOR RPM|SPEED|LOAD|ECT|IAT|TPS|MAF|MAP|FUELP|O2S1|O2S2|FUEL "
+                 "STUCK|DRIFT|NOISE|OPEN|SHORT|DROPOUT [value] [ms]");
+        return false;
+    }
+
+    // Value in the signal's units (signed for drift), then an optional duration
+    bool needs_value = (mode != OBD2_SENSOR_OPEN && mode != OBD2_SENSOR_SHORT);
+    int expected = needs_value ? 4 : 3;
+    if (argc < expected || argc > expected + 1) {
+        snprintf(reply, reply_size, "usage: SENSOR %s %s%s [ms]", argv[1], argv[2], needs_value ? " <value>" : "");
+        return false;
+    }
+    if (needs_value) {
+        char *end;
+        value = strtol(argv[3], &end, 10);
+        if (end == argv[3] || *end != '\0' || value < -65535 || value > 65535) {
+            snprintf(reply, reply_size, "invalid value %s", argv[3]);
+            return false;
+        }
+    }
+    if (argc == expected + 1 && !parse_value(argv[expected], &duration_ms)) {
+        snprintf(reply, reply_size, "invalid duration %s", argv[expected]);
+        return false;
+    }
+
+    if (!obd2_sensor_inject(signal, mode, (int32_t)value, duration_ms)) {
+        snprintf(reply, reply_size, "invalid value for %s", obd2_sensor_mode_name(mode));
+        return false;
+    }
+    return true;
+}
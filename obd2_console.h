@@ -0,0 +1,54 @@
+#ifndef __OBD2_CONSOLE_H__
+#define __OBD2_CONSOLE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Structured command protocol over USB serial
+//
+// Frame format (one line, terminated by '\n' or '\r'):
+//   $<seq> <command> [args...][;<command> [args...]]...
+//
+// Every command in a frame is executed in order. Commands that return data
+// produce a "!<seq>.<index> <data>" line, failures produce
+// "!<seq>.<index> ERR <reason>", and the frame is always acknowledged with
+// "!<seq> ACK <ok>/<total>". Characters received outside a '$' frame are
+// passed to the legacy single-character handler unchanged.
+
+#define OBD2_CONSOLE_LINE_MAX       256     // Longest accepted frame
+#define OBD2_CONSOLE_MAX_ARGS       16      // Tokens per command (incl. name)
+#define OBD2_CONSOLE_REPLY_MAX      128     // Longest per-command reply
+#define OBD2_CONSOLE_RX_BUDGET      512     // Max characters drained per poll
+
+#define OBD2_CONSOLE_FRAME_START    '$'
+#define OBD2_CONSOLE_REPLY_START    '!'
+#define OBD2_CONSOLE_SEPARATOR      ';'
+
+// Command handler: argv[0] is the command name. Writes an optional reply
+// (data on success, reason on failure) and returns success.
+typedef bool (*obd2_console_cmd_fn)(int argc, char **argv, char *reply, size_t reply_size);
+
+typedef struct {
+    const char *name;
+    obd2_console_cmd_fn handler;
+    const char *usage;
+} obd2_console_cmd_t;
+
+typedef void (*obd2_console_legacy_fn)(char cmd);
+
+// Initialization and polling
+void obd2_console_init(obd2_console_legacy_fn legacy_handler);
+void obd2_console_poll(void);
+
+// Feed characters directly (used by poll, exposed for host-side drivers)
+void obd2_console_feed(char ch);
+void obd2_console_execute_line(char *line);
+
+// Help and statistics
+void obd2_console_print_help(void);
+uint32_t obd2_console_get_frame_count(void);
+uint32_t obd2_console_get_command_count(void);
+uint32_t obd2_console_get_error_count(void);
+
+#endif // __OBD2_CONSOLE_H__
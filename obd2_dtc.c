@@ -1,97 +1,455 @@
 #include "obd2_dtc.h"
+#include "obd2_protocol.h"
+#include "obd2_storage.h"
+#include "obd2_freeze.h"
 #include "pico/stdlib.h"
 #include <stdio.h>
 #include <string.h>
 
+_Static_assert(OBD2_DTC_CAPACITY <= 0xFFFF, "DTC pool slots are 16-bit");
+_Static_assert(OBD2_DTC_HASH_SIZE >= 2 * OBD2_DTC_CAPACITY, "DTC hash index must be at least twice the capacity");
+
+#define DTC_STATUS_PERMANENT_MASK   (DTC_STATUS_CONFIRMED | DTC_STATUS_WARNING_INDICATOR_REQUESTED)
+#define DTC_STATUS_NOT_COMPLETED    (DTC_STATUS_TEST_NOT_COMPLETED_SINCE_CLEAR | DTC_STATUS_TEST_NOT_COMPLETED_THIS_CYCLE)
+
+// Persistent record flags and clear scopes
+#define DTC_RECORD_PERMANENT        0x01
+#define DTC_RECORD_MIL              0x02
+#define DTC_CLEAR_DIAGNOSTIC_INFO   0x00    // Service 04: permanent DTCs survive
+#define DTC_CLEAR_ALL               0x01    // Console/test reset: everything goes
+
 // Global DTC manager
 static dtc_manager_t dtc_manager;
 
-void obd2_dtc_init(void)
+// Pre-serialized Service 03/07/0A responses, rebuilt only after the store changes
+enum { DTC_LIST_STORED = 0, DTC_LIST_PENDING, DTC_LIST_PERMANENT, DTC_LIST_COUNT };
+
+static struct {
+    uint8_t data[2 + 2 * OBD2_DTC_MAX_PER_RESPONSE];
+    uint16_t length;
+    bool dirty;
+} dtc_payloads[DTC_LIST_COUNT] = {
+    [DTC_LIST_STORED] = { .dirty = true },
+    [DTC_LIST_PENDING] = { .dirty = true },
+    [DTC_LIST_PERMANENT] = { .dirty = true },
+};
+
+// Bitset helpers
+
+static inline void bit_set(uint32_t *bits, uint16_t slot)
+{
+    bits[slot >> 5] |= 1u << (slot & 31);
+}
+
+static inline void bit_clear(uint32_t *bits, uint16_t slot)
+{
+    bits[slot >> 5] &= ~(1u << (slot & 31));
+}
+
+// Fibonacci hash of the transmitted code
+static inline uint16_t hash_code(uint16_t key)
+{
+    return (uint16_t)(((uint32_t)key * 40503u) & 0xFFFF) >> (16 - OBD2_DTC_HASH_BITS);
+}
+
+static inline uint16_t entry_key(const dtc_entry_t *entry)
+{
+    return obd2_dtc_format_for_transmission(entry->code, entry->type);
+}
+
+// Inverse of obd2_dtc_format_for_transmission for the type bits
+static inline uint8_t key_type(uint16_t key)
+{
+    static const uint8_t types[4] = {DTC_TYPE_POWERTRAIN, DTC_TYPE_CHASSIS, DTC_TYPE_BODY, DTC_TYPE_NETWORK};
+    return types[key >> 14];
+}
+
+// Find the hash position holding key, or the empty position where it belongs
+static uint16_t find_position(uint16_t key, bool *found)
+{
+    uint16_t pos = hash_code(key);
+
+    while (dtc_manager.index[pos] != 0) {
+        if (entry_key(&dtc_manager.dtcs[dtc_manager.index[pos] - 1]) == key) {
+            *found = true;
+            return pos;
+        }
+        pos = (pos + 1) & (OBD2_DTC_HASH_SIZE - 1);
+    }
+
+    *found = false;
+    return pos;
+}
+
+static dtc_entry_t *find_entry(uint16_t code, uint8_t type)
+{
+    bool found;
+    uint16_t pos = find_position(obd2_dtc_format_for_transmission(code, type), &found);
+    return found ? &dtc_manager.dtcs[dtc_manager.index[pos] - 1] : NULL;
+}
+
+static void set_permanent(uint16_t slot, bool permanent)
+{
+    if (dtc_manager.dtcs[slot].permanent == permanent) {
+        return;
+    }
+
+    dtc_manager.dtcs[slot].permanent = permanent;
+    dtc_payloads[DTC_LIST_PERMANENT].dirty = true;
+    if (permanent) {
+        bit_set(dtc_manager.permanent_bits, slot);
+        dtc_manager.permanent_count++;
+    } else {
+        bit_clear(dtc_manager.permanent_bits, slot);
+        dtc_manager.permanent_count--;
+    }
+}
+
+// Keep the per-status bitsets and counters in step with an entry's status
+static void update_status_sets(uint16_t slot, uint8_t old_status, uint8_t new_status)
+{
+    uint8_t changed = old_status ^ new_status;
+
+    if (changed & DTC_STATUS_CONFIRMED) {
+        dtc_payloads[DTC_LIST_STORED].dirty = true;
+        if (new_status & DTC_STATUS_CONFIRMED) {
+            bit_set(dtc_manager.confirmed_bits, slot);
+            dtc_manager.confirmed_count++;
+
+            // Freeze the vehicle state at the moment the code is confirmed
+            // (replayed DTCs bring their frames back from flash instead)
+            if (!obd2_storage_is_restoring()) {
+                obd2_freeze_capture(entry_key(&dtc_manager.dtcs[slot]));
+            }
+        } else {
+            bit_clear(dtc_manager.confirmed_bits, slot);
+            dtc_manager.confirmed_count--;
+        }
+    }
+
+    if (changed & DTC_STATUS_PENDING) {
+        dtc_payloads[DTC_LIST_PENDING].dirty = true;
+        if (new_status & DTC_STATUS_PENDING) {
+            bit_set(dtc_manager.pending_bits, slot);
+            dtc_manager.pending_count++;
+        } else {
+            bit_clear(dtc_manager.pending_bits, slot);
+            dtc_manager.pending_count--;
+        }
+    }
+
+    // Permanent DTCs latch once the fault commands the MIL; healing or
+    // removing the entry releases them, a Service 04 clear does not
+    if ((new_status & DTC_STATUS_PERMANENT_MASK) == DTC_STATUS_PERMANENT_MASK &&
+        !dtc_manager.dtcs[slot].permanent) {
+        set_permanent(slot, true);
+    }
+
+    // The MIL is on while any DTC requests it
+    if (changed & DTC_STATUS_WARNING_INDICATOR_REQUESTED) {
+        if (new_status & DTC_STATUS_WARNING_INDICATOR_REQUESTED) {
+            dtc_manager.mil_count++;
+        } else {
+            dtc_manager.mil_count--;
+        }
+        dtc_manager.mil_status = dtc_manager.mil_count > 0;
+    }
+
+    // Confirmed DTCs age once they no longer request the MIL
+    if ((changed & DTC_STATUS_PERMANENT_MASK) != 0) {
+        if ((new_status & DTC_STATUS_PERMANENT_MASK) == DTC_STATUS_CONFIRMED) {
+            bit_set(dtc_manager.aging_bits, slot);
+        } else {
+            bit_clear(dtc_manager.aging_bits, slot);
+            dtc_manager.dtcs[slot].aging_cycles = 0;
+        }
+    }
+}
+
+static void set_status(uint16_t slot, uint8_t status)
+{
+    update_status_sets(slot, dtc_manager.dtcs[slot].status, status);
+    dtc_manager.dtcs[slot].status = status;
+}
+
+// Bring the status sets up to date after an obd2_dtc_entry_* step changed
+// the entry's status and permanent flag in place
+static void sync_entry(uint16_t slot, uint8_t old_status, bool was_permanent)
+{
+    dtc_entry_t *entry = &dtc_manager.dtcs[slot];
+    uint8_t status = entry->status;
+    bool permanent = entry->permanent;
+
+    entry->status = old_status;
+    entry->permanent = was_permanent;
+    set_status(slot, status);
+    set_permanent(slot, permanent);
+}
+
+// Empty the pool, hash index and status sets
+static void reset_store(void)
 {
     memset(&dtc_manager, 0, sizeof(dtc_manager_t));
+    for (uint16_t i = 0; i < MAX_STORED_DTCS; i++) {
+        dtc_manager.free_slots[i] = MAX_STORED_DTCS - 1 - i;
+    }
+    dtc_manager.free_count = MAX_STORED_DTCS;
     dtc_manager.count = 0;
     dtc_manager.mil_status = false;
     dtc_manager.clear_timestamp = to_ms_since_boot(get_absolute_time());
-    
-    printf("DTC manager initialized\r\n");
+
+    for (int i = 0; i < DTC_LIST_COUNT; i++) {
+        dtc_payloads[i].dirty = true;
+    }
+    obd2_freeze_clear();
 }
 
-bool obd2_dtc_add(uint16_t code, uint8_t type, uint8_t status)
+// Take a free pool slot for a new code and link it at hash position pos
+static uint16_t insert_entry(uint16_t pos, uint16_t code, uint8_t type, uint8_t status)
 {
-    // Check if DTC already exists
-    for (int i = 0; i < MAX_STORED_DTCS; i++) {
-        if (dtc_manager.dtcs[i].active && 
-            dtc_manager.dtcs[i].code == code && 
-            dtc_manager.dtcs[i].type == type) {
-            // Update existing DTC status
-            dtc_manager.dtcs[i].status |= status;
-            return true;
+    uint16_t slot = dtc_manager.free_slots[--dtc_manager.free_count];
+    dtc_entry_t *entry = &dtc_manager.dtcs[slot];
+
+    entry->code = code;
+    entry->type = type;
+    entry->status = status;
+    entry->active = true;
+    entry->permanent = false;
+    entry->mil = false;
+    entry->passed_cycles = 0;
+    entry->aging_cycles = 0;
+    entry->timestamp = to_ms_since_boot(get_absolute_time());
+
+    dtc_manager.index[pos] = slot + 1;
+    bit_set(dtc_manager.active_bits, slot);
+    dtc_manager.count++;
+    update_status_sets(slot, 0, status);
+    return slot;
+}
+
+// Unlink the entry at hash position pos and return its slot to the pool
+static void remove_entry(uint16_t pos)
+{
+    uint16_t slot = dtc_manager.index[pos] - 1;
+    obd2_freeze_invalidate(entry_key(&dtc_manager.dtcs[slot]));
+    set_status(slot, 0);
+    set_permanent(slot, false);
+    dtc_manager.dtcs[slot].active = false;
+    bit_clear(dtc_manager.active_bits, slot);
+    bit_clear(dtc_manager.tested_bits, slot);
+    dtc_manager.free_slots[dtc_manager.free_count++] = slot;
+    dtc_manager.count--;
+
+    // Backward-shift deletion keeps probe chains intact without tombstones
+    uint16_t hole = pos;
+    uint16_t next = (pos + 1) & (OBD2_DTC_HASH_SIZE - 1);
+    while (dtc_manager.index[next] != 0) {
+        uint16_t home = hash_code(entry_key(&dtc_manager.dtcs[dtc_manager.index[next] - 1]));
+        // Move the entry back if its home position is not within (hole, next]
+        if (((next - home) & (OBD2_DTC_HASH_SIZE - 1)) >= ((next - hole) & (OBD2_DTC_HASH_SIZE - 1))) {
+            dtc_manager.index[hole] = dtc_manager.index[next];
+            hole = next;
         }
+        next = (next + 1) & (OBD2_DTC_HASH_SIZE - 1);
     }
-    
-    // Find empty slot
-    for (int i = 0; i < MAX_STORED_DTCS; i++) {
-        if (!dtc_manager.dtcs[i].active) {
-            dtc_manager.dtcs[i].code = code;
-            dtc_manager.dtcs[i].type = type;
-            dtc_manager.dtcs[i].status = status;
-            dtc_manager.dtcs[i].active = true;
-            dtc_manager.dtcs[i].timestamp = to_ms_since_boot(get_absolute_time());
-            dtc_manager.count++;
-            
-            // Set MIL if this is a confirmed DTC
-            if (status & DTC_STATUS_CONFIRMED) {
-                dtc_manager.mil_status = true;
+    dtc_manager.index[hole] = 0;
+}
+
+// Service 04 semantics: drop every DTC except permanent ones, which stay
+// listed under Service 0A with their status reset
+static void clear_diagnostic_info(void)
+{
+    for (uint16_t w = 0; w < OBD2_DTC_BITSET_WORDS; w++) {
+        uint32_t word = dtc_manager.active_bits[w];
+        while (word != 0) {
+            uint16_t slot = (w << 5) + __builtin_ctz(word);
+            word &= word - 1;
+
+            uint8_t old_status = dtc_manager.dtcs[slot].status;
+            if (obd2_dtc_entry_clear(&dtc_manager.dtcs[slot])) {
+                sync_entry(slot, old_status, true);
+                bit_clear(dtc_manager.tested_bits, slot);
+            } else {
+                bool found;
+                remove_entry(find_position(entry_key(&dtc_manager.dtcs[slot]), &found));
             }
-            
-            printf("Added DTC: %c%04X with status 0x%02X\r\n", type, code, status);
-            return true;
         }
     }
-    
-    printf("DTC storage full, cannot add %c%04X\r\n", type, code);
-    return false;
+
+    obd2_freeze_clear();
+    dtc_manager.mil_status = false;
+    dtc_manager.clear_timestamp = to_ms_since_boot(get_absolute_time());
 }
 
-bool obd2_dtc_remove(uint16_t code, uint8_t type)
+// Persistence
+
+static void persist_entry(uint16_t slot)
+{
+    const dtc_entry_t *entry = &dtc_manager.dtcs[slot];
+    uint16_t key = entry_key(entry);
+    uint8_t record[6] = {
+        key >> 8, key & 0xFF, entry->status,
+        (entry->permanent ? DTC_RECORD_PERMANENT : 0) | (entry->mil ? DTC_RECORD_MIL : 0),
+        entry->passed_cycles, entry->aging_cycles
+    };
+
+    obd2_storage_append(OBD2_RECORD_DTC_SET, record, sizeof(record));
+}
+
+static void dtc_storage_restore(uint8_t type, const uint8_t *data, uint8_t length)
 {
-    for (int i = 0; i < MAX_STORED_DTCS; i++) {
-        if (dtc_manager.dtcs[i].active && 
-            dtc_manager.dtcs[i].code == code && 
-            dtc_manager.dtcs[i].type == type) {
-            
-            dtc_manager.dtcs[i].active = false;
-            dtc_manager.count--;
-            
-            printf("Removed DTC: %c%04X\r\n", type, code);
-            
-            // Check if we should turn off MIL
-            if (dtc_manager.count == 0) {
-                dtc_manager.mil_status = false;
+    bool found;
+    uint16_t key = (length >= 2) ? (data[0] << 8) | data[1] : 0;
+    uint16_t pos = find_position(key, &found);
+
+    switch (type) {
+        case OBD2_RECORD_DTC_SET:
+            if (length < 4) {
+                return;
             }
-            
-            return true;
+            if (!found) {
+                if (dtc_manager.free_count == 0) {
+                    return;
+                }
+                insert_entry(pos, key & 0x3FFF, key_type(key), data[2]);
+            }
+            {
+                uint16_t slot = dtc_manager.index[pos] - 1;
+                dtc_entry_t *entry = &dtc_manager.dtcs[slot];
+
+                set_status(slot, data[2]);
+                set_permanent(slot, (data[3] & DTC_RECORD_PERMANENT) != 0);
+                entry->mil = (data[3] & DTC_RECORD_MIL) != 0;
+
+                // Records written before the lifecycle counters end here
+                if (length >= 6) {
+                    entry->passed_cycles = data[4];
+                    entry->aging_cycles = data[5];
+                }
+            }
+            break;
+
+        case OBD2_RECORD_DTC_REMOVE:
+            if (length >= 2 && found) {
+                remove_entry(pos);
+            }
+            break;
+
+        case OBD2_RECORD_DTC_CLEAR:
+            if (length >= 1 && data[0] == DTC_CLEAR_ALL) {
+                reset_store();
+            } else {
+                clear_diagnostic_info();
+            }
+            break;
+    }
+}
+
+static void dtc_storage_snapshot(void)
+{
+    for (uint16_t w = 0; w < OBD2_DTC_BITSET_WORDS; w++) {
+        uint32_t word = dtc_manager.active_bits[w];
+        while (word != 0) {
+            persist_entry((w << 5) + __builtin_ctz(word));
+            word &= word - 1;
         }
     }
+}
+
+void obd2_dtc_init(void)
+{
+    reset_store();
+    obd2_storage_register(OBD2_RECORD_DTC_SET, OBD2_RECORD_DTC_CLEAR,
+                          dtc_storage_restore, dtc_storage_snapshot);
+    obd2_freeze_init();
     
-    return false;
+    printf("DTC manager initialized (capacity %u)\r\n", MAX_STORED_DTCS);
+}
+
+bool obd2_dtc_add(uint16_t code, uint8_t type, uint8_t status)
+{
+    bool found;
+    uint16_t pos = find_position(obd2_dtc_format_for_transmission(code, type), &found);
+
+    // Check if DTC already exists
+    if (found) {
+        uint16_t slot = dtc_manager.index[pos] - 1;
+        uint8_t old_status = dtc_manager.dtcs[slot].status;
+        bool was_permanent = dtc_manager.dtcs[slot].permanent;
+        bool was_mil = dtc_manager.dtcs[slot].mil;
+
+        // Update existing DTC status
+        dtc_manager.dtcs[slot].mil |= (status & DTC_STATUS_WARNING_INDICATOR_REQUESTED) != 0;
+        set_status(slot, old_status | status);
+        if (dtc_manager.dtcs[slot].status != old_status || dtc_manager.dtcs[slot].permanent != was_permanent ||
+            dtc_manager.dtcs[slot].mil != was_mil) {
+            persist_entry(slot);
+        }
+        return true;
+    }
+
+    if (dtc_manager.free_count == 0) {
+        printf("DTC storage full, cannot add %c%04X\r\n", type, code);
+        return false;
+    }
+
+    uint16_t slot = insert_entry(pos, code, type, status);
+    dtc_manager.dtcs[slot].mil = (status & DTC_STATUS_WARNING_INDICATOR_REQUESTED) != 0;
+    persist_entry(slot);
+
+    printf("Added DTC: %c%04X with status 0x%02X\r\n", type, code, status);
+    return true;
+}
+
+bool obd2_dtc_remove(uint16_t code, uint8_t type)
+{
+    bool found;
+    uint16_t key = obd2_dtc_format_for_transmission(code, type);
+    uint16_t pos = find_position(key, &found);
+
+    if (!found) {
+        return false;
+    }
+
+    remove_entry(pos);
+
+    uint8_t record[2] = {key >> 8, key & 0xFF};
+    obd2_storage_append(OBD2_RECORD_DTC_REMOVE, record, sizeof(record));
+
+    printf("Removed DTC: %c%04X\r\n", type, code);
+    return true;
 }
 
 void obd2_dtc_clear_all(void)
 {
-    memset(dtc_manager.dtcs, 0, sizeof(dtc_manager.dtcs));
-    dtc_manager.count = 0;
-    dtc_manager.mil_status = false;
-    dtc_manager.clear_timestamp = to_ms_since_boot(get_absolute_time());
+    uint8_t scope = DTC_CLEAR_ALL;
+
+    reset_store();
+    obd2_storage_append(OBD2_RECORD_DTC_CLEAR, &scope, sizeof(scope));
     
     printf("All DTCs cleared\r\n");
 }
 
-uint8_t obd2_dtc_get_count(void)
+void obd2_dtc_clear_diagnostic_info(void)
+{
+    uint8_t scope = DTC_CLEAR_DIAGNOSTIC_INFO;
+
+    clear_diagnostic_info();
+    obd2_storage_append(OBD2_RECORD_DTC_CLEAR, &scope, sizeof(scope));
+
+    printf("Diagnostic information cleared (%u permanent DTCs retained)\r\n", dtc_manager.permanent_count);
+}
+
+uint16_t obd2_dtc_get_count(void)
 {
     return dtc_manager.count;
 }
 
+uint16_t obd2_dtc_get_confirmed_count(void)
+{
+    return dtc_manager.confirmed_count;
+}
+
 bool obd2_dtc_get_mil_status(void)
 {
     return dtc_manager.mil_status;
@@ -102,66 +460,286 @@ void obd2_dtc_set_mil_status(bool status)
     dtc_manager.mil_status = status;
 }
 
-uint8_t obd2_dtc_get_stored(uint8_t *buffer, uint8_t max_size)
+// Lifecycle
+
+bool obd2_dtc_report_result(uint16_t code, uint8_t type, bool failed, bool mil)
 {
+    bool found;
+    uint16_t pos = find_position(obd2_dtc_format_for_transmission(code, type), &found);
+    uint16_t slot;
+
+    if (!found) {
+        // A passing test has nothing to update
+        if (!failed) {
+            return true;
+        }
+        if (dtc_manager.free_count == 0) {
+            printf("DTC storage full, cannot add %c%04X\r\n", type, code);
+            return false;
+        }
+        slot = insert_entry(pos, code, type, DTC_STATUS_NOT_COMPLETED);
+    } else {
+        slot = dtc_manager.index[pos] - 1;
+    }
+
+    dtc_entry_t *entry = &dtc_manager.dtcs[slot];
+    uint8_t old_status = entry->status;
+    bool was_permanent = entry->permanent;
+    bool changed = !found ||
+                   (failed && (entry->mil != mil || entry->passed_cycles != 0 || entry->aging_cycles != 0));
+
+    obd2_dtc_entry_result(entry, failed, mil);
+    uint8_t status = entry->status;
+
+    bit_set(dtc_manager.tested_bits, slot);
+    sync_entry(slot, old_status, was_permanent);
+    if (changed || status != old_status || entry->permanent != was_permanent) {
+        persist_entry(slot);
+    }
+
+    if ((status & ~old_status) & DTC_STATUS_CONFIRMED) {
+        printf("DTC %c%04X confirmed%s\r\n", type, code,
+               (status & DTC_STATUS_WARNING_INDICATOR_REQUESTED) ? ", MIL requested" : "");
+    }
+    return true;
+}
+
+void obd2_dtc_end_driving_cycle(void)
+{
+    for (uint16_t w = 0; w < OBD2_DTC_BITSET_WORDS; w++) {
+        uint32_t word = dtc_manager.tested_bits[w];
+        dtc_manager.tested_bits[w] = 0;
+
+        while (word != 0) {
+            uint16_t slot = (w << 5) + __builtin_ctz(word);
+            dtc_entry_t *entry = &dtc_manager.dtcs[slot];
+            uint8_t old_status = entry->status;
+            bool was_permanent = entry->permanent;
+            word &= word - 1;
+
+            bool keep = obd2_dtc_entry_end_cycle(entry);
+            if (old_status & ~entry->status & DTC_STATUS_WARNING_INDICATOR_REQUESTED) {
+                printf("DTC %c%04X healed, MIL request withdrawn\r\n", entry->type, entry->code);
+            }
+            sync_entry(slot, old_status, was_permanent);
+
+            if (keep) {
+                persist_entry(slot);
+            } else {
+                obd2_dtc_remove(entry->code, entry->type);
+            }
+        }
+    }
+
+    dtc_manager.driving_cycles++;
+}
+
+void obd2_dtc_warmup_cycle(void)
+{
+    for (uint16_t w = 0; w < OBD2_DTC_BITSET_WORDS; w++) {
+        uint32_t word = dtc_manager.aging_bits[w];
+
+        while (word != 0) {
+            uint16_t slot = (w << 5) + __builtin_ctz(word);
+            dtc_entry_t *entry = &dtc_manager.dtcs[slot];
+            word &= word - 1;
+
+            // Only warm-ups without a failure count
+            if (entry->status & DTC_STATUS_TEST_FAILED_THIS_CYCLE) {
+                continue;
+            }
+            if (!obd2_dtc_entry_warmup(entry)) {
+                printf("DTC %c%04X aged out\r\n", entry->type, entry->code);
+                obd2_dtc_remove(entry->code, entry->type);
+            } else {
+                persist_entry(slot);
+            }
+        }
+    }
+
+    dtc_manager.warmup_cycles++;
+}
+
+// Lifecycle of one entry
+
+void obd2_dtc_entry_result(dtc_entry_t *entry, bool failed, bool mil)
+{
+    uint8_t old_status = entry->status;
+    uint8_t status = old_status & ~DTC_STATUS_NOT_COMPLETED;
+
+    if (failed) {
+        status |= DTC_STATUS_TEST_FAILED | DTC_STATUS_TEST_FAILED_THIS_CYCLE |
+                  DTC_STATUS_TEST_FAILED_SINCE_CLEAR | DTC_STATUS_PENDING;
+
+        // Pending from an earlier driving cycle, or already stored: confirm
+        if ((old_status & DTC_STATUS_CONFIRMED) ||
+            (old_status & (DTC_STATUS_PENDING | DTC_STATUS_TEST_FAILED_THIS_CYCLE)) == DTC_STATUS_PENDING) {
+            status |= DTC_STATUS_CONFIRMED;
+            if (mil) {
+                status |= DTC_STATUS_WARNING_INDICATOR_REQUESTED;
+            }
+        }
+
+        entry->mil = mil;
+        entry->passed_cycles = 0;
+        entry->aging_cycles = 0;
+    } else {
+        status &= ~DTC_STATUS_TEST_FAILED;
+    }
+
+    if ((status & DTC_STATUS_PERMANENT_MASK) == DTC_STATUS_PERMANENT_MASK) {
+        entry->permanent = true;
+    }
+    entry->status = status;
+}
+
+bool obd2_dtc_entry_end_cycle(dtc_entry_t *entry)
+{
+    uint8_t status = entry->status;
+    bool passed = (status & DTC_STATUS_TEST_FAILED_THIS_CYCLE) == 0;
+
+    // Tested and never failed this cycle: pending drops, and enough such
+    // cycles in a row withdraw the MIL request and release the permanent DTC
+    if (passed) {
+        status &= ~DTC_STATUS_PENDING;
+        if ((status & DTC_STATUS_WARNING_INDICATOR_REQUESTED) &&
+            ++entry->passed_cycles >= OBD2_DTC_MIL_OFF_CYCLES) {
+            status &= ~DTC_STATUS_WARNING_INDICATOR_REQUESTED;
+            entry->passed_cycles = 0;
+        }
+        if (!(status & DTC_STATUS_WARNING_INDICATOR_REQUESTED)) {
+            entry->permanent = false;
+        }
+    }
+    entry->status = (status & ~DTC_STATUS_TEST_FAILED_THIS_CYCLE) | DTC_STATUS_TEST_NOT_COMPLETED_THIS_CYCLE;
+
+    // Nothing left to report (a healed pending or permanent DTC)
+    return !passed || entry->permanent || (status & (DTC_STATUS_PENDING | DTC_STATUS_CONFIRMED)) != 0;
+}
+
+bool obd2_dtc_entry_warmup(dtc_entry_t *entry)
+{
+    // Confirmed DTCs that no longer request the MIL age in warm-ups without a failure
+    if ((entry->status & DTC_STATUS_PERMANENT_MASK) != DTC_STATUS_CONFIRMED ||
+        (entry->status & DTC_STATUS_TEST_FAILED_THIS_CYCLE)) {
+        return true;
+    }
+    return ++entry->aging_cycles < OBD2_DTC_AGING_WARMUPS;
+}
+
+bool obd2_dtc_entry_clear(dtc_entry_t *entry)
+{
+    if (!entry->permanent) {
+        return false;
+    }
+
+    // Results from before the clear no longer count: only a passing test
+    // reported after it may release the entry
+    entry->status = 0;
+    entry->passed_cycles = 0;
+    return true;
+}
+
+// Serialize the DTCs selected by a status bitset: [count][code_hi][code_lo]...
+// The count byte always matches the number of codes actually written.
+static uint16_t serialize_set(const uint32_t *bits, uint8_t *buffer, uint16_t max_size)
+{
+    uint16_t pos = 1;
     uint8_t count = 0;
-    uint8_t pos = 0;
     
-    // First byte: number of DTCs
-    if (pos < max_size) {
-        buffer[pos++] = dtc_manager.count;
+    if (max_size == 0) {
+        return 0;
     }
     
     // Add DTC codes (2 bytes each)
-    for (int i = 0; i < MAX_STORED_DTCS && count < dtc_manager.count && (pos + 1) < max_size; i++) {
-        if (dtc_manager.dtcs[i].active && (dtc_manager.dtcs[i].status & DTC_STATUS_CONFIRMED)) {
+    for (uint16_t w = 0; w < OBD2_DTC_BITSET_WORDS && (pos + 1) < max_size; w++) {
+        uint32_t word = bits[w];
+        while (word != 0 && (pos + 1) < max_size && count < OBD2_DTC_MAX_PER_RESPONSE) {
+            uint16_t slot = (w << 5) + __builtin_ctz(word);
+            word &= word - 1;
+
             // Format DTC code for OBD2 transmission
-            uint16_t obd2_code = obd2_dtc_format_for_transmission(dtc_manager.dtcs[i].code, dtc_manager.dtcs[i].type);
+            uint16_t obd2_code = entry_key(&dtc_manager.dtcs[slot]);
             buffer[pos++] = (obd2_code >> 8) & 0xFF;
             buffer[pos++] = obd2_code & 0xFF;
             count++;
         }
     }
     
+    // First byte: number of DTCs
+    buffer[0] = count;
     return pos;
 }
 
-uint8_t obd2_dtc_get_pending(uint8_t *buffer, uint8_t max_size)
+uint16_t obd2_dtc_get_stored(uint8_t *buffer, uint16_t max_size)
 {
-    uint8_t count = 0;
-    uint8_t pos = 0;
-    
-    // Count pending DTCs
-    for (int i = 0; i < MAX_STORED_DTCS; i++) {
-        if (dtc_manager.dtcs[i].active && (dtc_manager.dtcs[i].status & DTC_STATUS_PENDING)) {
-            count++;
-        }
+    return serialize_set(dtc_manager.confirmed_bits, buffer, max_size);
+}
+
+uint16_t obd2_dtc_get_pending(uint8_t *buffer, uint16_t max_size)
+{
+    return serialize_set(dtc_manager.pending_bits, buffer, max_size);
+}
+
+uint16_t obd2_dtc_get_permanent(uint8_t *buffer, uint16_t max_size)
+{
+    // Permanent DTCs are confirmed DTCs that command the MIL
+    return serialize_set(dtc_manager.permanent_bits, buffer, max_size);
+}
+
+const uint8_t* obd2_dtc_get_response_payload(uint8_t service, uint16_t *length)
+{
+    int list;
+    const uint32_t *bits;
+
+    switch (service) {
+        case OBD2_SERVICE_03: list = DTC_LIST_STORED;    bits = dtc_manager.confirmed_bits; break;
+        case OBD2_SERVICE_07: list = DTC_LIST_PENDING;   bits = dtc_manager.pending_bits;   break;
+        case OBD2_SERVICE_0A: list = DTC_LIST_PERMANENT; bits = dtc_manager.permanent_bits; break;
+        default:
+            *length = 0;
+            return NULL;
     }
-    
-    // First byte: number of DTCs
-    if (pos < max_size) {
-        buffer[pos++] = count;
+
+    // Response: [service + 0x40][count][DTC1 hi][DTC1 lo]...
+    if (dtc_payloads[list].dirty) {
+        dtc_payloads[list].data[0] = service + OBD2_POSITIVE_RESPONSE_OFFSET;
+        dtc_payloads[list].length = 1 + serialize_set(bits, &dtc_payloads[list].data[1],
+                                                      sizeof(dtc_payloads[list].data) - 1);
+        dtc_payloads[list].dirty = false;
     }
-    
-    // Add pending DTC codes
-    count = 0;
-    for (int i = 0; i < MAX_STORED_DTCS && (pos + 1) < max_size; i++) {
-        if (dtc_manager.dtcs[i].active && (dtc_manager.dtcs[i].status & DTC_STATUS_PENDING)) {
-            uint16_t obd2_code = obd2_dtc_format_for_transmission(dtc_manager.dtcs[i].code, dtc_manager.dtcs[i].type);
-            buffer[pos++] = (obd2_code >> 8) & 0xFF;
-            buffer[pos++] = obd2_code & 0xFF;
+
+    *length = dtc_payloads[list].length;
+    return dtc_payloads[list].data;
+}
+
+uint16_t obd2_dtc_get_by_status_mask(uint8_t mask, uint8_t *buffer, uint16_t max_records)
+{
+    uint16_t count = 0;
+
+    for (uint16_t w = 0; w < OBD2_DTC_BITSET_WORDS && count < max_records; w++) {
+        uint32_t word = dtc_manager.active_bits[w];
+        while (word != 0 && count < max_records) {
+            uint16_t slot = (w << 5) + __builtin_ctz(word);
+            const dtc_entry_t *entry = &dtc_manager.dtcs[slot];
+            word &= word - 1;
+
+            if ((entry->status & mask) == 0) {
+                continue;
+            }
+            if (buffer != NULL) {
+                uint16_t obd2_code = entry_key(entry);
+                uint8_t *record = &buffer[count * 4];
+                record[0] = (obd2_code >> 8) & 0xFF;
+                record[1] = obd2_code & 0xFF;
+                record[2] = 0x00;  // No failure type byte
+                record[3] = entry->status;
+            }
             count++;
         }
     }
-    
-    return pos;
-}
 
-uint8_t obd2_dtc_get_permanent(uint8_t *buffer, uint8_t max_size)
-{
-    // For simulation, permanent DTCs are the same as confirmed DTCs
-    // In a real implementation, permanent DTCs would persist even after clearing
-    return obd2_dtc_get_stored(buffer, max_size);
+    return count;
 }
 
 uint16_t obd2_dtc_format_for_transmission(uint16_t code, uint8_t type)
@@ -193,28 +771,27 @@ uint16_t obd2_dtc_format_for_transmission(uint16_t code, uint8_t type)
     return result;
 }
 
-bool obd2_dtc_exists(uint16_t code, uint8_t type)
+void obd2_dtc_update_status(uint16_t code, uint8_t type, uint8_t status)
 {
-    for (int i = 0; i < MAX_STORED_DTCS; i++) {
-        if (dtc_manager.dtcs[i].active && 
-            dtc_manager.dtcs[i].code == code && 
-            dtc_manager.dtcs[i].type == type) {
-            return true;
-        }
+    dtc_entry_t *entry = find_entry(code, type);
+    if (entry == NULL || entry->status == status) {
+        return;
     }
-    return false;
+
+    uint16_t slot = entry - dtc_manager.dtcs;
+    set_status(slot, status);
+    persist_entry(slot);
+}
+
+bool obd2_dtc_exists(uint16_t code, uint8_t type)
+{
+    return find_entry(code, type) != NULL;
 }
 
 uint8_t obd2_dtc_get_status(uint16_t code, uint8_t type)
 {
-    for (int i = 0; i < MAX_STORED_DTCS; i++) {
-        if (dtc_manager.dtcs[i].active && 
-            dtc_manager.dtcs[i].code == code && 
-            dtc_manager.dtcs[i].type == type) {
-            return dtc_manager.dtcs[i].status;
-        }
-    }
-    return 0;
+    dtc_entry_t *entry = find_entry(code, type);
+    return entry ? entry->status : 0;
 }
 
 void obd2_dtc_format_code_string(uint16_t code, uint8_t type, char *str)
@@ -222,14 +799,82 @@ void obd2_dtc_format_code_string(uint16_t code, uint8_t type, char *str)
     sprintf(str, "%c%04X", type, code);
 }
 
+uint16_t obd2_dtc_parse_code_string(const char *str, uint8_t *type)
+{
+    uint16_t code = 0;
+
+    *type = 0;
+    if (str == NULL) {
+        return 0;
+    }
+
+    // First character selects the system (P, C, B, U)
+    switch (str[0]) {
+        case 'P': case 'p': *type = DTC_TYPE_POWERTRAIN; break;
+        case 'C': case 'c': *type = DTC_TYPE_CHASSIS; break;
+        case 'B': case 'b': *type = DTC_TYPE_BODY; break;
+        case 'U': case 'u': *type = DTC_TYPE_NETWORK; break;
+        default: return 0;
+    }
+
+    // Remaining four characters are hex digits, e.g. "P0171" -> 0x0171
+    for (int i = 1; i <= 4; i++) {
+        char c = str[i];
+        uint8_t digit;
+
+        if (c >= '0' && c <= '9') {
+            digit = c - '0';
+        } else if (c >= 'A' && c <= 'F') {
+            digit = c - 'A' + 10;
+        } else if (c >= 'a' && c <= 'f') {
+            digit = c - 'a' + 10;
+        } else {
+            *type = 0;
+            return 0;
+        }
+        code = (code << 4) | digit;
+    }
+
+    // First digit only has two bits in the transmitted format
+    if (code > 0x3FFF) {
+        *type = 0;
+        return 0;
+    }
+
+    return code;
+}
+
+uint16_t obd2_dtc_list(dtc_entry_t *entries, uint16_t max_entries)
+{
+    uint16_t count = 0;
+
+    for (uint16_t w = 0; w < OBD2_DTC_BITSET_WORDS && count < max_entries; w++) {
+        uint32_t word = dtc_manager.active_bits[w];
+        while (word != 0 && count < max_entries) {
+            entries[count++] = dtc_manager.dtcs[(w << 5) + __builtin_ctz(word)];
+            word &= word - 1;
+        }
+    }
+
+    return count;
+}
+
 void obd2_dtc_print_all(void)
 {
     printf("\r\n=== Stored DTCs ===\r\n");
     printf("Count: %d\r\n", dtc_manager.count);
     printf("MIL Status: %s\r\n", dtc_manager.mil_status ? "ON" : "OFF");
     
-    for (int i = 0; i < MAX_STORED_DTCS; i++) {
-        if (dtc_manager.dtcs[i].active) {
+    printf("Confirmed: %d, Pending: %d, Permanent: %d\r\n",
+           dtc_manager.confirmed_count, dtc_manager.pending_count, dtc_manager.permanent_count);
+    printf("MIL requests: %d, Driving cycles: %lu, Warm-ups: %lu\r\n",
+           dtc_manager.mil_count, dtc_manager.driving_cycles, dtc_manager.warmup_cycles);
+    
+    for (uint16_t w = 0; w < OBD2_DTC_BITSET_WORDS; w++) {
+        uint32_t word = dtc_manager.active_bits[w];
+        while (word != 0) {
+            int i = (w << 5) + __builtin_ctz(word);
+            word &= word - 1;
             printf("DTC %d: %c%04X, Status: 0x%02X\r\n", 
                    i, dtc_manager.dtcs[i].type, dtc_manager.dtcs[i].code, dtc_manager.dtcs[i].status);
         }
@@ -271,115 +916,6 @@ void obd2_dtc_test_scenario(void)
     printf("DTC test scenario completed\r\n");
 }
 
-// Advanced DTC simulation based on vehicle conditions
-void obd2_dtc_simulate_realistic_faults(void)
-{
-    static uint32_t last_simulation = 0;
-    static uint32_t simulation_counter = 0;
-    uint32_t current_time = to_ms_since_boot(get_absolute_time());
-
-    // Run simulation every 10 seconds
-    if (current_time - last_simulation < 10000) {
-        return;
-    }
-
-    last_simulation = current_time;
-    simulation_counter++;
-
-    // Get current vehicle parameters for condition-based faults
-    extern uint8_t obd2_get_engine_load(void);
-    extern uint16_t obd2_get_engine_rpm(void);
-    extern uint8_t obd2_get_coolant_temp(void);
-    extern uint8_t obd2_get_throttle_position(void);
-
-    uint8_t load = (obd2_get_engine_load() * 100) / 255;
-    uint16_t rpm = obd2_get_engine_rpm() / 4;
-    uint8_t coolant = obd2_get_coolant_temp() - 40;
-    uint8_t throttle = (obd2_get_throttle_position() * 100) / 255;
-
-    // Simulate various fault conditions based on vehicle state
-
-    // 1. High RPM conditions - potential engine issues
-    if (rpm > 5000 && simulation_counter % 15 == 0) {
-        if (!obd2_dtc_exists(DTC_P0300, DTC_TYPE_POWERTRAIN)) {
-            obd2_dtc_add(DTC_P0300, DTC_TYPE_POWERTRAIN, DTC_STATUS_PENDING);
-            printf("DTC P0300: Random/Multiple Cylinder Misfire (High RPM condition)\r\n");
-        }
-    }
-
-    // 2. High engine load - potential fuel system issues
-    if (load > 80 && simulation_counter % 20 == 0) {
-        if (!obd2_dtc_exists(DTC_P0171, DTC_TYPE_POWERTRAIN)) {
-            obd2_dtc_add(DTC_P0171, DTC_TYPE_POWERTRAIN,
-                        DTC_STATUS_TEST_FAILED | DTC_STATUS_CONFIRMED | DTC_STATUS_WARNING_INDICATOR_REQUESTED);
-            printf("DTC P0171: System Too Lean Bank 1 (High load condition)\r\n");
-        }
-    }
-
-    // 3. Temperature-related faults
-    if (coolant > 100 && simulation_counter % 25 == 0) {
-        if (!obd2_dtc_exists(DTC_P0115, DTC_TYPE_POWERTRAIN)) {
-            obd2_dtc_add(DTC_P0115, DTC_TYPE_POWERTRAIN, DTC_STATUS_CONFIRMED);
-            printf("DTC P0115: Engine Coolant Temperature Circuit (Overheating)\r\n");
-        }
-    }
-
-    // 4. Throttle position sensor issues
-    if (throttle > 90 && simulation_counter % 30 == 0) {
-        if (!obd2_dtc_exists(DTC_P0120, DTC_TYPE_POWERTRAIN)) {
-            obd2_dtc_add(DTC_P0120, DTC_TYPE_POWERTRAIN, DTC_STATUS_PENDING);
-            printf("DTC P0120: Throttle Position Sensor Circuit (Wide open throttle)\r\n");
-        }
-    }
-
-    // 5. Random intermittent faults (simulate real-world conditions)
-    if (simulation_counter % 45 == 0) {
-        uint16_t random_dtcs[] = {DTC_P0100, DTC_P0101, DTC_P0110, DTC_P0130, DTC_P0420, DTC_P0500};
-        int random_index = simulation_counter % 6;
-        uint16_t dtc_code = random_dtcs[random_index];
-
-        if (!obd2_dtc_exists(dtc_code, DTC_TYPE_POWERTRAIN)) {
-            uint8_t status = DTC_STATUS_PENDING;
-            if (simulation_counter % 3 == 0) {
-                status |= DTC_STATUS_CONFIRMED | DTC_STATUS_WARNING_INDICATOR_REQUESTED;
-            }
-            obd2_dtc_add(dtc_code, DTC_TYPE_POWERTRAIN, status);
-            printf("DTC P%04X: Intermittent fault detected\r\n", dtc_code);
-        }
-    }
-
-    // 6. Catalyst efficiency (after extended operation)
-    if (simulation_counter > 100 && simulation_counter % 60 == 0) {
-        if (!obd2_dtc_exists(DTC_P0420, DTC_TYPE_POWERTRAIN)) {
-            obd2_dtc_add(DTC_P0420, DTC_TYPE_POWERTRAIN,
-                        DTC_STATUS_CONFIRMED | DTC_STATUS_WARNING_INDICATOR_REQUESTED);
-            printf("DTC P0420: Catalyst System Efficiency Below Threshold (Extended operation)\r\n");
-        }
-    }
-
-    // 7. Oxygen sensor faults (gradual degradation)
-    if (simulation_counter % 80 == 0) {
-        if (!obd2_dtc_exists(DTC_P0130, DTC_TYPE_POWERTRAIN)) {
-            obd2_dtc_add(DTC_P0130, DTC_TYPE_POWERTRAIN, DTC_STATUS_PENDING);
-            printf("DTC P0130: O2 Sensor Circuit Malfunction Bank 1 Sensor 1\r\n");
-        }
-    }
-
-    // 8. Occasionally clear some pending DTCs (simulate intermittent issues)
-    if (simulation_counter % 50 == 0) {
-        // Clear some pending DTCs to simulate intermittent faults
-        for (int i = 0; i < MAX_STORED_DTCS; i++) {
-            if (dtc_manager.dtcs[i].active &&
-                (dtc_manager.dtcs[i].status & DTC_STATUS_PENDING) &&
-                !(dtc_manager.dtcs[i].status & DTC_STATUS_CONFIRMED)) {
-                printf("Clearing intermittent DTC P%04X\r\n", dtc_manager.dtcs[i].code);
-                obd2_dtc_remove(dtc_manager.dtcs[i].code, dtc_manager.dtcs[i].type);
-                break;  // Only clear one at a time
-            }
-        }
-    }
-}
-
 // Simulate specific automotive scenarios
 void obd2_dtc_simulate_cold_start_issues(void)
 {
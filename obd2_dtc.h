@@ -4,8 +4,37 @@
 #include <stdint.h>
 #include <stdbool.h>
 
-// Maximum number of DTCs that can be stored
-#define MAX_STORED_DTCS     10
+// Maximum number of DTCs that can be stored (override at build time)
+#ifndef OBD2_DTC_CAPACITY
+#define OBD2_DTC_CAPACITY   256
+#endif
+
+// Hash index size as a power of two, keep at least twice the capacity
+#ifndef OBD2_DTC_HASH_BITS
+#define OBD2_DTC_HASH_BITS  9
+#endif
+
+// Codes per Service 03/07/0A response (limited by the one byte DTC count)
+#define OBD2_DTC_MAX_PER_RESPONSE   255
+
+#define MAX_STORED_DTCS         OBD2_DTC_CAPACITY
+#define OBD2_DTC_HASH_SIZE      (1u << OBD2_DTC_HASH_BITS)
+#define OBD2_DTC_BITSET_WORDS   ((OBD2_DTC_CAPACITY + 31) / 32)
+
+// Lifecycle (ISO 15031-6 / 14229-1 style)
+//
+// A failed test result makes a DTC pending; failing again in the next driving
+// cycle confirms it and, for MIL-relevant codes, requests the MIL. A DTC that
+// has requested the MIL is also permanent. The MIL request is withdrawn after
+// OBD2_DTC_MIL_OFF_CYCLES consecutive driving cycles in which the test ran
+// and passed (which also releases the permanent DTC), and a confirmed DTC that
+// no longer requests the MIL is erased after OBD2_DTC_AGING_WARMUPS warm-up
+// cycles without a failure. A driving cycle in which the test passed without
+// failing also drops the pending status. Results and cycle ends are events:
+// a result touches one entry, and a cycle end only visits the entries tested
+// in that cycle (or, for warm-ups, the aging ones).
+#define OBD2_DTC_MIL_OFF_CYCLES     3
+#define OBD2_DTC_AGING_WARMUPS      40
 
 // DTC status bits
 #define DTC_STATUS_TEST_FAILED              0x01
@@ -54,14 +83,37 @@ typedef struct {
     uint8_t status;         // DTC status byte
     uint8_t type;           // DTC type (P, C, B, U)
     bool active;            // Is this DTC slot active
+    bool permanent;         // Latched once MIL-commanding, survives Service 04
+    bool mil;               // Confirmation requests the MIL
+    uint8_t passed_cycles;  // Consecutive passing driving cycles while requesting the MIL
+    uint8_t aging_cycles;   // Warm-up cycles without failure since the MIL request ended
     uint32_t timestamp;     // When the DTC was set
 } dtc_entry_t;
 
 // DTC manager structure
+//
+// Entries live in a fixed pool; an open-addressed hash keyed by the 16-bit
+// transmitted code maps to pool slots, and per-status bitsets over the pool
+// let the Service 03/07/0A lists be enumerated without scanning every slot.
 typedef struct {
     dtc_entry_t dtcs[MAX_STORED_DTCS];
-    uint8_t count;          // Number of active DTCs
+    uint16_t index[OBD2_DTC_HASH_SIZE];                 // Pool slot + 1, 0 = empty
+    uint16_t free_slots[MAX_STORED_DTCS];               // Stack of unused pool slots
+    uint16_t free_count;
+    uint32_t active_bits[OBD2_DTC_BITSET_WORDS];        // Slot in use
+    uint32_t confirmed_bits[OBD2_DTC_BITSET_WORDS];     // Stored DTCs (Service 03)
+    uint32_t pending_bits[OBD2_DTC_BITSET_WORDS];       // Pending DTCs (Service 07)
+    uint32_t permanent_bits[OBD2_DTC_BITSET_WORDS];     // Permanent DTCs (Service 0A)
+    uint32_t tested_bits[OBD2_DTC_BITSET_WORDS];        // Test result reported this driving cycle
+    uint32_t aging_bits[OBD2_DTC_BITSET_WORDS];         // Confirmed, MIL request withdrawn
+    uint16_t confirmed_count;
+    uint16_t pending_count;
+    uint16_t permanent_count;
+    uint16_t mil_count;     // DTCs requesting the MIL
+    uint16_t count;         // Number of active DTCs
     bool mil_status;        // Malfunction Indicator Lamp status
+    uint32_t driving_cycles; // Driving cycles ended since boot
+    uint32_t warmup_cycles;  // Warm-up cycles since boot
     uint32_t clear_timestamp; // When DTCs were last cleared
 } dtc_manager_t;
 
@@ -70,14 +122,40 @@ void obd2_dtc_init(void);
 bool obd2_dtc_add(uint16_t code, uint8_t type, uint8_t status);
 bool obd2_dtc_remove(uint16_t code, uint8_t type);
 void obd2_dtc_clear_all(void);
-uint8_t obd2_dtc_get_count(void);
+void obd2_dtc_clear_diagnostic_info(void);
+uint16_t obd2_dtc_get_count(void);
+uint16_t obd2_dtc_get_confirmed_count(void);
 bool obd2_dtc_get_mil_status(void);
 void obd2_dtc_set_mil_status(bool status);
 
-// Get DTCs for different services
-uint8_t obd2_dtc_get_stored(uint8_t *buffer, uint8_t max_size);
-uint8_t obd2_dtc_get_pending(uint8_t *buffer, uint8_t max_size);
-uint8_t obd2_dtc_get_permanent(uint8_t *buffer, uint8_t max_size);
+// Lifecycle events: a monitor test result, the end of a driving cycle (engine
+// stopped) and a completed warm-up cycle; false if a new DTC found no room
+bool obd2_dtc_report_result(uint16_t code, uint8_t type, bool failed, bool mil);
+void obd2_dtc_end_driving_cycle(void);
+void obd2_dtc_warmup_cycle(void);
+
+// The same lifecycle on a single entry, for DTC sets kept outside the manager
+// (the host fleet's per-vehicle sets, which have no flash log): each updates
+// the entry's status, counters and permanent flag. A new entry is zeroed
+// apart from code and type; end_cycle is only for entries with a result
+// this driving cycle. end_cycle, warmup and clear (Service 04) return
+// false once the entry has nothing left to report and should be removed.
+void obd2_dtc_entry_result(dtc_entry_t *entry, bool failed, bool mil);
+bool obd2_dtc_entry_end_cycle(dtc_entry_t *entry);
+bool obd2_dtc_entry_warmup(dtc_entry_t *entry);
+bool obd2_dtc_entry_clear(dtc_entry_t *entry);
+
+// Get DTCs for different services: [count][code_hi][code_lo]...
+uint16_t obd2_dtc_get_stored(uint8_t *buffer, uint16_t max_size);
+uint16_t obd2_dtc_get_pending(uint8_t *buffer, uint16_t max_size);
+uint16_t obd2_dtc_get_permanent(uint8_t *buffer, uint16_t max_size);
+
+// Complete, pre-serialized positive response for Service 03, 07 or 0A
+const uint8_t* obd2_dtc_get_response_payload(uint8_t service, uint16_t *length);
+
+// UDS ReadDTCInformation records [DTC hi][DTC lo][failure type][status] for
+// every DTC whose status shares a bit with mask; buffer may be NULL to count
+uint16_t obd2_dtc_get_by_status_mask(uint8_t mask, uint8_t *buffer, uint16_t max_records);
 
 // DTC status and management
 void obd2_dtc_update_status(uint16_t code, uint8_t type, uint8_t status);
@@ -88,6 +166,7 @@ uint8_t obd2_dtc_get_status(uint16_t code, uint8_t type);
 void obd2_dtc_format_code_string(uint16_t code, uint8_t type, char *str);
 uint16_t obd2_dtc_parse_code_string(const char *str, uint8_t *type);
 uint16_t obd2_dtc_format_for_transmission(uint16_t code, uint8_t type);
+uint16_t obd2_dtc_list(dtc_entry_t *entries, uint16_t max_entries);
 void obd2_dtc_print_all(void);
 
 // Test functions for simulation
@@ -95,8 +174,8 @@ void obd2_dtc_simulate_fault(uint16_t code, uint8_t type);
 void obd2_dtc_simulate_random_faults(void);
 void obd2_dtc_test_scenario(void);
 
-// Advanced DTC simulation functions
-void obd2_dtc_simulate_realistic_faults(void);
+// Advanced DTC simulation functions; condition-based faults come from the
+// rules in obd2_fault.h
 void obd2_dtc_simulate_cold_start_issues(void);
 void obd2_dtc_simulate_emissions_failure(void);
 void obd2_dtc_simulate_fuel_system_issues(void);
@@ -3,6 +3,14 @@
 #include "obd2_handler.h"
 #include "obd2_protocol.h"
 #include "obd2_dtc.h"
+#include "obd2_console.h"
+#include "obd2_storage.h"
+#include "obd2_freeze.h"
+#include "obd2_monitor.h"
+#include "obd2_uds.h"
+#include "obd2_periodic.h"
+#include "obd2_timer.h"
+#include "obd2_sensor.h"
 #include "xl2515.h"
 
 #define LED_PIN         25
@@ -14,9 +22,11 @@ static struct {
     bool running;
     bool led_state;
     bool button_pressed;
-    uint32_t last_led_toggle;
-    uint32_t last_stats_print;
-    uint32_t last_button_check;
+    bool mil_blink;
+    obd2_timer_t button_timer;      // Button sampling, 50 ms
+    obd2_timer_t stats_timer;       // Real-time data printout, 3 s
+    obd2_timer_t led_timer;         // Heartbeat LED, 1 s
+    obd2_timer_t status_timer;      // Status LED and MIL blink, 250 ms
     uint32_t startup_time;
 } app_state;
 
@@ -31,6 +41,7 @@ void handle_serial_command(char cmd);
 void run_diagnostic_tests(void);
 void print_realtime_vehicle_data(void);
 void print_available_pids(void);
+static void start_ui_timers(void);
 
 int main()
 {
@@ -55,19 +66,21 @@ int main()
     
     app_state.running = true;
     app_state.startup_time = to_ms_since_boot(get_absolute_time());
+    start_ui_timers();
     
     while (app_state.running) {
         // Process OBD2 messages
         obd2_handler_process();
         
+        // Move queued DTC/counter records to flash while the bus is quiet
+        obd2_storage_service(obd2_handler_get_idle_ms());
+        
         // Handle user interface
         handle_user_interface();
         
-        // Update status indicators
-        update_status_indicators();
-        
-        // Small delay to prevent overwhelming the system
-        sleep_ms(10);
+        // Sleep until the next timer is due, at most 10 ms so CAN and the
+        // console are still polled
+        best_effort_wfe_or_timeout(make_timeout_time_us(obd2_timer_next_due_us(10000)));
     }
     
     return 0;
@@ -96,9 +109,7 @@ void init_hardware(void)
     // Initialize application state
     app_state.led_state = false;
     app_state.button_pressed = false;
-    app_state.last_led_toggle = 0;
-    app_state.last_stats_print = 0;
-    app_state.last_button_check = 0;
+    app_state.mil_blink = false;
     
     printf("Hardware initialized\r\n");
 }
@@ -107,15 +118,21 @@ void init_obd2_system(void)
 {
     // Initialize DTC manager
     obd2_dtc_init();
+
+    // Initialize serial command console (single-char commands stay available)
+    obd2_console_init(handle_serial_command);
     
     // Initialize OBD2 handler
-    if (!obd2_handler_init()) {
+    if (!obd2_handler_init(&obd2_can_xl2515_transport)) {
         printf("ERROR: Failed to initialize OBD2 handler\r\n");
         return;
     }
     
-    // Add some sample DTCs for testing
-    obd2_dtc_simulate_fault(0x0171, DTC_TYPE_POWERTRAIN);  // System Too Lean
+    // Restore DTCs, counters and VIN saved before the last power cycle
+    if (!obd2_storage_init()) {
+        // First boot: add some sample DTCs for testing
+        obd2_dtc_simulate_fault(0x0171, DTC_TYPE_POWERTRAIN);  // System Too Lean
+    }
     
     printf("OBD2 system initialized successfully\r\n");
 }
@@ -138,35 +155,48 @@ void print_startup_banner(void)
 
 void handle_user_interface(void)
 {
-    uint32_t current_time = to_ms_since_boot(get_absolute_time());
+    // Check for USB serial commands (structured frames and single-char commands)
+    obd2_console_poll();
+}
 
-    // Check for USB serial commands
-    int ch = getchar_timeout_us(0);  // Non-blocking read
-    if (ch != PICO_ERROR_TIMEOUT) {
-        handle_serial_command((char)ch);
+static void check_button(void *context)
+{
+    bool button_state = !gpio_get(BUTTON_PIN);  // Active low
+
+    if (button_state && !app_state.button_pressed) {
+        // Button just pressed
+        app_state.button_pressed = true;
+        handle_button_press();
+    } else if (!button_state && app_state.button_pressed) {
+        // Button released
+        app_state.button_pressed = false;
     }
+}
 
-    // Check button state every 50ms
-    if (current_time - app_state.last_button_check > 50) {
-        app_state.last_button_check = current_time;
+static void print_stats(void *context)
+{
+    // Real-time data including advanced parameters
+    print_realtime_vehicle_data();
+}
 
-        bool button_state = !gpio_get(BUTTON_PIN);  // Active low
+static void toggle_led(void *context)
+{
+    // Show the system is alive
+    app_state.led_state = !app_state.led_state;
+    gpio_put(LED_PIN, app_state.led_state);
+}
 
-        if (button_state && !app_state.button_pressed) {
-            // Button just pressed
-            app_state.button_pressed = true;
-            handle_button_press();
-        } else if (!button_state && app_state.button_pressed) {
-            // Button released
-            app_state.button_pressed = false;
-        }
-    }
-    
-    // Print real-time data every 3 seconds (including advanced parameters)
-    if (current_time - app_state.last_stats_print > 3000) {
-        app_state.last_stats_print = current_time;
-        print_realtime_vehicle_data();
-    }
+static void refresh_status(void *context)
+{
+    update_status_indicators();
+}
+
+static void start_ui_timers(void)
+{
+    obd2_timer_start_periodic(&app_state.button_timer, 50 * 1000, check_button, NULL);
+    obd2_timer_start_periodic(&app_state.stats_timer, 3000 * 1000, print_stats, NULL);
+    obd2_timer_start_periodic(&app_state.led_timer, 1000 * 1000, toggle_led, NULL);
+    obd2_timer_start_periodic(&app_state.status_timer, 250 * 1000, refresh_status, NULL);
 }
 
 void handle_button_press(void)
@@ -190,6 +220,8 @@ void handle_button_press(void)
         case 3:
             printf("Displaying DTC information...\r\n");
             obd2_dtc_print_all();
+            obd2_freeze_print_all();
+            obd2_monitor_print_all();
             break;
 
         case 4:
@@ -235,6 +267,9 @@ void handle_serial_command(char cmd)
         case 'S':
             printf("Displaying current statistics...\r\n");
             obd2_handler_stats();
+            obd2_storage_stats();
+            obd2_uds_print_status();
+            obd2_periodic_print_status();
             break;
 
         case 't':
@@ -247,6 +282,7 @@ void handle_serial_command(char cmd)
         case 'D':
             printf("Displaying DTC information...\r\n");
             obd2_dtc_print_all();
+            obd2_freeze_print_all();
             break;
 
         case 'c':
@@ -277,6 +313,17 @@ void handle_serial_command(char cmd)
             obd2_dtc_print_all();
             break;
 
+        case 'm':
+        case 'M':
+            // Toggle a sensor-level fault: PID 0x10 reads low and P0102 sets through its rule
+            if (obd2_sensor_clear(OBD2_SIGNAL_MAF)) {
+                printf("MAF sensor fault cleared\r\n");
+            } else {
+                printf("Simulating MAF sensor stuck low...\r\n");
+                obd2_sensor_inject(OBD2_SIGNAL_MAF, OBD2_SENSOR_STUCK, 50, 0);
+            }
+            break;
+
         case 'x':
         case 'X':
             printf("Clearing all DTCs...\r\n");
@@ -320,11 +367,13 @@ void handle_serial_command(char cmd)
             printf("  e - Emissions failure\r\n");
             printf("  f - Fuel system issues\r\n");
             printf("  i - Ignition misfires\r\n");
+            printf("  m - MAF sensor stuck low (toggle)\r\n");
             printf("  x - Clear all DTCs\r\n");
             printf("  v - Vehicle data\r\n");
             printf("  n - Complete VIN information\r\n");
             printf("  p - Show available PIDs\r\n");
             printf("  h - Help (this message)\r\n");
+            obd2_console_print_help();
             break;
 
         default:
@@ -360,35 +409,38 @@ void print_available_pids(void)
     printf("  PID 15: O2 Sensor Bank 1 Sensor 2 (V)\r\n");
     printf("  PID 22: Fuel Rail Pressure (kPa)\r\n");
 
+    printf("\r\nPersistent Counters:\r\n");
+    printf("  PID 21: Distance with MIL On (km)\r\n");
+    printf("  PID 30: Warm-ups Since Codes Cleared\r\n");
+    printf("  PID 31: Distance Since Codes Cleared (km)\r\n");
+
     printf("\r\nDiagnostic Services:\r\n");
     printf("  Service 01: Live Data Stream\r\n");
+    printf("  Service 02: Freeze Frame Data\r\n");
     printf("  Service 03: Read Stored DTCs\r\n");
-    printf("  Service 04: Clear DTCs\r\n");
+    printf("  Service 04: Clear DTCs (permanent DTCs retained)\r\n");
+    printf("  Service 06: On-Board Monitor Test Results\r\n");
     printf("  Service 07: Read Pending DTCs\r\n");
-    printf("  Service 09: Vehicle Information (VIN)\r\n");
+    printf("  Service 0A: Read Permanent DTCs\r\n");
+    printf("  Service 09: Vehicle Information (VIN, CALID, CVN, IPT, ECU name, ESN)\r\n");
+    printf("  UDS 10/3E: Session Control, Tester Present\r\n");
+    printf("  UDS 22: Read Data By Identifier (F190 VIN, F4xx = Service 01 PID)\r\n");
+    printf("  UDS 19: Read DTC Information (01, 02, 0A)\r\n");
+    printf("  UDS 2A: Periodic Data (PDID = Service 01 PID, slow/medium/fast)\r\n");
     printf("============================\r\n\r\n");
 }
 
 void update_status_indicators(void)
 {
-    uint32_t current_time = to_ms_since_boot(get_absolute_time());
-    
-    // Toggle main LED every 1 second to show system is alive
-    if (current_time - app_state.last_led_toggle > 1000) {
-        app_state.last_led_toggle = current_time;
-        app_state.led_state = !app_state.led_state;
-        gpio_put(LED_PIN, app_state.led_state);
-    }
-    
     // Status LED indicates OBD2 activity
     bool activity = (obd2_handler_get_message_count() > 0);
     gpio_put(STATUS_LED_PIN, activity);
     
     // MIL simulation - blink status LED if DTCs are present
     if (obd2_dtc_get_mil_status()) {
-        // Blink faster when MIL is on
-        bool mil_blink = (current_time / 250) % 2;
-        gpio_put(STATUS_LED_PIN, mil_blink);
+        // Blink faster when MIL is on (called every 250 ms)
+        app_state.mil_blink = !app_state.mil_blink;
+        gpio_put(STATUS_LED_PIN, app_state.mil_blink);
     }
 }
 
@@ -411,10 +463,23 @@ void run_diagnostic_tests(void)
     printf("Test 3: DTC operations\r\n");
     obd2_handler_simulate_request(0x03, 0x00);  // Read stored DTCs
     obd2_handler_simulate_request(0x07, 0x00);  // Read pending DTCs
+    obd2_handler_simulate_request(0x0A, 0x00);  // Read permanent DTCs
+    obd2_handler_simulate_request(0x06, 0x00);  // Supported monitor IDs
+    obd2_handler_simulate_request(0x06, 0xA1);  // Misfire monitor results
     
     // Test 4: Vehicle information
     printf("Test 4: Vehicle information\r\n");
+    obd2_handler_simulate_request(0x09, 0x00);  // Supported InfoTypes
     obd2_handler_simulate_request(0x09, 0x02);  // VIN
+    obd2_handler_simulate_request(0x09, 0x04);  // Calibration IDs
+    obd2_handler_simulate_request(0x09, 0x0A);  // ECU name
+    
+    // Test 5: UDS
+    printf("Test 5: UDS services\r\n");
+    obd2_handler_simulate_request(0x10, 0x03);  // Extended session
+    obd2_handler_simulate_request(0x3E, 0x00);  // Tester present
+    obd2_handler_simulate_request(0x19, 0x0A);  // Supported DTCs
+    obd2_handler_simulate_request(0x10, 0x01);  // Back to default session
     
     printf("Diagnostic tests completed\r\n");
 }
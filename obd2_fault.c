@@ -0,0 +1,279 @@
+#include "obd2_fault.h"
+#include "obd2_dtc.h"
+#include <stdio.h>
+#include <string.h>
+
+#define TICKS_OF(ms)    (((ms) + OBD2_VEHICLE_TICK_MS - 1) / OBD2_VEHICLE_TICK_MS)
+
+// Built-in rules: what used to be checked every 10 s
+static const obd2_fault_rule_t default_rules[] = {
+    { DTC_P0300, DTC_TYPE_POWERTRAIN, true,
+      OBD2_SIGNAL_RPM, OBD2_FAULT_GT, 5000, 0, 0, 0, 10000, 7,
+      "Random/Multiple Cylinder Misfire (High RPM condition)" },
+    { DTC_P0171, DTC_TYPE_POWERTRAIN, true,
+      OBD2_SIGNAL_LOAD, OBD2_FAULT_GT, 80, 0, 0, 0, 10000, 5,
+      "System Too Lean Bank 1 (High load condition)" },
+    { DTC_P0115, DTC_TYPE_POWERTRAIN, false,
+      OBD2_SIGNAL_COOLANT, OBD2_FAULT_GT, 100, 0, 0, 0, 10000, 4,
+      "Engine Coolant Temperature Circuit (Overheating)" },
+    { DTC_P0120, DTC_TYPE_POWERTRAIN, false,
+      OBD2_SIGNAL_THROTTLE, OBD2_FAULT_GT, 90, 0, 0, 0, 10000, 3,
+      "Throttle Position Sensor Circuit (Wide open throttle)" },
+    { DTC_P0420, DTC_TYPE_POWERTRAIN, true,
+      OBD2_SIGNAL_RUNTIME, OBD2_FAULT_GT, 1200, 0, 0, 0, 1000, 100,
+      "Catalyst System Efficiency Below Threshold (Extended operation)" },
+    { DTC_P0130, DTC_TYPE_POWERTRAIN, true,
+      OBD2_SIGNAL_NONE, OBD2_FAULT_EQ, 0, 0, 0, 0, 400000, 50,
+      "O2 Sensor Circuit Malfunction Bank 1 Sensor 1" },
+
+    // Sensor circuit range checks (see obd2_sensor.h for injecting the faults)
+    { DTC_P0102, DTC_TYPE_POWERTRAIN, true,
+      OBD2_SIGNAL_MAF, OBD2_FAULT_LT, 100, OBD2_SIGNAL_RPM, OBD2_FAULT_GE, 500, 1000, 100,
+      "Mass Air Flow Circuit Low Input" },
+    { DTC_P0103, DTC_TYPE_POWERTRAIN, true,
+      OBD2_SIGNAL_MAF, OBD2_FAULT_GT, 60000, 0, 0, 0, 1000, 100,
+      "Mass Air Flow Circuit High Input" },
+
+    // Intermittent faults, each about once per 45 minutes of running
+    { DTC_P0100, DTC_TYPE_POWERTRAIN, false,
+      OBD2_SIGNAL_NONE, OBD2_FAULT_EQ, 0, 0, 0, 0, 300000, 11, "Intermittent fault detected" },
+    { DTC_P0101, DTC_TYPE_POWERTRAIN, false,
+      OBD2_SIGNAL_NONE, OBD2_FAULT_EQ, 0, 0, 0, 0, 300000, 11, "Intermittent fault detected" },
+    { DTC_P0110, DTC_TYPE_POWERTRAIN, false,
+      OBD2_SIGNAL_NONE, OBD2_FAULT_EQ, 0, 0, 0, 0, 300000, 11, "Intermittent fault detected" },
+    { DTC_P0500, DTC_TYPE_POWERTRAIN, false,
+      OBD2_SIGNAL_SPEED, OBD2_FAULT_GT, 0, 0, 0, 0, 300000, 11, "Intermittent fault detected" },
+};
+
+// Fault detection state of the firmware's vehicle
+static struct {
+    obd2_fault_table_t table;
+    obd2_fault_state_t vehicle;
+    int32_t debounce[OBD2_FAULT_MAX_RULES];
+    uint32_t passed[OBD2_FAULT_PASSED_WORDS(OBD2_FAULT_MAX_RULES)];
+    int32_t signals[OBD2_SIGNAL_COUNT];
+    uint32_t fired;
+} fault_state;
+
+static uint32_t next_random(obd2_fault_state_t *state)
+{
+    // xorshift32
+    uint32_t x = state->rng_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    state->rng_state = x;
+    return x;
+}
+
+// Turn a comparison into the inclusive range [min, min + span]
+static bool compile_condition(uint8_t signal, uint8_t compare, int32_t threshold,
+                              int32_t *min, uint32_t *span)
+{
+    int64_t low = INT32_MIN;
+    int64_t high = INT32_MAX;
+
+    if (signal >= OBD2_SIGNAL_COUNT) {
+        return false;
+    }
+    switch (compare) {
+        case OBD2_FAULT_GT: low = (int64_t)threshold + 1; break;
+        case OBD2_FAULT_GE: low = threshold;              break;
+        case OBD2_FAULT_LT: high = (int64_t)threshold - 1; break;
+        case OBD2_FAULT_LE: high = threshold;             break;
+        case OBD2_FAULT_EQ: low = high = threshold;       break;
+        default: return false;
+    }
+    if (low > high) {
+        return false;
+    }
+
+    *min = (int32_t)low;
+    *span = (uint32_t)(high - low);
+    return true;
+}
+
+static bool compile_rule(const obd2_fault_rule_t *rule, obd2_fault_check_t *check)
+{
+    if (!compile_condition(rule->signal, rule->compare, rule->threshold, &check->min, &check->span) ||
+        rule->probability == 0 || rule->probability > 100) {
+        return false;
+    }
+    if (rule->enable_signal == OBD2_SIGNAL_NONE) {
+        check->enable_min = INT32_MIN;
+        check->enable_span = UINT32_MAX;
+    } else if (!compile_condition(rule->enable_signal, rule->enable_compare, rule->enable_threshold,
+                                  &check->enable_min, &check->enable_span)) {
+        return false;
+    }
+    check->signal = rule->signal;
+    check->enable_signal = rule->enable_signal;
+    check->chance = (rule->probability >= 100) ? 0 : (uint16_t)(rule->probability * 65536u / 100);
+    check->debounce_ticks = TICKS_OF(rule->debounce_ms);
+    return true;
+}
+
+bool obd2_fault_compile(obd2_fault_table_t *table, const obd2_fault_rule_t *rules, uint16_t count)
+{
+    if (count > OBD2_FAULT_MAX_RULES) {
+        return false;
+    }
+
+    // Validate the whole table first so a bad rule leaves the active one running
+    for (uint16_t i = 0; i < count; i++) {
+        obd2_fault_check_t check;
+        if (!compile_rule(&rules[i], &check)) {
+            return false;
+        }
+    }
+
+    for (uint16_t i = 0; i < count; i++) {
+        compile_rule(&rules[i], &table->checks[i]);
+    }
+    table->rules = rules;
+    table->count = count;
+    return true;
+}
+
+const obd2_fault_rule_t* obd2_fault_get_default_rules(uint16_t *count)
+{
+    *count = sizeof(default_rules) / sizeof(default_rules[0]);
+    return default_rules;
+}
+
+bool obd2_fault_load(const obd2_fault_rule_t *rules, uint16_t count)
+{
+    if (!obd2_fault_compile(&fault_state.table, rules, count)) {
+        return false;
+    }
+    memset(fault_state.debounce, 0, sizeof(fault_state.debounce));
+    memset(fault_state.passed, 0, sizeof(fault_state.passed));
+    return true;
+}
+
+void obd2_fault_init(void)
+{
+    uint16_t count;
+    const obd2_fault_rule_t *rules = obd2_fault_get_default_rules(&count);
+
+    memset(&fault_state, 0, sizeof(fault_state));
+    fault_state.vehicle.debounce = fault_state.debounce;
+    fault_state.vehicle.passed = fault_state.passed;
+    fault_state.vehicle.rng_state = 0x2545F491u;
+    obd2_fault_load(rules, count);
+}
+
+// All signals in one pass, so rules never call the getters
+void obd2_fault_capture_signals(const obd2_vehicle_t *vehicle, int32_t *signals)
+{
+    signals[OBD2_SIGNAL_NONE] = 0;
+    signals[OBD2_SIGNAL_RPM] = vehicle->base_rpm;
+    signals[OBD2_SIGNAL_SPEED] = vehicle->vehicle_speed;
+    signals[OBD2_SIGNAL_LOAD] = vehicle->engine_load;
+    signals[OBD2_SIGNAL_COOLANT] = vehicle->coolant_temp;
+    signals[OBD2_SIGNAL_INTAKE_TEMP] = vehicle->intake_temp;
+    signals[OBD2_SIGNAL_THROTTLE] = vehicle->throttle_position;
+    signals[OBD2_SIGNAL_MAF] = vehicle->maf_flow_rate;
+    signals[OBD2_SIGNAL_MAP] = vehicle->manifold_pressure;
+    signals[OBD2_SIGNAL_FUEL_PRESSURE] = vehicle->fuel_pressure;
+    signals[OBD2_SIGNAL_O2_B1S1] = vehicle->o2_sensor_b1s1;
+    signals[OBD2_SIGNAL_O2_B1S2] = vehicle->o2_sensor_b1s2;
+    signals[OBD2_SIGNAL_SHORT_TRIM] = ((int32_t)vehicle->short_fuel_trim_b1 - 128) * 100 / 128;
+    signals[OBD2_SIGNAL_LONG_TRIM] = ((int32_t)vehicle->long_fuel_trim_b1 - 128) * 100 / 128;
+    signals[OBD2_SIGNAL_FUEL_LEVEL] = vehicle->fuel_level;
+    signals[OBD2_SIGNAL_RUNTIME] = vehicle->engine_runtime / (1000 / OBD2_VEHICLE_TICK_MS);
+}
+
+// Passing results only matter once per driving cycle
+static void pass_test(const obd2_fault_table_t *table, obd2_fault_state_t *state, uint16_t i,
+                      obd2_fault_report_t report, void *context)
+{
+    uint32_t bit = 1u << (i & 31);
+
+    if (!(state->passed[i >> 5] & bit)) {
+        state->passed[i >> 5] |= bit;
+        report(context, &table->rules[i], false);
+    }
+}
+
+void obd2_fault_evaluate(const obd2_fault_table_t *table, obd2_fault_state_t *state, bool running,
+                         const int32_t *signals, obd2_fault_report_t report, void *context)
+{
+    if (!running) {
+        if (state->was_running) {
+            state->was_running = false;
+            memset(state->debounce, 0, table->count * sizeof(state->debounce[0]));
+            memset(state->passed, 0, OBD2_FAULT_PASSED_WORDS(table->count) * sizeof(state->passed[0]));
+        }
+        return;
+    }
+    state->was_running = true;
+
+    for (uint16_t i = 0; i < table->count; i++) {
+        const obd2_fault_check_t *check = &table->checks[i];
+        int32_t *debounce = &state->debounce[i];
+
+        // Not enabled: the test does not run
+        if ((uint32_t)signals[check->enable_signal] - (uint32_t)check->enable_min > check->enable_span) {
+            *debounce = 0;
+            continue;
+        }
+
+        // Clear long enough: the test passes
+        if ((uint32_t)signals[check->signal] - (uint32_t)check->min > check->span) {
+            if (*debounce > 0) {
+                *debounce = 0;
+            }
+            if (--*debounce <= -(int32_t)check->debounce_ticks) {
+                *debounce = 0;
+                pass_test(table, state, i, report, context);
+            }
+            continue;
+        }
+
+        // Held long enough: roll once, then start over either way
+        if (*debounce < 0) {
+            *debounce = 0;
+        }
+        if (++*debounce >= (int32_t)check->debounce_ticks) {
+            *debounce = 0;
+            if (check->chance == 0 || (next_random(state) & 0xFFFF) < check->chance) {
+                report(context, &table->rules[i], true);
+            } else {
+                pass_test(table, state, i, report, context);
+            }
+        }
+    }
+}
+
+// The firmware's vehicle reports into the DTC manager
+static void report_result(void *context, const obd2_fault_rule_t *rule, bool failed)
+{
+    bool is_new = failed && !obd2_dtc_exists(rule->code, rule->type);
+
+    if (failed) {
+        fault_state.fired++;
+    }
+    if (obd2_dtc_report_result(rule->code, rule->type, failed, rule->mil) && is_new) {
+        printf("DTC %c%04X: %s\r\n", rule->type, rule->code, rule->description);
+    }
+}
+
+void obd2_fault_tick(const obd2_vehicle_t *vehicle)
+{
+    if (vehicle->engine_running) {
+        obd2_fault_capture_signals(vehicle, fault_state.signals);
+    }
+    obd2_fault_evaluate(&fault_state.table, &fault_state.vehicle, vehicle->engine_running,
+                        fault_state.signals, report_result, NULL);
+}
+
+uint16_t obd2_fault_get_rule_count(void)
+{
+    return fault_state.table.count;
+}
+
+uint32_t obd2_fault_get_fired_count(void)
+{
+    return fault_state.fired;
+}
@@ -0,0 +1,129 @@
+#ifndef __OBD2_FAULT_H__
+#define __OBD2_FAULT_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "obd2_vehicle.h"
+
+// Rule-based fault detection
+//
+// Condition-based DTCs are declared as a table of rules: a signal compared
+// with a threshold, an optional enable condition on a second signal, how
+// long both must hold (debounce), the chance the fault then sets, and the
+// DTC it reports. The table is compiled once into an array of range checks,
+// and every simulation tick captures the signals into one array and walks
+// the checks, so adding rules costs a compare each and no getter calls.
+// Rules are evaluated while the engine runs; their debounce restarts at
+// every engine start.
+//
+// A rule is a monitor test feeding the DTC lifecycle in obd2_dtc.h: a fault
+// that sets reports a failed result; a lost chance roll, or the condition
+// staying clear for the debounce time while enabled, reports a pass (at most
+// once per driving cycle).
+
+#define OBD2_FAULT_MAX_RULES        256
+
+// Signals rules can test, in physical units
+typedef enum {
+    OBD2_SIGNAL_NONE = 0,       // Always 0
+    OBD2_SIGNAL_RPM,            // RPM
+    OBD2_SIGNAL_SPEED,          // km/h
+    OBD2_SIGNAL_LOAD,           // %
+    OBD2_SIGNAL_COOLANT,        // °C
+    OBD2_SIGNAL_INTAKE_TEMP,    // °C
+    OBD2_SIGNAL_THROTTLE,       // %
+    OBD2_SIGNAL_MAF,            // g/s * 100
+    OBD2_SIGNAL_MAP,            // kPa * 100
+    OBD2_SIGNAL_FUEL_PRESSURE,  // kPa * 100
+    OBD2_SIGNAL_O2_B1S1,        // mV
+    OBD2_SIGNAL_O2_B1S2,        // mV
+    OBD2_SIGNAL_SHORT_TRIM,     // % (signed)
+    OBD2_SIGNAL_LONG_TRIM,      // % (signed)
+    OBD2_SIGNAL_FUEL_LEVEL,     // %
+    OBD2_SIGNAL_RUNTIME,        // Engine running time (s)
+    OBD2_SIGNAL_COUNT
+} obd2_signal_t;
+
+typedef enum {
+    OBD2_FAULT_GT = 0,
+    OBD2_FAULT_GE,
+    OBD2_FAULT_LT,
+    OBD2_FAULT_LE,
+    OBD2_FAULT_EQ
+} obd2_fault_compare_t;
+
+// Declarative rule; a zero enable_signal means no enable condition
+typedef struct {
+    uint16_t code;              // DTC code (without type prefix)
+    uint8_t type;               // DTC type (P, C, B, U)
+    bool mil;                   // Confirmation requests the MIL
+    uint8_t signal;             // obd2_signal_t
+    uint8_t compare;            // obd2_fault_compare_t
+    int32_t threshold;
+    uint8_t enable_signal;
+    uint8_t enable_compare;
+    int32_t enable_threshold;
+    uint32_t debounce_ms;       // Conditions held this long (0 = one tick)
+    uint8_t probability;        // Percent chance the fault then sets, else the test passes
+    const char *description;
+} obd2_fault_rule_t;
+
+// Compiled rule: each condition is an inclusive range, tested as one
+// unsigned compare of (value - min) against the range's span
+typedef struct {
+    int32_t min;
+    uint32_t span;
+    int32_t enable_min;
+    uint32_t enable_span;
+    uint8_t signal;
+    uint8_t enable_signal;
+    uint16_t chance;            // Out of 65536; 0 = always
+    uint32_t debounce_ticks;
+} obd2_fault_check_t;
+
+// Compiled rule table, read-only while vehicles are evaluated against it
+typedef struct {
+    const obd2_fault_rule_t *rules;
+    obd2_fault_check_t checks[OBD2_FAULT_MAX_RULES];
+    uint16_t count;
+} obd2_fault_table_t;
+
+#define OBD2_FAULT_PASSED_WORDS(count)  (((count) + 31) / 32)
+
+// Evaluation state of one vehicle: debounce holds a counter per rule, passed
+// OBD2_FAULT_PASSED_WORDS(count) words; both start zeroed, as does
+// was_running. rng_state seeds the chance rolls and must not be 0.
+typedef struct {
+    int32_t *debounce;          // Ticks the condition has held (> 0) or stayed clear (< 0)
+    uint32_t *passed;           // Pass reported this driving cycle
+    uint32_t rng_state;
+    bool was_running;
+} obd2_fault_state_t;
+
+// Test result of a rule for one vehicle
+typedef void (*obd2_fault_report_t)(void *context, const obd2_fault_rule_t *rule, bool failed);
+
+// Initialization with the built-in rules, and per-tick evaluation
+void obd2_fault_init(void);
+void obd2_fault_tick(const obd2_vehicle_t *vehicle);
+
+// Replace the rule table (rules must stay valid); false, with the previous
+// table left active, if a rule is invalid or there are more than
+// OBD2_FAULT_MAX_RULES
+bool obd2_fault_load(const obd2_fault_rule_t *rules, uint16_t count);
+
+// Rule tables for other vehicles than the firmware's (the host fleet):
+// compile a table (false, table untouched, as for obd2_fault_load), capture
+// a vehicle's signals, and run one tick of a vehicle's rules, reporting
+// each test result to report
+const obd2_fault_rule_t* obd2_fault_get_default_rules(uint16_t *count);
+bool obd2_fault_compile(obd2_fault_table_t *table, const obd2_fault_rule_t *rules, uint16_t count);
+void obd2_fault_capture_signals(const obd2_vehicle_t *vehicle, int32_t *signals);
+void obd2_fault_evaluate(const obd2_fault_table_t *table, obd2_fault_state_t *state, bool running,
+                         const int32_t *signals, obd2_fault_report_t report, void *context);
+
+// Statistics
+uint16_t obd2_fault_get_rule_count(void);
+uint32_t obd2_fault_get_fired_count(void);
+
+#endif // __OBD2_FAULT_H__
@@ -0,0 +1,149 @@
+#include "obd2_freeze.h"
+#include "obd2_storage.h"
+#include <stdio.h>
+#include <string.h>
+
+#define FREEZE_RECORD_HEADER    7   // [frame][dtc hi][dtc lo][sequence x4]
+
+_Static_assert(FREEZE_RECORD_HEADER + sizeof(obd2_vehicle_snapshot_t) <= OBD2_STORAGE_MAX_RECORD,
+               "Freeze frame must fit in one storage record");
+_Static_assert(OBD2_FREEZE_FRAME_SLOTS >= 2, "Need frame 0 plus at least one ring slot");
+
+// Freeze frame pool
+static struct {
+    obd2_freeze_frame_t frames[OBD2_FREEZE_FRAME_SLOTS];
+    uint8_t next_ring;          // Ring slot overwritten by the next capture (1..N-1)
+    uint8_t count;
+    uint32_t sequence;          // Last capture sequence number
+    uint32_t ring_sequence;     // Sequence of the newest ring capture
+} freeze_state;
+
+static void persist_frame(uint8_t slot)
+{
+    const obd2_freeze_frame_t *frame = &freeze_state.frames[slot];
+    uint8_t record[FREEZE_RECORD_HEADER + sizeof(obd2_vehicle_snapshot_t)];
+
+    record[0] = slot;
+    record[1] = frame->dtc >> 8;
+    record[2] = frame->dtc & 0xFF;
+    record[3] = frame->sequence >> 24;
+    record[4] = frame->sequence >> 16;
+    record[5] = frame->sequence >> 8;
+    record[6] = frame->sequence;
+    memcpy(&record[FREEZE_RECORD_HEADER], &frame->data, sizeof(frame->data));
+    obd2_storage_append(OBD2_RECORD_FREEZE_FRAME, record, sizeof(record));
+}
+
+static void store_frame(uint8_t slot, uint16_t dtc, uint32_t sequence)
+{
+    obd2_freeze_frame_t *frame = &freeze_state.frames[slot];
+
+    if (!frame->valid) {
+        freeze_state.count++;
+    }
+    frame->valid = true;
+    frame->dtc = dtc;
+    frame->sequence = sequence;
+
+    if (slot != 0 && sequence >= freeze_state.ring_sequence) {
+        freeze_state.ring_sequence = sequence;
+        freeze_state.next_ring = (slot + 1 < OBD2_FREEZE_FRAME_SLOTS) ? slot + 1 : 1;
+    }
+    if (sequence > freeze_state.sequence) {
+        freeze_state.sequence = sequence;
+    }
+}
+
+static void freeze_storage_restore(uint8_t type, const uint8_t *data, uint8_t length)
+{
+    if (length != FREEZE_RECORD_HEADER + sizeof(obd2_vehicle_snapshot_t) ||
+        data[0] >= OBD2_FREEZE_FRAME_SLOTS) {
+        return;
+    }
+
+    uint32_t sequence = ((uint32_t)data[3] << 24) | ((uint32_t)data[4] << 16) |
+                        ((uint32_t)data[5] << 8) | data[6];
+    store_frame(data[0], (data[1] << 8) | data[2], sequence);
+    memcpy(&freeze_state.frames[data[0]].data, &data[FREEZE_RECORD_HEADER], sizeof(obd2_vehicle_snapshot_t));
+}
+
+static void freeze_storage_snapshot(void)
+{
+    for (uint8_t slot = 0; slot < OBD2_FREEZE_FRAME_SLOTS; slot++) {
+        if (freeze_state.frames[slot].valid) {
+            persist_frame(slot);
+        }
+    }
+}
+
+void obd2_freeze_init(void)
+{
+    memset(&freeze_state, 0, sizeof(freeze_state));
+    freeze_state.next_ring = 1;
+    obd2_storage_register(OBD2_RECORD_FREEZE_FRAME, OBD2_RECORD_FREEZE_FRAME,
+                          freeze_storage_restore, freeze_storage_snapshot);
+}
+
+void obd2_freeze_capture(uint16_t dtc)
+{
+    uint8_t slot;
+
+    // Frame 0 keeps the first fault since clear, later faults rotate
+    if (!freeze_state.frames[0].valid) {
+        slot = 0;
+    } else {
+        slot = freeze_state.next_ring;
+    }
+
+    store_frame(slot, dtc, freeze_state.sequence + 1);
+    obd2_capture_vehicle_snapshot(&freeze_state.frames[slot].data);
+    persist_frame(slot);
+}
+
+const obd2_freeze_frame_t* obd2_freeze_get(uint8_t frame)
+{
+    if (frame >= OBD2_FREEZE_FRAME_SLOTS || !freeze_state.frames[frame].valid) {
+        return NULL;
+    }
+    return &freeze_state.frames[frame];
+}
+
+uint8_t obd2_freeze_get_count(void)
+{
+    return freeze_state.count;
+}
+
+void obd2_freeze_invalidate(uint16_t dtc)
+{
+    for (uint8_t slot = 0; slot < OBD2_FREEZE_FRAME_SLOTS; slot++) {
+        if (freeze_state.frames[slot].valid && freeze_state.frames[slot].dtc == dtc) {
+            freeze_state.frames[slot].valid = false;
+            freeze_state.count--;
+        }
+    }
+}
+
+void obd2_freeze_clear(void)
+{
+    memset(freeze_state.frames, 0, sizeof(freeze_state.frames));
+    freeze_state.count = 0;
+    freeze_state.next_ring = 1;
+    freeze_state.ring_sequence = 0;
+}
+
+void obd2_freeze_print_all(void)
+{
+    printf("\r\n=== Freeze Frames ===\r\n");
+    printf("Count: %u of %u\r\n", freeze_state.count, OBD2_FREEZE_FRAME_SLOTS);
+
+    for (uint8_t slot = 0; slot < OBD2_FREEZE_FRAME_SLOTS; slot++) {
+        const obd2_freeze_frame_t *frame = &freeze_state.frames[slot];
+        if (!frame->valid) {
+            continue;
+        }
+        printf("Frame %u: DTC %04X, RPM %u, Speed %u km/h, Coolant %d C, Load %u%%\r\n",
+               slot, frame->dtc, frame->data.engine_rpm / 4, frame->data.vehicle_speed,
+               frame->data.coolant_temp - 40, (frame->data.engine_load * 100) / 255);
+    }
+    printf("=====================\r\n\r\n");
+}
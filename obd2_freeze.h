@@ -0,0 +1,40 @@
+#ifndef __OBD2_FREEZE_H__
+#define __OBD2_FREEZE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "obd2_protocol.h"
+
+// Freeze frames for Service 02
+//
+// When a DTC is confirmed the DTC manager captures a snapshot of the vehicle
+// state into a preallocated pool. Frame 0 holds the first fault since the
+// last clear and is kept until Service 04; frames 1..N-1 form a ring that
+// overwrites the oldest capture. Capture is a fixed-size copy, so it is safe
+// from the simulation tick.
+
+#define OBD2_FREEZE_FRAME_SLOTS     8       // Frame 0 plus ring slots
+
+typedef struct {
+    bool valid;
+    uint16_t dtc;                   // Transmitted DTC that caused the capture
+    uint32_t sequence;              // Capture order, higher is newer
+    obd2_vehicle_snapshot_t data;   // Vehicle state at capture time
+} obd2_freeze_frame_t;
+
+// Initialization
+void obd2_freeze_init(void);
+
+// Capture and lookup
+void obd2_freeze_capture(uint16_t dtc);
+const obd2_freeze_frame_t* obd2_freeze_get(uint8_t frame);
+uint8_t obd2_freeze_get_count(void);
+
+// Removal
+void obd2_freeze_invalidate(uint16_t dtc);
+void obd2_freeze_clear(void);
+
+// Debug output
+void obd2_freeze_print_all(void);
+
+#endif // __OBD2_FREEZE_H__
@@ -1,16 +1,33 @@
 #include "obd2_handler.h"
 #include "obd2_protocol.h"
-#include "xl2515.h"
+#include "obd2_isotp.h"
+#include "obd2_uds.h"
+#include "obd2_pending.h"
+#include "obd2_periodic.h"
+#include "obd2_timer.h"
+#include "obd2_timing.h"
+#include "obd2_fault.h"
+#include "obd2_can.h"
+#include "pico/stdlib.h"
 #include <stdio.h>
 #include <string.h>
 
 // OBD2 handler state
 static struct {
     bool initialized;
+    const obd2_can_transport_t *transport;
     uint32_t messages_received;
     uint32_t messages_sent;
     uint32_t errors;
+    uint32_t nrc_suppressed;    // Negative responses withheld from functional requests
     uint8_t last_error_code;
+    uint32_t last_activity;     // Time of the last received frame (ms)
+    uint8_t rx_channel;         // Transport interface of the request being processed
+    obd2_channel_responder_t channel_responder;     // Other ECUs, NULL for none
+    uint32_t latency_count;     // Requests answered straight from the receive path
+    uint64_t latency_total_us;  // Frame arrival to response handed to the transport
+    uint32_t latency_min_us;
+    uint32_t latency_max_us;
 } obd2_state = {
     .initialized = false,
     .messages_received = 0,
@@ -19,93 +36,515 @@ static struct {
     .last_error_code = 0
 };
 
-// Message buffers
-static uint8_t rx_buffer[8];
-static uint8_t tx_buffer[8];
+// Received request waiting to be answered
+typedef struct {
+    uint8_t data[OBD2_CAN_MAX_FRAME_SIZE];  // Sized for CAN FD; classic uses 8 bytes
+    uint8_t length;
+    uint8_t channel;
+    uint32_t can_id;
+    uint64_t rx_time;           // Arrival, time_us_64() timebase
+} queued_request_t;
 
-bool obd2_handler_init(void)
+// Request queue (ring) with admission control
+static struct {
+    queued_request_t entries[OBD2_HANDLER_QUEUE_DEPTH];
+    queued_request_t overflow;  // Receives a frame while the ring is full
+    uint8_t head;
+    uint8_t count;
+    uint8_t max_depth;
+    uint32_t budget_us;
+    uint32_t service_x8_us;     // 8x the moving average time to answer one request
+    uint32_t shed;              // Requests answered with NRC 0x21
+    uint32_t delay_count;       // Queueing delay: arrival to start of handling
+    uint64_t delay_total_us;
+    uint32_t delay_max_us;
+} request_queue = {
+    .budget_us = OBD2_HANDLER_LATENCY_BUDGET_MS * 1000,
+};
+
+// Request waiting for the instant its ECU's timing profile answers it
+typedef struct {
+    queued_request_t request;
+    obd2_timer_t timer;
+    bool in_use;
+    bool pending_first;         // NRC 0x78 goes out when the timer fires
+} deferred_request_t;
+
+// Deferred requests
+static struct {
+    deferred_request_t slots[OBD2_HANDLER_DEFERRED_MAX];
+    uint8_t count;
+    uint32_t deferred;          // Requests answered through a timing profile
+    uint32_t pending_sent;      // NRC 0x78 sent by timing profiles
+} deferred_state;
+
+// Responses are encoded into the transport's transmit slot when it offers
+// one, else into tx_buffer
+static uint8_t tx_buffer[OBD2_CAN_MAX_FRAME_SIZE];
+
+// Response from the channel responder; ISO-TP copies it when the transfer starts
+#define OBD2_CHANNEL_RESPONSE_SIZE  64
+static uint8_t channel_response[OBD2_CHANNEL_RESPONSE_SIZE];
+
+static bool send_obd2_response(const obd2_message_t *request, obd2_response_t *response);
+static bool send_isotp_frame(const obd2_isotp_address_t *address, uint8_t *can_data, uint8_t can_length);
+static uint8_t* claim_tx_frame(void);
+static bool send_periodic_frame(uint8_t *can_data, uint8_t can_length);
+
+static void reset_latency(void)
+{
+    obd2_state.latency_count = 0;
+    obd2_state.latency_total_us = 0;
+    obd2_state.latency_min_us = UINT32_MAX;
+    obd2_state.latency_max_us = 0;
+    request_queue.max_depth = request_queue.count;
+    request_queue.shed = 0;
+    request_queue.delay_count = 0;
+    request_queue.delay_total_us = 0;
+    request_queue.delay_max_us = 0;
+}
+
+static uint32_t elapsed_us(uint64_t since, uint64_t now)
 {
-    // Initialize CAN interface at 500 kbps (standard OBD2 speed)
-    xl2515_init(KBPS500);
+    return (now > since) ? (uint32_t)(now - since) : 0;
+}
+
+static void record_latency(uint64_t rx_time_us)
+{
+    uint32_t latency = elapsed_us(rx_time_us, time_us_64());
+
+    obd2_state.latency_count++;
+    obd2_state.latency_total_us += latency;
+    if (latency < obd2_state.latency_min_us) {
+        obd2_state.latency_min_us = latency;
+    }
+    if (latency > obd2_state.latency_max_us) {
+        obd2_state.latency_max_us = latency;
+    }
+}
+
+bool obd2_handler_init(const obd2_can_transport_t *transport)
+{
+    // Initialize the CAN interface (standard OBD2 speed on the XL2515)
+    if (transport == NULL || !obd2_can_is_valid_frame_size(transport->frame_size) ||
+        !transport->init()) {
+        return false;
+    }
+    obd2_state.transport = transport;
     
     // Initialize vehicle simulation
     obd2_init_vehicle_simulation();
+    obd2_uds_init();
+    
+    // Multi-frame responses go out through ISO-TP using our ECU ID, segmented
+    // for the transport's frame size
+    obd2_isotp_init(send_isotp_frame, transport->frame_size);
+    
+    // Slow handlers finish from the main loop behind NRC 0x78
+    obd2_pending_init(send_obd2_response, claim_tx_frame);
+    
+    // Scheduled periodic identifiers go out on their own CAN ID
+    obd2_periodic_init(send_periodic_frame);
+    
+    // Every ECU answers immediately until given a timing profile
+    obd2_timing_init();
+    for (int i = 0; i < OBD2_HANDLER_DEFERRED_MAX; i++) {
+        obd2_timer_cancel(&deferred_state.slots[i].timer);
+    }
+    memset(&deferred_state, 0, sizeof(deferred_state));
     
     obd2_state.initialized = true;
     obd2_state.messages_received = 0;
     obd2_state.messages_sent = 0;
     obd2_state.errors = 0;
+    obd2_state.nrc_suppressed = 0;
+    reset_latency();
     
-    printf("OBD2 Handler initialized - Ready to receive requests\r\n");
+    printf("OBD2 Handler initialized on %s (%u-byte frames) - Ready to receive requests\r\n",
+           transport->name, transport->frame_size);
     return true;
 }
 
-void obd2_handler_process(void)
+// ISO-TP connection of a tester: with 11-bit OBD addressing its Flow
+// Control comes from the physical request ID even after a functional request
+static obd2_isotp_address_t tester_address(uint32_t can_id, uint8_t channel)
 {
-    if (!obd2_state.initialized) {
+    obd2_isotp_address_t address = {
+        .channel = channel,
+        .tester_id = (can_id == OBD2_REQUEST_ID) ? OBD2_PHYSICAL_REQUEST_ID : can_id,
+        .ecu_id = OBD2_ECU_ID,
+    };
+    return address;
+}
+
+static void select_channel(uint8_t channel)
+{
+    if (obd2_state.transport->tx_channel != NULL) {
+        obd2_state.transport->tx_channel(channel);
+    }
+}
+
+// View of a queued request for answering it without obd2_process_request()
+static bool parse_queued(const queued_request_t *entry, obd2_message_t *request)
+{
+    if (!obd2_parse_message(entry->data, entry->length, request)) {
+        obd2_state.errors++;
+        return false;
+    }
+    request->can_id = entry->can_id;
+    request->channel = entry->channel;
+    return true;
+}
+
+// Answer a request with NRC 0x21 without handling it
+static void shed_request(const queued_request_t *entry, const char *reason)
+{
+    obd2_message_t request;
+    obd2_response_t response;
+    
+    request_queue.shed++;
+    if (!parse_queued(entry, &request)) {
+        return;
+    }
+    
+    printf("Request for service 0x%02X shed (%s)\r\n", request.service, reason);
+    obd2_response_init(&response, claim_tx_frame());
+    obd2_create_error_response(request.service, OBD2_ERROR_BUSY_REPEAT_REQUEST, &response);
+    send_obd2_response(&request, &response);
+}
+
+// Queue a received request, or shed it if it cannot be answered in time:
+// it has waited (in the controller or kernel) plus the requests ahead of it
+// and its own handling, at the recent average handling time
+static void admit_request(queued_request_t *entry)
+{
+    if (entry == &request_queue.overflow) {
+        shed_request(entry, "queue full");
         return;
     }
     
-    // Check for incoming CAN messages
-    uint8_t rx_length = 0;
-    uint32_t can_id = OBD2_REQUEST_ID;
+    uint32_t expected_us = elapsed_us(entry->rx_time, time_us_64()) +
+                           (request_queue.count + 1) * (request_queue.service_x8_us / 8);
+    if (expected_us > request_queue.budget_us) {
+        shed_request(entry, "over latency budget");
+        return;
+    }
     
-    if (xl2515_recv(can_id, rx_buffer, &rx_length)) {
+    request_queue.count++;
+    if (request_queue.count > request_queue.max_depth) {
+        request_queue.max_depth = request_queue.count;
+    }
+}
+
+// Take what the transport has received: Flow Control goes to ISO-TP, requests
+// join the queue
+static void receive_frames(void)
+{
+    for (int n = 0; n < OBD2_HANDLER_RX_BURST; n++) {
+        // Received straight into the queue slot it will be handled from
+        queued_request_t *entry = &request_queue.overflow;
+        if (request_queue.count < OBD2_HANDLER_QUEUE_DEPTH) {
+            entry = &request_queue.entries[(request_queue.head + request_queue.count) % OBD2_HANDLER_QUEUE_DEPTH];
+        }
+        
+        entry->can_id = OBD2_REQUEST_ID;
+        if (!obd2_state.transport->recv(entry->can_id, entry->data, &entry->length)) {
+            return;
+        }
+        
+        // Latency is measured from frame arrival, as precisely as the transport knows it
+        entry->rx_time = (obd2_state.transport->rx_time_us != NULL) ?
+                         obd2_state.transport->rx_time_us() : time_us_64();
+        obd2_state.last_activity = to_ms_since_boot(get_absolute_time());
+        if (obd2_state.transport->rx_can_id != NULL) {
+            entry->can_id = obd2_state.transport->rx_can_id();
+        }
+        entry->channel = (obd2_state.transport->rx_channel != NULL) ?
+                         obd2_state.transport->rx_channel() : 0;
+        
+        // Flow Control for one of the tester's multi-frame responses
+        obd2_isotp_address_t address = tester_address(entry->can_id, entry->channel);
+        if (obd2_isotp_handle_frame(&address, entry->data, entry->length)) {
+            obd2_isotp_process();
+            continue;
+        }
+        
         obd2_state.messages_received++;
         
         printf("Received OBD2 request: ");
-        for (int i = 0; i < rx_length; i++) {
-            printf("%02X ", rx_buffer[i]);
+        for (int i = 0; i < entry->length; i++) {
+            printf("%02X ", entry->data[i]);
         }
         printf("\r\n");
         
-        // Process the OBD2 request
-        if (obd2_process_request(rx_buffer, rx_length)) {
-            printf("Request processed successfully\r\n");
+        admit_request(entry);
+    }
+}
+
+// Handle a request now and account for it
+static void answer_request(const queued_request_t *entry)
+{
+    obd2_state.rx_channel = entry->channel;
+    if (obd2_process_request(entry->can_id, entry->data, entry->length)) {
+        record_latency(entry->rx_time);
+        printf("Request processed successfully\r\n");
+    } else {
+        printf("Error processing request\r\n");
+        obd2_state.errors++;
+    }
+}
+
+// The timing profile's instant has come: NRC 0x78 first if it was drawn,
+// the response itself otherwise
+static void answer_deferred(void *context)
+{
+    deferred_request_t *slot = context;
+    
+    if (slot->pending_first) {
+        obd2_message_t request;
+        obd2_response_t response;
+        
+        slot->pending_first = false;
+        if (parse_queued(&slot->request, &request)) {
+            obd2_response_init(&response, claim_tx_frame());
+            obd2_create_error_response(request.service,
+                                       OBD2_ERROR_REQUEST_CORRECTLY_RECEIVED_RESPONSE_PENDING, &response);
+            send_obd2_response(&request, &response);
+            deferred_state.pending_sent++;
+        }
+        
+        const obd2_timing_profile_t *profile = obd2_timing_get_profile(OBD2_ECU_ID);
+        obd2_timer_start(&slot->timer, profile->pending_ms * 1000, answer_deferred, slot);
+        return;
+    }
+    
+    slot->in_use = false;
+    deferred_state.count--;
+    answer_request(&slot->request);
+}
+
+// Hold a request until the delay drawn from the ECU's timing profile has
+// passed since it arrived
+static void defer_request(const queued_request_t *entry)
+{
+    deferred_request_t *slot = NULL;
+    
+    for (int i = 0; i < OBD2_HANDLER_DEFERRED_MAX; i++) {
+        if (!deferred_state.slots[i].in_use) {
+            slot = &deferred_state.slots[i];
+            break;
+        }
+    }
+    if (slot == NULL) {
+        shed_request(entry, "no deferred response slot");
+        return;
+    }
+    
+    uint32_t delay_us = obd2_timing_sample_delay_us(OBD2_ECU_ID);
+    uint32_t waited_us = elapsed_us(entry->rx_time, time_us_64());
+    
+    slot->request = *entry;
+    slot->in_use = true;
+    slot->pending_first = obd2_timing_sample_pending(OBD2_ECU_ID);
+    deferred_state.count++;
+    deferred_state.deferred++;
+    obd2_timer_start(&slot->timer, (delay_us > waited_us) ? delay_us - waited_us : 0,
+                     answer_deferred, slot);
+}
+
+// Answer queued requests in arrival order
+static void serve_requests(void)
+{
+    for (int n = 0; n < OBD2_HANDLER_SERVE_BURST && request_queue.count > 0; n++) {
+        queued_request_t *entry = &request_queue.entries[request_queue.head];
+        uint64_t start = time_us_64();
+        uint32_t delay = elapsed_us(entry->rx_time, start);
+        
+        request_queue.delay_count++;
+        request_queue.delay_total_us += delay;
+        if (delay > request_queue.delay_max_us) {
+            request_queue.delay_max_us = delay;
+        }
+        
+        if (delay > request_queue.budget_us) {
+            // Held up behind slower requests than expected: too late now
+            shed_request(entry, "waited too long");
+        } else if (!obd2_timing_is_immediate(OBD2_ECU_ID)) {
+            // Answered when the ECU's timing profile says
+            defer_request(entry);
         } else {
-            printf("Error processing request\r\n");
-            obd2_state.errors++;
+            answer_request(entry);
+            
+            // Moving average over about 8 requests, kept scaled so that
+            // sub-8 us changes are not lost
+            request_queue.service_x8_us -= request_queue.service_x8_us / 8;
+            request_queue.service_x8_us += elapsed_us(start, time_us_64());
         }
+        
+        request_queue.head = (request_queue.head + 1) % OBD2_HANDLER_QUEUE_DEPTH;
+        request_queue.count--;
+    }
+}
+
+void obd2_handler_process(void)
+{
+    if (!obd2_state.initialized) {
+        return;
+    }
+    
+    // Due timers first: simulation step, periodic frames, ISO-TP timeouts
+    // and pacing, NRC 0x78 keepalives
+    obd2_timer_process();
+    
+    // Incoming CAN messages, then queued requests
+    receive_frames();
+    serve_requests();
+    
+    // Response-pending jobs and any multi-frame transfer
+    obd2_pending_process();
+    obd2_isotp_process();
+}
+
+// ISO 15765-4 / ISO 14229: an ECU that does not support a functionally
+// requested service or parameter stays silent, so a tester scanning PIDs
+// on 0x7DF only hears from the ECUs that have them
+static bool is_suppressed_for_functional(const obd2_response_t *response)
+{
+    if (response->payload != NULL || response->length != 3 ||
+        response->frame[OBD2_FRAME_SERVICE] != 0x7F) {
+        return false;
     }
     
-    // Update vehicle simulation
-    obd2_update_vehicle_simulation();
+    switch (response->data[0]) {
+        case OBD2_ERROR_SERVICE_NOT_SUPPORTED:
+        case OBD2_ERROR_SUBFUNCTION_NOT_SUPPORTED:
+        case OBD2_ERROR_REQUEST_OUT_OF_RANGE:
+        case OBD2_ERROR_SUBFUNCTION_NOT_SUPPORTED_IN_ACTIVE_SESSION:
+        case OBD2_ERROR_SERVICE_NOT_SUPPORTED_IN_ACTIVE_SESSION:
+            return true;
+        default:
+            return false;
+    }
+}
+
+void obd2_handler_set_channel_responder(obd2_channel_responder_t responder)
+{
+    obd2_state.channel_responder = responder;
 }
 
-bool obd2_process_request(uint8_t *can_data, uint8_t can_length)
+bool obd2_process_request(uint32_t can_id, const uint8_t *can_data, uint8_t can_length)
 {
     obd2_message_t request;
     obd2_response_t response;
     
-    // Parse the incoming OBD2 message
+    // Parse the incoming OBD2 message (a view of can_data, nothing copied)
     if (!obd2_parse_message(can_data, can_length, &request)) {
         printf("Failed to parse OBD2 message\r\n");
         return false;
     }
+    request.can_id = can_id;
+    request.channel = obd2_state.rx_channel;
+    
+    // The handler encodes straight into the frame that goes out
+    obd2_response_init(&response, claim_tx_frame());
     
     printf("Parsed request - Service: 0x%02X, PID: 0x%02X\r\n", 
            request.service, request.pid);
     
-    // Create response based on the request
-    if (!obd2_create_response(&request, &response)) {
-        printf("Failed to create OBD2 response\r\n");
-        return false;
+    // Requests on another ECU's channel are answered by that ECU
+    uint16_t channel_length = 0;
+    if (obd2_state.channel_responder != NULL) {
+        channel_length = obd2_state.channel_responder(request.channel, request.bytes, request.length,
+                                                      channel_response, sizeof(channel_response));
     }
     
-    // Format response into CAN message
-    uint8_t tx_length = obd2_format_can_message(&response, tx_buffer);
-    if (tx_length == 0) {
-        printf("Failed to format CAN message\r\n");
-        return false;
+    if (channel_length != 0) {
+        obd2_set_payload_response(channel_response, channel_length, &response);
+    } else {
+        // One job per service: a repeat while the first is pending is refused
+        if (obd2_pending_is_busy(request.service)) {
+            obd2_create_error_response(request.service, OBD2_ERROR_BUSY_REPEAT_REQUEST, &response);
+            return send_obd2_response(&request, &response);
+        }
+        
+        // Create response based on the request
+        if (!obd2_create_response(&request, &response)) {
+            printf("Failed to create OBD2 response\r\n");
+            return false;
+        }
+    }
+    
+    if (can_id == OBD2_REQUEST_ID && is_suppressed_for_functional(&response)) {
+        obd2_state.nrc_suppressed++;
+        return true;
+    }
+    
+    // Handler needs longer than P2: the pending job answers later
+    if (response.pending != NULL) {
+        if (!obd2_pending_start(&request, response.pending)) {
+            obd2_create_error_response(request.service, OBD2_ERROR_BUSY_REPEAT_REQUEST, &response);
+            return send_obd2_response(&request, &response);
+        }
+        return true;
     }
     
-    // Send response
-    if (obd2_send_response(tx_buffer, tx_length)) {
+    return send_obd2_response(&request, &response);
+}
+
+static uint8_t* claim_tx_frame(void)
+{
+    uint8_t *frame = NULL;
+    
+    if (obd2_state.transport->tx_claim != NULL) {
+        frame = obd2_state.transport->tx_claim();
+    }
+    return (frame != NULL) ? frame : tx_buffer;
+}
+
+// Queue a frame encoded by claim_tx_frame(): in place if it is still the
+// transport's current slot, otherwise as a copy through send()
+static bool transmit_frame(uint8_t *frame, uint8_t length)
+{
+    if (frame != tx_buffer && obd2_state.transport->tx_claim != NULL &&
+        frame == obd2_state.transport->tx_claim()) {
+        return obd2_state.transport->tx_commit(OBD2_ECU_ID, length);
+    }
+    return obd2_send_response(frame, length);
+}
+
+static bool send_obd2_response(const obd2_message_t *request, obd2_response_t *response)
+{
+    // UDS requests with the suppress-positive-response bit get no answer
+    if (response->payload == NULL && response->length == 0) {
+        printf("Response suppressed\r\n");
+        return true;
+    }
+    
+    // Answers go out on the interface the request came in on
+    select_channel(request->channel);
+    
+    // Long responses are segmented by ISO-TP (First Frame now, rest on Flow
+    // Control), in a session of their own per tester
+    if (response->payload != NULL) {
+        obd2_isotp_address_t address = tester_address(request->can_id, request->channel);
+        if (!obd2_isotp_send(&address, response->payload, response->payload_length)) {
+            printf("Failed to start multi-frame response\r\n");
+            return false;
+        }
+        obd2_state.messages_sent++;
+        printf("Sent OBD2 multi-frame response: %u bytes\r\n", response->payload_length);
+        return true;
+    }
+    
+    // Complete the frame in place and send it
+    uint8_t tx_length = obd2_finish_can_message(response);
+    
+    if (transmit_frame(response->frame, tx_length)) {
         obd2_state.messages_sent++;
         
         printf("Sent OBD2 response: ");
         for (int i = 0; i < tx_length; i++) {
-            printf("%02X ", tx_buffer[i]);
+            printf("%02X ", response->frame[i]);
         }
         printf("\r\n");
         
@@ -119,18 +558,66 @@ bool obd2_process_request(uint8_t *can_data, uint8_t can_length)
 bool obd2_send_response(uint8_t *can_data, uint8_t can_length)
 {
     // Send response with our ECU ID
-    xl2515_send(OBD2_ECU_ID, can_data, can_length);
-    return true;
+    return obd2_state.transport->send(OBD2_ECU_ID, can_data, can_length);
+}
+
+static bool send_isotp_frame(const obd2_isotp_address_t *address, uint8_t *can_data, uint8_t can_length)
+{
+    select_channel(address->channel);
+    return obd2_state.transport->send(address->ecu_id, can_data, can_length);
+}
+
+static bool send_periodic_frame(uint8_t *can_data, uint8_t can_length)
+{
+    return obd2_state.transport->send(OBD2_PERIODIC_ID, can_data, can_length);
 }
 
 void obd2_handler_stats(void)
 {
     printf("\r\n=== OBD2 Handler Statistics ===\r\n");
     printf("Initialized: %s\r\n", obd2_state.initialized ? "Yes" : "No");
+    if (obd2_state.transport != NULL) {
+        printf("Transport: %s (%u-byte frames)\r\n", obd2_state.transport->name,
+               obd2_state.transport->frame_size);
+    }
     printf("Messages Received: %lu\r\n", obd2_state.messages_received);
     printf("Messages Sent: %lu\r\n", obd2_state.messages_sent);
     printf("Errors: %lu\r\n", obd2_state.errors);
+    printf("Suppressed NRCs (ECU %03X, functional requests): %lu\r\n", OBD2_ECU_ID,
+           obd2_state.nrc_suppressed);
     printf("Last Error Code: 0x%02X\r\n", obd2_state.last_error_code);
+    if (obd2_state.latency_count > 0) {
+        printf("Response Latency: min %lu us, avg %lu us, max %lu us (%lu requests)\r\n",
+               obd2_state.latency_min_us,
+               (uint32_t)(obd2_state.latency_total_us / obd2_state.latency_count),
+               obd2_state.latency_max_us, obd2_state.latency_count);
+    }
+    printf("Request Queue: %u/%u (max %u), budget %lu ms, %lu shed with NRC 0x21\r\n",
+           request_queue.count, OBD2_HANDLER_QUEUE_DEPTH, request_queue.max_depth,
+           obd2_handler_get_latency_budget(), request_queue.shed);
+    if (request_queue.delay_count > 0) {
+        printf("Queueing Delay: avg %lu us, max %lu us; handling avg %lu us\r\n",
+               (uint32_t)(request_queue.delay_total_us / request_queue.delay_count),
+               request_queue.delay_max_us, request_queue.service_x8_us / 8);
+    }
+    const obd2_timing_profile_t *profile = obd2_timing_get_profile(OBD2_ECU_ID);
+    if (!obd2_timing_is_immediate(OBD2_ECU_ID) || deferred_state.deferred > 0) {
+        printf("Response Timing: %s, delay %u ms, jitter %u ms, %u%% NRC 0x78 first; "
+               "%lu deferred (%u waiting), %lu NRC 0x78 sent\r\n",
+               obd2_timing_mode_name(profile->mode), profile->delay_ms, profile->jitter_ms,
+               profile->pending_percent, deferred_state.deferred, deferred_state.count,
+               deferred_state.pending_sent);
+    }
+    printf("Service 01 Memo: %lu hits, %lu misses (same PID within one simulation tick)\r\n",
+           obd2_get_pid_memo_hits(), obd2_get_pid_memo_misses());
+    printf("Fault Rules: %u, %lu fired\r\n", obd2_fault_get_rule_count(), obd2_fault_get_fired_count());
+    printf("Timers: %u pending, %lu expired\r\n", obd2_timer_get_pending_count(),
+           obd2_timer_get_expired_count());
+    printf("Pending Jobs: %u (NRC 0x78 sent: %lu)\r\n", obd2_pending_get_active(),
+           obd2_pending_get_keepalive_count());
+    printf("ISO-TP: %u active sessions, %lu transfers, %lu aborted, %lu refused (no buffer)\r\n",
+           obd2_isotp_get_active_count(), obd2_isotp_get_transfer_count(),
+           obd2_isotp_get_abort_count(), obd2_isotp_get_pool_failures());
     printf("Engine Running: %s\r\n", obd2_get_engine_state() ? "Yes" : "No");
     printf("Engine Runtime: %lu seconds\r\n", obd2_get_engine_runtime());
     printf("===============================\r\n\r\n");
@@ -149,13 +636,14 @@ void obd2_handler_test_response(void)
     };
     
     obd2_response_t test_response;
+    uint8_t can_msg[OBD2_CAN_CLASSIC_FRAME_SIZE];
+    obd2_response_init(&test_response, can_msg);
     if (obd2_create_response(&test_request, &test_response)) {
         printf("Test response created successfully\r\n");
         printf("Service: 0x%02X, PID: 0x%02X, Length: %d\r\n",
-               test_response.service, test_response.pid, test_response.length);
+               can_msg[OBD2_FRAME_SERVICE], can_msg[OBD2_FRAME_PID], test_response.length);
         
-        uint8_t can_msg[8];
-        uint8_t msg_len = obd2_format_can_message(&test_response, can_msg);
+        uint8_t msg_len = obd2_finish_can_message(&test_response);
         
         printf("CAN message: ");
         for (int i = 0; i < msg_len; i++) {
@@ -171,10 +659,10 @@ void obd2_handler_simulate_request(uint8_t service, uint8_t pid)
 {
     printf("Simulating OBD2 request - Service: 0x%02X, PID: 0x%02X\r\n", service, pid);
     
-    // Create a simulated CAN message
+    // Create a simulated CAN message, physically addressed so every answer is shown
     uint8_t sim_can_data[8] = {0x02, service, pid, 0x00, 0x00, 0x00, 0x00, 0x00};
     
-    if (obd2_process_request(sim_can_data, 8)) {
+    if (obd2_process_request(OBD2_PHYSICAL_REQUEST_ID, sim_can_data, 8)) {
         printf("Simulated request processed successfully\r\n");
     } else {
         printf("Failed to process simulated request\r\n");
@@ -192,16 +680,65 @@ uint32_t obd2_handler_get_message_count(void)
     return obd2_state.messages_received;
 }
 
+uint32_t obd2_handler_get_sent_count(void)
+{
+    return obd2_state.messages_sent;
+}
+
 uint32_t obd2_handler_get_error_count(void)
 {
     return obd2_state.errors;
 }
 
+uint32_t obd2_handler_get_suppressed_count(void)
+{
+    return obd2_state.nrc_suppressed;
+}
+
+void obd2_handler_set_latency_budget(uint32_t budget_ms)
+{
+    request_queue.budget_us = budget_ms * 1000;
+}
+
+uint32_t obd2_handler_get_latency_budget(void)
+{
+    return request_queue.budget_us / 1000;
+}
+
+uint8_t obd2_handler_get_queue_depth(void)
+{
+    return request_queue.count;
+}
+
+uint32_t obd2_handler_get_shed_count(void)
+{
+    return request_queue.shed;
+}
+
+uint8_t obd2_handler_get_deferred_count(void)
+{
+    return deferred_state.count;
+}
+
+uint32_t obd2_handler_get_idle_ms(void)
+{
+    // A multi-frame or deferred response in progress counts as bus activity
+    if (obd2_isotp_is_busy() || deferred_state.count > 0) {
+        return 0;
+    }
+    return to_ms_since_boot(get_absolute_time()) - obd2_state.last_activity;
+}
+
 void obd2_handler_reset_stats(void)
 {
     obd2_state.messages_received = 0;
     obd2_state.messages_sent = 0;
     obd2_state.errors = 0;
+    obd2_state.nrc_suppressed = 0;
     obd2_state.last_error_code = 0;
+    reset_latency();
+    deferred_state.deferred = 0;
+    deferred_state.pending_sent = 0;
+    obd2_reset_pid_memo_stats();
     printf("OBD2 handler statistics reset\r\n");
 }
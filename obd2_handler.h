@@ -3,22 +3,58 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "obd2_can.h"
 
 // Function prototypes for OBD2 handler
 
-// Initialization and main processing
-bool obd2_handler_init(void);
+// Request queue: frames are taken from the transport as they arrive and
+// answered in order. A request that finds the queue full, or that could not
+// be answered within the latency budget (time already waited plus the
+// estimated wait behind the queue), is answered with NRC 0x21 at once so the
+// tester repeats it instead of timing out.
+#define OBD2_HANDLER_QUEUE_DEPTH        16
+#define OBD2_HANDLER_LATENCY_BUDGET_MS  30      // Default: P2 (50 ms) less main loop margin
+#define OBD2_HANDLER_RX_BURST           16      // Frames taken from the transport per call
+#define OBD2_HANDLER_SERVE_BURST        4       // Requests answered per call
+
+// Requests held back by the ECU's response timing profile (obd2_timing.h)
+// leave the queue and wait for their timer; a request finding every slot
+// taken is answered with NRC 0x21.
+#define OBD2_HANDLER_DEFERRED_MAX       8
+
+// Initialization on a CAN transport (e.g. &obd2_can_xl2515_transport) and main processing
+bool obd2_handler_init(const obd2_can_transport_t *transport);
 void obd2_handler_process(void);
 
+// Further ECUs on other transport channels (host build: a vehicle per extra
+// SocketCAN interface). The responder gets the request as [SID][PID...] and
+// writes [SID+40]... or [7F][SID][NRC], returning its length; 0 leaves the
+// request to this ECU's services.
+typedef uint16_t (*obd2_channel_responder_t)(uint8_t channel, const uint8_t *request, uint8_t length,
+                                             uint8_t *response, uint16_t max_length);
+void obd2_handler_set_channel_responder(obd2_channel_responder_t responder);
+
 // Message processing
-bool obd2_process_request(uint8_t *can_data, uint8_t can_length);
+// can_id is the request's CAN ID: negative responses that only say "not
+// supported" are not sent to functional (OBD2_REQUEST_ID) requests
+bool obd2_process_request(uint32_t can_id, const uint8_t *can_data, uint8_t can_length);
 bool obd2_send_response(uint8_t *can_data, uint8_t can_length);
 
 // Statistics and diagnostics
 void obd2_handler_stats(void);
 bool obd2_handler_is_initialized(void);
 uint32_t obd2_handler_get_message_count(void);
+uint32_t obd2_handler_get_sent_count(void);
 uint32_t obd2_handler_get_error_count(void);
+uint32_t obd2_handler_get_suppressed_count(void);
+
+// Request queue and admission control
+void obd2_handler_set_latency_budget(uint32_t budget_ms);
+uint32_t obd2_handler_get_latency_budget(void);
+uint8_t obd2_handler_get_queue_depth(void);
+uint32_t obd2_handler_get_shed_count(void);
+uint8_t obd2_handler_get_deferred_count(void);
+uint32_t obd2_handler_get_idle_ms(void);
 void obd2_handler_reset_stats(void);
 
 // Test and simulation functions
@@ -27,7 +63,6 @@ void obd2_handler_simulate_request(uint8_t service, uint8_t pid);
 
 // Vehicle simulation functions (from vehicle_data.c)
 void obd2_init_vehicle_simulation(void);
-void obd2_update_vehicle_simulation(void);
 void obd2_set_engine_state(bool running);
 bool obd2_get_engine_state(void);
 uint32_t obd2_get_engine_runtime(void);
@@ -0,0 +1,391 @@
+#include "obd2_isotp.h"
+#include "obd2_timer.h"
+#include "pico/stdlib.h"
+#include <stdio.h>
+#include <string.h>
+
+// One transfer to one tester
+typedef struct {
+    obd2_isotp_state_t state;
+    obd2_isotp_address_t address;
+    uint8_t *buffer;            // Pool buffer holding the payload
+    uint16_t length;
+    uint16_t offset;            // Next payload byte to transmit
+    uint8_t sequence;           // Next consecutive frame sequence number
+    uint8_t block_size;         // Frames allowed before next FC (0 = unlimited)
+    uint8_t block_remaining;
+    uint8_t wait_frames;
+    uint32_t st_min_us;         // Separation time between consecutive frames
+    bool frame_due;             // Separation time over, next frame may go
+    obd2_timer_t timer;         // Flow Control timeout, or separation time
+    uint32_t order;             // Submission order, for transfers queued on one tester
+} isotp_session_t;
+
+// Session table
+static struct {
+    obd2_isotp_send_fn send;
+    uint8_t frame_size;         // Transport TX_DL: 8 classic, up to 64 FD
+    isotp_session_t sessions[OBD2_ISOTP_MAX_SESSIONS];
+    uint8_t active;             // Sessions not idle
+    uint8_t next_session;       // Round-robin start of the next process call
+    uint32_t next_order;
+    uint32_t small_free;        // Free pool buffers, one bit each
+    uint32_t large_free;
+    uint32_t transfers;
+    uint32_t aborts;
+    uint32_t pool_failures;     // Responses dropped for lack of a session or buffer
+} isotp_state;
+
+// Buffer pool
+static uint8_t small_buffers[OBD2_ISOTP_SMALL_BUFFERS][OBD2_ISOTP_SMALL_BUFFER];
+static uint8_t large_buffers[OBD2_ISOTP_LARGE_BUFFERS][OBD2_ISOTP_MAX_PAYLOAD];
+
+void obd2_isotp_init(obd2_isotp_send_fn send, uint8_t frame_size)
+{
+    for (uint8_t i = 0; i < OBD2_ISOTP_MAX_SESSIONS; i++) {
+        obd2_timer_cancel(&isotp_state.sessions[i].timer);
+    }
+    memset(&isotp_state, 0, sizeof(isotp_state));
+    isotp_state.send = send;
+    isotp_state.frame_size = obd2_can_is_valid_frame_size(frame_size) ?
+                             frame_size : OBD2_CAN_CLASSIC_FRAME_SIZE;
+    isotp_state.small_free = (1u << OBD2_ISOTP_SMALL_BUFFERS) - 1;
+    isotp_state.large_free = (1u << OBD2_ISOTP_LARGE_BUFFERS) - 1;
+}
+
+// Smallest free buffer that holds length bytes, or NULL
+static uint8_t* pool_alloc(uint16_t length)
+{
+    uint8_t index;
+
+    if (length <= OBD2_ISOTP_SMALL_BUFFER && isotp_state.small_free != 0) {
+        index = __builtin_ctz(isotp_state.small_free);
+        isotp_state.small_free &= ~(1u << index);
+        return small_buffers[index];
+    }
+    if (isotp_state.large_free != 0) {
+        index = __builtin_ctz(isotp_state.large_free);
+        isotp_state.large_free &= ~(1u << index);
+        return large_buffers[index];
+    }
+    return NULL;
+}
+
+static void pool_free(uint8_t *buffer)
+{
+    uintptr_t offset = (uintptr_t)buffer - (uintptr_t)small_buffers;
+
+    if (offset < sizeof(small_buffers)) {
+        isotp_state.small_free |= 1u << (offset / OBD2_ISOTP_SMALL_BUFFER);
+    } else {
+        isotp_state.large_free |= 1u << ((buffer - &large_buffers[0][0]) / OBD2_ISOTP_MAX_PAYLOAD);
+    }
+}
+
+static bool same_tester(const obd2_isotp_address_t *a, const obd2_isotp_address_t *b)
+{
+    return a->channel == b->channel && a->tester_id == b->tester_id;
+}
+
+static bool send_frame(const obd2_isotp_address_t *address, uint8_t *frame, uint8_t used)
+{
+    // Pad to a full classic CAN frame as required by ISO 15765-4; longer FD
+    // frames only up to the next length the DLC can encode
+    uint8_t length = obd2_can_frame_length(used < OBD2_CAN_CLASSIC_FRAME_SIZE ?
+                                           OBD2_CAN_CLASSIC_FRAME_SIZE : used);
+
+    for (uint8_t i = used; i < length; i++) {
+        frame[i] = OBD2_ISOTP_PADDING;
+    }
+    return isotp_state.send != NULL && isotp_state.send(address, frame, length);
+}
+
+static void start_transfer(isotp_session_t *session);
+static void abort_transfer(isotp_session_t *session, const char *reason);
+
+static void session_timer(void *context)
+{
+    isotp_session_t *session = context;
+
+    if (session->state == OBD2_ISOTP_WAIT_FLOW_CONTROL) {
+        abort_transfer(session, "flow control timeout");
+    } else if (session->state == OBD2_ISOTP_SENDING) {
+        session->frame_due = true;
+    }
+}
+
+static void wait_flow_control(isotp_session_t *session)
+{
+    session->state = OBD2_ISOTP_WAIT_FLOW_CONTROL;
+    obd2_timer_start(&session->timer, OBD2_ISOTP_TIMEOUT_BS_MS * 1000, session_timer, session);
+}
+
+// Release the session and start the tester's next queued transfer, if any
+static void end_transfer(isotp_session_t *session)
+{
+    isotp_session_t *next = NULL;
+
+    obd2_timer_cancel(&session->timer);
+    pool_free(session->buffer);
+    session->state = OBD2_ISOTP_IDLE;
+    isotp_state.active--;
+
+    for (uint8_t i = 0; i < OBD2_ISOTP_MAX_SESSIONS; i++) {
+        isotp_session_t *candidate = &isotp_state.sessions[i];
+        if (candidate->state == OBD2_ISOTP_QUEUED && same_tester(&candidate->address, &session->address) &&
+            (next == NULL || (int32_t)(candidate->order - next->order) < 0)) {
+            next = candidate;
+        }
+    }
+    if (next != NULL) {
+        start_transfer(next);
+    }
+}
+
+static void abort_transfer(isotp_session_t *session, const char *reason)
+{
+    isotp_state.aborts++;
+    printf("ISO-TP transfer to %03lX aborted: %s\r\n", session->address.tester_id, reason);
+    end_transfer(session);
+}
+
+// First frame: 12-bit length followed by as much payload as fits (the
+// 32-bit length escape is never needed below OBD2_ISOTP_MAX_PAYLOAD)
+static void start_transfer(isotp_session_t *session)
+{
+    uint8_t frame[OBD2_CAN_MAX_FRAME_SIZE];
+    uint8_t frame_size = isotp_state.frame_size;
+
+    frame[0] = OBD2_ISOTP_PCI_FIRST | ((session->length >> 8) & 0x0F);
+    frame[1] = session->length & 0xFF;
+    memcpy(&frame[2], session->buffer, frame_size - 2);
+
+    if (!send_frame(&session->address, frame, frame_size)) {
+        abort_transfer(session, "transmit failed");
+        return;
+    }
+
+    session->offset = frame_size - 2;
+    session->sequence = 1;
+    session->wait_frames = 0;
+    wait_flow_control(session);
+    isotp_state.transfers++;
+}
+
+// Convert an STmin byte to microseconds
+static uint32_t decode_st_min(uint8_t st_min)
+{
+    if (st_min <= 0x7F) {
+        return (uint32_t)st_min * 1000;
+    }
+    if (st_min >= 0xF1 && st_min <= 0xF9) {
+        return (uint32_t)(st_min - 0xF0) * 100;
+    }
+    return 127000;  // Reserved values: use the largest separation time
+}
+
+bool obd2_isotp_send(const obd2_isotp_address_t *address, const uint8_t *payload, uint16_t length)
+{
+    uint8_t frame[OBD2_CAN_MAX_FRAME_SIZE];
+    uint8_t frame_size = isotp_state.frame_size;
+
+    if (address == NULL || payload == NULL || length == 0) {
+        return false;
+    }
+
+    // Short responses fit in a single frame
+    if (length <= OBD2_CAN_CLASSIC_FRAME_SIZE - 1) {
+        frame[0] = OBD2_ISOTP_PCI_SINGLE | length;
+        memcpy(&frame[1], payload, length);
+        return send_frame(address, frame, length + 1);
+    }
+
+    // CAN FD: escaped Single Frame with the length in the second byte
+    if (length <= frame_size - 2) {
+        frame[0] = OBD2_ISOTP_PCI_SINGLE;
+        frame[1] = length;
+        memcpy(&frame[2], payload, length);
+        return send_frame(address, frame, length + 2);
+    }
+
+    if (length > OBD2_ISOTP_MAX_PAYLOAD) {
+        printf("ISO-TP payload too long (%u bytes)\r\n", length);
+        return false;
+    }
+
+    // A free session, and whether this tester already has a transfer running
+    isotp_session_t *session = NULL;
+    bool tester_busy = false;
+    for (uint8_t i = 0; i < OBD2_ISOTP_MAX_SESSIONS; i++) {
+        isotp_session_t *candidate = &isotp_state.sessions[i];
+        if (candidate->state == OBD2_ISOTP_IDLE) {
+            if (session == NULL) {
+                session = candidate;
+            }
+        } else if (same_tester(&candidate->address, address)) {
+            tester_busy = true;
+        }
+    }
+
+    uint8_t *buffer = (session != NULL) ? pool_alloc(length) : NULL;
+    if (buffer == NULL) {
+        isotp_state.pool_failures++;
+        printf("ISO-TP: no free session for a %u-byte response\r\n", length);
+        return false;
+    }
+
+    memcpy(buffer, payload, length);
+    session->address = *address;
+    session->buffer = buffer;
+    session->length = length;
+    session->order = isotp_state.next_order++;
+    session->state = OBD2_ISOTP_QUEUED;
+    isotp_state.active++;
+
+    // The tester's receiver takes one message at a time: queue behind it
+    if (!tester_busy) {
+        start_transfer(session);
+        return session->state != OBD2_ISOTP_IDLE;
+    }
+    return true;
+}
+
+bool obd2_isotp_handle_frame(const obd2_isotp_address_t *address, const uint8_t *can_data,
+                             uint8_t can_length)
+{
+    isotp_session_t *session = NULL;
+
+    if (address == NULL || can_data == NULL || can_length < 1 ||
+        (can_data[0] & 0xF0) != OBD2_ISOTP_PCI_FLOW_CONTROL) {
+        return false;
+    }
+
+    for (uint8_t i = 0; i < OBD2_ISOTP_MAX_SESSIONS && isotp_state.active > 0; i++) {
+        if (isotp_state.sessions[i].state == OBD2_ISOTP_WAIT_FLOW_CONTROL &&
+            same_tester(&isotp_state.sessions[i].address, address)) {
+            session = &isotp_state.sessions[i];
+            break;
+        }
+    }
+    if (session == NULL) {
+        return true;  // Unexpected Flow Control, ignore it
+    }
+
+    switch (can_data[0] & 0x0F) {
+        case OBD2_ISOTP_FS_CONTINUE:
+            session->block_size = (can_length > 1) ? can_data[1] : 0;
+            session->block_remaining = session->block_size;
+            session->st_min_us = decode_st_min((can_length > 2) ? can_data[2] : 0);
+            obd2_timer_cancel(&session->timer);
+            session->frame_due = true;
+            session->state = OBD2_ISOTP_SENDING;
+            break;
+
+        case OBD2_ISOTP_FS_WAIT:
+            if (++session->wait_frames > OBD2_ISOTP_MAX_WAIT_FRAMES) {
+                abort_transfer(session, "too many FC.WAIT frames");
+            } else {
+                wait_flow_control(session);
+            }
+            break;
+
+        case OBD2_ISOTP_FS_OVERFLOW:
+        default:
+            abort_transfer(session, "receiver overflow");
+            break;
+    }
+
+    return true;
+}
+
+static void process_session(isotp_session_t *session)
+{
+    uint8_t frame[OBD2_CAN_MAX_FRAME_SIZE];
+    uint8_t capacity = isotp_state.frame_size - 1;
+
+    if (session->state != OBD2_ISOTP_SENDING || !session->frame_due) {
+        return;
+    }
+
+    for (int burst = 0; burst < OBD2_ISOTP_BURST_LIMIT; burst++) {
+        uint16_t remaining = session->length - session->offset;
+        uint8_t chunk = (remaining > capacity) ? capacity : remaining;
+
+        frame[0] = OBD2_ISOTP_PCI_CONSECUTIVE | (session->sequence & 0x0F);
+        memcpy(&frame[1], &session->buffer[session->offset], chunk);
+
+        if (!send_frame(&session->address, frame, chunk + 1)) {
+            abort_transfer(session, "transmit failed");
+            return;
+        }
+
+        session->offset += chunk;
+        session->sequence = (session->sequence + 1) & 0x0F;
+
+        if (session->offset >= session->length) {
+            end_transfer(session);
+            return;
+        }
+
+        // Block exhausted: wait for the next Flow Control frame
+        if (session->block_size != 0 && --session->block_remaining == 0) {
+            session->frame_due = false;
+            wait_flow_control(session);
+            return;
+        }
+
+        if (session->st_min_us != 0) {
+            session->frame_due = false;
+            obd2_timer_start(&session->timer, session->st_min_us, session_timer, session);
+            return;
+        }
+    }
+
+    // Burst limit reached: continue with the next tick so other work runs
+    session->frame_due = false;
+    obd2_timer_start(&session->timer, 0, session_timer, session);
+}
+
+void obd2_isotp_process(void)
+{
+    if (isotp_state.active == 0) {
+        return;
+    }
+
+    // Sessions take turns at going first so their frames interleave
+    uint8_t first = isotp_state.next_session;
+    for (uint8_t n = 0; n < OBD2_ISOTP_MAX_SESSIONS; n++) {
+        process_session(&isotp_state.sessions[(first + n) % OBD2_ISOTP_MAX_SESSIONS]);
+    }
+    isotp_state.next_session = (first + 1) % OBD2_ISOTP_MAX_SESSIONS;
+}
+
+bool obd2_isotp_is_busy(void)
+{
+    return isotp_state.active > 0;
+}
+
+uint8_t obd2_isotp_get_active_count(void)
+{
+    return isotp_state.active;
+}
+
+uint8_t obd2_isotp_get_frame_size(void)
+{
+    return isotp_state.frame_size;
+}
+
+uint32_t obd2_isotp_get_transfer_count(void)
+{
+    return isotp_state.transfers;
+}
+
+uint32_t obd2_isotp_get_abort_count(void)
+{
+    return isotp_state.aborts;
+}
+
+uint32_t obd2_isotp_get_pool_failures(void)
+{
+    return isotp_state.pool_failures;
+}
@@ -0,0 +1,87 @@
+#ifndef __OBD2_ISOTP_H__
+#define __OBD2_ISOTP_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "obd2_can.h"
+
+// ISO 15765-2 (ISO-TP) transmit side for responses longer than a single frame
+//
+// A response is sent as a First Frame, after which the tester's Flow Control
+// frame paces the Consecutive Frames (block size and STmin). Transfers are
+// advanced from obd2_isotp_process() so the main loop is never blocked; the
+// Flow Control timeout and the separation time are timers (obd2_timer.h).
+//
+// The frame size comes from the transport: with CAN FD (frame size above 8),
+// payloads up to frame size - 2 go out as one escaped Single Frame
+// [00][length][data...] and longer ones use correspondingly larger First and
+// Consecutive Frames, each padded to the next length the DLC can encode.
+//
+// Every tester connection (interface plus CAN IDs) has its own session, so
+// a gateway and a logger can pull long responses at the same time; their
+// Consecutive Frames interleave. Payloads are copied into buffers from a
+// fixed pool with a small and a large size class. A response to a tester
+// whose previous transfer is still running waits behind it instead of
+// replacing it.
+
+#define OBD2_ISOTP_MAX_PAYLOAD      1024    // Largest response we will segment
+#define OBD2_ISOTP_PADDING          0x00    // Filler for unused frame bytes
+#define OBD2_ISOTP_TIMEOUT_BS_MS    1000    // N_Bs: wait for Flow Control
+#define OBD2_ISOTP_MAX_WAIT_FRAMES  10      // FC.WAIT frames accepted in a row
+#define OBD2_ISOTP_BURST_LIMIT      16      // Consecutive frames per session and process call
+
+// Sessions (running or queued transfers) and the buffer pool behind them
+#define OBD2_ISOTP_MAX_SESSIONS     8
+#define OBD2_ISOTP_SMALL_BUFFER     128     // VIN, calibration IDs, DTC lists
+#define OBD2_ISOTP_SMALL_BUFFERS    6
+#define OBD2_ISOTP_LARGE_BUFFERS    2       // OBD2_ISOTP_MAX_PAYLOAD bytes each
+
+// PCI types (upper nibble of first byte)
+#define OBD2_ISOTP_PCI_SINGLE       0x00
+#define OBD2_ISOTP_PCI_FIRST        0x10
+#define OBD2_ISOTP_PCI_CONSECUTIVE  0x20
+#define OBD2_ISOTP_PCI_FLOW_CONTROL 0x30
+
+// Flow status values
+#define OBD2_ISOTP_FS_CONTINUE      0x00
+#define OBD2_ISOTP_FS_WAIT          0x01
+#define OBD2_ISOTP_FS_OVERFLOW      0x02
+
+typedef enum {
+    OBD2_ISOTP_IDLE = 0,
+    OBD2_ISOTP_QUEUED,              // Waiting for the tester's previous transfer
+    OBD2_ISOTP_WAIT_FLOW_CONTROL,
+    OBD2_ISOTP_SENDING
+} obd2_isotp_state_t;
+
+// Connection a transfer runs on
+typedef struct {
+    uint8_t channel;            // Transport interface (0 when there is only one)
+    uint32_t tester_id;         // CAN ID the tester's Flow Control arrives with
+    uint32_t ecu_id;            // CAN ID our frames are sent with
+} obd2_isotp_address_t;
+
+// Frame transmit callback (connection, CAN data and length)
+typedef bool (*obd2_isotp_send_fn)(const obd2_isotp_address_t *address, uint8_t *can_data,
+                                   uint8_t can_length);
+
+// Initialization (transport frame size, see obd2_can.h) and processing
+void obd2_isotp_init(obd2_isotp_send_fn send, uint8_t frame_size);
+void obd2_isotp_process(void);
+
+// Transmit a complete response payload (single or multi-frame) to a tester
+bool obd2_isotp_send(const obd2_isotp_address_t *address, const uint8_t *payload, uint16_t length);
+
+// Incoming Flow Control frames from a tester; returns true if the frame was consumed
+bool obd2_isotp_handle_frame(const obd2_isotp_address_t *address, const uint8_t *can_data,
+                             uint8_t can_length);
+
+// Status and statistics
+bool obd2_isotp_is_busy(void);
+uint8_t obd2_isotp_get_active_count(void);
+uint8_t obd2_isotp_get_frame_size(void);
+uint32_t obd2_isotp_get_transfer_count(void);
+uint32_t obd2_isotp_get_abort_count(void);
+uint32_t obd2_isotp_get_pool_failures(void);
+
+#endif // __OBD2_ISOTP_H__
@@ -0,0 +1,59 @@
+#include "obd2_memo.h"
+#include <string.h>
+
+static obd2_memo_entry_t* memo_slot(obd2_memo_t *memo, uint32_t ecu, uint8_t service, uint8_t pid)
+{
+    // Consecutive PIDs of one ECU land in consecutive slots
+    uint32_t hash = pid + service * 7u + ecu * 13u;
+    return &memo->slots[hash & (OBD2_MEMO_SLOTS - 1)];
+}
+
+void obd2_memo_init(obd2_memo_t *memo)
+{
+    memset(memo, 0, sizeof(*memo));
+}
+
+uint8_t obd2_memo_lookup(obd2_memo_t *memo, uint32_t ecu, uint8_t service, uint8_t pid,
+                         uint32_t tick, uint8_t *data)
+{
+    const obd2_memo_entry_t *entry = memo_slot(memo, ecu, service, pid);
+
+    if (entry->length == 0 || entry->tick != tick || entry->ecu != ecu ||
+        entry->service != service || entry->pid != pid) {
+        memo->misses++;
+        return 0;
+    }
+
+    memcpy(data, entry->data, entry->length);
+    memo->hits++;
+    return entry->length;
+}
+
+void obd2_memo_store(obd2_memo_t *memo, uint32_t ecu, uint8_t service, uint8_t pid,
+                     uint32_t tick, const uint8_t *data, uint8_t length)
+{
+    if (length == 0 || length > OBD2_MEMO_DATA_MAX) {
+        return;
+    }
+
+    obd2_memo_entry_t *entry = memo_slot(memo, ecu, service, pid);
+    entry->ecu = ecu;
+    entry->tick = tick;
+    entry->service = service;
+    entry->pid = pid;
+    entry->length = length;
+    memcpy(entry->data, data, length);
+}
+
+void obd2_memo_clear(obd2_memo_t *memo)
+{
+    for (int i = 0; i < OBD2_MEMO_SLOTS; i++) {
+        memo->slots[i].length = 0;
+    }
+}
+
+void obd2_memo_reset_stats(obd2_memo_t *memo)
+{
+    memo->hits = 0;
+    memo->misses = 0;
+}
@@ -0,0 +1,49 @@
+#ifndef __OBD2_MEMO_H__
+#define __OBD2_MEMO_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Per-tick response memo
+//
+// Simulated values only change when the vehicle model steps (every 50 ms),
+// so identical requests within one tick - several testers, or one tester
+// polling faster than the simulation - can reuse the data bytes encoded for
+// the first. Entries are keyed by (ECU, service, PID) and stamped with the
+// tick they were encoded in; an entry from an earlier tick is a miss. The
+// table is direct-mapped, so a lookup is one slot compare and a colliding
+// key simply replaces the older entry.
+
+#define OBD2_MEMO_SLOTS         32      // Power of two
+#define OBD2_MEMO_DATA_MAX      4       // Service 01 PIDs carry at most 4 data bytes
+
+typedef struct {
+    uint32_t ecu;
+    uint32_t tick;
+    uint8_t service;
+    uint8_t pid;
+    uint8_t length;                     // 0 = empty slot
+    uint8_t data[OBD2_MEMO_DATA_MAX];
+} obd2_memo_entry_t;
+
+typedef struct {
+    obd2_memo_entry_t slots[OBD2_MEMO_SLOTS];
+    uint32_t hits;
+    uint32_t misses;
+} obd2_memo_t;
+
+void obd2_memo_init(obd2_memo_t *memo);
+
+// Copy the data encoded for this key in this tick; returns its length, 0 on a miss
+uint8_t obd2_memo_lookup(obd2_memo_t *memo, uint32_t ecu, uint8_t service, uint8_t pid,
+                         uint32_t tick, uint8_t *data);
+
+// Remember freshly encoded data (longer than OBD2_MEMO_DATA_MAX is not kept)
+void obd2_memo_store(obd2_memo_t *memo, uint32_t ecu, uint8_t service, uint8_t pid,
+                     uint32_t tick, const uint8_t *data, uint8_t length);
+
+// Drop every entry, for state changes within a tick (e.g. Service 04)
+void obd2_memo_clear(obd2_memo_t *memo);
+void obd2_memo_reset_stats(obd2_memo_t *memo);
+
+#endif // __OBD2_MEMO_H__
@@ -0,0 +1,345 @@
+#include "obd2_monitor.h"
+#include "obd2_protocol.h"
+#include "obd2_dtc.h"
+#include "obd2_vehinfo.h"
+#include <stdio.h>
+#include <string.h>
+
+#define MID_RANGES              8       // Supported-MID bitmaps at 00, 20, ... E0
+#define O2_THRESHOLD_MV         450     // Rich/lean switch point upstream
+#define O2_DOWNSTREAM_MV        420     // Switch point downstream
+#define EGR_AVERAGE_SHIFT       5       // Running average weight 1/32
+#define MISFIRE_INTERVAL        10      // Ticks between misfires of a faulty cylinder
+
+// Running aggregates, one per reported test value
+enum {
+    VAL_O2S1_MIN = 0,
+    VAL_O2S1_MAX,
+    VAL_O2S2_MIN,
+    VAL_O2S2_MAX,
+    VAL_CATALYST_RATIO,
+    VAL_EGR_MAP,
+    VAL_MISFIRE_EWMA_ALL,
+    VAL_MISFIRE_CYCLE_ALL,
+    VAL_MISFIRE_EWMA_CYL1,
+    VAL_MISFIRE_CYCLE_CYL1 = VAL_MISFIRE_EWMA_CYL1 + OBD2_MONITOR_CYLINDERS,
+    VAL_COUNT = VAL_MISFIRE_CYCLE_CYL1 + OBD2_MONITOR_CYLINDERS
+};
+
+typedef struct {
+    uint8_t mid;
+    uint8_t tid;
+    uint8_t uasid;
+    uint8_t value;          // Index into the aggregate table
+    uint16_t min_limit;
+    uint16_t max_limit;
+} monitor_test_t;
+
+// Test table, grouped by MID
+static const monitor_test_t monitor_tests[] = {
+    // O2 sensors: voltage swing over the test cycle (0.122 mV units)
+    { OBD2_MID_O2_B1S1, OBD2_TID_O2_MIN_VOLTAGE, OBD2_UASID_VOLTAGE, VAL_O2S1_MIN, 0x0000, 3279 },     // <= 0.40 V
+    { OBD2_MID_O2_B1S1, OBD2_TID_O2_MAX_VOLTAGE, OBD2_UASID_VOLTAGE, VAL_O2S1_MAX, 4508, 0xFFFF },     // >= 0.55 V
+    { OBD2_MID_O2_B1S2, OBD2_TID_O2_MIN_VOLTAGE, OBD2_UASID_VOLTAGE, VAL_O2S2_MIN, 0x0000, 3689 },     // <= 0.45 V
+    { OBD2_MID_O2_B1S2, OBD2_TID_O2_MAX_VOLTAGE, OBD2_UASID_VOLTAGE, VAL_O2S2_MAX, 3279, 0xFFFF },     // >= 0.40 V
+
+    // Catalyst: downstream sensor should switch far less often than upstream
+    { OBD2_MID_CATALYST_B1, OBD2_TID_CATALYST_SWITCH_RATIO, OBD2_UASID_RAW_MILLI, VAL_CATALYST_RATIO, 0, 750 },
+
+    // EGR: manifold pressure under part load (0.01 kPa units)
+    { OBD2_MID_EGR_B1, OBD2_TID_EGR_PART_LOAD_MAP, OBD2_UASID_PRESSURE, VAL_EGR_MAP, 3000, 9000 },
+
+    // Misfire counts (J1979 reports 0000-FFFF limits for these TIDs)
+    { OBD2_MID_MISFIRE_GENERAL, OBD2_TID_MISFIRE_EWMA, OBD2_UASID_COUNTS, VAL_MISFIRE_EWMA_ALL, 0x0000, 0xFFFF },
+    { OBD2_MID_MISFIRE_GENERAL, OBD2_TID_MISFIRE_CYCLE, OBD2_UASID_COUNTS, VAL_MISFIRE_CYCLE_ALL, 0x0000, 0xFFFF },
+    { OBD2_MID_MISFIRE_CYL1 + 0, OBD2_TID_MISFIRE_EWMA, OBD2_UASID_COUNTS, VAL_MISFIRE_EWMA_CYL1 + 0, 0x0000, 0xFFFF },
+    { OBD2_MID_MISFIRE_CYL1 + 0, OBD2_TID_MISFIRE_CYCLE, OBD2_UASID_COUNTS, VAL_MISFIRE_CYCLE_CYL1 + 0, 0x0000, 0xFFFF },
+    { OBD2_MID_MISFIRE_CYL1 + 1, OBD2_TID_MISFIRE_EWMA, OBD2_UASID_COUNTS, VAL_MISFIRE_EWMA_CYL1 + 1, 0x0000, 0xFFFF },
+    { OBD2_MID_MISFIRE_CYL1 + 1, OBD2_TID_MISFIRE_CYCLE, OBD2_UASID_COUNTS, VAL_MISFIRE_CYCLE_CYL1 + 1, 0x0000, 0xFFFF },
+    { OBD2_MID_MISFIRE_CYL1 + 2, OBD2_TID_MISFIRE_EWMA, OBD2_UASID_COUNTS, VAL_MISFIRE_EWMA_CYL1 + 2, 0x0000, 0xFFFF },
+    { OBD2_MID_MISFIRE_CYL1 + 2, OBD2_TID_MISFIRE_CYCLE, OBD2_UASID_COUNTS, VAL_MISFIRE_CYCLE_CYL1 + 2, 0x0000, 0xFFFF },
+    { OBD2_MID_MISFIRE_CYL1 + 3, OBD2_TID_MISFIRE_EWMA, OBD2_UASID_COUNTS, VAL_MISFIRE_EWMA_CYL1 + 3, 0x0000, 0xFFFF },
+    { OBD2_MID_MISFIRE_CYL1 + 3, OBD2_TID_MISFIRE_CYCLE, OBD2_UASID_COUNTS, VAL_MISFIRE_CYCLE_CYL1 + 3, 0x0000, 0xFFFF },
+};
+
+#define MONITOR_TEST_COUNT  (sizeof(monitor_tests) / sizeof(monitor_tests[0]))
+#define VALUE_BIT(value)    (1u << (value))
+#define MISFIRE_VALUES      (~0u << VAL_MISFIRE_EWMA_ALL)
+
+_Static_assert(VAL_COUNT <= 32, "Completion flags are a 32-bit mask");
+
+// Monitor state
+static struct {
+    uint16_t values[VAL_COUNT];
+    uint32_t completed;             // Bit per value: test completed this driving cycle
+    uint32_t completed_since_clear; // In earlier driving cycles since DTCs were cleared
+    uint32_t completed_at_clear;    // Completed this cycle before the clear, not counted
+    uint32_t mid_bitmaps[MID_RANGES];
+    uint8_t first_test[256];        // Table index + 1 of a MID's first test, 0 = none
+    uint8_t test_count[256];
+
+    // Aggregate inputs
+    bool o2_sampled;                // Min/max valid for this test cycle
+    bool upstream_rich;
+    bool downstream_rich;
+    uint16_t upstream_switches;
+    uint16_t downstream_switches;
+    uint32_t egr_map_average;       // Fixed point, << EGR_AVERAGE_SHIFT
+    bool egr_sampled;
+    uint32_t ticks;
+    bool cycle_started;             // Ticked since the last driving cycle began
+
+    uint8_t response[2 + 9 * OBD2_MONITOR_MAX_TESTS_PER_MID];
+} monitor_state;
+
+static inline uint16_t mv_to_uasid_voltage(uint16_t mv)
+{
+    uint32_t value = ((uint32_t)mv * 1000) / 122;
+    return value > 0xFFFF ? 0xFFFF : value;
+}
+
+static inline void saturating_increment(uint16_t *value)
+{
+    if (*value < 0xFFFF) {
+        (*value)++;
+    }
+}
+
+void obd2_monitor_init(void)
+{
+    memset(&monitor_state, 0, sizeof(monitor_state));
+
+    // Index tests by MID and build the supported-MID bitmaps from the table
+    for (uint8_t i = 0; i < MONITOR_TEST_COUNT; i++) {
+        uint8_t mid = monitor_tests[i].mid;
+
+        if (monitor_state.first_test[mid] == 0) {
+            monitor_state.first_test[mid] = i + 1;
+        }
+        monitor_state.test_count[mid]++;
+        monitor_state.mid_bitmaps[(mid - 1) / 32] |= 1u << (31 - ((mid - 1) % 32));
+    }
+
+    // Last bit of each range announces the next range
+    for (int range = MID_RANGES - 2; range >= 0; range--) {
+        if (monitor_state.mid_bitmaps[range + 1] != 0) {
+            monitor_state.mid_bitmaps[range] |= 1u;
+        }
+    }
+
+    obd2_monitor_new_driving_cycle();
+    printf("Monitor results initialized (%u tests)\r\n", (unsigned)MONITOR_TEST_COUNT);
+}
+
+void obd2_monitor_new_driving_cycle(void)
+{
+    // Report which monitors completed in the cycle that just ended
+    if (monitor_state.cycle_started) {
+        obd2_vehinfo_record_driving_cycle(monitor_state.completed & VALUE_BIT(VAL_CATALYST_RATIO),
+                                          monitor_state.completed & VALUE_BIT(VAL_O2S1_MAX),
+                                          monitor_state.completed & VALUE_BIT(VAL_EGR_MAP));
+        monitor_state.cycle_started = false;
+    }
+
+    // Fold last cycle's misfire counts into the 10-cycle EWMA (weight 0.1)
+    for (uint8_t c = 0; c <= OBD2_MONITOR_CYLINDERS; c++) {
+        uint8_t ewma = (c == 0) ? VAL_MISFIRE_EWMA_ALL : VAL_MISFIRE_EWMA_CYL1 + c - 1;
+        uint8_t cycle = (c == 0) ? VAL_MISFIRE_CYCLE_ALL : VAL_MISFIRE_CYCLE_CYL1 + c - 1;
+
+        monitor_state.values[ewma] = (monitor_state.values[ewma] * 9 + monitor_state.values[cycle] + 5) / 10;
+        monitor_state.values[cycle] = 0;
+    }
+
+    // O2 min/max and switch counts restart with each test cycle
+    monitor_state.o2_sampled = false;
+    monitor_state.upstream_switches = 0;
+    monitor_state.downstream_switches = 0;
+
+    // Misfire counts are always reported, other tests must complete again
+    monitor_state.completed_since_clear |= monitor_state.completed & ~monitor_state.completed_at_clear;
+    monitor_state.completed_at_clear = 0;
+    monitor_state.completed = MISFIRE_VALUES;
+}
+
+void obd2_monitor_clear_readiness(void)
+{
+    // Monitors have to run again after a clear, including ones already done this cycle
+    monitor_state.completed_since_clear = 0;
+    monitor_state.completed_at_clear = monitor_state.completed;
+}
+
+void obd2_monitor_get_readiness(uint8_t *supported, uint8_t *incomplete)
+{
+    uint32_t done = monitor_state.completed_since_clear |
+                    (monitor_state.completed & ~monitor_state.completed_at_clear);
+
+    *supported = OBD2_READINESS_CATALYST | OBD2_READINESS_O2_SENSOR | OBD2_READINESS_EGR;
+    *incomplete = ((done & VALUE_BIT(VAL_CATALYST_RATIO)) ? 0 : OBD2_READINESS_CATALYST) |
+                  ((done & VALUE_BIT(VAL_O2S1_MAX)) ? 0 : OBD2_READINESS_O2_SENSOR) |
+                  ((done & VALUE_BIT(VAL_EGR_MAP)) ? 0 : OBD2_READINESS_EGR);
+}
+
+static void update_o2_monitors(const obd2_vehicle_snapshot_t *snapshot)
+{
+    uint16_t s1 = mv_to_uasid_voltage(snapshot->o2_sensor_b1s1);
+    uint16_t s2 = mv_to_uasid_voltage(snapshot->o2_sensor_b1s2);
+    bool upstream_rich = snapshot->o2_sensor_b1s1 > O2_THRESHOLD_MV;
+    bool downstream_rich = snapshot->o2_sensor_b1s2 > O2_DOWNSTREAM_MV;
+
+    if (!monitor_state.o2_sampled) {
+        monitor_state.values[VAL_O2S1_MIN] = monitor_state.values[VAL_O2S1_MAX] = s1;
+        monitor_state.values[VAL_O2S2_MIN] = monitor_state.values[VAL_O2S2_MAX] = s2;
+        monitor_state.upstream_rich = upstream_rich;
+        monitor_state.downstream_rich = downstream_rich;
+        monitor_state.o2_sampled = true;
+        monitor_state.completed |= VALUE_BIT(VAL_O2S1_MIN) | VALUE_BIT(VAL_O2S1_MAX) |
+                                   VALUE_BIT(VAL_O2S2_MIN) | VALUE_BIT(VAL_O2S2_MAX);
+        return;
+    }
+
+    if (s1 < monitor_state.values[VAL_O2S1_MIN]) monitor_state.values[VAL_O2S1_MIN] = s1;
+    if (s1 > monitor_state.values[VAL_O2S1_MAX]) monitor_state.values[VAL_O2S1_MAX] = s1;
+    if (s2 < monitor_state.values[VAL_O2S2_MIN]) monitor_state.values[VAL_O2S2_MIN] = s2;
+    if (s2 > monitor_state.values[VAL_O2S2_MAX]) monitor_state.values[VAL_O2S2_MAX] = s2;
+
+    // Catalyst: ratio of downstream to upstream rich/lean switches
+    if (upstream_rich != monitor_state.upstream_rich) {
+        monitor_state.upstream_rich = upstream_rich;
+        saturating_increment(&monitor_state.upstream_switches);
+    }
+    if (downstream_rich != monitor_state.downstream_rich) {
+        monitor_state.downstream_rich = downstream_rich;
+        saturating_increment(&monitor_state.downstream_switches);
+    }
+    if (monitor_state.upstream_switches != 0) {
+        uint32_t ratio = ((uint32_t)monitor_state.downstream_switches * 1000) / monitor_state.upstream_switches;
+        monitor_state.values[VAL_CATALYST_RATIO] = ratio > 0xFFFF ? 0xFFFF : ratio;
+        monitor_state.completed |= VALUE_BIT(VAL_CATALYST_RATIO);
+    }
+}
+
+static void update_egr_monitor(const obd2_vehicle_snapshot_t *snapshot)
+{
+    // Only part-load operation (roughly 30-70% load) is representative
+    if (snapshot->engine_load < 77 || snapshot->engine_load > 178) {
+        return;
+    }
+
+    uint32_t sample = (uint32_t)snapshot->manifold_pressure << EGR_AVERAGE_SHIFT;
+    if (!monitor_state.egr_sampled) {
+        monitor_state.egr_map_average = sample;
+        monitor_state.egr_sampled = true;
+    } else {
+        monitor_state.egr_map_average += (sample >> EGR_AVERAGE_SHIFT) - (monitor_state.egr_map_average >> EGR_AVERAGE_SHIFT);
+    }
+    monitor_state.values[VAL_EGR_MAP] = monitor_state.egr_map_average >> EGR_AVERAGE_SHIFT;
+    monitor_state.completed |= VALUE_BIT(VAL_EGR_MAP);
+}
+
+static void update_misfire_monitor(void)
+{
+    // Cylinders with a misfire DTC misfire regularly; P0300 spreads misfires
+    // across all cylinders
+    bool random_misfire = obd2_dtc_exists(DTC_P0300, DTC_TYPE_POWERTRAIN);
+
+    for (uint8_t c = 0; c < OBD2_MONITOR_CYLINDERS; c++) {
+        bool misfire = false;
+
+        if (monitor_state.ticks % MISFIRE_INTERVAL == 0 &&
+            obd2_dtc_exists(DTC_P0301 + c, DTC_TYPE_POWERTRAIN)) {
+            misfire = true;
+        }
+        if (random_misfire && monitor_state.ticks % (2 * MISFIRE_INTERVAL) == 0 &&
+            (monitor_state.ticks / (2 * MISFIRE_INTERVAL)) % OBD2_MONITOR_CYLINDERS == c) {
+            misfire = true;
+        }
+
+        if (misfire) {
+            saturating_increment(&monitor_state.values[VAL_MISFIRE_CYCLE_CYL1 + c]);
+            saturating_increment(&monitor_state.values[VAL_MISFIRE_CYCLE_ALL]);
+        }
+    }
+}
+
+void obd2_monitor_tick(void)
+{
+    obd2_vehicle_snapshot_t snapshot;
+
+    obd2_capture_vehicle_snapshot(&snapshot);
+    monitor_state.ticks++;
+    monitor_state.cycle_started = true;
+
+    update_o2_monitors(&snapshot);
+    update_egr_monitor(&snapshot);
+    update_misfire_monitor();
+}
+
+const uint8_t* obd2_monitor_get_response(uint8_t mid, uint16_t *length)
+{
+    uint8_t *out = monitor_state.response;
+    uint16_t pos = 0;
+
+    out[pos++] = OBD2_SERVICE_06 + OBD2_POSITIVE_RESPONSE_OFFSET;
+
+    // Supported-MID request: [46][MID][bitmap x4]
+    if ((mid & 0x1F) == 0) {
+        uint8_t range = mid / 32;
+        if (range > 0 && !(monitor_state.mid_bitmaps[range - 1] & 1u)) {
+            *length = 0;
+            return NULL;
+        }
+        out[pos++] = mid;
+        out[pos++] = (monitor_state.mid_bitmaps[range] >> 24) & 0xFF;
+        out[pos++] = (monitor_state.mid_bitmaps[range] >> 16) & 0xFF;
+        out[pos++] = (monitor_state.mid_bitmaps[range] >> 8) & 0xFF;
+        out[pos++] = monitor_state.mid_bitmaps[range] & 0xFF;
+        *length = pos;
+        return out;
+    }
+
+    if (monitor_state.first_test[mid] == 0) {
+        *length = 0;
+        return NULL;
+    }
+
+    // One record per test: [MID][TID][UASID][value][min][max], all zero
+    // until the test has completed in this driving cycle
+    const monitor_test_t *test = &monitor_tests[monitor_state.first_test[mid] - 1];
+    for (uint8_t i = 0; i < monitor_state.test_count[mid] && i < OBD2_MONITOR_MAX_TESTS_PER_MID; i++, test++) {
+        bool completed = monitor_state.completed & VALUE_BIT(test->value);
+        uint16_t value = completed ? monitor_state.values[test->value] : 0;
+        uint16_t min_limit = completed ? test->min_limit : 0;
+        uint16_t max_limit = completed ? test->max_limit : 0;
+
+        out[pos++] = test->mid;
+        out[pos++] = test->tid;
+        out[pos++] = test->uasid;
+        out[pos++] = value >> 8;
+        out[pos++] = value & 0xFF;
+        out[pos++] = min_limit >> 8;
+        out[pos++] = min_limit & 0xFF;
+        out[pos++] = max_limit >> 8;
+        out[pos++] = max_limit & 0xFF;
+    }
+
+    *length = pos;
+    return out;
+}
+
+void obd2_monitor_print_all(void)
+{
+    printf("\r\n=== Monitor Test Results (Service 06) ===\r\n");
+    for (uint8_t i = 0; i < MONITOR_TEST_COUNT; i++) {
+        const monitor_test_t *test = &monitor_tests[i];
+        uint16_t value = monitor_state.values[test->value];
+        bool pass = value >= test->min_limit && value <= test->max_limit;
+
+        if (!(monitor_state.completed & VALUE_BIT(test->value))) {
+            printf("MID %02X TID %02X: not completed\r\n", test->mid, test->tid);
+            continue;
+        }
+        printf("MID %02X TID %02X: %5u [%u..%u] %s\r\n", test->mid, test->tid,
+               value, test->min_limit, test->max_limit, pass ? "PASS" : "FAIL");
+    }
+    printf("=========================================\r\n\r\n");
+}
@@ -0,0 +1,64 @@
+#ifndef __OBD2_MONITOR_H__
+#define __OBD2_MONITOR_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// On-board monitor test results for Service 06
+//
+// Each tick folds the current simulation state into running aggregates
+// (sensor min/max, switch ratios, averages, misfire counts). A request only
+// formats the stored values: [46][MID][TID][UASID][value][min][max]...
+// Supported-MID bitmaps are generated from the test table at init.
+
+#define OBD2_MONITOR_CYLINDERS          4
+#define OBD2_MONITOR_MAX_TESTS_PER_MID  4
+
+// Monitor IDs (OBDMIDs)
+#define OBD2_MID_O2_B1S1                0x01    // Oxygen sensor monitor Bank 1 Sensor 1
+#define OBD2_MID_O2_B1S2                0x02    // Oxygen sensor monitor Bank 1 Sensor 2
+#define OBD2_MID_CATALYST_B1            0x21    // Catalyst monitor Bank 1
+#define OBD2_MID_EGR_B1                 0x31    // EGR monitor Bank 1
+#define OBD2_MID_MISFIRE_GENERAL        0xA1    // Misfire monitor general data
+#define OBD2_MID_MISFIRE_CYL1           0xA2    // Misfire cylinder 1 (A2-A5 for 1-4)
+
+// Test IDs
+#define OBD2_TID_O2_MIN_VOLTAGE         0x07    // Minimum sensor voltage for test cycle
+#define OBD2_TID_O2_MAX_VOLTAGE         0x08    // Maximum sensor voltage for test cycle
+#define OBD2_TID_MISFIRE_EWMA           0x0B    // EWMA misfire counts, last 10 driving cycles
+#define OBD2_TID_MISFIRE_CYCLE          0x0C    // Misfire counts, current driving cycle
+#define OBD2_TID_CATALYST_SWITCH_RATIO  0x80    // Downstream/upstream O2 switch ratio
+#define OBD2_TID_EGR_PART_LOAD_MAP      0x80    // Average MAP under part load
+
+// Unit and scaling IDs
+#define OBD2_UASID_RAW                  0x01    // Raw value, 1 per bit
+#define OBD2_UASID_VOLTAGE              0x0A    // 0.122 mV per bit
+#define OBD2_UASID_RAW_MILLI            0x04    // Raw value, 0.001 per bit
+#define OBD2_UASID_PRESSURE             0x17    // 0.01 kPa per bit
+#define OBD2_UASID_COUNTS               0x24    // Counts
+
+// Readiness bits of PID 01 bytes C (supported) and D (incomplete), spark ignition
+#define OBD2_READINESS_CATALYST         0x01
+#define OBD2_READINESS_O2_SENSOR        0x20
+#define OBD2_READINESS_EGR              0x80
+
+// Continuous monitors (misfire, fuel system, components) in PID 01 byte B:
+// supported and always complete
+#define OBD2_READINESS_CONTINUOUS       0x07
+
+// Initialization and per-tick update
+void obd2_monitor_init(void);
+void obd2_monitor_tick(void);
+void obd2_monitor_new_driving_cycle(void);
+
+// PID 01 readiness: monitors completed since DTCs were last cleared
+void obd2_monitor_clear_readiness(void);
+void obd2_monitor_get_readiness(uint8_t *supported, uint8_t *incomplete);
+
+// Complete Service 06 response for a MID (NULL if not supported)
+const uint8_t* obd2_monitor_get_response(uint8_t mid, uint16_t *length);
+
+// Debug output
+void obd2_monitor_print_all(void);
+
+#endif // __OBD2_MONITOR_H__
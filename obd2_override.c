@@ -0,0 +1,240 @@
+#include "obd2_override.h"
+#include <stdio.h>
+#include <string.h>
+
+// Active overrides are kept densely packed in slots[0..count) so the tick only
+// visits live entries; pid_index maps a PID to its slot + 1 for O(1) lookup
+// (0 means not overridden, so the zero-initialized table is valid).
+static struct {
+    obd2_override_t slots[OBD2_OVERRIDE_MAX_SLOTS];
+    uint8_t count;
+    uint8_t pid_index[256];
+} override_state;
+
+void obd2_override_init(void)
+{
+    memset(&override_state, 0, sizeof(override_state));
+}
+
+// Get the slot for a PID, allocating one if needed
+static obd2_override_t *acquire_slot(uint8_t pid)
+{
+    uint8_t index = override_state.pid_index[pid];
+
+    if (index == OBD2_OVERRIDE_NO_SLOT) {
+        if (override_state.count >= OBD2_OVERRIDE_MAX_SLOTS) {
+            printf("Override table full, cannot override PID 0x%02X\r\n", pid);
+            return NULL;
+        }
+        index = ++override_state.count;
+        override_state.pid_index[pid] = index;
+    }
+    index--;
+
+    obd2_override_t *slot = &override_state.slots[index];
+    memset(slot, 0, sizeof(obd2_override_t));
+    slot->pid = pid;
+    return slot;
+}
+
+bool obd2_override_set_fixed(uint8_t pid, uint16_t value)
+{
+    obd2_override_t *slot = acquire_slot(pid);
+    if (slot == NULL) {
+        return false;
+    }
+
+    slot->mode = OBD2_OVERRIDE_FIXED;
+    slot->value = value;
+    return true;
+}
+
+bool obd2_override_set_ramp(uint8_t pid, uint16_t from, uint16_t to, uint16_t ticks)
+{
+    obd2_override_t *slot = acquire_slot(pid);
+    if (slot == NULL) {
+        return false;
+    }
+
+    if (ticks == 0) {
+        ticks = 1;
+    }
+
+    slot->mode = OBD2_OVERRIDE_RAMP;
+    slot->value = from;
+    slot->target = to;
+    slot->position = (int32_t)from << 8;
+    slot->rate = (((int32_t)to - (int32_t)from) << 8) / ticks;
+    if (slot->rate == 0 && to != from) {
+        slot->rate = (to > from) ? 1 : -1;
+    }
+    return true;
+}
+
+bool obd2_override_set_noise(uint8_t pid, uint16_t center, uint16_t amplitude)
+{
+    obd2_override_t *slot = acquire_slot(pid);
+    if (slot == NULL) {
+        return false;
+    }
+
+    slot->mode = OBD2_OVERRIDE_NOISE;
+    slot->value = center;
+    slot->target = center;
+    slot->amplitude = amplitude;
+    slot->rng_state = 0x9E3779B9u ^ ((uint32_t)pid << 16) ^ center;
+    return true;
+}
+
+bool obd2_override_set_steps(uint8_t pid, const uint16_t *values, uint8_t count, uint16_t dwell_ticks)
+{
+    if (values == NULL || count == 0 || count > OBD2_OVERRIDE_MAX_STEPS) {
+        return false;
+    }
+
+    obd2_override_t *slot = acquire_slot(pid);
+    if (slot == NULL) {
+        return false;
+    }
+
+    slot->mode = OBD2_OVERRIDE_STEP;
+    memcpy(slot->steps, values, count * sizeof(uint16_t));
+    slot->step_count = count;
+    slot->step_index = 0;
+    slot->dwell_ticks = dwell_ticks ? dwell_ticks : 1;
+    slot->dwell_remaining = slot->dwell_ticks;
+    slot->value = values[0];
+    return true;
+}
+
+bool obd2_override_clear(uint8_t pid)
+{
+    uint8_t index = override_state.pid_index[pid];
+    if (index == OBD2_OVERRIDE_NO_SLOT) {
+        return false;
+    }
+    index--;
+
+    // Move the last slot into the hole to keep the active list packed
+    uint8_t last = --override_state.count;
+    if (index != last) {
+        override_state.slots[index] = override_state.slots[last];
+        override_state.pid_index[override_state.slots[index].pid] = index + 1;
+    }
+    override_state.pid_index[pid] = OBD2_OVERRIDE_NO_SLOT;
+    return true;
+}
+
+void obd2_override_clear_all(void)
+{
+    for (uint8_t i = 0; i < override_state.count; i++) {
+        override_state.pid_index[override_state.slots[i].pid] = OBD2_OVERRIDE_NO_SLOT;
+    }
+    override_state.count = 0;
+}
+
+static uint32_t next_random(uint32_t *state)
+{
+    // xorshift32
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+void obd2_override_tick(void)
+{
+    for (uint8_t i = 0; i < override_state.count; i++) {
+        obd2_override_t *slot = &override_state.slots[i];
+
+        switch (slot->mode) {
+            case OBD2_OVERRIDE_RAMP:
+                if (slot->value != slot->target) {
+                    slot->position += slot->rate;
+                    int32_t value = slot->position >> 8;
+                    if ((slot->rate > 0 && value >= slot->target) ||
+                        (slot->rate < 0 && value <= slot->target)) {
+                        value = slot->target;
+                    }
+                    slot->value = (uint16_t)value;
+                }
+                break;
+
+            case OBD2_OVERRIDE_NOISE:
+                {
+                    int32_t span = 2 * (int32_t)slot->amplitude + 1;
+                    int32_t offset = (int32_t)(next_random(&slot->rng_state) % span) - slot->amplitude;
+                    int32_t value = (int32_t)slot->target + offset;
+                    if (value < 0) value = 0;
+                    if (value > 0xFFFF) value = 0xFFFF;
+                    slot->value = (uint16_t)value;
+                }
+                break;
+
+            case OBD2_OVERRIDE_STEP:
+                if (--slot->dwell_remaining == 0) {
+                    slot->dwell_remaining = slot->dwell_ticks;
+                    slot->step_index = (slot->step_index + 1) % slot->step_count;
+                    slot->value = slot->steps[slot->step_index];
+                }
+                break;
+
+            default:
+                break;
+        }
+    }
+}
+
+bool obd2_override_get(uint8_t pid, uint16_t *value)
+{
+    uint8_t index = override_state.pid_index[pid];
+    if (index == OBD2_OVERRIDE_NO_SLOT) {
+        return false;
+    }
+
+    *value = override_state.slots[index - 1].value;
+    return true;
+}
+
+void obd2_override_apply(uint8_t pid, uint8_t *data, uint8_t data_length)
+{
+    uint16_t value;
+
+    if (data_length == 0 || !obd2_override_get(pid, &value)) {
+        return;
+    }
+
+    // Single byte PIDs saturate, two or more byte PIDs take the value as A*256+B
+    if (data_length == 1) {
+        data[0] = (value > 0xFF) ? 0xFF : (uint8_t)value;
+    } else {
+        data[0] = (value >> 8) & 0xFF;
+        data[1] = value & 0xFF;
+    }
+}
+
+uint8_t obd2_override_get_active_count(void)
+{
+    return override_state.count;
+}
+
+const obd2_override_t* obd2_override_get_slot(uint8_t index)
+{
+    if (index >= override_state.count) {
+        return NULL;
+    }
+    return &override_state.slots[index];
+}
+
+const char* obd2_override_mode_name(uint8_t mode)
+{
+    switch (mode) {
+        case OBD2_OVERRIDE_FIXED: return "FIXED";
+        case OBD2_OVERRIDE_RAMP:  return "RAMP";
+        case OBD2_OVERRIDE_NOISE: return "NOISE";
+        case OBD2_OVERRIDE_STEP:  return "STEP";
+        default:                  return "NONE";
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef __OBD2_OVERRIDE_H__
+#define __OBD2_OVERRIDE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Per-PID value overrides for Service 01
+//
+// An override replaces the encoded bytes of a PID response ("A" or "A*256+B")
+// with a scripted value. Overrides are advanced once per simulation tick and
+// only active slots are visited, so the feature costs nothing when unused.
+
+#define OBD2_OVERRIDE_MAX_SLOTS     16      // Concurrently overridden PIDs
+#define OBD2_OVERRIDE_MAX_STEPS     8       // Values in a step sequence
+#define OBD2_OVERRIDE_NO_SLOT       0
+
+typedef enum {
+    OBD2_OVERRIDE_NONE = 0,
+    OBD2_OVERRIDE_FIXED,        // Constant value
+    OBD2_OVERRIDE_RAMP,         // Linear ramp between two values, then hold
+    OBD2_OVERRIDE_NOISE,        // Uniform noise around a center value
+    OBD2_OVERRIDE_STEP          // Repeating sequence of values with a dwell time
+} obd2_override_mode_t;
+
+typedef struct {
+    uint8_t pid;                // Service 01 PID
+    uint8_t mode;               // obd2_override_mode_t
+    uint16_t value;             // Current value applied to responses
+    int32_t position;           // Ramp position (value * 256)
+    int32_t rate;               // Ramp increment per tick (value * 256)
+    uint16_t target;            // Ramp end value / noise center
+    uint16_t amplitude;         // Noise amplitude
+    uint32_t rng_state;         // Noise generator state
+    uint16_t steps[OBD2_OVERRIDE_MAX_STEPS];
+    uint8_t step_count;
+    uint8_t step_index;
+    uint16_t dwell_ticks;       // Ticks each step value is held
+    uint16_t dwell_remaining;
+} obd2_override_t;
+
+// Initialization and tick
+void obd2_override_init(void);
+void obd2_override_tick(void);
+
+// Override control
+bool obd2_override_set_fixed(uint8_t pid, uint16_t value);
+bool obd2_override_set_ramp(uint8_t pid, uint16_t from, uint16_t to, uint16_t ticks);
+bool obd2_override_set_noise(uint8_t pid, uint16_t center, uint16_t amplitude);
+bool obd2_override_set_steps(uint8_t pid, const uint16_t *values, uint8_t count, uint16_t dwell_ticks);
+bool obd2_override_clear(uint8_t pid);
+void obd2_override_clear_all(void);
+
+// Query and response encoding
+bool obd2_override_get(uint8_t pid, uint16_t *value);
+void obd2_override_apply(uint8_t pid, uint8_t *data, uint8_t data_length);
+uint8_t obd2_override_get_active_count(void);
+const obd2_override_t* obd2_override_get_slot(uint8_t index);
+const char* obd2_override_mode_name(uint8_t mode);
+
+#endif // __OBD2_OVERRIDE_H__
@@ -0,0 +1,145 @@
+#include "obd2_pending.h"
+#include "obd2_timer.h"
+#include "pico/stdlib.h"
+#include <stdio.h>
+#include <string.h>
+
+typedef struct {
+    bool active;
+    obd2_message_t request;
+    uint8_t bytes[2 + OBD2_MESSAGE_MAX_DATA];  // Request view points here, not at the receive buffer
+    obd2_pending_step_fn step;
+    uint32_t start;             // Request time (ms)
+    obd2_timer_t keepalive;     // Next NRC 0x78
+} pending_job_t;
+
+// Pending job table
+static struct {
+    pending_job_t jobs[OBD2_PENDING_MAX_JOBS];
+    uint8_t active;
+    obd2_pending_send_fn send;
+    obd2_pending_frame_fn frame;
+    uint32_t keepalives_sent;
+} pending_state;
+
+void obd2_pending_init(obd2_pending_send_fn send, obd2_pending_frame_fn frame)
+{
+    for (uint8_t i = 0; i < OBD2_PENDING_MAX_JOBS; i++) {
+        obd2_timer_cancel(&pending_state.jobs[i].keepalive);
+    }
+    memset(&pending_state, 0, sizeof(pending_state));
+    pending_state.send = send;
+    pending_state.frame = frame;
+}
+
+static void finish_job(pending_job_t *job, obd2_response_t *response)
+{
+    response->pending = NULL;
+    obd2_timer_cancel(&job->keepalive);
+    job->active = false;
+    pending_state.active--;
+    pending_state.send(&job->request, response);
+}
+
+// Still working: tell the tester to keep waiting before its timer runs out
+static void send_keepalive(void *context)
+{
+    pending_job_t *job = context;
+    obd2_response_t response;
+
+    obd2_response_init(&response, pending_state.frame());
+    obd2_create_error_response(job->request.service,
+                               OBD2_ERROR_REQUEST_CORRECTLY_RECEIVED_RESPONSE_PENDING, &response);
+    pending_state.send(&job->request, &response);
+    pending_state.keepalives_sent++;
+    obd2_timer_start(&job->keepalive, (OBD2_PENDING_P2_STAR_MS - OBD2_PENDING_MARGIN_MS) * 1000,
+                     send_keepalive, job);
+}
+
+// Run one step; returns true if the job completed
+static bool step_job(pending_job_t *job, uint32_t now)
+{
+    obd2_response_t response;
+    uint32_t elapsed = now - job->start;
+
+    obd2_response_init(&response, pending_state.frame());
+    if (job->step(&job->request, elapsed, &response)) {
+        finish_job(job, &response);
+        return true;
+    }
+
+    if (elapsed >= OBD2_PENDING_TIMEOUT_MS) {
+        printf("Pending service 0x%02X timed out\r\n", job->request.service);
+        obd2_create_error_response(job->request.service, OBD2_ERROR_GENERAL, &response);
+        finish_job(job, &response);
+        return true;
+    }
+    return false;
+}
+
+bool obd2_pending_start(const obd2_message_t *request, obd2_pending_step_fn step)
+{
+    pending_job_t *job = NULL;
+
+    for (uint8_t i = 0; i < OBD2_PENDING_MAX_JOBS; i++) {
+        if (!pending_state.jobs[i].active) {
+            job = &pending_state.jobs[i];
+            break;
+        }
+    }
+    if (job == NULL) {
+        return false;
+    }
+
+    uint32_t now = to_ms_since_boot(get_absolute_time());
+    job->active = true;
+    job->request = *request;
+    if (request->bytes != NULL) {
+        memcpy(job->bytes, request->bytes, request->length);
+        job->request.bytes = job->bytes;
+        job->request.data = &job->bytes[2];
+    }
+    job->step = step;
+    job->start = now;
+    obd2_timer_start(&job->keepalive, (OBD2_PENDING_P2_MS - OBD2_PENDING_MARGIN_MS) * 1000,
+                     send_keepalive, job);
+    pending_state.active++;
+
+    // Quick jobs answer right away without any NRC 0x78
+    step_job(job, now);
+    return true;
+}
+
+void obd2_pending_process(void)
+{
+    if (pending_state.active == 0) {
+        return;
+    }
+
+    uint32_t now = to_ms_since_boot(get_absolute_time());
+    for (uint8_t i = 0; i < OBD2_PENDING_MAX_JOBS; i++) {
+        if (pending_state.jobs[i].active) {
+            step_job(&pending_state.jobs[i], now);
+        }
+    }
+}
+
+bool obd2_pending_is_busy(uint8_t service)
+{
+    for (uint8_t i = 0; i < OBD2_PENDING_MAX_JOBS && pending_state.active > 0; i++) {
+        if (pending_state.jobs[i].active && pending_state.jobs[i].request.service == service) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint8_t obd2_pending_get_active(void)
+{
+    return pending_state.active;
+}
+
+uint32_t obd2_pending_get_keepalive_count(void)
+{
+    return pending_state.keepalives_sent;
+}
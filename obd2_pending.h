@@ -0,0 +1,45 @@
+#ifndef __OBD2_PENDING_H__
+#define __OBD2_PENDING_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "obd2_protocol.h"
+
+// Response-pending jobs (NRC 0x78)
+//
+// A handler that cannot answer within P2 sets response->pending to a step
+// function instead of filling the response. The handler layer turns that into
+// a job: the step is called once per main loop pass until it reports the
+// response complete, and meanwhile [7F][SID][78] is sent just before P2 and
+// again within every P2* so the tester keeps waiting. Other requests are
+// served normally while jobs run; a second request for a service that is
+// still pending is answered with NRC 0x21.
+
+#define OBD2_PENDING_MAX_JOBS       4
+#define OBD2_PENDING_P2_MS          50      // Tester response timeout
+#define OBD2_PENDING_P2_STAR_MS     5000    // Extended timeout after NRC 0x78
+#define OBD2_PENDING_MARGIN_MS      20      // Main loop latency allowance
+#define OBD2_PENDING_TIMEOUT_MS     30000   // Job abandoned with NRC 0x10
+
+// Response transmit callback (single frame or ISO-TP, to the tester that
+// sent the request), and the frame a response is encoded into
+typedef bool (*obd2_pending_send_fn)(const obd2_message_t *request, obd2_response_t *response);
+typedef uint8_t* (*obd2_pending_frame_fn)(void);
+
+// Initialization and per-loop processing
+void obd2_pending_init(obd2_pending_send_fn send, obd2_pending_frame_fn frame);
+void obd2_pending_process(void);
+
+// Start a job for a request whose handler returned a pending step. The
+// request bytes are copied into the job and the step runs once immediately;
+// false if no job slot is free.
+bool obd2_pending_start(const obd2_message_t *request, obd2_pending_step_fn step);
+
+// True while a job for this service is running
+bool obd2_pending_is_busy(uint8_t service);
+
+// Statistics
+uint8_t obd2_pending_get_active(void);
+uint32_t obd2_pending_get_keepalive_count(void);
+
+#endif // __OBD2_PENDING_H__
@@ -0,0 +1,181 @@
+#include "obd2_periodic.h"
+#include "obd2_protocol.h"
+#include "obd2_override.h"
+#include "obd2_timer.h"
+#include "pico/stdlib.h"
+#include <stdio.h>
+#include <string.h>
+
+// Rate periods in timer ticks
+static const uint16_t rate_ticks[] = {
+    [OBD2_PERIODIC_RATE_SLOW] = 1000000 / OBD2_PERIODIC_TICK_US,
+    [OBD2_PERIODIC_RATE_MEDIUM] = 200000 / OBD2_PERIODIC_TICK_US,
+    [OBD2_PERIODIC_RATE_FAST] = 1,
+};
+
+typedef struct {
+    uint8_t pdid;           // 0 = unused slot (PID 00 is a bitmap, never scheduled)
+    uint8_t rate;
+    uint32_t next_tick;
+} periodic_entry_t;
+
+// Schedule state
+static struct {
+    periodic_entry_t entries[OBD2_PERIODIC_MAX_ENTRIES];
+    uint8_t count;
+    uint32_t ticks;
+    obd2_timer_t timer;
+    obd2_periodic_send_fn send;
+    uint32_t frames_sent;
+    uint32_t ticks_missed;      // Entries that fell behind and were resynchronised
+} periodic_state;
+
+static void periodic_tick(void *context);
+
+static void update_timer(void)
+{
+    // Fixed period between ticks, no drift
+    if (periodic_state.count > 0 && !obd2_timer_is_pending(&periodic_state.timer)) {
+        obd2_timer_start_periodic(&periodic_state.timer, OBD2_PERIODIC_TICK_US, periodic_tick, NULL);
+    } else if (periodic_state.count == 0) {
+        obd2_timer_cancel(&periodic_state.timer);
+    }
+}
+
+void obd2_periodic_init(obd2_periodic_send_fn send)
+{
+    obd2_timer_cancel(&periodic_state.timer);
+    memset(&periodic_state, 0, sizeof(periodic_state));
+    periodic_state.send = send;
+}
+
+static periodic_entry_t* find_entry(uint8_t pdid)
+{
+    for (uint8_t i = 0; i < OBD2_PERIODIC_MAX_ENTRIES; i++) {
+        if (periodic_state.entries[i].pdid == pdid) {
+            return &periodic_state.entries[i];
+        }
+    }
+    return NULL;
+}
+
+bool obd2_periodic_add(uint8_t pdid, uint8_t rate)
+{
+    obd2_vehicle_snapshot_t snapshot;
+    uint8_t data[8];
+
+    if (pdid == 0 || rate < OBD2_PERIODIC_RATE_SLOW || rate > OBD2_PERIODIC_RATE_FAST) {
+        return false;
+    }
+
+    // Only PIDs the encoder can serve
+    obd2_capture_vehicle_snapshot(&snapshot);
+    if (obd2_encode_pid(pdid, &snapshot, data) == 0) {
+        return false;
+    }
+
+    // Rescheduling an identifier just changes its rate
+    periodic_entry_t *entry = find_entry(pdid);
+    if (entry == NULL) {
+        entry = find_entry(0);
+        if (entry == NULL) {
+            return false;
+        }
+        entry->pdid = pdid;
+        periodic_state.count++;
+    }
+    entry->rate = rate;
+    entry->next_tick = periodic_state.ticks + 1;
+
+    update_timer();
+    return true;
+}
+
+bool obd2_periodic_remove(uint8_t pdid)
+{
+    periodic_entry_t *entry = (pdid != 0) ? find_entry(pdid) : NULL;
+
+    if (entry == NULL) {
+        return false;
+    }
+    entry->pdid = 0;
+    periodic_state.count--;
+    update_timer();
+    return true;
+}
+
+void obd2_periodic_stop_all(void)
+{
+    if (periodic_state.count == 0) {
+        return;
+    }
+    memset(periodic_state.entries, 0, sizeof(periodic_state.entries));
+    periodic_state.count = 0;
+    update_timer();
+    printf("Periodic transmission stopped\r\n");
+}
+
+static void periodic_tick(void *context)
+{
+    // Ticks the loop was too late for still count, so rates stay on time
+    periodic_state.ticks += 1 + periodic_state.timer.overruns;
+    periodic_state.timer.overruns = 0;
+
+    uint32_t now = periodic_state.ticks;
+    obd2_vehicle_snapshot_t snapshot;
+    bool captured = false;
+
+    for (uint8_t i = 0; i < OBD2_PERIODIC_MAX_ENTRIES; i++) {
+        periodic_entry_t *entry = &periodic_state.entries[i];
+        if (entry->pdid == 0 || (int32_t)(now - entry->next_tick) < 0) {
+            continue;
+        }
+
+        // One vehicle snapshot serves every frame due in this pass
+        if (!captured) {
+            obd2_capture_vehicle_snapshot(&snapshot);
+            captured = true;
+        }
+
+        // UUDT frame: [PDID][data...], padded to 8 bytes
+        uint8_t frame[8] = {0};
+        uint8_t length;
+        frame[0] = entry->pdid;
+        length = obd2_encode_pid(entry->pdid, &snapshot, &frame[1]);
+        obd2_override_apply(entry->pdid, &frame[1], length);
+        if (periodic_state.send(frame, sizeof(frame))) {
+            periodic_state.frames_sent++;
+        }
+
+        // Stay on the tick grid; a late loop skips missed slots instead of bursting
+        entry->next_tick += rate_ticks[entry->rate];
+        if ((int32_t)(now - entry->next_tick) >= 0) {
+            periodic_state.ticks_missed++;
+            entry->next_tick = now + rate_ticks[entry->rate];
+        }
+    }
+}
+
+uint8_t obd2_periodic_get_count(void)
+{
+    return periodic_state.count;
+}
+
+uint32_t obd2_periodic_get_sent_count(void)
+{
+    return periodic_state.frames_sent;
+}
+
+void obd2_periodic_print_status(void)
+{
+    static const char *rate_names[] = { "-", "slow", "medium", "fast" };
+
+    printf("Periodic: %u scheduled, %lu frames sent, %lu late\r\n", periodic_state.count,
+           periodic_state.frames_sent, periodic_state.ticks_missed);
+    for (uint8_t i = 0; i < OBD2_PERIODIC_MAX_ENTRIES; i++) {
+        const periodic_entry_t *entry = &periodic_state.entries[i];
+        if (entry->pdid != 0) {
+            printf("  PDID %02X (DID F2%02X) %s\r\n", entry->pdid, entry->pdid, rate_names[entry->rate]);
+        }
+    }
+}
@@ -0,0 +1,42 @@
+#ifndef __OBD2_PERIODIC_H__
+#define __OBD2_PERIODIC_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Periodic data transmission (UDS ReadDataByPeriodicIdentifier, 0x2A)
+//
+// A tester schedules periodic identifiers (PDID xx = DID F2xx = Service 01
+// PID xx) at slow, medium or fast rate; the emulator then pushes
+// [PDID][data...] frames on OBD2_PERIODIC_ID without further requests.
+// A repeating timer (obd2_timer.h) counts fixed-rate ticks while anything is
+// scheduled and sends the frames that are due, from the main loop, so the
+// CAN controller is never touched from interrupt context.
+
+#define OBD2_PERIODIC_ID                0x6E8   // Periodic frames (not an ISO-TP channel)
+#define OBD2_PERIODIC_MAX_ENTRIES       16      // Fixed schedule table
+#define OBD2_PERIODIC_TICK_US           10000   // Timer period, fast rate
+
+// Transmission modes
+#define OBD2_PERIODIC_RATE_SLOW         0x01    // 1 s
+#define OBD2_PERIODIC_RATE_MEDIUM       0x02    // 200 ms
+#define OBD2_PERIODIC_RATE_FAST         0x03    // 10 ms
+#define OBD2_PERIODIC_STOP              0x04
+
+// Frame transmit callback (CAN data and length)
+typedef bool (*obd2_periodic_send_fn)(uint8_t *can_data, uint8_t can_length);
+
+// Initialization
+void obd2_periodic_init(obd2_periodic_send_fn send);
+
+// Schedule management; add fails for unsupported PDIDs or a full table
+bool obd2_periodic_add(uint8_t pdid, uint8_t rate);
+bool obd2_periodic_remove(uint8_t pdid);
+void obd2_periodic_stop_all(void);
+
+// Status and statistics
+uint8_t obd2_periodic_get_count(void);
+uint32_t obd2_periodic_get_sent_count(void);
+void obd2_periodic_print_status(void);
+
+#endif // __OBD2_PERIODIC_H__
@@ -1,23 +1,34 @@
 #include "obd2_protocol.h"
 #include "obd2_dtc.h"
+#include "obd2_override.h"
+#include "obd2_freeze.h"
+#include "obd2_monitor.h"
+#include "obd2_vehinfo.h"
+#include "obd2_uds.h"
+#include "obd2_storage.h"
+#include "obd2_handler.h"
+#include "obd2_memo.h"
 #include <string.h>
 #include <stdio.h>
 
-// Multi-frame VIN transmission state
-vin_multiframe_t vin_transmission = {0};
-
 // Supported PIDs bitmasks for Service 01
 // Calculate bitmask: bit 31 = PID 01, bit 30 = PID 02, etc.
-static const uint32_t supported_pids_01_20 = 0xBE1FE813;  // PIDs: 01,04,05,06,07,0A,0B,0C,0D,0E,0F,10,11,13,14,15,1C,1F,20
-static const uint32_t supported_pids_21_40 = 0x84000001;  // PIDs: 21,22,2F,40
+static const uint32_t supported_pids_01_20 = 0xDE7F9801;  // PIDs: 01,02,04,05,06,07,0A,0B,0C,0D,0E,0F,10,11,14,15,20
+static const uint32_t supported_pids_21_40 = 0xC0038001;  // PIDs: 21,22,2F,30,31,40
 static const uint32_t supported_pids_41_60 = 0x00000000;  // PIDs 41-60 supported (none)
 
+// Service 01 values encoded in the current vehicle generation (zeroed = empty)
+static obd2_memo_t pid_memo;
+
+// Service 02 serves the same data PIDs from a freeze frame (no monitor status)
+static const uint32_t supported_pids_02_01_20 = 0x5E7F9801;  // PIDs: 02,04,05,06,07,0A,0B,0C,0D,0E,0F,10,11,14,15,20
+
 bool obd2_is_valid_request(uint32_t can_id)
 {
     return (can_id == OBD2_REQUEST_ID);
 }
 
-bool obd2_parse_message(uint8_t *can_data, uint8_t can_length, obd2_message_t *message)
+bool obd2_parse_message(const uint8_t *can_data, uint8_t can_length, obd2_message_t *message)
 {
     if (can_data == NULL || message == NULL || can_length < 2) {
         return false;
@@ -26,380 +37,487 @@ bool obd2_parse_message(uint8_t *can_data, uint8_t can_length, obd2_message_t *m
     // Single frame format: [Length][Service][PID][Data...]
     uint8_t pci = can_data[0] & 0xF0;  // Protocol Control Information
     uint8_t length = can_data[0] & 0x0F;  // Data length
+    uint8_t offset = 1;
     
     // Only handle single frame messages for now
     if (pci != 0x00) {
         return false;
     }
     
-    if (length < 1 || length > 7 || length > (can_length - 1)) {
+    // CAN FD single frame: [00][Length][Service][PID][Data...]
+    if (length == 0 && can_length > OBD2_CAN_CLASSIC_FRAME_SIZE) {
+        length = can_data[1];
+        offset = 2;
+        if (length < OBD2_CAN_CLASSIC_FRAME_SIZE || length > OBD2_MESSAGE_MAX_DATA + 2) {
+            return false;
+        }
+    }
+    
+    if (length < 1 || (offset == 1 && length > 7) || length > (can_length - offset)) {
         return false;
     }
     
-    message->service = can_data[1];
+    message->service = can_data[offset];
     message->length = length;
     
     if (length >= 2) {
-        message->pid = can_data[2];
+        message->pid = can_data[offset + 1];
     } else {
         message->pid = 0;
     }
     
-    // Copy additional data if present
-    for (int i = 0; i < (length - 2) && i < 6; i++) {
-        if ((i + 3) < can_length) {
-            message->data[i] = can_data[i + 3];
-        }
-    }
+    // Additional data is read in place from the frame
+    message->bytes = &can_data[offset];
+    message->data = &can_data[offset + 2];
     
     return true;
 }
 
 bool obd2_create_response(obd2_message_t *request, obd2_response_t *response)
 {
-    if (request == NULL || response == NULL) {
+    if (request == NULL || response == NULL || response->frame == NULL) {
         return false;
     }
     
-    // Initialize response
-    memset(response, 0, sizeof(obd2_response_t));
-    
     switch (request->service) {
         case OBD2_SERVICE_01:  // Show current data
             return obd2_handle_service_01(request, response);
             
+        case OBD2_SERVICE_02:  // Show freeze frame data
+            return obd2_handle_service_02(request, response);
+            
         case OBD2_SERVICE_03:  // Show stored DTCs
             return obd2_handle_service_03(request, response);
             
         case OBD2_SERVICE_04:  // Clear DTCs
             return obd2_handle_service_04(request, response);
             
+        case OBD2_SERVICE_06:  // Test results, other component/system monitoring
+            return obd2_handle_service_06(request, response);
+            
+        case OBD2_SERVICE_07:  // Show pending DTCs
+            return obd2_handle_service_07(request, response);
+            
+        case OBD2_SERVICE_0A:  // Show permanent DTCs
+            return obd2_handle_service_0A(request, response);
+            
         case OBD2_SERVICE_09:  // Vehicle information
             return obd2_handle_service_09(request, response);
             
+        case OBD2_UDS_SID_SESSION_CONTROL:      // UDS services
+        case OBD2_UDS_SID_READ_DTC_INFORMATION:
+        case OBD2_UDS_SID_READ_DATA_BY_ID:
+        case OBD2_UDS_SID_TESTER_PRESENT:
+        case OBD2_UDS_SID_READ_PERIODIC_DATA:
+            return obd2_handle_uds(request, response);
+            
         default:
             obd2_create_error_response(request->service, OBD2_ERROR_SERVICE_NOT_SUPPORTED, response);
             return true;
     }
 }
 
-bool obd2_handle_service_01(obd2_message_t *request, obd2_response_t *response)
+void obd2_response_init(obd2_response_t *response, uint8_t *frame)
 {
-    response->service = OBD2_SERVICE_01 + OBD2_POSITIVE_RESPONSE_OFFSET;
-    response->pid = request->pid;
-    
-    switch (request->pid) {
+    response->frame = frame;
+    response->data = &frame[OBD2_FRAME_DATA];
+    response->length = 0;
+    response->payload = NULL;
+    response->pending = NULL;
+}
+
+void obd2_response_set_header(obd2_response_t *response, uint8_t service, uint8_t pid)
+{
+    response->frame[OBD2_FRAME_SERVICE] = service;
+    response->frame[OBD2_FRAME_PID] = pid;
+}
+
+static void put_bitmap(uint32_t bitmap, uint8_t *data)
+{
+    data[0] = (bitmap >> 24) & 0xFF;
+    data[1] = (bitmap >> 16) & 0xFF;
+    data[2] = (bitmap >> 8) & 0xFF;
+    data[3] = bitmap & 0xFF;
+}
+
+uint8_t obd2_encode_supported_pids(uint8_t pid, uint8_t *data)
+{
+    switch (pid) {
         case OBD2_PID_SUPPORTED_01_20:
-            response->data[0] = (supported_pids_01_20 >> 24) & 0xFF;
-            response->data[1] = (supported_pids_01_20 >> 16) & 0xFF;
-            response->data[2] = (supported_pids_01_20 >> 8) & 0xFF;
-            response->data[3] = supported_pids_01_20 & 0xFF;
-            response->length = 6;  // Service + PID + 4 data bytes
-            break;
-            
-        case OBD2_PID_MONITOR_STATUS:
-            response->data[0] = 0x07;  // MIL off, 3 DTCs available
-            response->data[1] = 0xFF;  // Tests available
-            response->data[2] = 0x00;  // Tests incomplete
-            response->data[3] = 0xFF;  // Tests available (cont.)
-            response->length = 6;
-            break;
-            
+            put_bitmap(supported_pids_01_20, data);
+            return 4;
+        case OBD2_PID_SUPPORTED_21_40:
+            put_bitmap(supported_pids_21_40, data);
+            return 4;
+        case OBD2_PID_SUPPORTED_41_60:
+            put_bitmap(supported_pids_41_60, data);
+            return 4;
+        default:
+            return 0;
+    }
+}
+
+uint8_t obd2_encode_monitor_status(bool mil, uint16_t confirmed, uint8_t supported, uint8_t incomplete,
+                                   uint8_t *data)
+{
+    data[0] = (mil ? 0x80 : 0x00) | (confirmed > 0x7F ? 0x7F : confirmed);
+    data[1] = OBD2_READINESS_CONTINUOUS;
+    data[2] = supported;
+    data[3] = incomplete;
+    return 4;
+}
+
+uint32_t obd2_get_pid_memo_hits(void)
+{
+    return pid_memo.hits;
+}
+
+uint32_t obd2_get_pid_memo_misses(void)
+{
+    return pid_memo.misses;
+}
+
+void obd2_reset_pid_memo_stats(void)
+{
+    obd2_memo_reset_stats(&pid_memo);
+}
+
+uint8_t obd2_encode_pid(uint8_t pid, const obd2_vehicle_snapshot_t *snapshot, uint8_t *data)
+{
+    switch (pid) {
         case OBD2_PID_ENGINE_LOAD:
-            response->data[0] = obd2_get_engine_load();
-            response->length = 3;
-            break;
+            data[0] = snapshot->engine_load;
+            return 1;
             
         case OBD2_PID_COOLANT_TEMP:
-            response->data[0] = obd2_get_coolant_temp();
-            response->length = 3;
-            break;
+            data[0] = snapshot->coolant_temp;
+            return 1;
             
         case OBD2_PID_ENGINE_RPM:
-            {
-                uint16_t rpm = obd2_get_engine_rpm();
-                response->data[0] = (rpm >> 8) & 0xFF;
-                response->data[1] = rpm & 0xFF;
-                response->length = 4;
-            }
-            break;
+            data[0] = (snapshot->engine_rpm >> 8) & 0xFF;
+            data[1] = snapshot->engine_rpm & 0xFF;
+            return 2;
             
         case OBD2_PID_VEHICLE_SPEED:
-            response->data[0] = obd2_get_vehicle_speed();
-            response->length = 3;
-            break;
+            data[0] = snapshot->vehicle_speed;
+            return 1;
             
         case OBD2_PID_FUEL_PRESSURE:
-            {
-                uint16_t pressure = obd2_get_fuel_pressure();
-                response->data[0] = pressure / 300;  // Convert kPa*100 to 3kPa units
-                response->length = 3;
-            }
-            break;
+            data[0] = snapshot->fuel_pressure / 300;  // Convert kPa*100 to 3kPa units
+            return 1;
 
         case OBD2_PID_INTAKE_MAP:
-            {
-                uint16_t map = obd2_get_manifold_pressure();
-                response->data[0] = map / 100;  // Convert kPa*100 to kPa
-                response->length = 3;
-            }
-            break;
+            data[0] = snapshot->manifold_pressure / 100;  // Convert kPa*100 to kPa
+            return 1;
 
         case OBD2_PID_TIMING_ADVANCE:
-            response->data[0] = obd2_get_timing_advance();
-            response->length = 3;
-            break;
+            data[0] = snapshot->timing_advance;
+            return 1;
 
         case OBD2_PID_INTAKE_TEMP:
-            response->data[0] = obd2_get_intake_temp();
-            response->length = 3;
-            break;
+            data[0] = snapshot->intake_temp;
+            return 1;
 
         case OBD2_PID_MAF_RATE:
-            {
-                uint16_t maf = obd2_get_maf_flow_rate();
-                response->data[0] = (maf >> 8) & 0xFF;  // High byte
-                response->data[1] = maf & 0xFF;         // Low byte
-                response->length = 4;
-            }
-            break;
+            data[0] = (snapshot->maf_flow_rate >> 8) & 0xFF;  // High byte
+            data[1] = snapshot->maf_flow_rate & 0xFF;         // Low byte
+            return 2;
 
         case OBD2_PID_THROTTLE_POS:
-            response->data[0] = obd2_get_throttle_position();
-            response->length = 3;
-            break;
+            data[0] = snapshot->throttle_position;
+            return 1;
 
         case OBD2_PID_O2_B1S1:
-            {
-                uint16_t o2_voltage = obd2_get_o2_sensor_b1s1();
-                response->data[0] = (o2_voltage * 255) / 1000;  // Convert mV to 0-255 scale
-                response->data[1] = 0xFF;  // Short term fuel trim (not used in this format)
-                response->length = 4;
-            }
-            break;
+            data[0] = (snapshot->o2_sensor_b1s1 * 255) / 1000;  // Convert mV to 0-255 scale
+            data[1] = 0xFF;  // Short term fuel trim (not used in this format)
+            return 2;
 
         case OBD2_PID_O2_B1S2:
-            {
-                uint16_t o2_voltage = obd2_get_o2_sensor_b1s2();
-                response->data[0] = (o2_voltage * 255) / 1000;  // Convert mV to 0-255 scale
-                response->data[1] = 0xFF;  // Short term fuel trim (not used in this format)
-                response->length = 4;
-            }
-            break;
+            data[0] = (snapshot->o2_sensor_b1s2 * 255) / 1000;  // Convert mV to 0-255 scale
+            data[1] = 0xFF;  // Short term fuel trim (not used in this format)
+            return 2;
 
         case OBD2_PID_SHORT_FUEL_TRIM_1:
-            response->data[0] = obd2_get_short_fuel_trim_b1();
-            response->length = 3;
-            break;
+            data[0] = snapshot->short_fuel_trim_b1;
+            return 1;
 
         case OBD2_PID_LONG_FUEL_TRIM_1:
-            response->data[0] = obd2_get_long_fuel_trim_b1();
-            response->length = 3;
-            break;
+            data[0] = snapshot->long_fuel_trim_b1;
+            return 1;
             
         case OBD2_PID_FUEL_TANK_LEVEL:
-            response->data[0] = obd2_get_fuel_level();
-            response->length = 3;
-            break;
+            data[0] = snapshot->fuel_level;
+            return 1;
 
         case OBD2_PID_FUEL_RAIL_PRESSURE:
             {
-                uint16_t pressure = obd2_get_fuel_pressure();
                 // Fuel rail pressure relative to manifold vacuum
-                uint16_t map = obd2_get_manifold_pressure();
-                uint16_t relative_pressure = pressure - map;
-                response->data[0] = (relative_pressure >> 8) & 0xFF;
-                response->data[1] = relative_pressure & 0xFF;
-                response->length = 4;
+                uint16_t relative_pressure = snapshot->fuel_pressure - snapshot->manifold_pressure;
+                data[0] = (relative_pressure >> 8) & 0xFF;
+                data[1] = relative_pressure & 0xFF;
             }
-            break;
+            return 2;
+
+        case OBD2_PID_DISTANCE_WITH_MIL:
+            data[0] = (snapshot->distance_with_mil >> 8) & 0xFF;
+            data[1] = snapshot->distance_with_mil & 0xFF;
+            return 2;
+
+        case OBD2_PID_WARMUPS_SINCE_CLEAR:
+            data[0] = snapshot->warmups_since_clear;
+            return 1;
 
+        case OBD2_PID_DISTANCE_SINCE_CLEAR:
+            data[0] = (snapshot->distance_since_clear >> 8) & 0xFF;
+            data[1] = snapshot->distance_since_clear & 0xFF;
+            return 2;
+
+        default:
+            return 0;
+    }
+}
+
+bool obd2_handle_service_01(obd2_message_t *request, obd2_response_t *response)
+{
+    obd2_response_set_header(response, OBD2_SERVICE_01 + OBD2_POSITIVE_RESPONSE_OFFSET, request->pid);
+    
+    switch (request->pid) {
+        case OBD2_PID_SUPPORTED_01_20:
         case OBD2_PID_SUPPORTED_21_40:
-            response->data[0] = (supported_pids_21_40 >> 24) & 0xFF;
-            response->data[1] = (supported_pids_21_40 >> 16) & 0xFF;
-            response->data[2] = (supported_pids_21_40 >> 8) & 0xFF;
-            response->data[3] = supported_pids_21_40 & 0xFF;
-            response->length = 6;
+        case OBD2_PID_SUPPORTED_41_60:
+            response->length = 2 + obd2_encode_supported_pids(request->pid, response->data);
             break;
             
-        case OBD2_PID_SUPPORTED_41_60:
-            response->data[0] = (supported_pids_41_60 >> 24) & 0xFF;
-            response->data[1] = (supported_pids_41_60 >> 16) & 0xFF;
-            response->data[2] = (supported_pids_41_60 >> 8) & 0xFF;
-            response->data[3] = supported_pids_41_60 & 0xFF;
-            response->length = 6;
+        case OBD2_PID_MONITOR_STATUS:
+            {
+                // MIL and stored DTC count from the DTC lifecycle, readiness
+                // from the Service 06 monitors
+                uint8_t supported, incomplete;
+                obd2_monitor_get_readiness(&supported, &incomplete);
+                response->length = 2 + obd2_encode_monitor_status(obd2_dtc_get_mil_status(),
+                                                                  obd2_dtc_get_confirmed_count(),
+                                                                  supported, incomplete, response->data);
+            }
             break;
             
+        case OBD2_PID_FREEZE_DTC:
+            {
+                // DTC that caused freeze frame 0 (0000 if none)
+                const obd2_freeze_frame_t *frame = obd2_freeze_get(0);
+                uint16_t dtc = frame ? frame->dtc : 0;
+                response->data[0] = (dtc >> 8) & 0xFF;
+                response->data[1] = dtc & 0xFF;
+                response->length = 4;
+            }
+            break;
+
         default:
-            obd2_create_error_response(request->service, OBD2_ERROR_SUBFUNCTION_NOT_SUPPORTED, response);
-            return true;
+            {
+                obd2_vehicle_snapshot_t snapshot;
+                uint8_t data_length;
+                uint32_t generation = obd2_get_vehicle_generation();
+
+                // The same PID asked again before the model steps gets the same bytes
+                data_length = obd2_memo_lookup(&pid_memo, OBD2_ECU_ID, OBD2_SERVICE_01, request->pid,
+                                               generation, response->data);
+                if (data_length == 0) {
+                    obd2_capture_vehicle_snapshot(&snapshot);
+                    data_length = obd2_encode_pid(request->pid, &snapshot, response->data);
+                    obd2_memo_store(&pid_memo, OBD2_ECU_ID, OBD2_SERVICE_01, request->pid,
+                                    generation, response->data, data_length);
+                }
+                if (data_length == 0) {
+                    obd2_create_error_response(request->service, OBD2_ERROR_SUBFUNCTION_NOT_SUPPORTED, response);
+                    return true;
+                }
+                response->length = 2 + data_length;
+            }
+            break;
     }
-    
+
+    // Scripted overrides replace the simulated value before transmission
+    obd2_override_apply(request->pid, response->data, response->length - 2);
+
     return true;
 }
 
-bool obd2_handle_service_03(obd2_message_t *request, obd2_response_t *response)
+bool obd2_handle_service_02(obd2_message_t *request, obd2_response_t *response)
 {
-    response->service = OBD2_SERVICE_03 + OBD2_POSITIVE_RESPONSE_OFFSET;
+    // Request: [02][PID][frame]; response: [42][PID][frame][data...]
+    uint8_t frame_number = (request->length >= 3) ? request->data[0] : 0;
+    const obd2_freeze_frame_t *frame = obd2_freeze_get(frame_number);
+    uint8_t data_length;
 
-    // Get stored DTCs from DTC manager
-    uint8_t dtc_buffer[8];
-    uint8_t dtc_data_length = obd2_dtc_get_stored(dtc_buffer, sizeof(dtc_buffer));
+    obd2_response_set_header(response, OBD2_SERVICE_02 + OBD2_POSITIVE_RESPONSE_OFFSET, request->pid);
+    response->data[0] = frame_number;
 
-    if (dtc_data_length > 0 && dtc_data_length <= 7) {
-        // Copy DTC data to response
-        memcpy(response->data, dtc_buffer, dtc_data_length);
-        response->length = 2 + dtc_data_length;  // Service + data
-    } else {
-        // No DTCs stored
-        response->data[0] = 0x00;
-        response->length = 3;
+    // PID 02 answers 0000 for an empty frame, everything else needs a frame
+    if (frame == NULL && request->pid != OBD2_PID_FREEZE_DTC) {
+        obd2_create_error_response(request->service, OBD2_ERROR_REQUEST_OUT_OF_RANGE, response);
+        return true;
     }
 
-    return true;
-}
-
-bool obd2_handle_service_04(obd2_message_t *request, obd2_response_t *response)
-{
-    response->service = OBD2_SERVICE_04 + OBD2_POSITIVE_RESPONSE_OFFSET;
-    response->length = 2;  // Just service response
-    
-    // Clear DTCs (simulation - just acknowledge)
-    obd2_clear_dtcs();
-    
-    return true;
-}
-
-bool obd2_handle_service_09(obd2_message_t *request, obd2_response_t *response)
-{
-    response->service = OBD2_SERVICE_09 + OBD2_POSITIVE_RESPONSE_OFFSET;
-    response->pid = request->pid;
-    
     switch (request->pid) {
-        case OBD2_PID_VIN_MESSAGE_COUNT:
-            response->data[0] = 0x01;  // 1 message for VIN
-            response->length = 3;
+        case OBD2_PID_SUPPORTED_01_20:
+            put_bitmap(supported_pids_02_01_20, &response->data[1]);
+            data_length = 4;
             break;
-            
-        case OBD2_PID_VIN:
-            {
-                // Get complete VIN from vehicle data
-                const char* vin = obd2_get_vin();
 
-                // Send VIN in proper OBD2 format
-                // Many scan tools can handle this format for complete VIN
-                // Format: [Data_Length][VIN_17_chars] - total 18 bytes
-                // We'll send as much as possible in 6 bytes available
+        case OBD2_PID_FREEZE_DTC:
+            response->data[1] = frame ? (frame->dtc >> 8) & 0xFF : 0;
+            response->data[2] = frame ? frame->dtc & 0xFF : 0;
+            data_length = 2;
+            break;
 
-                response->data[0] = 17;  // VIN length (17 characters)
+        case OBD2_PID_SUPPORTED_21_40:
+            put_bitmap(supported_pids_21_40, &response->data[1]);
+            data_length = 4;
+            break;
 
-                // Send first 5 VIN characters (max that fits in remaining 5 bytes)
-                memcpy(&response->data[1], vin, 5);
-                response->length = 8;  // Service + PID + length + 5 VIN chars
+        case OBD2_PID_SUPPORTED_41_60:
+            put_bitmap(supported_pids_41_60, &response->data[1]);
+            data_length = 4;
+            break;
 
-                printf("VIN requested - Full VIN: %s\r\n", vin);
-                printf("Sending: Length=17, First 5 chars=%.5s\r\n", vin);
-                printf("Complete VIN available via USB serial interface\r\n");
+        default:
+            data_length = obd2_encode_pid(request->pid, &frame->data, &response->data[1]);
+            if (data_length == 0) {
+                obd2_create_error_response(request->service, OBD2_ERROR_SUBFUNCTION_NOT_SUPPORTED, response);
+                return true;
             }
             break;
-            
-        default:
-            obd2_create_error_response(request->service, OBD2_ERROR_SUBFUNCTION_NOT_SUPPORTED, response);
-            return true;
     }
-    
+
+    response->length = 3 + data_length;
     return true;
 }
 
-void obd2_create_error_response(uint8_t service, uint8_t error_code, obd2_response_t *response)
+void obd2_set_payload_response(const uint8_t *payload, uint16_t length, obd2_response_t *response)
 {
-    response->service = 0x7F;  // Negative response service
-    response->pid = service;   // Original service that failed
-    response->data[0] = error_code;
-    response->length = 3;
+    if (length > 7) {
+        // Does not fit a single frame
+        response->payload = payload;
+        response->payload_length = length;
+        return;
+    }
+
+    memcpy(&response->frame[OBD2_FRAME_SERVICE], payload, length);
+    response->length = length;
 }
 
-uint8_t obd2_format_can_message(obd2_response_t *response, uint8_t *can_data)
+// Shared by Services 03, 07 and 0A: the DTC manager keeps each response
+// pre-serialized as [SID+40][count][DTCs...]
+static bool handle_dtc_list_service(uint8_t service, obd2_response_t *response)
 {
-    if (response == NULL || can_data == NULL) {
-        return 0;
-    }
-    
-    // Single frame format: [Length][Service][PID][Data...]
-    can_data[0] = response->length;  // PCI + Length
-    can_data[1] = response->service;
-    
-    if (response->length >= 2) {
-        can_data[2] = response->pid;
-    }
-    
-    // Copy response data
-    for (int i = 0; i < (response->length - 2) && i < 5; i++) {
-        can_data[i + 3] = response->data[i];
-    }
-    
-    // Pad remaining bytes with 0x00 (optional)
-    for (int i = response->length + 1; i < 8; i++) {
-        can_data[i] = 0x00;
+    uint16_t length;
+    const uint8_t *payload = obd2_dtc_get_response_payload(service, &length);
+
+    if (payload == NULL || length < 2) {
+        obd2_create_error_response(service, OBD2_ERROR_GENERAL, response);
+        return true;
     }
-    
-    return response->length + 1;  // Total CAN message length
+
+    obd2_set_payload_response(payload, length, response);
+    return true;
 }
 
-// Multi-frame VIN transmission functions
-void obd2_start_vin_transmission(const char* vin)
+bool obd2_handle_service_03(obd2_message_t *request, obd2_response_t *response)
 {
-    if (vin != NULL) {
-        vin_transmission.active = true;
-        vin_transmission.frame_number = 1;  // Start with frame 1 (first frame is 0)
-        vin_transmission.total_frames = 4;  // Total frames needed for 17-char VIN
-        strncpy(vin_transmission.vin_data, vin, 17);
-        vin_transmission.vin_data[17] = '\0';
-
-        printf("Multi-frame VIN transmission started for: %s\r\n", vin);
-    }
+    return handle_dtc_list_service(OBD2_SERVICE_03, response);
 }
 
-bool obd2_handle_vin_multiframe(obd2_response_t *response)
+// Service 04 confirms once the clear has reached flash; the wait is bounded
+// because the RAM state is already cleared and the log catches up later
+#define SERVICE_04_PERSIST_WAIT_MS  2000
+
+static bool service_04_persist_step(const obd2_message_t *request, uint32_t elapsed_ms,
+                                    obd2_response_t *response)
 {
-    if (!vin_transmission.active) {
+    if (obd2_storage_is_pending() && elapsed_ms < SERVICE_04_PERSIST_WAIT_MS) {
         return false;
     }
 
-    // Calculate data offset for this frame
-    uint8_t data_offset = 4 + (vin_transmission.frame_number - 1) * 7;  // 4 chars in first frame, 7 in each subsequent
-    uint8_t remaining_chars = 17 - (4 + (vin_transmission.frame_number - 1) * 7);
-    uint8_t chars_this_frame = (remaining_chars > 7) ? 7 : remaining_chars;
+    obd2_response_set_header(response, OBD2_SERVICE_04 + OBD2_POSITIVE_RESPONSE_OFFSET, 0);
+    response->length = 2;  // Just service response
+    return true;
+}
 
-    if (chars_this_frame > 0) {
-        // Consecutive frame format: [2X][Data...]
-        // Where X = frame sequence number (1-F)
-        response->data[0] = 0x20 | vin_transmission.frame_number;  // Consecutive frame + sequence
+bool obd2_handle_service_04(obd2_message_t *request, obd2_response_t *response)
+{
+    // Clear stored/pending DTCs and since-clear counters (permanent DTCs stay)
+    obd2_clear_dtcs();
+    
+    // Answered from the pending job (NRC 0x78 while flash is written)
+    response->pending = service_04_persist_step;
+    return true;
+}
 
-        // Copy VIN data for this frame
-        memcpy(&response->data[1], &vin_transmission.vin_data[data_offset], chars_this_frame);
+bool obd2_handle_service_06(obd2_message_t *request, obd2_response_t *response)
+{
+    uint16_t length;
+    const uint8_t *payload = obd2_monitor_get_response(request->pid, &length);
 
-        // Pad remaining bytes with 0x00 if needed
-        for (int i = chars_this_frame + 1; i < 8; i++) {
-            response->data[i] = 0x00;
-        }
+    // Results are kept as running aggregates, so this only formats stored values
+    if (payload == NULL) {
+        obd2_create_error_response(OBD2_SERVICE_06, OBD2_ERROR_SUBFUNCTION_NOT_SUPPORTED, response);
+        return true;
+    }
 
-        response->length = 8;
+    obd2_set_payload_response(payload, length, response);
+    return true;
+}
 
-        printf("Consecutive frame %d: %.7s\r\n", vin_transmission.frame_number,
-               &vin_transmission.vin_data[data_offset]);
+bool obd2_handle_service_07(obd2_message_t *request, obd2_response_t *response)
+{
+    return handle_dtc_list_service(OBD2_SERVICE_07, response);
+}
 
-        vin_transmission.frame_number++;
+bool obd2_handle_service_0A(obd2_message_t *request, obd2_response_t *response)
+{
+    return handle_dtc_list_service(OBD2_SERVICE_0A, response);
+}
 
-        // Check if transmission complete
-        if (vin_transmission.frame_number > vin_transmission.total_frames) {
-            vin_transmission.active = false;
-            printf("VIN multi-frame transmission completed\r\n");
-        }
+bool obd2_handle_uds(obd2_message_t *request, obd2_response_t *response)
+{
+    uint16_t length;
+    const uint8_t *payload = obd2_uds_handle_request(request, &length);
 
+    // Suppressed positive response: length stays 0 and nothing is sent
+    if (payload == NULL) {
         return true;
     }
 
-    vin_transmission.active = false;
-    return false;
+    obd2_set_payload_response(payload, length, response);
+    return true;
+}
+
+bool obd2_handle_service_09(obd2_message_t *request, obd2_response_t *response)
+{
+    uint16_t length;
+    const uint8_t *payload = obd2_vehinfo_get_response(request->pid, &length);
+
+    // Payloads are serialized when their data changes, not per request
+    if (payload == NULL) {
+        obd2_create_error_response(OBD2_SERVICE_09, OBD2_ERROR_SUBFUNCTION_NOT_SUPPORTED, response);
+        return true;
+    }
+
+    obd2_set_payload_response(payload, length, response);
+    return true;
+}
+
+void obd2_create_error_response(uint8_t service, uint8_t error_code, obd2_response_t *response)
+{
+    response->frame[OBD2_FRAME_SERVICE] = 0x7F;    // Negative response service
+    response->frame[OBD2_FRAME_PID] = service;      // Original service that failed
+    response->data[0] = error_code;
+    response->length = 3;
+}
+
+uint8_t obd2_finish_can_message(obd2_response_t *response)
+{
+    // Single frame format: [Length][Service][PID][Data...], already in place;
+    // bytes past the length are not transmitted, so they are left as they are
+    response->frame[OBD2_FRAME_PCI] = response->length;
+    return response->length + 1;  // Total CAN message length
 }
@@ -3,9 +3,11 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "obd2_can.h"
 
 // OBD2 CAN IDs
 #define OBD2_REQUEST_ID         0x7DF    // Functional request ID
+#define OBD2_PHYSICAL_REQUEST_ID 0x7E0   // Physical request ID for our ECU
 #define OBD2_RESPONSE_ID_BASE   0x7E8    // Response ID base (7E8-7EF for ECUs 0-7)
 #define OBD2_ECU_ID             0x7E8    // Our ECU response ID
 
@@ -94,8 +96,9 @@
 #define OBD2_PID_CVN                    0x06    // Calibration Verification Numbers
 #define OBD2_PID_IPT_COUNT              0x07    // In-use performance tracking message count
 #define OBD2_PID_IPT                    0x08    // In-use performance tracking for spark ignition vehicles
-#define OBD2_PID_ESN_COUNT              0x09    // ESN message count
-#define OBD2_PID_ESN                    0x0A    // Engine serial number
+#define OBD2_PID_ECU_NAME_COUNT         0x09    // ECU name message count
+#define OBD2_PID_ECU_NAME               0x0A    // ECU name
+#define OBD2_PID_ESN                    0x0D    // Engine serial number
 
 // Error codes
 #define OBD2_ERROR_GENERAL              0x10    // General reject
@@ -121,34 +124,108 @@
 #define OBD2_ERROR_SUBFUNCTION_NOT_SUPPORTED_IN_ACTIVE_SESSION 0x7E // Sub-function not supported in active session
 #define OBD2_ERROR_SERVICE_NOT_SUPPORTED_IN_ACTIVE_SESSION 0x7F // Service not supported in active session
 
-// OBD2 message structure
+// Request bytes after service and PID in the largest (CAN FD) single frame
+#define OBD2_MESSAGE_MAX_DATA   (OBD2_CAN_FD_FRAME_SIZE - 4)
+
+// OBD2 request: a read-only view of the received frame, which stays
+// untouched until the response has been handed to the transport
 typedef struct {
     uint8_t service;        // Service ID
     uint8_t pid;           // Parameter ID
-    uint8_t data[6];       // Data bytes (max 6 for single frame)
+    const uint8_t *bytes;  // [Service][PID][data...] as received
+    const uint8_t *data;   // Data bytes after service and PID (length - 2 of them)
     uint8_t length;        // Total message length
+    uint32_t can_id;       // Addressing, set by the handler: request CAN ID
+    uint8_t channel;       // and the transport interface it arrived on
 } obd2_message_t;
 
-// OBD2 response structure
-typedef struct {
-    uint8_t service;        // Service ID + 0x40 for positive response
-    uint8_t pid;           // Parameter ID (if applicable)
-    uint8_t data[7];       // Response data
-    uint8_t length;        // Total response length
+// Step of a response that completes later (see obd2_pending.h): fills the
+// response and returns true once done, false to be called again
+struct obd2_response;
+typedef bool (*obd2_pending_step_fn)(const obd2_message_t *request, uint32_t elapsed_ms,
+                                     struct obd2_response *response);
+
+// Byte positions in a single frame: [PCI][Service][PID][data...]
+#define OBD2_FRAME_PCI          0
+#define OBD2_FRAME_SERVICE      1
+#define OBD2_FRAME_PID          2
+#define OBD2_FRAME_DATA         3
+
+// OBD2 response, encoded in place into its transmit frame (a transport
+// slot or a buffer of at least 8 bytes) so no copy is made on the way out
+typedef struct obd2_response {
+    uint8_t *frame;        // Single frame being encoded
+    uint8_t *data;         // Response data (frame + OBD2_FRAME_DATA)
+    uint8_t length;        // Total response length (service onwards), 0 = nothing to send
+    const uint8_t *payload; // Complete multi-frame response (sent via ISO-TP), or NULL
+    uint16_t payload_length;
+    obd2_pending_step_fn pending; // Set instead of a response to answer later
 } obd2_response_t;
 
+// Vehicle state as reported through Service 01 (values already OBD2-scaled
+// as returned by the obd2_get_* functions). Freeze frames store one of these
+// so Service 02 reuses the Service 01 encoder.
+typedef struct {
+    uint16_t engine_rpm;            // RPM * 4
+    uint16_t maf_flow_rate;         // g/s * 100
+    uint16_t fuel_pressure;         // kPa * 100
+    uint16_t manifold_pressure;     // kPa * 100
+    uint16_t o2_sensor_b1s1;        // mV
+    uint16_t o2_sensor_b1s2;        // mV
+    uint16_t distance_with_mil;     // km
+    uint16_t distance_since_clear;  // km
+    uint8_t engine_load;
+    uint8_t coolant_temp;
+    uint8_t vehicle_speed;
+    uint8_t intake_temp;
+    uint8_t throttle_position;
+    uint8_t fuel_level;
+    uint8_t short_fuel_trim_b1;
+    uint8_t long_fuel_trim_b1;
+    uint8_t timing_advance;
+    uint8_t warmups_since_clear;
+} obd2_vehicle_snapshot_t;
+
 // Function prototypes
 bool obd2_is_valid_request(uint32_t can_id);
-bool obd2_parse_message(uint8_t *can_data, uint8_t can_length, obd2_message_t *message);
+bool obd2_parse_message(const uint8_t *can_data, uint8_t can_length, obd2_message_t *message);
 bool obd2_create_response(obd2_message_t *request, obd2_response_t *response);
+
+// Point a response at the frame it is encoded into (nothing else is cleared)
+void obd2_response_init(obd2_response_t *response, uint8_t *frame);
+void obd2_response_set_header(obd2_response_t *response, uint8_t service, uint8_t pid);
+
 void obd2_create_error_response(uint8_t service, uint8_t error_code, obd2_response_t *response);
-uint8_t obd2_format_can_message(obd2_response_t *response, uint8_t *can_data);
+
+// Hand a pre-serialized [SID+40][byte][data...] response to the transmit path:
+// copied once into the frame, or a pointer hand-off to ISO-TP (which copies
+// it when the transfer starts)
+void obd2_set_payload_response(const uint8_t *payload, uint16_t length, obd2_response_t *response);
+
+// Write the PCI of a single-frame response; returns the CAN frame length
+uint8_t obd2_finish_can_message(obd2_response_t *response);
+
+// Encode the data bytes of a vehicle-data PID; returns 0 if not supported
+uint8_t obd2_encode_pid(uint8_t pid, const obd2_vehicle_snapshot_t *snapshot, uint8_t *data);
+
+// Encode a Service 01 supported-PID bitmap (PID 00, 20 or 40); returns 0 otherwise
+uint8_t obd2_encode_supported_pids(uint8_t pid, uint8_t *data);
+
+// Encode PID 01 (monitor status since DTCs cleared) from the MIL, the
+// stored DTC count and the non-continuous monitors' readiness bits; returns 4
+uint8_t obd2_encode_monitor_status(bool mil, uint16_t confirmed, uint8_t supported, uint8_t incomplete,
+                                   uint8_t *data);
 
 // Service handlers
 bool obd2_handle_service_01(obd2_message_t *request, obd2_response_t *response);
+bool obd2_handle_service_02(obd2_message_t *request, obd2_response_t *response);
 bool obd2_handle_service_03(obd2_message_t *request, obd2_response_t *response);
 bool obd2_handle_service_04(obd2_message_t *request, obd2_response_t *response);
+bool obd2_handle_service_06(obd2_message_t *request, obd2_response_t *response);
+bool obd2_handle_service_07(obd2_message_t *request, obd2_response_t *response);
+bool obd2_handle_service_0A(obd2_message_t *request, obd2_response_t *response);
 bool obd2_handle_service_09(obd2_message_t *request, obd2_response_t *response);
+bool obd2_handle_uds(obd2_message_t *request, obd2_response_t *response);
 
 // Vehicle data simulation functions
 uint8_t obd2_get_engine_load(void);
@@ -170,20 +247,26 @@ uint8_t obd2_get_short_fuel_trim_b1(void);
 uint8_t obd2_get_long_fuel_trim_b1(void);
 uint8_t obd2_get_timing_advance(void);
 
+// Persistent counters (restored from flash)
+uint16_t obd2_get_distance_with_mil(void);
+uint16_t obd2_get_distance_since_clear(void);
+uint8_t obd2_get_warmups_since_clear(void);
+uint32_t obd2_get_odometer(void);
+
+// Copy of the current vehicle state (no simulation step, safe from the tick)
+void obd2_capture_vehicle_snapshot(obd2_vehicle_snapshot_t *snapshot);
+
+// Changes whenever the vehicle state does (simulation tick, Service 04,
+// engine start/stop, restore); values encoded under one generation stay valid
+uint32_t obd2_get_vehicle_generation(void);
+
+// Service 01 memo statistics
+uint32_t obd2_get_pid_memo_hits(void);
+uint32_t obd2_get_pid_memo_misses(void);
+void obd2_reset_pid_memo_stats(void);
+
 // VIN handling
 const char* obd2_get_vin(void);
 void obd2_set_vin(const char* vin);
 
-// Multi-frame VIN transmission
-typedef struct {
-    bool active;
-    uint8_t frame_number;
-    uint8_t total_frames;
-    char vin_data[18];  // 17 chars + null terminator
-} vin_multiframe_t;
-
-extern vin_multiframe_t vin_transmission;
-bool obd2_handle_vin_multiframe(obd2_response_t *response);
-void obd2_start_vin_transmission(const char* vin);
-
 #endif // __OBD2_PROTOCOL_H__
@@ -0,0 +1,244 @@
+#include "obd2_sensor.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+#define TICKS_OF(ms)    (((ms) + OBD2_VEHICLE_TICK_MS - 1) / OBD2_VEHICLE_TICK_MS)
+#define NO_SLOT         0
+
+// Where each sensor signal lives in the vehicle model, and its electrical
+// rails in the signal's units (the range its PID can carry); size 0 marks
+// signals that are computed rather than sensed
+typedef struct {
+    const char *name;
+    uint8_t offset;
+    uint8_t size;
+    int32_t low;
+    int32_t high;
+} sensor_field_t;
+
+#define FIELD(name, member, low, high) \
+    { name, offsetof(obd2_vehicle_t, member), sizeof(((obd2_vehicle_t *)0)->member), low, high }
+
+static const sensor_field_t sensor_fields[OBD2_SIGNAL_COUNT] = {
+    [OBD2_SIGNAL_RPM]           = FIELD("RPM",   base_rpm,          0, 16383),
+    [OBD2_SIGNAL_SPEED]         = FIELD("SPEED", vehicle_speed,     0, 255),
+    [OBD2_SIGNAL_LOAD]          = FIELD("LOAD",  engine_load,       0, 100),
+    [OBD2_SIGNAL_COOLANT]       = FIELD("ECT",   coolant_temp,      0, 215),
+    [OBD2_SIGNAL_INTAKE_TEMP]   = FIELD("IAT",   intake_temp,       0, 215),
+    [OBD2_SIGNAL_THROTTLE]      = FIELD("TPS",   throttle_position, 0, 100),
+    [OBD2_SIGNAL_MAF]           = FIELD("MAF",   maf_flow_rate,     0, 65535),
+    [OBD2_SIGNAL_MAP]           = FIELD("MAP",   manifold_pressure, 0, 25500),
+    [OBD2_SIGNAL_FUEL_PRESSURE] = FIELD("FUELP", fuel_pressure,     0, 65535),
+    [OBD2_SIGNAL_O2_B1S1]       = FIELD("O2S1",  o2_sensor_b1s1,    0, 1275),
+    [OBD2_SIGNAL_O2_B1S2]       = FIELD("O2S2",  o2_sensor_b1s2,    0, 1275),
+    [OBD2_SIGNAL_FUEL_LEVEL]    = FIELD("FUEL",  fuel_level,        0, 100),
+};
+
+// Active faults are packed in faults[0..count); signal_index maps a signal to
+// its slot + 1 (0 = no fault)
+static struct {
+    obd2_sensor_fault_t faults[OBD2_SENSOR_MAX_FAULTS];
+    uint8_t count;
+    uint8_t signal_index[OBD2_SIGNAL_COUNT];
+} sensor_state;
+
+static uint32_t next_random(uint32_t *state)
+{
+    // xorshift32
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+static int32_t read_field(const obd2_vehicle_t *vehicle, const sensor_field_t *field)
+{
+    const uint8_t *p = (const uint8_t *)vehicle + field->offset;
+    return (field->size == 1) ? *p : *(const uint16_t *)p;
+}
+
+static void write_field(obd2_vehicle_t *vehicle, const sensor_field_t *field, int32_t value)
+{
+    uint8_t *p = (uint8_t *)vehicle + field->offset;
+
+    if (value < field->low) value = field->low;
+    if (value > field->high) value = field->high;
+    if (field->size == 1) {
+        *p = (uint8_t)value;
+    } else {
+        *(uint16_t *)p = (uint16_t)value;
+    }
+}
+
+void obd2_sensor_init(void)
+{
+    memset(&sensor_state, 0, sizeof(sensor_state));
+}
+
+bool obd2_sensor_inject(uint8_t signal, uint8_t mode, int32_t value, uint32_t duration_ms)
+{
+    if (signal >= OBD2_SIGNAL_COUNT || sensor_fields[signal].size == 0 ||
+        mode == OBD2_SENSOR_OK || mode > OBD2_SENSOR_DROPOUT ||
+        ((mode == OBD2_SENSOR_NOISE) && value <= 0) ||
+        ((mode == OBD2_SENSOR_DROPOUT) && (value <= 0 || value > 100))) {
+        return false;
+    }
+
+    uint8_t index = sensor_state.signal_index[signal];
+    if (index == NO_SLOT) {
+        index = ++sensor_state.count;
+        sensor_state.signal_index[signal] = index;
+    }
+
+    obd2_sensor_fault_t *fault = &sensor_state.faults[index - 1];
+    memset(fault, 0, sizeof(obd2_sensor_fault_t));
+    fault->signal = signal;
+    fault->mode = mode;
+    fault->value = value;
+    fault->duration_ticks = TICKS_OF(duration_ms);
+    fault->rng_state = 0x2545F491u ^ ((uint32_t)signal << 16) ^ (uint32_t)value;
+
+    printf("Sensor fault: %s %s %ld\r\n", sensor_fields[signal].name, obd2_sensor_mode_name(mode), (long)value);
+    return true;
+}
+
+bool obd2_sensor_clear(uint8_t signal)
+{
+    if (signal >= OBD2_SIGNAL_COUNT || sensor_state.signal_index[signal] == NO_SLOT) {
+        return false;
+    }
+    uint8_t index = sensor_state.signal_index[signal] - 1;
+
+    // Move the last fault into the hole to keep the active list packed
+    uint8_t last = --sensor_state.count;
+    if (index != last) {
+        sensor_state.faults[index] = sensor_state.faults[last];
+        sensor_state.signal_index[sensor_state.faults[index].signal] = index + 1;
+    }
+    sensor_state.signal_index[signal] = NO_SLOT;
+    return true;
+}
+
+void obd2_sensor_clear_all(void)
+{
+    sensor_state.count = 0;
+    memset(sensor_state.signal_index, 0, sizeof(sensor_state.signal_index));
+}
+
+bool obd2_sensor_apply(const obd2_vehicle_t *model, obd2_vehicle_t *sensed)
+{
+    if (sensor_state.count == 0) {
+        return false;
+    }
+
+    *sensed = *model;
+    for (uint8_t i = 0; i < sensor_state.count; ) {
+        obd2_sensor_fault_t *fault = &sensor_state.faults[i];
+        const sensor_field_t *field = &sensor_fields[fault->signal];
+        int32_t value = read_field(model, field);
+
+        // Timed faults (noise bursts) end by themselves
+        if (fault->duration_ticks != 0 && fault->ticks >= fault->duration_ticks) {
+            obd2_sensor_clear(fault->signal);
+            continue;
+        }
+        fault->ticks++;
+
+        switch (fault->mode) {
+            case OBD2_SENSOR_STUCK:
+                value = fault->value;
+                break;
+
+            case OBD2_SENSOR_DRIFT:
+                {
+                    // Offset in thousandths so slow drifts still move every tick
+                    int32_t limit = (field->high - field->low) * 1000;
+                    fault->offset += fault->value * OBD2_VEHICLE_TICK_MS;
+                    if (fault->offset > limit) fault->offset = limit;
+                    if (fault->offset < -limit) fault->offset = -limit;
+                    value += fault->offset / 1000;
+                }
+                break;
+
+            case OBD2_SENSOR_NOISE:
+                value += (int32_t)(next_random(&fault->rng_state) % (2 * (uint32_t)fault->value + 1)) - fault->value;
+                break;
+
+            case OBD2_SENSOR_OPEN:
+                value = field->low;
+                break;
+
+            case OBD2_SENSOR_SHORT:
+                value = field->high;
+                break;
+
+            case OBD2_SENSOR_DROPOUT:
+                if (next_random(&fault->rng_state) % 100 < (uint32_t)fault->value) {
+                    value = field->low;
+                }
+                break;
+
+            default:
+                break;
+        }
+
+        write_field(sensed, field, value);
+        i++;
+    }
+
+    return true;
+}
+
+uint8_t obd2_sensor_get_active_count(void)
+{
+    return sensor_state.count;
+}
+
+const obd2_sensor_fault_t* obd2_sensor_get_fault(uint8_t index)
+{
+    return (index < sensor_state.count) ? &sensor_state.faults[index] : NULL;
+}
+
+const char* obd2_sensor_mode_name(uint8_t mode)
+{
+    switch (mode) {
+        case OBD2_SENSOR_STUCK:   return "STUCK";
+        case OBD2_SENSOR_DRIFT:   return "DRIFT";
+        case OBD2_SENSOR_NOISE:   return "NOISE";
+        case OBD2_SENSOR_OPEN:    return "OPEN";
+        case OBD2_SENSOR_SHORT:   return "SHORT";
+        case OBD2_SENSOR_DROPOUT: return "DROPOUT";
+        default:                  return "OK";
+    }
+}
+
+const char* obd2_sensor_signal_name(uint8_t signal)
+{
+    return (signal < OBD2_SIGNAL_COUNT && sensor_fields[signal].name != NULL) ? sensor_fields[signal].name : "?";
+}
+
+bool obd2_sensor_parse_signal(const char *name, uint8_t *signal)
+{
+    for (uint8_t i = 0; i < OBD2_SIGNAL_COUNT; i++) {
+        if (sensor_fields[i].name != NULL && strcasecmp(name, sensor_fields[i].name) == 0) {
+            *signal = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool obd2_sensor_parse_mode(const char *name, uint8_t *mode)
+{
+    for (uint8_t m = OBD2_SENSOR_STUCK; m <= OBD2_SENSOR_DROPOUT; m++) {
+        if (strcasecmp(name, obd2_sensor_mode_name(m)) == 0) {
+            *mode = m;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,60 @@
+#ifndef __OBD2_SENSOR_H__
+#define __OBD2_SENSOR_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "obd2_vehicle.h"
+#include "obd2_fault.h"
+
+// Sensor-level fault injection
+//
+// A sensor fault corrupts what the ECU reads for one signal, not the
+// simulated engine itself: each tick the firmware copies the model into a
+// "sensed" vehicle, applies the active faults to it, and serves PIDs, freeze
+// frames, monitors and the fault rules from that copy. A MAF stuck low thus
+// shows in PID 0x10 and sets P0102 through its rule like a real one would.
+// Active faults are kept densely packed and only they are visited; with none
+// active the tick is a single compare and the model is read directly.
+
+#define OBD2_SENSOR_MAX_FAULTS      OBD2_SIGNAL_COUNT   // One per signal
+
+typedef enum {
+    OBD2_SENSOR_OK = 0,
+    OBD2_SENSOR_STUCK,          // Reads a constant (value)
+    OBD2_SENSOR_DRIFT,          // Offset grows by value per second
+    OBD2_SENSOR_NOISE,          // Uniform noise of +-value
+    OBD2_SENSOR_OPEN,           // Reads the low rail
+    OBD2_SENSOR_SHORT,          // Reads the high rail
+    OBD2_SENSOR_DROPOUT         // Reads the low rail on value percent of ticks
+} obd2_sensor_mode_t;
+
+typedef struct {
+    uint8_t signal;             // obd2_signal_t
+    uint8_t mode;               // obd2_sensor_mode_t
+    int32_t value;              // Mode parameter, in the signal's units (see obd2_fault.h)
+    int32_t offset;             // Drift so far (value * ticks)
+    uint32_t ticks;             // Ticks active
+    uint32_t duration_ticks;    // Fault clears itself after this (0 = until cleared)
+    uint32_t rng_state;
+} obd2_sensor_fault_t;
+
+// Initialization, and the per-tick step: copies model into sensed with the
+// active faults applied; false (sensed untouched) when no fault is active
+void obd2_sensor_init(void);
+bool obd2_sensor_apply(const obd2_vehicle_t *model, obd2_vehicle_t *sensed);
+
+// Fault control; false for a signal that is not a sensor (trims, runtime) or
+// an invalid mode parameter. duration_ms 0 keeps the fault until cleared.
+bool obd2_sensor_inject(uint8_t signal, uint8_t mode, int32_t value, uint32_t duration_ms);
+bool obd2_sensor_clear(uint8_t signal);
+void obd2_sensor_clear_all(void);
+
+// Query
+uint8_t obd2_sensor_get_active_count(void);
+const obd2_sensor_fault_t* obd2_sensor_get_fault(uint8_t index);
+const char* obd2_sensor_mode_name(uint8_t mode);
+const char* obd2_sensor_signal_name(uint8_t signal);
+bool obd2_sensor_parse_signal(const char *name, uint8_t *signal);
+bool obd2_sensor_parse_mode(const char *name, uint8_t *mode);
+
+#endif // __OBD2_SENSOR_H__
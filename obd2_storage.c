@@ -0,0 +1,462 @@
+#include "obd2_storage.h"
+#include "pico/stdlib.h"
+#include "pico/flash.h"
+#include "hardware/flash.h"
+#include <stdio.h>
+#include <string.h>
+
+_Static_assert(OBD2_STORAGE_SECTOR_COUNT >= 3, "Log needs an active, a fallback and a spare sector");
+_Static_assert(OBD2_STORAGE_MAX_RECORD + 3 <= FLASH_PAGE_SIZE, "Records must fit in one flash page");
+
+// Flash layout: the log occupies the last sectors of the device
+#define STORAGE_SIZE            (OBD2_STORAGE_SECTOR_COUNT * FLASH_SECTOR_SIZE)
+#define STORAGE_OFFSET          (PICO_FLASH_SIZE_BYTES - STORAGE_SIZE)
+#define STORAGE_MAGIC           0x4C44424Fu     // "OBDL"
+#define SECTOR_HEADER_SIZE      16
+#define RECORD_OVERHEAD         3               // Type, length, checksum
+#define FLASH_TIMEOUT_MS        100
+
+typedef struct {
+    uint32_t magic;
+    uint32_t generation;        // Increases with every compaction
+    uint32_t generation_check;  // ~generation, detects torn headers
+    uint32_t reserved;
+} sector_header_t;
+
+_Static_assert(sizeof(sector_header_t) == SECTOR_HEADER_SIZE, "Sector header layout");
+
+typedef struct {
+    uint32_t offset;
+    const uint8_t *data;
+} flash_op_t;
+
+// Storage state
+static struct {
+    struct {
+        uint8_t first_type;
+        uint8_t last_type;
+        obd2_storage_restore_fn restore;
+        obd2_storage_snapshot_fn snapshot;
+    } clients[OBD2_STORAGE_MAX_CLIENTS];
+    uint8_t client_count;
+
+    // Encoded records waiting for flash (ring buffer)
+    uint8_t queue[OBD2_STORAGE_QUEUE_SIZE];
+    uint16_t queue_head;
+    uint16_t queue_used;
+
+    // Image of the flash page currently being appended to
+    uint8_t page[FLASH_PAGE_SIZE];
+
+    bool ready;
+    bool restoring;
+    uint8_t active_sector;
+    uint32_t generation;
+    uint32_t write_offset;      // Next free byte within the active sector
+    uint8_t spare_sector;       // Next sector to compact into
+    bool spare_erased;
+    bool compaction_requested;
+    uint32_t compaction_retry_ms;   // No compaction before this (after a failed one)
+    uint16_t commit_remaining;  // Queued snapshot bytes not yet in flash
+
+    uint32_t records_restored;
+    uint32_t records_written;
+    uint32_t pages_programmed;
+    uint32_t sectors_erased;
+    uint32_t compactions;
+    uint32_t records_dropped;
+} storage;
+
+static inline const uint8_t *sector_data(uint8_t sector)
+{
+    return (const uint8_t *)(XIP_BASE + STORAGE_OFFSET + sector * FLASH_SECTOR_SIZE);
+}
+
+static uint8_t record_checksum(uint8_t type, uint8_t length, const uint8_t *data)
+{
+    // CRC-8 (polynomial 0x07) over type, length and payload
+    uint8_t crc = 0;
+    uint8_t header[2] = {type, length};
+
+    for (int i = 0; i < 2 + length; i++) {
+        crc ^= (i < 2) ? header[i] : data[i - 2];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+// Flash operations run with interrupts (and the other core) held off
+
+static void do_program(void *param)
+{
+    flash_op_t *op = param;
+    flash_range_program(op->offset, op->data, FLASH_PAGE_SIZE);
+}
+
+static void do_erase(void *param)
+{
+    flash_op_t *op = param;
+    flash_range_erase(op->offset, FLASH_SECTOR_SIZE);
+}
+
+static bool program_page(uint8_t sector, uint32_t page_offset)
+{
+    flash_op_t op = {
+        .offset = STORAGE_OFFSET + sector * FLASH_SECTOR_SIZE + page_offset,
+        .data = storage.page
+    };
+
+    if (flash_safe_execute(do_program, &op, FLASH_TIMEOUT_MS) != PICO_OK) {
+        printf("Storage: page program failed at 0x%08lX\r\n", (unsigned long)op.offset);
+        return false;
+    }
+    storage.pages_programmed++;
+    return true;
+}
+
+static bool erase_sector(uint8_t sector)
+{
+    flash_op_t op = { .offset = STORAGE_OFFSET + sector * FLASH_SECTOR_SIZE };
+
+    if (flash_safe_execute(do_erase, &op, FLASH_TIMEOUT_MS) != PICO_OK) {
+        printf("Storage: erase of sector %u failed\r\n", sector);
+        return false;
+    }
+    storage.sectors_erased++;
+    return true;
+}
+
+static bool sector_is_erased(uint8_t sector)
+{
+    const uint32_t *words = (const uint32_t *)sector_data(sector);
+
+    for (uint32_t i = 0; i < FLASH_SECTOR_SIZE / 4; i++) {
+        if (words[i] != 0xFFFFFFFFu) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool read_header(uint8_t sector, uint32_t *generation)
+{
+    sector_header_t header;
+
+    memcpy(&header, sector_data(sector), sizeof(header));
+    if (header.magic != STORAGE_MAGIC || header.generation_check != ~header.generation) {
+        return false;
+    }
+    *generation = header.generation;
+    return true;
+}
+
+// Walk the records of a sector. Returns the offset after the last valid record
+// and whether the sector's snapshot was committed. With replay set, records
+// are handed to their clients.
+static uint32_t scan_sector(uint8_t sector, bool replay, bool *committed)
+{
+    const uint8_t *data = sector_data(sector);
+    uint32_t pos = SECTOR_HEADER_SIZE;
+
+    *committed = false;
+
+    while (pos + RECORD_OVERHEAD <= FLASH_SECTOR_SIZE) {
+        uint8_t type = data[pos];
+        uint32_t page_end = (pos & ~(FLASH_PAGE_SIZE - 1)) + FLASH_PAGE_SIZE;
+
+        if (type == OBD2_RECORD_ERASED) {
+            break;
+        }
+        if (type == OBD2_RECORD_PAD) {
+            pos = page_end;
+            continue;
+        }
+
+        uint8_t length = data[pos + 1];
+        if (pos + RECORD_OVERHEAD + length > page_end ||
+            record_checksum(type, length, &data[pos + 2]) != data[pos + 2 + length]) {
+            // Torn write: nothing after this point can be trusted
+            return page_end;
+        }
+
+        if (type == OBD2_RECORD_SNAPSHOT_END) {
+            *committed = true;
+        } else if (replay) {
+            for (uint8_t i = 0; i < storage.client_count; i++) {
+                if (type >= storage.clients[i].first_type && type <= storage.clients[i].last_type) {
+                    storage.clients[i].restore(type, &data[pos + 2], length);
+                    storage.records_restored++;
+                    break;
+                }
+            }
+        }
+        pos += RECORD_OVERHEAD + length;
+    }
+
+    return pos;
+}
+
+// Queue helpers
+
+static inline uint8_t queue_peek(uint16_t offset)
+{
+    return storage.queue[(storage.queue_head + offset) % OBD2_STORAGE_QUEUE_SIZE];
+}
+
+static void queue_pop(uint8_t *dest, uint16_t length)
+{
+    for (uint16_t i = 0; i < length; i++) {
+        dest[i] = storage.queue[storage.queue_head];
+        storage.queue_head = (storage.queue_head + 1) % OBD2_STORAGE_QUEUE_SIZE;
+    }
+    storage.queue_used -= length;
+}
+
+bool obd2_storage_register(uint8_t first_type, uint8_t last_type,
+                           obd2_storage_restore_fn restore, obd2_storage_snapshot_fn snapshot)
+{
+    if (storage.client_count >= OBD2_STORAGE_MAX_CLIENTS || restore == NULL || snapshot == NULL) {
+        return false;
+    }
+
+    storage.clients[storage.client_count].first_type = first_type;
+    storage.clients[storage.client_count].last_type = last_type;
+    storage.clients[storage.client_count].restore = restore;
+    storage.clients[storage.client_count].snapshot = snapshot;
+    storage.client_count++;
+    return true;
+}
+
+bool obd2_storage_append(uint8_t type, const void *data, uint8_t length)
+{
+    if (storage.restoring) {
+        return true;  // Replayed state is already in flash
+    }
+
+    if (length > OBD2_STORAGE_MAX_RECORD ||
+        storage.queue_used + RECORD_OVERHEAD + length > OBD2_STORAGE_QUEUE_SIZE) {
+        // Flash no longer matches RAM: re-snapshot everything into a new sector
+        storage.records_dropped++;
+        storage.compaction_requested = true;
+        return false;
+    }
+
+    uint16_t tail = (storage.queue_head + storage.queue_used) % OBD2_STORAGE_QUEUE_SIZE;
+    const uint8_t *bytes = data;
+
+    storage.queue[tail] = type;
+    storage.queue[(tail + 1) % OBD2_STORAGE_QUEUE_SIZE] = length;
+    for (uint8_t i = 0; i < length; i++) {
+        storage.queue[(tail + 2 + i) % OBD2_STORAGE_QUEUE_SIZE] = bytes[i];
+    }
+    storage.queue[(tail + 2 + length) % OBD2_STORAGE_QUEUE_SIZE] = record_checksum(type, length, bytes);
+    storage.queue_used += RECORD_OVERHEAD + length;
+    return true;
+}
+
+// Start a new sector: header, then a full snapshot from every client. Records
+// still queued for the old sector are already reflected in the snapshot.
+static void begin_compaction(void)
+{
+    sector_header_t header;
+    uint32_t dropped = storage.records_dropped;
+
+    storage.queue_head = 0;
+    storage.queue_used = 0;
+    storage.compaction_requested = false;
+
+    for (uint8_t i = 0; i < storage.client_count; i++) {
+        storage.clients[i].snapshot();
+    }
+
+    if (storage.records_dropped != dropped) {
+        // Snapshot did not fit: nothing reaches flash, boot keeps the previous
+        // sector and the spare stays erased. Nothing is programmed until a
+        // later attempt (the state may have shrunk by then) commits.
+        printf("Storage: snapshot exceeds queue, compaction retried in %u ms\r\n", OBD2_STORAGE_RETRY_MS);
+        storage.queue_used = 0;
+        storage.compaction_requested = true;
+        storage.compaction_retry_ms = to_ms_since_boot(get_absolute_time()) + OBD2_STORAGE_RETRY_MS;
+        return;
+    }
+    obd2_storage_append(OBD2_RECORD_SNAPSHOT_END, NULL, 0);
+    storage.commit_remaining = storage.queue_used;
+
+    storage.active_sector = storage.spare_sector;
+    storage.generation++;
+    header.magic = STORAGE_MAGIC;
+    header.generation = storage.generation;
+    header.generation_check = ~storage.generation;
+    header.reserved = 0xFFFFFFFFu;
+    memset(storage.page, 0xFF, sizeof(storage.page));
+    memcpy(storage.page, &header, sizeof(header));
+    storage.write_offset = SECTOR_HEADER_SIZE;
+
+    // The sector after the new one holds the oldest data and becomes the spare
+    storage.spare_sector = (storage.active_sector + 1) % OBD2_STORAGE_SECTOR_COUNT;
+    storage.spare_erased = false;
+    storage.compactions++;
+}
+
+// Move as many queued records as fit into the current page and program it
+static void program_next_page(void)
+{
+    uint32_t page_start = storage.write_offset & ~(FLASH_PAGE_SIZE - 1);
+    uint16_t pos = storage.write_offset - page_start;
+    uint16_t start = pos;
+    uint16_t consumed = 0;
+
+    if (storage.write_offset >= FLASH_SECTOR_SIZE) {
+        storage.compaction_requested = true;
+        return;
+    }
+
+    while (storage.queue_used > 0) {
+        uint16_t total = RECORD_OVERHEAD + queue_peek(1);
+
+        if (pos + total > FLASH_PAGE_SIZE) {
+            if (page_start + FLASH_PAGE_SIZE >= FLASH_SECTOR_SIZE) {
+                storage.compaction_requested = true;
+            }
+            storage.page[pos] = OBD2_RECORD_PAD;
+            pos = FLASH_PAGE_SIZE;
+            break;
+        }
+
+        queue_pop(&storage.page[pos], total);
+        pos += total;
+        consumed += total;
+        storage.records_written++;
+    }
+
+    if (pos == start || !program_page(storage.active_sector, page_start)) {
+        return;
+    }
+
+    if (storage.commit_remaining > 0) {
+        storage.commit_remaining = (consumed >= storage.commit_remaining) ? 0 : storage.commit_remaining - consumed;
+    }
+
+    if (pos >= FLASH_PAGE_SIZE) {
+        storage.write_offset = page_start + FLASH_PAGE_SIZE;
+        memset(storage.page, 0xFF, sizeof(storage.page));
+    } else {
+        storage.write_offset = page_start + pos;
+    }
+}
+
+bool obd2_storage_init(void)
+{
+    int8_t best = -1;
+    uint32_t best_generation = 0;
+    uint32_t max_generation = 0;
+    uint64_t start = time_us_64();
+    bool committed;
+
+    storage.restoring = true;
+
+    // Newest committed sector wins; older ones are fallbacks
+    for (uint8_t sector = 0; sector < OBD2_STORAGE_SECTOR_COUNT; sector++) {
+        uint32_t generation;
+        if (!read_header(sector, &generation)) {
+            continue;
+        }
+        if (generation > max_generation) {
+            max_generation = generation;
+        }
+        scan_sector(sector, false, &committed);
+        if (committed && (best < 0 || generation > best_generation)) {
+            best = sector;
+            best_generation = generation;
+        }
+    }
+
+    storage.generation = max_generation;
+
+    if (best >= 0) {
+        storage.active_sector = best;
+        storage.write_offset = scan_sector(best, true, &committed);
+
+        // Resume appending inside the partially written page
+        memset(storage.page, 0xFF, sizeof(storage.page));
+        if (storage.write_offset < FLASH_SECTOR_SIZE) {
+            uint32_t page_start = storage.write_offset & ~(FLASH_PAGE_SIZE - 1);
+            memcpy(storage.page, sector_data(best) + page_start, storage.write_offset - page_start);
+        }
+
+        storage.spare_sector = (best + 1) % OBD2_STORAGE_SECTOR_COUNT;
+        storage.spare_erased = sector_is_erased(storage.spare_sector);
+    } else {
+        // Empty or foreign flash: snapshot the default state on first service
+        storage.spare_sector = 0;
+        storage.spare_erased = sector_is_erased(0);
+        storage.compaction_requested = true;
+    }
+
+    storage.restoring = false;
+    storage.ready = true;
+
+    printf("Storage initialized: %lu records restored in %lu us (%s)\r\n",
+           (unsigned long)storage.records_restored, (unsigned long)(time_us_64() - start),
+           best >= 0 ? "log found" : "empty");
+    return best >= 0;
+}
+
+void obd2_storage_service(uint32_t bus_idle_ms)
+{
+    bool queue_pressure = storage.queue_used > (OBD2_STORAGE_QUEUE_SIZE * 3) / 4;
+
+    if (!storage.ready) {
+        return;
+    }
+
+    // At most one flash operation per call
+
+    if (storage.compaction_requested && storage.spare_erased &&
+        (int32_t)(to_ms_since_boot(get_absolute_time()) - storage.compaction_retry_ms) >= 0) {
+        begin_compaction();
+    }
+
+    if (storage.queue_used > 0 && !storage.compaction_requested) {
+        if (bus_idle_ms >= OBD2_STORAGE_PROGRAM_IDLE_MS || queue_pressure) {
+            program_next_page();
+        }
+        return;
+    }
+
+    // Erasing takes tens of milliseconds, so keep the spare ready during quiet periods
+    if (!storage.spare_erased &&
+        (bus_idle_ms >= OBD2_STORAGE_ERASE_IDLE_MS || (storage.compaction_requested && queue_pressure))) {
+        storage.spare_erased = erase_sector(storage.spare_sector);
+    }
+}
+
+bool obd2_storage_is_restoring(void)
+{
+    return storage.restoring;
+}
+
+bool obd2_storage_is_pending(void)
+{
+    return storage.queue_used > 0 || storage.compaction_requested || storage.commit_remaining > 0;
+}
+
+void obd2_storage_stats(void)
+{
+    printf("\r\n=== Persistent Storage ===\r\n");
+    printf("Region: 0x%08lX, %u sectors\r\n", (unsigned long)STORAGE_OFFSET, OBD2_STORAGE_SECTOR_COUNT);
+    printf("Active Sector: %u (generation %lu), %lu/%u bytes used\r\n",
+           storage.active_sector, (unsigned long)storage.generation,
+           (unsigned long)storage.write_offset, FLASH_SECTOR_SIZE);
+    printf("Spare Sector: %u (%s)\r\n", storage.spare_sector, storage.spare_erased ? "erased" : "needs erase");
+    printf("Queued: %u bytes%s\r\n", storage.queue_used, storage.commit_remaining ? " (snapshot uncommitted)" : "");
+    printf("Records Restored: %lu, Written: %lu, Dropped: %lu\r\n",
+           (unsigned long)storage.records_restored, (unsigned long)storage.records_written,
+           (unsigned long)storage.records_dropped);
+    printf("Pages Programmed: %lu, Sectors Erased: %lu, Compactions: %lu\r\n",
+           (unsigned long)storage.pages_programmed, (unsigned long)storage.sectors_erased,
+           (unsigned long)storage.compactions);
+    printf("==========================\r\n\r\n");
+}
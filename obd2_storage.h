@@ -0,0 +1,62 @@
+#ifndef __OBD2_STORAGE_H__
+#define __OBD2_STORAGE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Log-structured persistent storage in the last sectors of flash
+//
+// Modules append small typed records (DTC changes, VIN, counters, freeze
+// frames) to a RAM queue; obd2_storage_service() moves them to flash one page
+// at a time while the CAN bus is quiet. Each sector starts with a full state
+// snapshot followed by delta records, so when the active sector fills the
+// state is re-snapshotted into the next (pre-erased) sector and the old ones
+// are erased in the background. Sectors are used round robin for wear
+// levelling. At boot only the newest committed sector is replayed.
+
+#define OBD2_STORAGE_SECTOR_COUNT       8       // Flash sectors reserved for the log
+#define OBD2_STORAGE_QUEUE_SIZE         4096    // RAM bytes waiting to be programmed
+#define OBD2_STORAGE_MAX_RECORD         64      // Largest record payload
+#define OBD2_STORAGE_MAX_CLIENTS        8       // Modules that persist state
+#define OBD2_STORAGE_PROGRAM_IDLE_MS    2       // Bus idle time before a page program
+#define OBD2_STORAGE_ERASE_IDLE_MS      250     // Bus idle time before a sector erase
+
+// Wait before compacting again after a snapshot did not fit the queue
+#ifndef OBD2_STORAGE_RETRY_MS
+#define OBD2_STORAGE_RETRY_MS           10000
+#endif
+
+// Record types
+#define OBD2_RECORD_PAD                 0x00    // Skip to the next flash page
+#define OBD2_RECORD_SNAPSHOT_END        0x01    // Sector snapshot is complete
+#define OBD2_RECORD_DTC_SET             0x10    // [code hi][code lo][status][flags][passed][aging]
+#define OBD2_RECORD_DTC_REMOVE          0x11    // [code hi][code lo]
+#define OBD2_RECORD_DTC_CLEAR           0x12    // [scope] Service 04 or full clear
+#define OBD2_RECORD_VIN                 0x20    // 17 VIN characters
+#define OBD2_RECORD_COUNTERS            0x21    // Odometer and since-clear counters
+#define OBD2_RECORD_FREEZE_FRAME        0x30    // Freeze frame snapshot
+#define OBD2_RECORD_ERASED              0xFF    // End of written data
+
+// Client callbacks: restore is called for every replayed record of the
+// client's types, snapshot must append the client's complete current state.
+typedef void (*obd2_storage_restore_fn)(uint8_t type, const uint8_t *data, uint8_t length);
+typedef void (*obd2_storage_snapshot_fn)(void);
+
+// Registration (before obd2_storage_init)
+bool obd2_storage_register(uint8_t first_type, uint8_t last_type,
+                           obd2_storage_restore_fn restore, obd2_storage_snapshot_fn snapshot);
+
+// Initialization replays the log (true if saved state was found); service
+// moves queued records to flash
+bool obd2_storage_init(void);
+void obd2_storage_service(uint32_t bus_idle_ms);
+
+// Append a record (queued, never touches flash directly)
+bool obd2_storage_append(uint8_t type, const void *data, uint8_t length);
+bool obd2_storage_is_restoring(void);
+bool obd2_storage_is_pending(void);
+
+// Statistics
+void obd2_storage_stats(void);
+
+#endif // __OBD2_STORAGE_H__
@@ -0,0 +1,275 @@
+#include "obd2_timer.h"
+#include "pico/stdlib.h"
+#include <stddef.h>
+
+#define TIMER_SLOTS         (1u << OBD2_TIMER_SLOT_BITS)
+#define TIMER_SLOT_MASK     (TIMER_SLOTS - 1)
+#define TIMER_EXPIRING      OBD2_TIMER_LEVELS   // Level of timers taken off the wheel to run
+#define TIMER_MAX_TICKS     ((1u << (OBD2_TIMER_SLOT_BITS * OBD2_TIMER_LEVELS)) - 1)
+
+// Wheel state
+static struct {
+    obd2_timer_t *slots[OBD2_TIMER_LEVELS][TIMER_SLOTS];
+    uint64_t occupied[OBD2_TIMER_LEVELS];   // Non-empty slots, one bit each
+    obd2_timer_t *expiring;     // Timers of the tick being run
+    uint32_t current;           // Next tick to run
+    bool running;               // Inside obd2_timer_process()
+    uint16_t pending;
+    uint32_t expired;
+} wheel;
+
+static uint32_t ticks_at(uint64_t time_us)
+{
+    return (uint32_t)(time_us / OBD2_TIMER_TICK_US);
+}
+
+static obd2_timer_t** list_of(const obd2_timer_t *timer)
+{
+    if (timer->level == TIMER_EXPIRING) {
+        return &wheel.expiring;
+    }
+    return &wheel.slots[timer->level][timer->slot];
+}
+
+static void list_push(obd2_timer_t **list, obd2_timer_t *timer)
+{
+    timer->prev = NULL;
+    timer->next = *list;
+    if (*list != NULL) {
+        (*list)->prev = timer;
+    }
+    *list = timer;
+}
+
+static void list_remove(obd2_timer_t *timer)
+{
+    obd2_timer_t **list = list_of(timer);
+
+    if (timer->prev != NULL) {
+        timer->prev->next = timer->next;
+    } else {
+        *list = timer->next;
+    }
+    if (timer->next != NULL) {
+        timer->next->prev = timer->prev;
+    }
+    if (*list == NULL && timer->level != TIMER_EXPIRING) {
+        wheel.occupied[timer->level] &= ~(1ull << timer->slot);
+    }
+}
+
+// File a timer by how far away it is: level L holds timers due within
+// 64^(L+1) ticks, in the slot of their expiry at that level's resolution
+static void wheel_insert(obd2_timer_t *timer)
+{
+    uint32_t delta = timer->expires - wheel.current;
+    uint32_t position = timer->expires;
+    uint8_t level = 0;
+
+    if ((int32_t)delta < 0) {
+        // Already due: run with the next tick
+        position = wheel.current;
+        delta = 0;
+    } else if (delta > TIMER_MAX_TICKS) {
+        position = wheel.current + TIMER_MAX_TICKS;
+        delta = TIMER_MAX_TICKS;
+        timer->expires = position;
+    }
+
+    while (level < OBD2_TIMER_LEVELS - 1 && delta >= (1u << (OBD2_TIMER_SLOT_BITS * (level + 1)))) {
+        level++;
+    }
+
+    timer->level = level;
+    timer->slot = (position >> (OBD2_TIMER_SLOT_BITS * level)) & TIMER_SLOT_MASK;
+    list_push(&wheel.slots[level][timer->slot], timer);
+    wheel.occupied[level] |= 1ull << timer->slot;
+}
+
+static void start_timer(obd2_timer_t *timer, uint32_t delay_us, uint32_t period_ticks,
+                        obd2_timer_fn callback, void *context)
+{
+    uint64_t now_us = time_us_64();
+
+    obd2_timer_cancel(timer);
+
+    // An empty wheel has nothing to catch up on
+    if (wheel.pending == 0 && !wheel.running) {
+        wheel.current = ticks_at(now_us);
+    }
+
+    // Round up so a timer never expires before its delay has passed
+    timer->expires = ticks_at(now_us + delay_us + OBD2_TIMER_TICK_US - 1);
+    timer->period = period_ticks;
+    timer->callback = callback;
+    timer->context = context;
+    timer->overruns = 0;
+    timer->pending = true;
+    wheel.pending++;
+    wheel_insert(timer);
+}
+
+void obd2_timer_start(obd2_timer_t *timer, uint32_t delay_us, obd2_timer_fn callback, void *context)
+{
+    start_timer(timer, delay_us, 0, callback, context);
+}
+
+void obd2_timer_start_periodic(obd2_timer_t *timer, uint32_t period_us, obd2_timer_fn callback,
+                               void *context)
+{
+    uint32_t period_ticks = (period_us + OBD2_TIMER_TICK_US - 1) / OBD2_TIMER_TICK_US;
+
+    start_timer(timer, period_us, period_ticks > 0 ? period_ticks : 1, callback, context);
+}
+
+void obd2_timer_cancel(obd2_timer_t *timer)
+{
+    if (!timer->pending) {
+        return;
+    }
+    list_remove(timer);
+    timer->pending = false;
+    wheel.pending--;
+}
+
+bool obd2_timer_is_pending(const obd2_timer_t *timer)
+{
+    return timer->pending;
+}
+
+// Refile the timers of one slot now that they are closer
+static void cascade(uint8_t level, uint32_t slot)
+{
+    obd2_timer_t *timer = wheel.slots[level][slot];
+
+    wheel.slots[level][slot] = NULL;
+    wheel.occupied[level] &= ~(1ull << slot);
+    while (timer != NULL) {
+        obd2_timer_t *next = timer->next;
+        wheel_insert(timer);
+        timer = next;
+    }
+}
+
+static void run_expiring(uint32_t now)
+{
+    while (wheel.expiring != NULL) {
+        obd2_timer_t *timer = wheel.expiring;
+
+        list_remove(timer);
+        timer->pending = false;
+        wheel.pending--;
+        wheel.expired++;
+
+        // Re-armed before the callback so it can cancel or restart itself
+        if (timer->period != 0) {
+            timer->expires += timer->period;
+            if ((int32_t)(now - timer->expires) >= 0) {
+                uint32_t missed = (now - timer->expires) / timer->period + 1;
+                timer->overruns += missed;
+                timer->expires += missed * timer->period;
+            }
+            timer->pending = true;
+            wheel.pending++;
+            wheel_insert(timer);
+        }
+
+        timer->callback(timer->context);
+    }
+}
+
+void obd2_timer_process(void)
+{
+    uint32_t now = ticks_at(time_us_64());
+
+    if (wheel.running) {
+        return;
+    }
+    wheel.running = true;
+
+    while ((int32_t)(now - wheel.current) >= 0) {
+        uint32_t tick = wheel.current;
+
+        // Each time a level wraps, the next slot of the level above comes down
+        for (uint8_t level = 1; level < OBD2_TIMER_LEVELS; level++) {
+            if ((tick & ((1u << (OBD2_TIMER_SLOT_BITS * level)) - 1)) != 0) {
+                break;
+            }
+            cascade(level, (tick >> (OBD2_TIMER_SLOT_BITS * level)) & TIMER_SLOT_MASK);
+        }
+
+        // Take the tick's timers off the wheel before running any callback,
+        // so timers started from a callback are filed against the next tick
+        uint32_t slot = tick & TIMER_SLOT_MASK;
+        obd2_timer_t *timer = wheel.slots[0][slot];
+        wheel.slots[0][slot] = NULL;
+        wheel.occupied[0] &= ~(1ull << slot);
+        while (timer != NULL) {
+            obd2_timer_t *next = timer->next;
+            timer->level = TIMER_EXPIRING;
+            list_push(&wheel.expiring, timer);
+            timer = next;
+        }
+        wheel.current = tick + 1;
+        run_expiring(now);
+
+        // Skip empty slots up to the next timer, the next wrap or the present
+        uint32_t offset = wheel.current & TIMER_SLOT_MASK;
+        if (offset != 0 && (int32_t)(now - wheel.current) >= 0) {
+            uint64_t ahead = wheel.occupied[0] >> offset;
+            uint32_t skip = (ahead != 0) ? (uint32_t)__builtin_ctzll(ahead) : TIMER_SLOTS - offset;
+            if (skip > now + 1 - wheel.current) {
+                skip = now + 1 - wheel.current;
+            }
+            wheel.current += skip;
+        }
+    }
+
+    wheel.running = false;
+}
+
+uint32_t obd2_timer_next_due_us(uint32_t limit_us)
+{
+    if (wheel.pending == 0) {
+        return limit_us;
+    }
+
+    uint64_t now_us = time_us_64();
+    uint32_t now = ticks_at(now_us);
+
+    // Timers further out come down a level at the next wrap at the earliest
+    uint32_t due = (wheel.current + TIMER_SLOT_MASK) & ~TIMER_SLOT_MASK;
+    bool upper = false;
+    for (uint8_t level = 1; level < OBD2_TIMER_LEVELS; level++) {
+        upper |= wheel.occupied[level] != 0;
+    }
+
+    if (wheel.occupied[0] != 0) {
+        // Nearest occupied slot from the current tick onwards
+        uint32_t offset = wheel.current & TIMER_SLOT_MASK;
+        uint64_t rotated = wheel.occupied[0] >> offset;
+        if (offset != 0) {
+            rotated |= wheel.occupied[0] << (TIMER_SLOTS - offset);
+        }
+        uint32_t nearest = wheel.current + __builtin_ctzll(rotated);
+        if (!upper || (int32_t)(nearest - due) < 0) {
+            due = nearest;
+        }
+    }
+
+    if ((int32_t)(due - now) <= 0) {
+        return 0;
+    }
+    uint64_t wait_us = (uint64_t)(due - now) * OBD2_TIMER_TICK_US - now_us % OBD2_TIMER_TICK_US;
+    return (wait_us < limit_us) ? (uint32_t)wait_us : limit_us;
+}
+
+uint16_t obd2_timer_get_pending_count(void)
+{
+    return wheel.pending;
+}
+
+uint32_t obd2_timer_get_expired_count(void)
+{
+    return wheel.expired;
+}
@@ -0,0 +1,65 @@
+#ifndef __OBD2_TIMER_H__
+#define __OBD2_TIMER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Timer wheel
+//
+// Every timed action of the emulator - the simulation tick (and fault rules),
+// periodic transmission, ISO-TP timeouts and STmin pacing, NRC 0x78
+// keepalives, session timeouts and the user interface - is a timer here
+// instead of a clock comparison of its own. The wheel is hierarchical: four
+// levels of 64 slots at 100 us, 6.4 ms, 410 ms and 26 s resolution (delays
+// up to 27 minutes), so starting, cancelling and expiring a timer are
+// constant time and timers further out move down a level each time the
+// level below wraps. Callbacks run from obd2_timer_process() in the main
+// loop, never in interrupt context, and may start or cancel any timer
+// including their own.
+//
+// Timers are embedded in their owner's state and must not be moved or
+// cleared while pending.
+
+#define OBD2_TIMER_TICK_US      100     // Wheel resolution (the finest ISO-TP STmin)
+#define OBD2_TIMER_LEVELS       4
+#define OBD2_TIMER_SLOT_BITS    6       // 64 slots per level
+
+typedef void (*obd2_timer_fn)(void *context);
+
+typedef struct obd2_timer {
+    struct obd2_timer *next;    // Slot list
+    struct obd2_timer *prev;
+    uint32_t expires;           // Wheel tick
+    uint32_t period;            // Ticks between expiries, 0 = one-shot
+    obd2_timer_fn callback;
+    void *context;
+    uint32_t overruns;          // Periods skipped because the loop was late
+    uint8_t level;
+    uint8_t slot;
+    bool pending;
+} obd2_timer_t;
+
+// One-shot timer; restarting a pending timer moves it
+void obd2_timer_start(obd2_timer_t *timer, uint32_t delay_us, obd2_timer_fn callback, void *context);
+
+// Repeating timer, first expiry one period from now. It stays on its
+// period grid; if the loop falls a whole period behind, the missed expiries
+// are dropped and counted in overruns instead of run back to back.
+void obd2_timer_start_periodic(obd2_timer_t *timer, uint32_t period_us, obd2_timer_fn callback,
+                               void *context);
+
+void obd2_timer_cancel(obd2_timer_t *timer);
+bool obd2_timer_is_pending(const obd2_timer_t *timer);
+
+// Run every timer that is due; reads the clock once
+void obd2_timer_process(void);
+
+// Microseconds until the next timer is due (0 if one is already due), at
+// most limit_us; how long the main loop may sleep
+uint32_t obd2_timer_next_due_us(uint32_t limit_us);
+
+// Statistics
+uint16_t obd2_timer_get_pending_count(void);
+uint32_t obd2_timer_get_expired_count(void);
+
+#endif // __OBD2_TIMER_H__
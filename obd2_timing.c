@@ -0,0 +1,116 @@
+#include "obd2_timing.h"
+#include "obd2_protocol.h"
+#include <string.h>
+
+// Timing state
+static struct {
+    obd2_timing_profile_t profiles[OBD2_TIMING_MAX_ECUS];
+    uint32_t rng_state;
+} timing_state;
+
+static obd2_timing_profile_t* profile_of(uint32_t ecu_id)
+{
+    if (ecu_id < OBD2_RESPONSE_ID_BASE || ecu_id >= OBD2_RESPONSE_ID_BASE + OBD2_TIMING_MAX_ECUS) {
+        return NULL;
+    }
+    return &timing_state.profiles[ecu_id - OBD2_RESPONSE_ID_BASE];
+}
+
+static uint32_t next_random(void)
+{
+    // xorshift32
+    uint32_t x = timing_state.rng_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    timing_state.rng_state = x;
+    return x;
+}
+
+void obd2_timing_init(void)
+{
+    memset(&timing_state, 0, sizeof(timing_state));
+    timing_state.rng_state = 0x9E3779B9u;
+}
+
+bool obd2_timing_set_profile(uint32_t ecu_id, const obd2_timing_profile_t *profile)
+{
+    obd2_timing_profile_t *slot = profile_of(ecu_id);
+    if (slot == NULL || profile->mode > OBD2_TIMING_NORMAL || profile->pending_percent > 100) {
+        return false;
+    }
+
+    *slot = *profile;
+    if (slot->pending_percent > 0 && slot->pending_ms == 0) {
+        slot->pending_ms = OBD2_TIMING_PENDING_MS;
+    }
+    return true;
+}
+
+const obd2_timing_profile_t* obd2_timing_get_profile(uint32_t ecu_id)
+{
+    return profile_of(ecu_id);
+}
+
+bool obd2_timing_is_immediate(uint32_t ecu_id)
+{
+    const obd2_timing_profile_t *profile = profile_of(ecu_id);
+    return profile == NULL ||
+           (profile->mode == OBD2_TIMING_IMMEDIATE && profile->pending_percent == 0);
+}
+
+uint32_t obd2_timing_sample_delay_us(uint32_t ecu_id)
+{
+    const obd2_timing_profile_t *profile = profile_of(ecu_id);
+    if (profile == NULL) {
+        return 0;
+    }
+
+    int64_t delay_us = (int64_t)profile->delay_ms * 1000;
+    int64_t jitter_us = (int64_t)profile->jitter_ms * 1000;
+
+    switch (profile->mode) {
+        case OBD2_TIMING_FIXED:
+            break;
+
+        case OBD2_TIMING_UNIFORM:
+            delay_us += next_random() % (uint32_t)(jitter_us + 1);
+            break;
+
+        case OBD2_TIMING_NORMAL:
+            {
+                // Sum of 12 uniforms less their mean: unit variance, close
+                // enough to normal within +-6 standard deviations
+                int64_t sum = 0;
+                for (int i = 0; i < 12; i++) {
+                    sum += next_random() & 0xFFFF;
+                }
+                delay_us += (sum - 12 * 32768) * jitter_us / 65536;
+                if (delay_us < 0) {
+                    delay_us = 0;
+                }
+            }
+            break;
+
+        default:
+            return 0;
+    }
+    return (uint32_t)delay_us;
+}
+
+bool obd2_timing_sample_pending(uint32_t ecu_id)
+{
+    const obd2_timing_profile_t *profile = profile_of(ecu_id);
+    return profile != NULL && profile->pending_percent > 0 &&
+           next_random() % 100 < profile->pending_percent;
+}
+
+const char* obd2_timing_mode_name(uint8_t mode)
+{
+    switch (mode) {
+        case OBD2_TIMING_FIXED:   return "FIXED";
+        case OBD2_TIMING_UNIFORM: return "UNIFORM";
+        case OBD2_TIMING_NORMAL:  return "NORMAL";
+        default:                  return "IMMEDIATE";
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef __OBD2_TIMING_H__
+#define __OBD2_TIMING_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// ECU response timing profiles
+//
+// By default a request is answered as soon as it is handled. A profile makes
+// an ECU answer like a slow or jittery real one: each request is held for a
+// delay drawn from the profile - fixed, uniform between two bounds, or normal
+// around a mean - measured from the frame's arrival, and answered when a
+// timer for that instant fires. Other requests, transfers and periodic frames
+// carry on in the meantime. A profile can also answer a share of requests
+// with NRC 0x78 (response pending) at that instant and the response itself
+// a further pending delay later.
+//
+// Profiles are kept per ECU response ID (0x7E8-0x7EF); this emulator answers
+// as OBD2_ECU_ID.
+
+#define OBD2_TIMING_MAX_ECUS        8
+#define OBD2_TIMING_PENDING_MS      200     // Default delay from NRC 0x78 to the response
+
+typedef enum {
+    OBD2_TIMING_IMMEDIATE = 0,  // Answer as soon as handled
+    OBD2_TIMING_FIXED,          // delay_ms
+    OBD2_TIMING_UNIFORM,        // delay_ms to delay_ms + jitter_ms
+    OBD2_TIMING_NORMAL          // Mean delay_ms, standard deviation jitter_ms
+} obd2_timing_mode_t;
+
+typedef struct {
+    uint8_t mode;               // obd2_timing_mode_t
+    uint8_t pending_percent;    // Requests answered with NRC 0x78 first
+    uint16_t delay_ms;
+    uint16_t jitter_ms;
+    uint16_t pending_ms;        // NRC 0x78 to the response
+} obd2_timing_profile_t;
+
+// Initialization (every ECU immediate)
+void obd2_timing_init(void);
+
+// Profile control; false if ecu_id is not 0x7E8-0x7EF
+bool obd2_timing_set_profile(uint32_t ecu_id, const obd2_timing_profile_t *profile);
+const obd2_timing_profile_t* obd2_timing_get_profile(uint32_t ecu_id);
+bool obd2_timing_is_immediate(uint32_t ecu_id);
+
+// Draw the response delay for one request (us), and whether it gets NRC 0x78 first
+uint32_t obd2_timing_sample_delay_us(uint32_t ecu_id);
+bool obd2_timing_sample_pending(uint32_t ecu_id);
+
+const char* obd2_timing_mode_name(uint8_t mode);
+
+#endif // __OBD2_TIMING_H__
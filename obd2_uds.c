@@ -0,0 +1,458 @@
+#include "obd2_uds.h"
+#include "obd2_dtc.h"
+#include "obd2_override.h"
+#include "obd2_vehinfo.h"
+#include "obd2_handler.h"
+#include "obd2_isotp.h"
+#include "obd2_periodic.h"
+#include "obd2_timer.h"
+#include "pico/stdlib.h"
+#include <stdio.h>
+#include <string.h>
+
+#define DID_HASH_SIZE       (1u << OBD2_UDS_DID_HASH_BITS)
+#define SESSION_BIT(s)      (1u << (s))
+#define ALL_SESSIONS        (SESSION_BIT(OBD2_UDS_SESSION_DEFAULT) | SESSION_BIT(OBD2_UDS_SESSION_EXTENDED))
+#define EXTENDED_ONLY       SESSION_BIT(OBD2_UDS_SESSION_EXTENDED)
+#define DTC_STATUS_AVAILABILITY 0xFF    // Every status bit is supported
+#define DTC_FORMAT_ISO14229 0x01
+
+// DID read function: fills data and returns its length (0 = not available)
+typedef uint8_t (*uds_did_read_fn)(uint8_t *data);
+
+typedef struct {
+    uint16_t did;
+    uint8_t sessions;       // Sessions the DID can be read in
+    uds_did_read_fn read;
+} uds_did_t;
+
+static uint8_t read_active_session(uint8_t *data);
+static uint8_t read_part_number(uint8_t *data);
+static uint8_t read_ecu_serial(uint8_t *data);
+static uint8_t read_vin(uint8_t *data);
+static uint8_t read_software_version(uint8_t *data);
+static uint8_t read_system_name(uint8_t *data);
+static uint8_t read_engine_runtime(uint8_t *data);
+static uint8_t read_odometer(uint8_t *data);
+
+// Identification and vehicle DIDs (F4xx OBD PIDs are served separately)
+static const uds_did_t did_table[] = {
+    { 0x0100, EXTENDED_ONLY, read_engine_runtime },     // Engine runtime (s)
+    { 0x0101, ALL_SESSIONS,  read_odometer },           // Odometer (km)
+    { 0xF186, ALL_SESSIONS,  read_active_session },     // Active diagnostic session
+    { 0xF187, ALL_SESSIONS,  read_part_number },        // Spare part number
+    { 0xF18C, ALL_SESSIONS,  read_ecu_serial },         // ECU serial number
+    { 0xF190, ALL_SESSIONS,  read_vin },                // VIN
+    { 0xF195, ALL_SESSIONS,  read_software_version },   // Supplier software version
+    { 0xF197, ALL_SESSIONS,  read_system_name },        // System name
+};
+
+#define DID_COUNT   (sizeof(did_table) / sizeof(did_table[0]))
+
+_Static_assert(DID_HASH_SIZE >= 2 * DID_COUNT, "DID hash index must be at least twice the table");
+
+// UDS state
+static struct {
+    uint8_t session;
+    obd2_timer_t s3_timer;          // S3: back to the default session without requests
+    uint8_t did_index[DID_HASH_SIZE];   // Table index + 1, 0 = empty
+    uint8_t response[OBD2_ISOTP_MAX_PAYLOAD];
+} uds_state;
+
+static inline uint8_t hash_did(uint16_t did)
+{
+    return (uint8_t)((((uint32_t)did * 40503u) & 0xFFFF) >> (16 - OBD2_UDS_DID_HASH_BITS));
+}
+
+static const uds_did_t* find_did(uint16_t did)
+{
+    uint8_t pos = hash_did(did);
+
+    while (uds_state.did_index[pos] != 0) {
+        const uds_did_t *entry = &did_table[uds_state.did_index[pos] - 1];
+        if (entry->did == did) {
+            return entry;
+        }
+        pos = (pos + 1) & (DID_HASH_SIZE - 1);
+    }
+    return NULL;
+}
+
+void obd2_uds_init(void)
+{
+    obd2_timer_cancel(&uds_state.s3_timer);
+    memset(&uds_state, 0, sizeof(uds_state));
+    uds_state.session = OBD2_UDS_SESSION_DEFAULT;
+
+    for (uint8_t i = 0; i < DID_COUNT; i++) {
+        uint8_t pos = hash_did(did_table[i].did);
+        while (uds_state.did_index[pos] != 0) {
+            pos = (pos + 1) & (DID_HASH_SIZE - 1);
+        }
+        uds_state.did_index[pos] = i + 1;
+    }
+}
+
+// DID readers
+
+static uint8_t read_active_session(uint8_t *data)
+{
+    data[0] = uds_state.session;
+    return 1;
+}
+
+static uint8_t read_part_number(uint8_t *data)
+{
+    static const char part_number[] = "OBDEMU-RP2350-01";
+    memcpy(data, part_number, sizeof(part_number) - 1);
+    return sizeof(part_number) - 1;
+}
+
+static uint8_t read_ecu_serial(uint8_t *data)
+{
+    // Same serial as Service 09 InfoType 0D: [49][0D][NODI][ESN...]
+    uint16_t length;
+    const uint8_t *payload = obd2_vehinfo_get_response(OBD2_PID_ESN, &length);
+
+    if (payload == NULL || length <= 3) {
+        return 0;
+    }
+    memcpy(data, &payload[3], length - 3);
+    return length - 3;
+}
+
+static uint8_t read_vin(uint8_t *data)
+{
+    const char *vin = obd2_get_vin();
+    memcpy(data, vin, 17);
+    return 17;
+}
+
+static uint8_t read_software_version(uint8_t *data)
+{
+    static const char version[] = "1.0";
+    memcpy(data, version, sizeof(version) - 1);
+    return sizeof(version) - 1;
+}
+
+static uint8_t read_system_name(uint8_t *data)
+{
+    static const char name[] = "OBD2 Emulator";
+    memcpy(data, name, sizeof(name) - 1);
+    return sizeof(name) - 1;
+}
+
+static uint8_t read_engine_runtime(uint8_t *data)
+{
+    uint32_t runtime = obd2_get_engine_runtime();
+    data[0] = runtime >> 24;
+    data[1] = runtime >> 16;
+    data[2] = runtime >> 8;
+    data[3] = runtime;
+    return 4;
+}
+
+static uint8_t read_odometer(uint8_t *data)
+{
+    uint32_t odometer = obd2_get_odometer();
+    data[0] = odometer >> 24;
+    data[1] = odometer >> 16;
+    data[2] = odometer >> 8;
+    data[3] = odometer;
+    return 4;
+}
+
+// Response helpers
+
+static const uint8_t* negative_response(uint8_t service, uint8_t nrc, uint16_t *length)
+{
+    uds_state.response[0] = 0x7F;
+    uds_state.response[1] = service;
+    uds_state.response[2] = nrc;
+    *length = 3;
+    return uds_state.response;
+}
+
+static void session_timeout(void *context)
+{
+    printf("UDS session timeout, returning to default session\r\n");
+    uds_state.session = OBD2_UDS_SESSION_DEFAULT;
+    obd2_periodic_stop_all();
+}
+
+// Every request restarts S3 while a non-default session is active
+static void restart_session_timer(void)
+{
+    if (uds_state.session != OBD2_UDS_SESSION_DEFAULT) {
+        obd2_timer_start(&uds_state.s3_timer, OBD2_UDS_S3_SERVER_MS * 1000, session_timeout, NULL);
+    } else {
+        obd2_timer_cancel(&uds_state.s3_timer);
+    }
+}
+
+static const uint8_t* handle_session_control(const uint8_t *msg, uint8_t msg_length, uint16_t *length)
+{
+    if (msg_length != 2) {
+        return negative_response(msg[0], OBD2_ERROR_INVALID_FORMAT, length);
+    }
+
+    uint8_t session = msg[1] & ~OBD2_UDS_SUPPRESS_POSITIVE_RESPONSE;
+    switch (session) {
+        case OBD2_UDS_SESSION_DEFAULT:
+        case OBD2_UDS_SESSION_EXTENDED:
+            break;
+
+        case OBD2_UDS_SESSION_PROGRAMMING:
+            // Programming is only entered from the extended session
+            if (uds_state.session == OBD2_UDS_SESSION_DEFAULT) {
+                return negative_response(msg[0], OBD2_ERROR_SUBFUNCTION_NOT_SUPPORTED_IN_ACTIVE_SESSION, length);
+            }
+            break;
+
+        default:
+            return negative_response(msg[0], OBD2_ERROR_SUBFUNCTION_NOT_SUPPORTED, length);
+    }
+
+    uds_state.session = session;
+    restart_session_timer();
+    printf("UDS session changed to 0x%02X\r\n", session);
+
+    // Periodic transmission only runs outside the default session
+    if (session == OBD2_UDS_SESSION_DEFAULT) {
+        obd2_periodic_stop_all();
+    }
+
+    if (msg[1] & OBD2_UDS_SUPPRESS_POSITIVE_RESPONSE) {
+        *length = 0;
+        return NULL;
+    }
+
+    // [50][session][P2 hi][P2 lo][P2* hi][P2* lo] (P2* in 10 ms units)
+    uds_state.response[0] = OBD2_UDS_SID_SESSION_CONTROL + OBD2_POSITIVE_RESPONSE_OFFSET;
+    uds_state.response[1] = session;
+    uds_state.response[2] = OBD2_UDS_P2_SERVER_MS >> 8;
+    uds_state.response[3] = OBD2_UDS_P2_SERVER_MS & 0xFF;
+    uds_state.response[4] = (OBD2_UDS_P2_STAR_SERVER_MS / 10) >> 8;
+    uds_state.response[5] = (OBD2_UDS_P2_STAR_SERVER_MS / 10) & 0xFF;
+    *length = 6;
+    return uds_state.response;
+}
+
+static const uint8_t* handle_tester_present(const uint8_t *msg, uint8_t msg_length, uint16_t *length)
+{
+    if (msg_length != 2) {
+        return negative_response(msg[0], OBD2_ERROR_INVALID_FORMAT, length);
+    }
+    if ((msg[1] & ~OBD2_UDS_SUPPRESS_POSITIVE_RESPONSE) != 0x00) {
+        return negative_response(msg[0], OBD2_ERROR_SUBFUNCTION_NOT_SUPPORTED, length);
+    }
+
+    // The S3 timer was already restarted by receiving the request
+    if (msg[1] & OBD2_UDS_SUPPRESS_POSITIVE_RESPONSE) {
+        *length = 0;
+        return NULL;
+    }
+
+    uds_state.response[0] = OBD2_UDS_SID_TESTER_PRESENT + OBD2_POSITIVE_RESPONSE_OFFSET;
+    uds_state.response[1] = 0x00;
+    *length = 2;
+    return uds_state.response;
+}
+
+static uint8_t read_obd_pid_did(uint8_t pid, uint8_t *data)
+{
+    obd2_vehicle_snapshot_t snapshot;
+    uint8_t data_length;
+
+    obd2_capture_vehicle_snapshot(&snapshot);
+    data_length = obd2_encode_pid(pid, &snapshot, data);
+    obd2_override_apply(pid, data, data_length);
+    return data_length;
+}
+
+static const uint8_t* handle_read_data_by_id(const uint8_t *msg, uint8_t msg_length, uint16_t *length)
+{
+    // [22][DID hi][DID lo]... one or more DIDs
+    if (msg_length < 3 || (msg_length - 1) % 2 != 0) {
+        return negative_response(msg[0], OBD2_ERROR_INVALID_FORMAT, length);
+    }
+
+    uint16_t pos = 0;
+    uint8_t buffer[32];
+
+    uds_state.response[pos++] = OBD2_UDS_SID_READ_DATA_BY_ID + OBD2_POSITIVE_RESPONSE_OFFSET;
+
+    for (uint8_t i = 1; i + 1 < msg_length; i += 2) {
+        uint16_t did = (msg[i] << 8) | msg[i + 1];
+        uint8_t data_length = 0;
+
+        if ((did & 0xFF00) == OBD2_UDS_DID_OBD_PID_BASE) {
+            data_length = read_obd_pid_did(did & 0xFF, buffer);
+        } else {
+            const uds_did_t *entry = find_did(did);
+            if (entry != NULL && (entry->sessions & SESSION_BIT(uds_state.session))) {
+                data_length = entry->read(buffer);
+            }
+        }
+
+        // Unsupported DIDs are skipped, the request fails only if none is
+        if (data_length == 0) {
+            continue;
+        }
+        if (pos + 2u + data_length > sizeof(uds_state.response)) {
+            return negative_response(msg[0], OBD2_ERROR_RESPONSE_TOO_LONG, length);
+        }
+        uds_state.response[pos++] = did >> 8;
+        uds_state.response[pos++] = did & 0xFF;
+        memcpy(&uds_state.response[pos], buffer, data_length);
+        pos += data_length;
+    }
+
+    if (pos == 1) {
+        return negative_response(msg[0], OBD2_ERROR_REQUEST_OUT_OF_RANGE, length);
+    }
+
+    *length = pos;
+    return uds_state.response;
+}
+
+static const uint8_t* handle_read_periodic_data(const uint8_t *msg, uint8_t msg_length, uint16_t *length)
+{
+    // [2A][mode][PDID...]; stop without PDIDs stops everything
+    if (msg_length < 2 || (msg_length < 3 && msg[1] != OBD2_PERIODIC_STOP)) {
+        return negative_response(msg[0], OBD2_ERROR_INVALID_FORMAT, length);
+    }
+
+    uint8_t mode = msg[1];
+    uint8_t accepted = 0;
+
+    switch (mode) {
+        case OBD2_PERIODIC_RATE_SLOW:
+        case OBD2_PERIODIC_RATE_MEDIUM:
+        case OBD2_PERIODIC_RATE_FAST:
+            for (uint8_t i = 2; i < msg_length; i++) {
+                if (obd2_periodic_add(msg[i], mode)) {
+                    accepted++;
+                }
+            }
+            // Unsupported PDIDs or a full table are only an error if nothing was scheduled
+            if (accepted == 0) {
+                return negative_response(msg[0], OBD2_ERROR_REQUEST_OUT_OF_RANGE, length);
+            }
+            break;
+
+        case OBD2_PERIODIC_STOP:
+            if (msg_length == 2) {
+                obd2_periodic_stop_all();
+            }
+            for (uint8_t i = 2; i < msg_length; i++) {
+                obd2_periodic_remove(msg[i]);
+            }
+            break;
+
+        default:
+            return negative_response(msg[0], OBD2_ERROR_REQUEST_OUT_OF_RANGE, length);
+    }
+
+    uds_state.response[0] = OBD2_UDS_SID_READ_PERIODIC_DATA + OBD2_POSITIVE_RESPONSE_OFFSET;
+    *length = 1;
+    return uds_state.response;
+}
+
+static const uint8_t* handle_read_dtc_information(const uint8_t *msg, uint8_t msg_length, uint16_t *length)
+{
+    if (msg_length < 2) {
+        return negative_response(msg[0], OBD2_ERROR_INVALID_FORMAT, length);
+    }
+
+    uint8_t subfunction = msg[1];
+    uint8_t mask;
+    uint16_t max_records = (sizeof(uds_state.response) - 3) / 4;
+
+    switch (subfunction) {
+        case OBD2_UDS_DTC_COUNT_BY_STATUS_MASK:
+        case OBD2_UDS_DTC_BY_STATUS_MASK:
+            if (msg_length != 3) {
+                return negative_response(msg[0], OBD2_ERROR_INVALID_FORMAT, length);
+            }
+            mask = msg[2] & DTC_STATUS_AVAILABILITY;
+            break;
+
+        case OBD2_UDS_DTC_SUPPORTED:
+            if (msg_length != 2) {
+                return negative_response(msg[0], OBD2_ERROR_INVALID_FORMAT, length);
+            }
+            mask = 0xFF;
+            break;
+
+        default:
+            return negative_response(msg[0], OBD2_ERROR_SUBFUNCTION_NOT_SUPPORTED, length);
+    }
+
+    uds_state.response[0] = OBD2_UDS_SID_READ_DTC_INFORMATION + OBD2_POSITIVE_RESPONSE_OFFSET;
+    uds_state.response[1] = subfunction;
+    uds_state.response[2] = DTC_STATUS_AVAILABILITY;
+
+    if (subfunction == OBD2_UDS_DTC_COUNT_BY_STATUS_MASK) {
+        // [59][01][availability][format][count hi][count lo]
+        uint16_t count = obd2_dtc_get_by_status_mask(mask, NULL, max_records);
+        uds_state.response[3] = DTC_FORMAT_ISO14229;
+        uds_state.response[4] = count >> 8;
+        uds_state.response[5] = count & 0xFF;
+        *length = 6;
+        return uds_state.response;
+    }
+
+    // [59][sub][availability][DTC hi][DTC lo][FTB][status]...
+    uint16_t count = obd2_dtc_get_by_status_mask(mask, &uds_state.response[3], max_records);
+    *length = 3 + count * 4;
+    return uds_state.response;
+}
+
+const uint8_t* obd2_uds_handle_request(obd2_message_t *request, uint16_t *length)
+{
+    // Handlers parse [SID][bytes...] straight from the received frame
+    const uint8_t *msg = request->bytes;
+    uint8_t msg_length = request->length;
+
+    restart_session_timer();
+
+    switch (request->service) {
+        case OBD2_UDS_SID_SESSION_CONTROL:
+            return handle_session_control(msg, msg_length, length);
+
+        case OBD2_UDS_SID_TESTER_PRESENT:
+            return handle_tester_present(msg, msg_length, length);
+
+        case OBD2_UDS_SID_READ_DATA_BY_ID:
+        case OBD2_UDS_SID_READ_DTC_INFORMATION:
+            // Data and DTC reads are not available while programming
+            if (uds_state.session == OBD2_UDS_SESSION_PROGRAMMING) {
+                return negative_response(request->service, OBD2_ERROR_SERVICE_NOT_SUPPORTED_IN_ACTIVE_SESSION, length);
+            }
+            if (request->service == OBD2_UDS_SID_READ_DATA_BY_ID) {
+                return handle_read_data_by_id(msg, msg_length, length);
+            }
+            return handle_read_dtc_information(msg, msg_length, length);
+
+        case OBD2_UDS_SID_READ_PERIODIC_DATA:
+            // Streaming needs an extended session, so a session timeout stops it
+            if (uds_state.session != OBD2_UDS_SESSION_EXTENDED) {
+                return negative_response(request->service, OBD2_ERROR_SERVICE_NOT_SUPPORTED_IN_ACTIVE_SESSION, length);
+            }
+            return handle_read_periodic_data(msg, msg_length, length);
+
+        default:
+            return negative_response(request->service, OBD2_ERROR_SERVICE_NOT_SUPPORTED, length);
+    }
+}
+
+uint8_t obd2_uds_get_session(void)
+{
+    return uds_state.session;
+}
+
+void obd2_uds_print_status(void)
+{
+    printf("UDS Session: 0x%02X, DIDs: %u + F400-F4FF\r\n", obd2_uds_get_session(), (unsigned)DID_COUNT);
+}
@@ -0,0 +1,54 @@
+#ifndef __OBD2_UDS_H__
+#define __OBD2_UDS_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "obd2_protocol.h"
+#include "obd2_pending.h"
+
+// UDS (ISO 14229) diagnostic services
+//
+// Requests arrive through obd2_create_response like any J1979 service and
+// are answered from complete response buffers ([SID+40]... or [7F][SID][NRC]),
+// long ones going out over ISO-TP. DIDs F400-F4FF read the Service 01 PID of
+// the same number through the shared PID encoder; other DIDs are looked up
+// in a hash index built from the DID table at init, so lookup cost does not
+// grow with the table.
+
+// Service IDs
+#define OBD2_UDS_SID_SESSION_CONTROL        0x10    // DiagnosticSessionControl
+#define OBD2_UDS_SID_READ_DTC_INFORMATION   0x19    // ReadDTCInformation
+#define OBD2_UDS_SID_READ_DATA_BY_ID        0x22    // ReadDataByIdentifier
+#define OBD2_UDS_SID_READ_PERIODIC_DATA     0x2A    // ReadDataByPeriodicIdentifier
+#define OBD2_UDS_SID_TESTER_PRESENT         0x3E    // TesterPresent
+
+// Diagnostic sessions
+#define OBD2_UDS_SESSION_DEFAULT            0x01
+#define OBD2_UDS_SESSION_PROGRAMMING        0x02
+#define OBD2_UDS_SESSION_EXTENDED           0x03
+
+// ReadDTCInformation subfunctions
+#define OBD2_UDS_DTC_COUNT_BY_STATUS_MASK   0x01
+#define OBD2_UDS_DTC_BY_STATUS_MASK         0x02
+#define OBD2_UDS_DTC_SUPPORTED              0x0A
+
+// Timing reported in the session response
+#define OBD2_UDS_P2_SERVER_MS               OBD2_PENDING_P2_MS
+#define OBD2_UDS_P2_STAR_SERVER_MS          OBD2_PENDING_P2_STAR_MS
+#define OBD2_UDS_S3_SERVER_MS               5000    // Non-default session timeout
+
+#define OBD2_UDS_SUPPRESS_POSITIVE_RESPONSE 0x80    // Subfunction bit
+#define OBD2_UDS_DID_OBD_PID_BASE           0xF400  // F400 + PID = Service 01 PID
+#define OBD2_UDS_DID_HASH_BITS              6       // Index size, at least twice the DID table
+
+// Initialization
+void obd2_uds_init(void);
+
+// Request dispatch; NULL when the response is suppressed
+const uint8_t* obd2_uds_handle_request(obd2_message_t *request, uint16_t *length);
+
+// Session state
+uint8_t obd2_uds_get_session(void);
+void obd2_uds_print_status(void);
+
+#endif // __OBD2_UDS_H__
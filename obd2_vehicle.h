@@ -0,0 +1,70 @@
+#ifndef __OBD2_VEHICLE_H__
+#define __OBD2_VEHICLE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "obd2_protocol.h"
+
+// Vehicle model
+//
+// All simulated engine and vehicle state lives in one obd2_vehicle_t, and
+// obd2_vehicle_step() advances it by one 50 ms tick without reading the
+// clock or touching any other module. The firmware runs a single instance
+// (vehicle_data.c adds timing, persistence, monitors and DTCs around it);
+// the host fleet simulator runs thousands of them side by side.
+
+#define OBD2_VEHICLE_TICK_MS    50
+
+typedef struct {
+    // Simulated signals (physical units)
+    uint32_t engine_runtime;        // Engine running ticks
+    uint16_t base_rpm;              // RPM
+    uint8_t throttle_position;      // 0-100%
+    uint8_t vehicle_speed;          // km/h
+    uint8_t engine_load;            // 0-100%
+    uint8_t coolant_temp;           // °C
+    uint8_t intake_temp;            // °C
+    uint8_t fuel_level;             // 0-100%
+    bool engine_running;
+    uint16_t maf_flow_rate;         // g/s * 100
+    uint16_t fuel_pressure;         // kPa * 100
+    uint16_t manifold_pressure;     // kPa * 100
+    uint16_t o2_sensor_b1s1;        // mV
+    uint16_t o2_sensor_b1s2;        // mV
+    uint8_t short_fuel_trim_b1;     // 128 +/- trim
+    uint8_t long_fuel_trim_b1;      // 128 +/- trim
+    uint8_t timing_advance;         // Degrees + 64
+
+    // Model state
+    uint32_t simulation_cycle;      // Ticks since init (drives the driving pattern)
+    float fuel_trim_integrator;     // Closed-loop fuel control
+
+    // Distance and warm-up counters (persisted by the firmware)
+    uint32_t odometer_m;
+    uint32_t distance_since_clear_m;
+    uint32_t distance_with_mil_m;
+    uint8_t warmups_since_clear;
+    uint16_t distance_mm;           // Sub-meter distance accumulator
+    uint8_t start_coolant_temp;     // Coolant temperature at engine start
+    bool warmup_counted;            // Warm-up already counted this drive
+} obd2_vehicle_t;
+
+// Initialise to a warm idling engine. Seed 0 gives the firmware's vehicle;
+// other seeds shift the driving pattern phase and fuel level so vehicles of
+// a fleet do not move in lockstep.
+void obd2_vehicle_init(obd2_vehicle_t *vehicle, uint32_t seed);
+
+// Advance one tick; mil_on accrues distance with MIL. Returns true when the
+// distance/warm-up counters reached a point worth persisting.
+bool obd2_vehicle_step(obd2_vehicle_t *vehicle, bool mil_on);
+
+// Start or stop the engine; returns true when a new drive starts
+bool obd2_vehicle_set_engine_state(obd2_vehicle_t *vehicle, bool running);
+
+// Service 04: reset the since-clear counters
+void obd2_vehicle_clear_counters(obd2_vehicle_t *vehicle);
+
+// Current values in Service 01 scaling
+void obd2_vehicle_capture_snapshot(const obd2_vehicle_t *vehicle, obd2_vehicle_snapshot_t *snapshot);
+
+#endif // __OBD2_VEHICLE_H__
@@ -0,0 +1,211 @@
+#include "obd2_vehinfo.h"
+#include "obd2_protocol.h"
+#include <stdio.h>
+#include <string.h>
+
+#define INFO_TYPE_COUNT     (OBD2_PID_ESN + 1)  // InfoTypes 00-0D
+#define CALID_LENGTH        16
+
+// In-use performance tracking counters, J1979 order for spark ignition
+enum {
+    IPT_OBDCOND = 0,
+    IPT_IGNCNTR,
+    IPT_CATCOMP1,
+    IPT_CATCOND1,
+    IPT_CATCOMP2,
+    IPT_CATCOND2,
+    IPT_O2SCOMP1,
+    IPT_O2SCOND1,
+    IPT_O2SCOMP2,
+    IPT_O2SCOND2,
+    IPT_EGRCOMP,
+    IPT_EGRCOND,
+    IPT_AIRCOMP,
+    IPT_AIRCOND,
+    IPT_EVAPCOMP,
+    IPT_EVAPCOND,
+    IPT_SO2SCOMP1,
+    IPT_SO2SCOND1,
+    IPT_SO2SCOMP2,
+    IPT_SO2SCOND2
+};
+
+_Static_assert(IPT_SO2SCOND2 + 1 == OBD2_VEHINFO_IPT_COUNT, "IPT counter list out of sync");
+
+// Calibration software and its verification numbers
+static const struct {
+    char calid[CALID_LENGTH + 1];
+    uint32_t cvn;
+} calibrations[OBD2_VEHINFO_CALID_COUNT] = {
+    { "OBDEMU-ENG-0100", 0x1A2B3C4D },
+    { "OBDEMU-TCM-0100", 0x5E6F7081 },
+};
+
+static const char ecu_name[] = "ECM";
+static const char ecu_text[] = "EngineControl";
+static const char engine_serial[OBD2_VEHINFO_ESN_LENGTH + 1] = "00000RP2350OBD001";
+
+// Cached responses: [49][InfoType][NODI][data...]
+static struct {
+    uint8_t supported[6];
+    uint8_t counts[5][3];           // InfoTypes 01, 03, 05, 07, 09
+    uint8_t vin[3 + 17];
+    uint8_t calid[3 + CALID_LENGTH * OBD2_VEHINFO_CALID_COUNT];
+    uint8_t cvn[3 + 4 * OBD2_VEHINFO_CALID_COUNT];
+    uint8_t ipt[3 + 2 * OBD2_VEHINFO_IPT_COUNT];
+    uint8_t ecu_name[3 + OBD2_VEHINFO_ECU_NAME_LENGTH];
+    uint8_t esn[3 + OBD2_VEHINFO_ESN_LENGTH];
+
+    const uint8_t *payloads[INFO_TYPE_COUNT];
+    uint8_t lengths[INFO_TYPE_COUNT];
+    uint16_t ipt_counters[OBD2_VEHINFO_IPT_COUNT];
+} vehinfo_state;
+
+static uint8_t* start_response(uint8_t *buffer, uint8_t info_type, uint8_t items, uint8_t length)
+{
+    buffer[0] = OBD2_SERVICE_09 + OBD2_POSITIVE_RESPONSE_OFFSET;
+    buffer[1] = info_type;
+    buffer[2] = items;
+    vehinfo_state.payloads[info_type] = buffer;
+    vehinfo_state.lengths[info_type] = length;
+    return &buffer[3];
+}
+
+static void build_count(uint8_t slot, uint8_t info_type, uint8_t items)
+{
+    start_response(vehinfo_state.counts[slot], info_type, items, 3);
+}
+
+static void build_vin(void)
+{
+    uint8_t *data = start_response(vehinfo_state.vin, OBD2_PID_VIN, 1, sizeof(vehinfo_state.vin));
+    const char *vin = obd2_get_vin();
+
+    memset(data, 0, 17);
+    memcpy(data, vin, strlen(vin));  // VIN storage is always terminated at 17
+}
+
+static void build_ipt(void)
+{
+    uint8_t *data = start_response(vehinfo_state.ipt, OBD2_PID_IPT, OBD2_VEHINFO_IPT_COUNT,
+                                   sizeof(vehinfo_state.ipt));
+
+    for (uint8_t i = 0; i < OBD2_VEHINFO_IPT_COUNT; i++) {
+        data[i * 2] = vehinfo_state.ipt_counters[i] >> 8;
+        data[i * 2 + 1] = vehinfo_state.ipt_counters[i] & 0xFF;
+    }
+}
+
+static void build_static_payloads(void)
+{
+    uint8_t *data;
+
+    data = start_response(vehinfo_state.calid, OBD2_PID_CALIBRATION_ID, OBD2_VEHINFO_CALID_COUNT,
+                          sizeof(vehinfo_state.calid));
+    memset(data, 0, CALID_LENGTH * OBD2_VEHINFO_CALID_COUNT);
+    for (uint8_t i = 0; i < OBD2_VEHINFO_CALID_COUNT; i++) {
+        memcpy(&data[i * CALID_LENGTH], calibrations[i].calid, strlen(calibrations[i].calid));
+    }
+
+    data = start_response(vehinfo_state.cvn, OBD2_PID_CVN, OBD2_VEHINFO_CALID_COUNT,
+                          sizeof(vehinfo_state.cvn));
+    for (uint8_t i = 0; i < OBD2_VEHINFO_CALID_COUNT; i++) {
+        data[i * 4] = calibrations[i].cvn >> 24;
+        data[i * 4 + 1] = calibrations[i].cvn >> 16;
+        data[i * 4 + 2] = calibrations[i].cvn >> 8;
+        data[i * 4 + 3] = calibrations[i].cvn;
+    }
+
+    // ECU name: 4-byte acronym, '-', 15-byte text, both zero padded
+    data = start_response(vehinfo_state.ecu_name, OBD2_PID_ECU_NAME, 1, sizeof(vehinfo_state.ecu_name));
+    memset(data, 0, OBD2_VEHINFO_ECU_NAME_LENGTH);
+    memcpy(data, ecu_name, strlen(ecu_name));
+    data[4] = '-';
+    memcpy(&data[5], ecu_text, strlen(ecu_text));
+
+    data = start_response(vehinfo_state.esn, OBD2_PID_ESN, 1, sizeof(vehinfo_state.esn));
+    memcpy(data, engine_serial, OBD2_VEHINFO_ESN_LENGTH);
+
+    // Message counts (ISO 15765-4: one message per data item)
+    build_count(0, OBD2_PID_VIN_MESSAGE_COUNT, 1);
+    build_count(1, OBD2_PID_CALIBRATION_ID_COUNT, OBD2_VEHINFO_CALID_COUNT);
+    build_count(2, OBD2_PID_CVN_COUNT, OBD2_VEHINFO_CALID_COUNT);
+    build_count(3, OBD2_PID_IPT_COUNT, OBD2_VEHINFO_IPT_COUNT);
+    build_count(4, OBD2_PID_ECU_NAME_COUNT, 1);
+}
+
+static void build_supported(void)
+{
+    uint32_t bitmap = 0;
+
+    // Supported InfoTypes follow from the payloads that were built
+    for (uint8_t info_type = 1; info_type < INFO_TYPE_COUNT; info_type++) {
+        if (vehinfo_state.payloads[info_type] != NULL) {
+            bitmap |= 1u << (32 - info_type);
+        }
+    }
+
+    vehinfo_state.supported[0] = OBD2_SERVICE_09 + OBD2_POSITIVE_RESPONSE_OFFSET;
+    vehinfo_state.supported[1] = 0x00;
+    vehinfo_state.supported[2] = (bitmap >> 24) & 0xFF;
+    vehinfo_state.supported[3] = (bitmap >> 16) & 0xFF;
+    vehinfo_state.supported[4] = (bitmap >> 8) & 0xFF;
+    vehinfo_state.supported[5] = bitmap & 0xFF;
+    vehinfo_state.payloads[0] = vehinfo_state.supported;
+    vehinfo_state.lengths[0] = sizeof(vehinfo_state.supported);
+}
+
+void obd2_vehinfo_init(void)
+{
+    memset(&vehinfo_state, 0, sizeof(vehinfo_state));
+
+    build_static_payloads();
+    build_vin();
+    build_ipt();
+    build_supported();
+}
+
+void obd2_vehinfo_vin_changed(void)
+{
+    build_vin();
+}
+
+static inline void ipt_increment(uint8_t counter)
+{
+    // A numerator/denominator pair is halved together so the ratio survives
+    if (vehinfo_state.ipt_counters[counter] == 0xFFFF) {
+        uint8_t pair = counter & ~1u;
+        vehinfo_state.ipt_counters[pair] /= 2;
+        vehinfo_state.ipt_counters[pair + 1] /= 2;
+    }
+    vehinfo_state.ipt_counters[counter]++;
+}
+
+void obd2_vehinfo_record_driving_cycle(bool catalyst, bool o2_sensor, bool egr)
+{
+    ipt_increment(IPT_IGNCNTR);
+    ipt_increment(IPT_OBDCOND);
+
+    // Bank 1 monitors only; upstream sensor counts as O2S, downstream as SO2S
+    ipt_increment(IPT_CATCOND1);
+    ipt_increment(IPT_O2SCOND1);
+    ipt_increment(IPT_EGRCOND);
+    ipt_increment(IPT_SO2SCOND1);
+    if (catalyst) ipt_increment(IPT_CATCOMP1);
+    if (o2_sensor) ipt_increment(IPT_O2SCOMP1);
+    if (egr) ipt_increment(IPT_EGRCOMP);
+    if (o2_sensor) ipt_increment(IPT_SO2SCOMP1);
+
+    build_ipt();
+}
+
+const uint8_t* obd2_vehinfo_get_response(uint8_t info_type, uint16_t *length)
+{
+    if (info_type >= INFO_TYPE_COUNT || vehinfo_state.payloads[info_type] == NULL) {
+        *length = 0;
+        return NULL;
+    }
+
+    *length = vehinfo_state.lengths[info_type];
+    return vehinfo_state.payloads[info_type];
+}
@@ -0,0 +1,31 @@
+#ifndef __OBD2_VEHINFO_H__
+#define __OBD2_VEHINFO_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Service 09 vehicle information
+//
+// Every InfoType response is serialized once into its own buffer, at init or
+// when the underlying data changes (VIN set or restored, driving cycle end).
+// A request is a lookup that hands the finished payload to the transmit path.
+
+#define OBD2_VEHINFO_CALID_COUNT        2       // Calibration IDs (one CVN each)
+#define OBD2_VEHINFO_IPT_COUNT          20      // In-use performance counters (spark ignition)
+#define OBD2_VEHINFO_ECU_NAME_LENGTH    20      // "ECM" + '-' + name, zero padded
+#define OBD2_VEHINFO_ESN_LENGTH         17
+
+// Initialization
+void obd2_vehinfo_init(void);
+
+// Rebuild cached payloads after their source data changed
+void obd2_vehinfo_vin_changed(void);
+
+// In-use performance tracking: called once per finished driving cycle with
+// the monitors that completed during it
+void obd2_vehinfo_record_driving_cycle(bool catalyst, bool o2_sensor, bool egr);
+
+// Complete Service 09 response for an InfoType (NULL if not supported)
+const uint8_t* obd2_vehinfo_get_response(uint8_t info_type, uint16_t *length);
+
+#endif // __OBD2_VEHINFO_H__
@@ -13,6 +13,10 @@ Requirements:
 Usage:
     python3 test_obd2.py --interface socketcan --channel can0
     python3 test_obd2.py --interface serial --channel /dev/ttyUSB0
+    python3 test_obd2.py --channel can0 --console /dev/ttyACM0
+
+Tests that drive the emulator through its serial console (e.g. ending a
+driving cycle) need --console and pyserial; they are skipped without it.
 """
 
 import argparse
@@ -28,6 +32,55 @@ except ImportError:
 # OBD2 Constants
 OBD2_REQUEST_ID = 0x7DF
 OBD2_RESPONSE_ID = 0x7E8
+OBD2_PHYSICAL_REQUEST_ID = 0x7E0  # Flow Control frames go to the ECU's physical ID
+OBD2_NRC_RESPONSE_PENDING = 0x78
+
+def decode_dtcs(response):
+    """DTC codes of a Service 03/07/0A response: [len][service][count][DTC hi][DTC lo]..."""
+    data = response[2:]
+    codes = []
+    for i in range(1, 1 + 2 * data[0], 2):
+        if i + 1 >= len(data):
+            break
+        raw = (data[i] << 8) | data[i + 1]
+        codes.append(f"{'PCBU'[raw >> 14]}{raw & 0x3FFF:04X}")
+    return codes
+
+# Checks run after a response validated; they get the earlier responses by
+# test name and return (passed, message)
+def check_mil_status(response, previous):
+    """PID 01 byte A: MIL bit plus the count of confirmed DTCs (Service 03)"""
+    if len(response) < 4:
+        return False, "Short PID 01 response"
+    mil = bool(response[3] & 0x80)
+    count = response[3] & 0x7F
+    if 'Stored DTCs' in previous:
+        stored = len(decode_dtcs(previous['Stored DTCs']))
+        if count != min(stored, 0x7F):
+            return False, f"DTC count {count} does not match {stored} stored DTCs"
+    if mil and count == 0:
+        return False, "MIL on without a confirmed DTC"
+    return True, f"MIL {'ON' if mil else 'OFF'}, {count} confirmed"
+
+def check_mil_cleared(response, previous):
+    """PID 01 byte A after Service 04: MIL off, no confirmed DTC"""
+    if len(response) < 4 or response[3] != 0x00:
+        return False, "MIL status not reset by Service 04"
+    return True, "MIL OFF, 0 confirmed"
+
+def check_multiple_dids(response, previous):
+    """ReadDataByIdentifier echoes every DID before its data: F40C (2 bytes), F40D (1 byte)"""
+    if len(response) < 8 or response[2:4] != [0xF4, 0x0C] or response[6:8] != [0xF4, 0x0D]:
+        return False, "DIDs F40C/F40D not both answered"
+    return True, "Both DIDs answered"
+
+def check_permanent_retained(response, previous):
+    """Permanent DTCs listed before Service 04 must still be listed"""
+    before = set(decode_dtcs(previous.get('Permanent DTCs', [0, 0x4A, 0])))
+    missing = before - set(decode_dtcs(response))
+    if missing:
+        return False, f"Permanent DTCs lost: {' '.join(sorted(missing))}"
+    return True, f"{len(before)} permanent DTCs retained"
 
 # Test cases for OBD2 requests
 TEST_CASES = [
@@ -87,6 +140,34 @@ TEST_CASES = [
         'expected_pid': None,
         'description': 'Read pending diagnostic trouble codes'
     },
+    {
+        'name': 'Permanent DTCs',
+        'request': [0x01, 0x0A],
+        'expected_service': 0x4A,
+        'expected_pid': None,
+        'description': 'Read permanent diagnostic trouble codes'
+    },
+    {
+        'name': 'Freeze Frame DTC',
+        'request': [0x03, 0x02, 0x02, 0x00],
+        'expected_service': 0x42,
+        'expected_pid': 0x02,
+        'description': 'DTC that caused freeze frame 0'
+    },
+    {
+        'name': 'Freeze Frame RPM',
+        'request': [0x03, 0x02, 0x0C, 0x00],
+        'expected_service': 0x42,
+        'expected_pid': 0x0C,
+        'description': 'Engine RPM stored in freeze frame 0'
+    },
+    {
+        'name': 'Supported Monitor IDs',
+        'request': [0x02, 0x06, 0x00],
+        'expected_service': 0x46,
+        'expected_pid': 0x00,
+        'description': 'Service 06 MIDs 01-20 supported bitmap'
+    },
     {
         'name': 'VIN Message Count',
         'request': [0x02, 0x09, 0x01],
@@ -100,17 +181,154 @@ TEST_CASES = [
         'expected_service': 0x49,
         'expected_pid': 0x02,
         'description': 'Read Vehicle Identification Number'
+    },
+    {
+        'name': 'Calibration IDs',
+        'request': [0x02, 0x09, 0x04],
+        'expected_service': 0x49,
+        'expected_pid': 0x04,
+        'description': 'Read calibration IDs (multi-frame)'
+    },
+    {
+        'name': 'ECU Name',
+        'request': [0x02, 0x09, 0x0A],
+        'expected_service': 0x49,
+        'expected_pid': 0x0A,
+        'description': 'Read ECU name (multi-frame)'
+    },
+    # UDS (ISO 14229); the session is returned to default at the end
+    {
+        'name': 'Default Session',
+        'request': [0x02, 0x10, 0x01],
+        'expected_service': 0x50,
+        'expected_pid': 0x01,
+        'description': 'DiagnosticSessionControl to the default session'
+    },
+    {
+        'name': 'Programming Session From Default',
+        'request': [0x02, 0x10, 0x02],
+        'physical': True,
+        'expected_nrc': 0x7E,
+        'description': 'Programming session is refused in the default session (physical request)'
+    },
+    {
+        'name': 'Extended Session',
+        'request': [0x02, 0x10, 0x03],
+        'expected_service': 0x50,
+        'expected_pid': 0x03,
+        'description': 'DiagnosticSessionControl to the extended session'
+    },
+    {
+        'name': 'Read DID VIN',
+        'request': [0x03, 0x22, 0xF1, 0x90],
+        'expected_service': 0x62,
+        'expected_pid': 0xF1,
+        'description': 'ReadDataByIdentifier F190 (multi-frame)'
+    },
+    {
+        'name': 'Read DID Engine RPM',
+        'request': [0x03, 0x22, 0xF4, 0x0C],
+        'expected_service': 0x62,
+        'expected_pid': 0xF4,
+        'description': 'ReadDataByIdentifier F40C (PID 0C)'
+    },
+    {
+        'name': 'Read Multiple DIDs',
+        'request': [0x05, 0x22, 0xF4, 0x0C, 0xF4, 0x0D],
+        'expected_service': 0x62,
+        'expected_pid': 0xF4,
+        'check': check_multiple_dids,
+        'description': 'ReadDataByIdentifier F40C and F40D in one request'
+    },
+    {
+        'name': 'DTC Count By Status Mask',
+        'request': [0x03, 0x19, 0x01, 0xFF],
+        'expected_service': 0x59,
+        'expected_pid': 0x01,
+        'description': 'ReadDTCInformation 01: number of DTCs matching the mask'
+    },
+    {
+        'name': 'DTCs By Status Mask',
+        'request': [0x03, 0x19, 0x02, 0xFF],
+        'expected_service': 0x59,
+        'expected_pid': 0x02,
+        'description': 'ReadDTCInformation 02: DTCs matching the mask'
+    },
+    {
+        'name': 'Tester Present',
+        'request': [0x02, 0x3E, 0x00],
+        'expected_service': 0x7E,
+        'expected_pid': 0x00,
+        'description': 'TesterPresent keeps the extended session alive'
+    },
+    {
+        'name': 'Tester Present Suppressed',
+        'request': [0x02, 0x3E, 0x80],
+        'expect_no_response': True,
+        'description': 'TesterPresent with the suppress bit gets no response'
+    },
+    {
+        'name': 'Return To Default Session',
+        'request': [0x02, 0x10, 0x01],
+        'expected_service': 0x50,
+        'expected_pid': 0x01,
+        'description': 'DiagnosticSessionControl back to the default session'
+    },
+    # DTC lifecycle; Service 04 clears the emulator, so these run last
+    {
+        'name': 'MIL Status',
+        'request': [0x02, 0x01, 0x01],
+        'expected_service': 0x41,
+        'expected_pid': 0x01,
+        'check': check_mil_status,
+        'description': 'MIL and confirmed DTC count match Service 03'
+    },
+    {
+        'name': 'Clear Diagnostic Information',
+        'request': [0x01, 0x04],
+        'expected_service': 0x44,
+        'expected_pid': None,
+        'description': 'Clear DTCs (Service 04, may answer response pending first)'
+    },
+    {
+        'name': 'MIL Status After Clear',
+        'request': [0x02, 0x01, 0x01],
+        'expected_service': 0x41,
+        'expected_pid': 0x01,
+        'check': check_mil_cleared,
+        'description': 'Service 04 turns the MIL off and resets the count'
+    },
+    {
+        'name': 'Permanent DTCs After Clear',
+        'request': [0x01, 0x0A],
+        'expected_service': 0x4A,
+        'expected_pid': None,
+        'check': check_permanent_retained,
+        'description': 'Permanent DTCs survive Service 04'
+    },
+    {
+        'name': 'Permanent DTCs After Driving Cycle',
+        'console': ['ENGINE OFF', 'ENGINE ON'],
+        'request': [0x01, 0x0A],
+        'expected_service': 0x4A,
+        'expected_pid': None,
+        'check': check_permanent_retained,
+        'description': 'A driving cycle without a passing test keeps them after Service 04'
     }
 ]
 
 class OBD2Tester:
-    def __init__(self, interface, channel, bitrate=500000):
+    def __init__(self, interface, channel, bitrate=500000, console=None):
         """Initialize OBD2 tester with CAN interface"""
         self.interface = interface
         self.channel = channel
         self.bitrate = bitrate
+        self.console_port = console
         self.bus = None
+        self.console = None
+        self.console_seq = 0
         self.test_results = []
+        self.responses = {}
         
     def connect(self):
         """Connect to CAN bus"""
@@ -121,18 +339,45 @@ class OBD2Tester:
                 bitrate=self.bitrate
             )
             print(f"Connected to CAN bus: {self.interface}:{self.channel} @ {self.bitrate} bps")
-            return True
         except Exception as e:
             print(f"Failed to connect to CAN bus: {e}")
             return False
+
+        if self.console_port:
+            try:
+                import serial
+                self.console = serial.Serial(self.console_port, 115200, timeout=1.0)
+                print(f"Connected to console: {self.console_port}")
+            except Exception as e:
+                print(f"Failed to open console: {e}")
+                return False
+        return True
     
     def disconnect(self):
         """Disconnect from CAN bus"""
         if self.bus:
             self.bus.shutdown()
             print("Disconnected from CAN bus")
+        if self.console:
+            self.console.close()
+
+    def send_command(self, command):
+        """Send a console frame ($<seq> <command>) and wait for its ACK"""
+        self.console_seq += 1
+        seq = self.console_seq
+        self.console.write(f"${seq} {command}\n".encode('ascii'))
+        print(f"Console: {command}")
+
+        deadline = time.time() + 2.0
+        while time.time() < deadline:
+            line = self.console.readline().decode('ascii', 'replace').strip()
+            if line.startswith(f"!{seq} ACK"):
+                ok, _, total = line.split()[2].partition('/')
+                return ok == total
+        print("No console acknowledgement")
+        return False
     
-    def send_request(self, data):
+    def send_request(self, data, request_id=OBD2_REQUEST_ID, timeout=2.0):
         """Send OBD2 request and wait for response"""
         if not self.bus:
             return None
@@ -142,7 +387,7 @@ class OBD2Tester:
         
         # Create and send CAN message
         msg = can.Message(
-            arbitration_id=OBD2_REQUEST_ID,
+            arbitration_id=request_id,
             data=padded_data,
             is_extended_id=False
         )
@@ -151,11 +396,19 @@ class OBD2Tester:
             self.bus.send(msg)
             print(f"Sent: {' '.join(f'{b:02X}' for b in data)}")
             
-            # Wait for response (timeout 2 seconds)
-            response = self.bus.recv(timeout=2.0)
+            # Wait for response (timeout 2 seconds by default)
+            response = self.bus.recv(timeout=timeout)
+
+            # Response pending (NRC 0x78): the final answer follows within P2*
+            while (response and response.arbitration_id == OBD2_RESPONSE_ID and
+                   response.data[1] == 0x7F and response.data[3] == OBD2_NRC_RESPONSE_PENDING):
+                print(f"Received: {' '.join(f'{b:02X}' for b in response.data)} (pending)")
+                response = self.bus.recv(timeout=5.0)
             
             if response and response.arbitration_id == OBD2_RESPONSE_ID:
                 print(f"Received: {' '.join(f'{b:02X}' for b in response.data)}")
+                if (response.data[0] & 0xF0) == 0x10:
+                    return self.receive_multiframe(response.data)
                 return response.data
             else:
                 print("No response received or wrong ID")
@@ -165,11 +418,54 @@ class OBD2Tester:
             print(f"Error sending request: {e}")
             return None
     
-    def validate_response(self, response, expected_service, expected_pid=None):
+    def receive_multiframe(self, first_frame):
+        """Reassemble an ISO-TP multi-frame response.
+
+        Returns the payload prefixed with its length byte so it can be
+        validated like a single frame response.
+        """
+        total_length = ((first_frame[0] & 0x0F) << 8) | first_frame[1]
+        payload = list(first_frame[2:8])
+
+        # Flow Control: continue to send, no block limit, no separation time
+        flow_control = can.Message(
+            arbitration_id=OBD2_PHYSICAL_REQUEST_ID,
+            data=[0x30, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00],
+            is_extended_id=False
+        )
+        self.bus.send(flow_control)
+
+        expected_sequence = 1
+        while len(payload) < total_length:
+            frame = self.bus.recv(timeout=1.0)
+            if frame is None:
+                print("Timed out waiting for consecutive frame")
+                return None
+            if frame.arbitration_id != OBD2_RESPONSE_ID:
+                continue
+            if frame.data[0] != (0x20 | expected_sequence):
+                print(f"Unexpected consecutive frame: {frame.data[0]:02X}")
+                return None
+            payload.extend(frame.data[1:8])
+            expected_sequence = (expected_sequence + 1) & 0x0F
+
+        payload = payload[:total_length]
+        print(f"Reassembled {total_length} bytes: {' '.join(f'{b:02X}' for b in payload)}")
+        return [min(total_length, 0xFF)] + payload
+
+    def validate_response(self, response, expected_service, expected_pid=None, expected_nrc=None):
         """Validate OBD2 response format and content"""
         if not response or len(response) < 2:
             return False, "Invalid response length"
         
+        # Negative response expected: [7F][service][NRC]
+        if expected_nrc is not None:
+            if response[1] != 0x7F or len(response) < 4 or response[2] != expected_service:
+                return False, f"Expected negative response to 0x{expected_service:02X}"
+            if response[3] != expected_nrc:
+                return False, f"Wrong NRC: expected 0x{expected_nrc:02X}, got 0x{response[3]:02X}"
+            return True, f"Negative response 0x{response[3]:02X}"
+        
         # Check if it's an error response
         if response[1] == 0x7F:
             error_service = response[2] if len(response) > 2 else 0
@@ -221,17 +517,65 @@ class OBD2Tester:
             supported = (data[0] << 24) + (data[1] << 16) + (data[2] << 8) + data[3]
             return f"Supported PIDs: 0x{supported:08X}"
         
-        elif name == 'Stored DTCs' and len(data) >= 1:
-            dtc_count = data[0]
-            return f"DTC Count: {dtc_count}"
+        elif test_case['request'][1] in (0x03, 0x07, 0x0A):
+            # No PID byte for DTC services: [count][DTC hi][DTC lo]...
+            return f"DTC Count: {response[2]} {' '.join(decode_dtcs(response))}"
+        
+        elif name == 'Freeze Frame DTC' and len(data) >= 3:
+            # [frame][DTC hi][DTC lo]
+            raw = (data[1] << 8) | data[2]
+            code = f"{'PCBU'[raw >> 14]}{raw & 0x3FFF:04X}" if raw else "none"
+            return f"Frame {data[0]}: DTC {code}"
+        
+        elif name == 'Freeze Frame RPM' and len(data) >= 3:
+            rpm = ((data[1] << 8) + data[2]) / 4
+            return f"Frame {data[0]}: RPM {rpm:.0f}"
+        
+        elif response[1] == 0x50 and len(data) >= 4:
+            # [P2 ms hi][lo][P2* x10 ms hi][lo]
+            p2 = (data[0] << 8) | data[1]
+            p2_star = ((data[2] << 8) | data[3]) * 10
+            return f"P2: {p2} ms, P2*: {p2_star} ms"
+        
+        elif name == 'Read DID VIN' and len(data) > 1:
+            # [DID lo][17 VIN characters]
+            vin = ''.join(chr(b) for b in data[1:] if 32 <= b <= 126)
+            return f"VIN: '{vin}'"
+        
+        elif name == 'DTC Count By Status Mask' and len(data) >= 4:
+            # [availability mask][format][count hi][count lo]
+            return f"DTC Count: {(data[2] << 8) | data[3]}"
+        
+        elif name == 'DTCs By Status Mask' and len(data) >= 1:
+            # [availability mask] then [DTC hi][DTC lo][failure type][status]...
+            records = [f"{'PCBU'[data[i] >> 6]}{((data[i] & 0x3F) << 8) | data[i + 1]:04X}/{data[i + 3]:02X}"
+                       for i in range(1, len(data) - 3, 4)]
+            return f"DTCs: {' '.join(records) or 'none'}"
+        
+        elif name == 'Supported Monitor IDs' and len(data) >= 4:
+            bitmap = (data[0] << 24) | (data[1] << 16) | (data[2] << 8) | data[3]
+            mids = [f"{i + 1:02X}" for i in range(32) if bitmap & (1 << (31 - i))]
+            return f"Supported MIDs: {' '.join(mids)}"
         
         elif name == 'VIN Message Count' and len(data) >= 1:
             count = data[0]
             return f"VIN Messages: {count}"
         
-        elif name == 'Vehicle Identification Number' and len(data) > 0:
-            vin_part = ''.join(chr(b) for b in data if 32 <= b <= 126)
-            return f"VIN Part: '{vin_part}'"
+        elif name == 'Vehicle Identification Number' and len(data) > 1:
+            # [NODI][17 VIN characters]
+            vin = ''.join(chr(b) for b in data[1:] if 32 <= b <= 126)
+            return f"VIN: '{vin}'"
+        
+        elif name == 'Calibration IDs' and len(data) > 1:
+            # [NODI][16 bytes per calibration ID, zero padded]
+            calids = [bytes(data[i:i + 16]).rstrip(b'\x00').decode('ascii', 'replace')
+                      for i in range(1, 1 + 16 * data[0], 16)]
+            return f"CALIDs: {', '.join(calids)}"
+        
+        elif name == 'ECU Name' and len(data) > 1:
+            # [NODI][acronym x4]['-'][name x15]
+            ecu = bytes(data[1:]).replace(b'\x00', b'').decode('ascii', 'replace')
+            return f"ECU: '{ecu}'"
         
         else:
             return f"Raw data: {' '.join(f'{b:02X}' for b in data)}"
@@ -240,8 +584,37 @@ class OBD2Tester:
         """Run a single test case"""
         print(f"\n--- {test_case['name']} ---")
         print(f"Description: {test_case['description']}")
+
+        if 'console' in test_case:
+            if not self.console:
+                print("SKIP: needs --console")
+                return
+            for command in test_case['console']:
+                if not self.send_command(command):
+                    self.test_results.append({
+                        'name': test_case['name'],
+                        'passed': False,
+                        'error': f"Console command failed: {command}",
+                        'data': None
+                    })
+                    return
+        
+        request_id = OBD2_PHYSICAL_REQUEST_ID if test_case.get('physical') else OBD2_REQUEST_ID
+        if test_case.get('expect_no_response'):
+            # Well past P2 (50 ms): anything arriving is an unwanted answer
+            response = self.send_request(test_case['request'], request_id, timeout=0.5)
+            passed = response is None
+            print("✓ PASS: No response" if passed else "✗ FAIL: Unexpected response")
+            self.test_results.append({
+                'name': test_case['name'],
+                'passed': passed,
+                'error': None if passed else 'Unexpected response',
+                'data': None
+            })
+            time.sleep(0.5)
+            return
         
-        response = self.send_request(test_case['request'])
+        response = self.send_request(test_case['request'], request_id)
         
         if response is None:
             result = {
@@ -253,11 +626,15 @@ class OBD2Tester:
         else:
             valid, message = self.validate_response(
                 response, 
-                test_case['expected_service'], 
-                test_case.get('expected_pid')
+                test_case.get('expected_service', test_case['request'][1]), 
+                test_case.get('expected_pid'),
+                test_case.get('expected_nrc')
             )
+            if valid and 'check' in test_case:
+                valid, message = test_case['check'](response, self.responses)
             
             if valid:
+                self.responses[test_case['name']] = response
                 data_interpretation = self.interpret_data(test_case, response)
                 print(f"✓ PASS: {message}")
                 print(f"Data: {data_interpretation}")
@@ -315,10 +692,12 @@ def main():
                        help='CAN channel (can0, /dev/ttyUSB0, etc.)')
     parser.add_argument('--bitrate', type=int, default=500000,
                        help='CAN bitrate (default: 500000)')
+    parser.add_argument('--console',
+                       help='Emulator serial console (/dev/ttyACM0), enables console driven tests')
     
     args = parser.parse_args()
     
-    tester = OBD2Tester(args.interface, args.channel, args.bitrate)
+    tester = OBD2Tester(args.interface, args.channel, args.bitrate, args.console)
     
     if not tester.connect():
         sys.exit(1)